@@ -46,6 +46,7 @@ dsp_dec_srcs := \
     src/dsp/argb_sse2.c \
     src/dsp/cpu.c \
     src/dsp/dec.c \
+    src/dsp/dec_avx2.c \
     src/dsp/dec_clip_tables.c \
     src/dsp/dec_mips32.c \
     src/dsp/dec_mips_dsp_r2.c \
@@ -57,19 +58,23 @@ dsp_dec_srcs := \
     src/dsp/filters_mips_dsp_r2.c \
     src/dsp/filters_sse2.c \
     src/dsp/lossless.c \
+    src/dsp/lossless_avx2.c \
     src/dsp/lossless_mips_dsp_r2.c \
     src/dsp/lossless_neon.$(NEON) \
     src/dsp/lossless_sse2.c \
     src/dsp/rescaler.c \
+    src/dsp/rescaler_avx2.c \
     src/dsp/rescaler_mips32.c \
     src/dsp/rescaler_mips_dsp_r2.c \
     src/dsp/rescaler_neon.$(NEON) \
     src/dsp/rescaler_sse2.c \
     src/dsp/upsampling.c \
+    src/dsp/upsampling_avx2.c \
     src/dsp/upsampling_mips_dsp_r2.c \
     src/dsp/upsampling_neon.$(NEON) \
     src/dsp/upsampling_sse2.c \
     src/dsp/yuv.c \
+    src/dsp/yuv_avx2.c \
     src/dsp/yuv_mips32.c \
     src/dsp/yuv_mips_dsp_r2.c \
     src/dsp/yuv_sse2.c \
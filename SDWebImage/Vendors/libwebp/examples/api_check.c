@@ -0,0 +1,505 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Checks of the decoding and encoding APIs on synthetic pictures.
+//
+//  Each check runs generated pictures through a public API and compares the
+//  result with a reference one, e.g. the output of an incremental decoding
+//  with the one of WebPDecode(). The exit code is non-zero if any check
+//  fails.
+//
+//  Usage: api_check [check_name ...]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "webp/decode.h"
+#include "webp/encode.h"
+
+//------------------------------------------------------------------------------
+// Random generator and synthetic pictures
+
+static uint32_t Random(uint32_t* const seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  return *seed >> 8;
+}
+
+static int RandomRange(uint32_t* const seed, int min, int max) {
+  return min + (int)(Random(seed) % (uint32_t)(max - min + 1));
+}
+
+// Fills 'pic' with smooth gradients, a few discs and some noise, all in the
+// ARGB samples. The alpha channel is a gradient too, if 'has_alpha' is true.
+static int MakePicture(int width, int height, int has_alpha, uint32_t seed,
+                       WebPPicture* const pic) {
+  int cx[8], cy[8], r2[8], dv[8][3];
+  int x, y, k;
+  if (!WebPPictureInit(pic)) return 0;
+  pic->width = width;
+  pic->height = height;
+  pic->use_argb = 1;
+  if (!WebPPictureAlloc(pic)) return 0;
+  for (k = 0; k < 8; ++k) {
+    const int r = RandomRange(&seed, width / 16 + 1, width / 3 + 1);
+    cx[k] = RandomRange(&seed, 0, width - 1);
+    cy[k] = RandomRange(&seed, 0, height - 1);
+    r2[k] = r * r;
+    dv[k][0] = RandomRange(&seed, -60, 60);
+    dv[k][1] = RandomRange(&seed, -60, 60);
+    dv[k][2] = RandomRange(&seed, -60, 60);
+  }
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; ++x) {
+      uint32_t argb = 0;
+      int c;
+      for (c = 0; c < 3; ++c) {
+        int v = 128 + (int)(60. * sin(x / 37. + c) * cos(y / 29. - c));
+        for (k = 0; k < 8; ++k) {
+          const int dx = x - cx[k], dy = y - cy[k];
+          if (dx * dx + dy * dy < r2[k]) v += dv[k][c];
+        }
+        v += RandomRange(&seed, -3, 3);
+        v = (v < 0) ? 0 : (v > 255) ? 255 : v;
+        argb |= (uint32_t)v << (16 - 8 * c);
+      }
+      argb |= (has_alpha ? (uint32_t)(255 * (x + y) / (width + height))
+                         : 0xffu) << 24;
+      pic->argb[y * pic->argb_stride + x] = argb;
+    }
+  }
+  return 1;
+}
+
+// Encodes 'pic' with 'config'. Returns false in case of error.
+static int Encode(const WebPConfig* const config, WebPPicture* const pic,
+                  WebPMemoryWriter* const writer) {
+  WebPMemoryWriterInit(writer);
+  pic->writer = WebPMemoryWrite;
+  pic->custom_ptr = writer;
+  if (!WebPEncode(config, pic)) {
+    WebPMemoryWriterClear(writer);
+    return 0;
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Incremental decoding of segmented input
+
+typedef struct {
+  const char* name;
+  int lossless;
+  int has_alpha;
+  int partitions;   // log2 of the number of token partitions (lossy only)
+} SegmentsInput;
+
+static const SegmentsInput kSegmentsInputs[] = {
+  { "lossy, 1 partition", 0, 0, 0 },
+  { "lossy, 2 partitions", 0, 0, 1 },
+  { "lossy, 4 partitions", 0, 0, 2 },
+  { "lossy, 8 partitions", 0, 0, 3 },
+  { "lossy + alpha, 8 partitions", 0, 1, 3 },
+  { "lossless + alpha", 1, 1, 0 },
+};
+#define NUM_SEGMENTS_INPUTS \
+    ((int)(sizeof(kSegmentsInputs) / sizeof(kSegmentsInputs[0])))
+
+// How the bitstream is cut into segments and handed to WebPIAppendSegments().
+typedef enum {
+  SPLIT_WHOLE = 0,     // one segment
+  SPLIT_RANDOM,        // random sizes, a few segments per call
+  SPLIT_TINY,          // 1 to 3 bytes per segment, all of them in one call
+  SPLIT_LAST
+} SplitMode;
+
+static const char* const kSplitNames[SPLIT_LAST] = {
+  "whole", "random", "tiny"
+};
+
+// Decodes 'data' as RGBA through WebPIAppendSegments(). Returns the status of
+// the last call, and the decoded samples in '*rgba' on success.
+static VP8StatusCode DecodeSegments(const uint8_t* const data, size_t size,
+                                    SplitMode mode, uint32_t seed,
+                                    int width, int height,
+                                    uint8_t** const rgba) {
+  WebPISegment* const segments =
+      (WebPISegment*)malloc((size + 1) * sizeof(*segments));
+  WebPIDecoder* idec;
+  VP8StatusCode status = VP8_STATUS_OUT_OF_MEMORY;
+  size_t pos = 0;
+  int num_segments = 0;
+  int first = 0;
+  *rgba = NULL;
+  if (segments == NULL) return status;
+  while (pos < size) {
+    size_t len = size - pos;
+    if (mode == SPLIT_RANDOM) {
+      len = (size_t)RandomRange(&seed, 1, 2000);
+    } else if (mode == SPLIT_TINY) {
+      len = (size_t)RandomRange(&seed, 1, 3);
+    }
+    if (len > size - pos) len = size - pos;
+    segments[num_segments].data = data + pos;
+    segments[num_segments].size = len;
+    ++num_segments;
+    pos += len;
+  }
+  idec = WebPINewRGB(MODE_RGBA, NULL, 0, 0);
+  if (idec == NULL) goto End;
+  status = VP8_STATUS_SUSPENDED;
+  while (first < num_segments && status == VP8_STATUS_SUSPENDED) {
+    const int n = (mode == SPLIT_RANDOM) ?
+        RandomRange(&seed, 1, 4) : num_segments - first;
+    const int count = (n < num_segments - first) ? n : num_segments - first;
+    status = WebPIAppendSegments(idec, segments + first, count);
+    first += count;
+  }
+  if (status == VP8_STATUS_OK) {
+    int w, h, stride, y;
+    const uint8_t* const out = WebPIDecGetRGB(idec, NULL, &w, &h, &stride);
+    *rgba = (uint8_t*)malloc((size_t)width * height * 4);
+    if (out == NULL || w != width || h != height) {
+      status = VP8_STATUS_BITSTREAM_ERROR;
+    } else if (*rgba == NULL) {
+      status = VP8_STATUS_OUT_OF_MEMORY;
+    } else {
+      for (y = 0; y < height; ++y) {
+        memcpy(*rgba + (size_t)y * width * 4, out + (size_t)y * stride,
+               (size_t)width * 4);
+      }
+    }
+  }
+  WebPIDelete(idec);
+ End:
+  free(segments);
+  return status;
+}
+
+static int CheckIDecSegments(void) {
+  const int width = 211, height = 157;
+  int ok = 1;
+  int i, mode;
+  for (i = 0; i < NUM_SEGMENTS_INPUTS; ++i) {
+    const SegmentsInput* const in = &kSegmentsInputs[i];
+    WebPConfig config;
+    WebPPicture pic;
+    WebPMemoryWriter writer;
+    uint8_t* ref;
+    if (!WebPConfigInit(&config) ||
+        !MakePicture(width, height, in->has_alpha, 17 + i, &pic)) {
+      return 0;
+    }
+    config.lossless = in->lossless;
+    config.partitions = in->partitions;
+    config.low_memory = 1;   // the token buffer limits to 1 partition
+    if (!Encode(&config, &pic, &writer)) {
+      WebPPictureFree(&pic);
+      return 0;
+    }
+    WebPPictureFree(&pic);
+    ref = WebPDecodeRGBA(writer.mem, writer.size, NULL, NULL);
+    for (mode = 0; mode < SPLIT_LAST; ++mode) {
+      uint8_t* rgba;
+      const VP8StatusCode status =
+          DecodeSegments(writer.mem, writer.size, (SplitMode)mode, 31 + mode,
+                         width, height, &rgba);
+      const int match = (ref != NULL && status == VP8_STATUS_OK &&
+                         !memcmp(rgba, ref, (size_t)width * height * 4));
+      printf("  %-28s %-7s %s", in->name, kSplitNames[mode],
+             match ? "ok\n" : "FAILED");
+      if (!match) printf(" (status %d)\n", status);
+      ok &= match;
+      free(rgba);
+    }
+    WebPFree(ref);
+    WebPMemoryWriterClear(&writer);
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Multi-threaded rescaling
+
+// Decodes 'data' into 'output' with the Lanczos filter, using 'num_threads'
+// threads (none if 0).
+static int DecodeScaled(const uint8_t* const data, size_t size,
+                        WEBP_CSP_MODE colorspace, int width, int height,
+                        int num_threads, WebPDecBuffer* const output) {
+  WebPDecoderConfig config;
+  if (!WebPInitDecoderConfig(&config)) return 0;
+  config.output.colorspace = colorspace;
+  config.options.use_scaling = 1;
+  config.options.scaled_width = width;
+  config.options.scaled_height = height;
+  config.options.rescaling_filter = WEBP_RESCALE_LANCZOS3;
+  config.options.use_threads = (num_threads > 0);
+  config.options.num_threads = num_threads;
+  if (WebPDecode(data, size, &config) != VP8_STATUS_OK) return 0;
+  *output = config.output;
+  return 1;
+}
+
+static int SameDecBuffers(const WebPDecBuffer* const a,
+                          const WebPDecBuffer* const b) {
+  if (WebPIsRGBMode(a->colorspace)) {
+    return (a->u.RGBA.size == b->u.RGBA.size &&
+            !memcmp(a->u.RGBA.rgba, b->u.RGBA.rgba, a->u.RGBA.size));
+  } else {
+    const WebPYUVABuffer* const p = &a->u.YUVA;
+    const WebPYUVABuffer* const q = &b->u.YUVA;
+    return (p->y_size == q->y_size && !memcmp(p->y, q->y, p->y_size) &&
+            p->u_size == q->u_size && !memcmp(p->u, q->u, p->u_size) &&
+            p->v_size == q->v_size && !memcmp(p->v, q->v, p->v_size) &&
+            p->a_size == q->a_size &&
+            (p->a_size == 0 || !memcmp(p->a, q->a, p->a_size)));
+  }
+}
+
+// The output of a rescaling split into column strips must be the same as the
+// single-threaded one.
+static int CheckRescaleThreads(void) {
+  static const int kSizes[][2] = { { 300, 200 }, { 530, 411 }, { 129, 31 } };
+  static const int kThreads[] = { 1, 4, 16 };
+  const int width = 400, height = 300;
+  int ok = 1;
+  int has_alpha, mode, s, t;
+  for (has_alpha = 0; has_alpha <= 1; ++has_alpha) {
+    WebPConfig config;
+    WebPPicture pic;
+    WebPMemoryWriter writer;
+    if (!WebPConfigInit(&config) ||
+        !MakePicture(width, height, has_alpha, 5 + has_alpha, &pic)) {
+      return 0;
+    }
+    if (!Encode(&config, &pic, &writer)) {
+      WebPPictureFree(&pic);
+      return 0;
+    }
+    WebPPictureFree(&pic);
+    for (mode = MODE_RGB; mode < MODE_LAST; ++mode) {
+      int match = 1;
+      for (s = 0; s < (int)(sizeof(kSizes) / sizeof(kSizes[0])); ++s) {
+        WebPDecBuffer ref;
+        if (!DecodeScaled(writer.mem, writer.size, (WEBP_CSP_MODE)mode,
+                          kSizes[s][0], kSizes[s][1], 0, &ref)) {
+          match = 0;
+          continue;
+        }
+        for (t = 0; t < (int)(sizeof(kThreads) / sizeof(kThreads[0])); ++t) {
+          WebPDecBuffer out;
+          if (!DecodeScaled(writer.mem, writer.size, (WEBP_CSP_MODE)mode,
+                            kSizes[s][0], kSizes[s][1], kThreads[t], &out)) {
+            match = 0;
+            continue;
+          }
+          match &= SameDecBuffers(&ref, &out);
+          WebPFreeDecBuffer(&out);
+        }
+        WebPFreeDecBuffer(&ref);
+      }
+      printf("  %-10s mode %-2d %s\n", has_alpha ? "alpha" : "opaque", mode,
+             match ? "ok" : "FAILED");
+      ok &= match;
+    }
+    WebPMemoryWriterClear(&writer);
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Target size search
+
+// Returns the relative error on 'target_size' of 'pic' encoded with 'method'
+// and 'thread_level', or a negative value in case of error.
+static double TargetSizeError(WebPPicture* const pic, int method,
+                              int target_size, int thread_level) {
+  WebPConfig config;
+  WebPMemoryWriter writer;
+  double error;
+  if (!WebPConfigInit(&config)) return -1.;
+  config.method = method;
+  config.target_size = target_size;
+  config.pass = 6;   // as set by cwebp -size
+  config.thread_level = thread_level;
+  if (!Encode(&config, pic, &writer)) return -1.;
+  error = fabs((double)writer.size - target_size) / target_size;
+  WebPMemoryWriterClear(&writer);
+  return error;
+}
+
+// The multi-threaded quantizer search must reach the target size about as
+// closely as the sequential one.
+static int CheckTargetSize(void) {
+  static const int kMethods[] = { 3, 4, 6 };
+  static const int kTargets[] = { 4000, 10000, 25000 };
+  static const int kThreadLevels[] = { 2, 3, 8 };
+  const double max_extra_error = 0.05;
+  WebPPicture pic;
+  int ok = 1;
+  int m, s, t;
+  if (!MakePicture(320, 240, 0, 3, &pic)) return 0;
+  for (m = 0; m < (int)(sizeof(kMethods) / sizeof(kMethods[0])); ++m) {
+    for (s = 0; s < (int)(sizeof(kTargets) / sizeof(kTargets[0])); ++s) {
+      const double ref_error =
+          TargetSizeError(&pic, kMethods[m], kTargets[s], 0);
+      printf("  method %d target %-6d error %5.1f%%", kMethods[m],
+             kTargets[s], 100. * ref_error);
+      for (t = 0; t < (int)(sizeof(kThreadLevels) /
+                            sizeof(kThreadLevels[0])); ++t) {
+        const double error = TargetSizeError(&pic, kMethods[m], kTargets[s],
+                                             kThreadLevels[t]);
+        const int match = (ref_error >= 0. && error >= 0. &&
+                           error <= ref_error + max_extra_error);
+        printf(", threads %d: %5.1f%%%s", kThreadLevels[t], 100. * error,
+               match ? "" : " FAILED");
+        ok &= match;
+      }
+      printf("\n");
+    }
+  }
+  WebPPictureFree(&pic);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Memory policy
+
+typedef struct {
+  size_t live;        // number of bytes currently allocated
+  size_t peak;
+  int num_blocks;     // number of blocks currently allocated
+} MemoryTracker;
+
+// The size of each block is stored in front of it.
+#define BLOCK_HEADER 16
+
+static void* TrackedMalloc(size_t size, void* opaque) {
+  MemoryTracker* const tracker = (MemoryTracker*)opaque;
+  uint8_t* const mem = (uint8_t*)malloc(size + BLOCK_HEADER);
+  if (mem == NULL) return NULL;
+  memcpy(mem, &size, sizeof(size));
+  tracker->live += size;
+  if (tracker->live > tracker->peak) tracker->peak = tracker->live;
+  ++tracker->num_blocks;
+  return mem + BLOCK_HEADER;
+}
+
+static void TrackedFree(void* ptr, void* opaque) {
+  MemoryTracker* const tracker = (MemoryTracker*)opaque;
+  uint8_t* const mem = (uint8_t*)ptr - BLOCK_HEADER;
+  size_t size;
+  memcpy(&size, mem, sizeof(size));
+  tracker->live -= size;
+  --tracker->num_blocks;
+  free(mem);
+}
+
+// Encodes 'pic' with 'thread_level' and a policy of the given 'budget'.
+// Returns the encoding error, and the peak usage of the policy's allocator.
+static WebPEncodingError EncodeWithBudget(WebPPicture* const pic,
+                                          int thread_level, size_t budget,
+                                          size_t* const peak) {
+  MemoryTracker tracker;
+  WebPMemoryPolicy policy;
+  WebPConfig config;
+  WebPMemoryWriter writer;
+  if (!WebPConfigInit(&config)) return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+  memset(&tracker, 0, sizeof(tracker));
+  policy.malloc_func = TrackedMalloc;
+  policy.free_func = TrackedFree;
+  policy.opaque = &tracker;
+  policy.budget = budget;
+  config.memory = &policy;
+  config.method = 4;
+  config.thread_level = thread_level;
+  pic->error_code = VP8_ENC_OK;
+  if (Encode(&config, pic, &writer)) WebPMemoryWriterClear(&writer);
+  *peak = tracker.peak;
+  if (tracker.num_blocks != 0 || tracker.live != 0) {
+    return VP8_ENC_ERROR_LAST;   // leaked in the policy
+  }
+  return pic->error_code;
+}
+
+// The budget must hold when the worker threads allocate too: all the working
+// memory, including the scope's bookkeeping, goes through the policy and is
+// released at the end of the call.
+static int CheckMemoryBudget(void) {
+  static const int kThreadLevels[] = { 0, 1, 4 };
+  WebPPicture pic;
+  int ok = 1;
+  int t;
+  if (!MakePicture(640, 480, 1, 11, &pic)) return 0;
+  for (t = 0; t < (int)(sizeof(kThreadLevels) / sizeof(kThreadLevels[0]));
+       ++t) {
+    size_t peak, budget_peak;
+    const WebPEncodingError error =
+        EncodeWithBudget(&pic, kThreadLevels[t], 0, &peak);
+    const size_t budget = peak / 2;
+    const WebPEncodingError budget_error =
+        EncodeWithBudget(&pic, kThreadLevels[t], budget, &budget_peak);
+    const int match = (error == VP8_ENC_OK && peak > 0 &&
+                       budget_error == VP8_ENC_ERROR_MEMORY_BUDGET &&
+                       budget_peak <= budget);
+    printf("  threads %d: peak %d, with a budget of %d: peak %d, error %d %s\n",
+           kThreadLevels[t], (int)peak, (int)budget, (int)budget_peak,
+           budget_error, match ? "ok" : "FAILED");
+    ok &= match;
+  }
+  WebPPictureFree(&pic);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+
+typedef struct {
+  const char* name;
+  int (*run)(void);
+} Check;
+
+static const Check kChecks[] = {
+  { "idec_segments", CheckIDecSegments },
+  { "rescale_threads", CheckRescaleThreads },
+  { "target_size", CheckTargetSize },
+  { "memory_budget", CheckMemoryBudget },
+};
+#define NUM_CHECKS ((int)(sizeof(kChecks) / sizeof(kChecks[0])))
+
+static int IsSelected(int argc, const char* argv[], const char* const name) {
+  int i;
+  if (argc <= 1) return 1;
+  for (i = 1; i < argc; ++i) {
+    if (strstr(name, argv[i]) != NULL) return 1;
+  }
+  return 0;
+}
+
+int main(int argc, const char* argv[]) {
+  int ok = 1;
+  int i;
+  if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "-help"))) {
+    printf("Usage: api_check [check_name ...]\n"
+           "Only the checks whose name contains one of the 'check_name'\n"
+           "arguments are run, if any. Checks:");
+    for (i = 0; i < NUM_CHECKS; ++i) printf(" %s", kChecks[i].name);
+    printf("\n");
+    return 0;
+  }
+  for (i = 0; i < NUM_CHECKS; ++i) {
+    int check_ok;
+    if (!IsSelected(argc, argv, kChecks[i].name)) continue;
+    printf("%s\n", kChecks[i].name);
+    check_ok = kChecks[i].run();
+    printf("%s: %s\n", kChecks[i].name, check_ok ? "ok" : "FAILED");
+    ok &= check_ok;
+  }
+  return ok ? 0 : 1;
+}
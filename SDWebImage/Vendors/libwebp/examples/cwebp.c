@@ -190,6 +190,20 @@ static void PrintExtraInfoLossless(const WebPPicture* const pic,
   }
 }
 
+// The timings are only available if libwebp was built with WEBP_STAGE_TIMING.
+static void PrintStageStats(const WebPEncStageStats* const stats) {
+  const double ms = 1e-6;
+  if (stats->total_ns == 0) return;
+  fprintf(stderr, "Encoding stages (ms): conversion %.3f, analysis %.3f, "
+                  "transforms %.3f, coding %.3f\n",
+          stats->convert_ns * ms, stats->analysis_ns * ms,
+          stats->transform_ns * ms, stats->coding_ns * ms);
+  fprintf(stderr, "                      bitstream %.3f, alpha %.3f, "
+                  "total %.3f\n",
+          stats->bitstream_ns * ms, stats->alpha_ns * ms,
+          stats->total_ns * ms);
+}
+
 static void PrintExtraInfoLossy(const WebPPicture* const pic, int short_output,
                                 int full_details,
                                 const char* const file_name) {
@@ -526,7 +540,8 @@ static void HelpLong(void) {
   printf("  -z <int> ............... activates lossless preset with given\n"
          "                           level in [0:fast, ..., 9:slowest]\n");
   printf("\n");
-  printf("  -m <int> ............... compression method (0=fast, 6=slowest)\n");
+  printf("  -m <int> ............... compression method (0=fast, 6=slowest),\n");
+  printf("                           -1 for the lossy realtime mode\n");
   printf("  -segments <int> ........ number of segments to use (1..4)\n");
   printf("  -size <int> ............ target size (in bytes)\n");
   printf("  -psnr <float> .......... target PSNR (in dB. typically: 42)\n");
@@ -545,7 +560,10 @@ static void HelpLong(void) {
   printf("  -pass <int> ............ analysis pass number (1..10)\n");
   printf("  -crop <x> <y> <w> <h> .. crop picture with the given rectangle\n");
   printf("  -resize <w> <h> ........ resize picture (after any cropping)\n");
+  printf("  -lanczos ............... use a Lanczos filter for -resize\n");
   printf("  -mt .................... use multi-threading if available\n");
+  printf("  -threads <int> ......... number of threads coding the lossy\n"
+         "                           macroblocks and resizing (implies -mt)\n");
   printf("  -low_memory ............ reduce memory usage (slower encoding)\n");
   printf("  -map <int> ............. print map of extra info\n");
   printf("  -print_psnr ............ prints averaged PSNR distortion\n");
@@ -615,7 +633,8 @@ static const char* const kErrorMessages[VP8_ENC_ERROR_LAST] = {
   "PARTITION_OVERFLOW: Partition is too big to fit 16M",
   "BAD_WRITE: Picture writer returned an I/O error",
   "FILE_TOO_BIG: File would be too big to fit in 4G",
-  "USER_ABORT: encoding abort requested by user"
+  "USER_ABORT: encoding abort requested by user",
+  "MEMORY_BUDGET: encoding needs more memory than allowed"
 };
 
 //------------------------------------------------------------------------------
@@ -632,6 +651,7 @@ int main(int argc, const char *argv[]) {
   uint32_t background_color = 0xffffffu;
   int crop = 0, crop_x = 0, crop_y = 0, crop_w = 0, crop_h = 0;
   int resize_w = 0, resize_h = 0;
+  WebPRescalingFilter resize_filter = WEBP_RESCALE_BOX;
   int lossless_preset = 6;
   int use_lossless_preset = -1;  // -1=unset, 0=don't use, 1=use it
   int show_progress = 0;
@@ -642,6 +662,7 @@ int main(int argc, const char *argv[]) {
   WebPPicture original_picture;    // when PSNR or SSIM is requested
   WebPConfig config;
   WebPAuxStats stats;
+  WebPEncStageStats stage_stats;
   WebPMemoryWriter memory_writer;
   Metadata metadata;
   Stopwatch stop_watch;
@@ -767,6 +788,8 @@ int main(int argc, const char *argv[]) {
       config.emulate_jpeg_size = 1;
     } else if (!strcmp(argv[c], "-mt")) {
       ++config.thread_level;  // increase thread level
+    } else if (!strcmp(argv[c], "-threads") && c < argc - 1) {
+      config.thread_level = ExUtilGetInt(argv[++c], 0, &parse_error);
     } else if (!strcmp(argv[c], "-low_memory")) {
       config.low_memory = 1;
     } else if (!strcmp(argv[c], "-strong")) {
@@ -794,6 +817,8 @@ int main(int argc, const char *argv[]) {
     } else if (!strcmp(argv[c], "-resize") && c < argc - 2) {
       resize_w = ExUtilGetInt(argv[++c], 0, &parse_error);
       resize_h = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-lanczos")) {
+      resize_filter = WEBP_RESCALE_LANCZOS3;
 #ifndef WEBP_DLL
     } else if (!strcmp(argv[c], "-noasm")) {
       VP8GetCPUInfo = NULL;
@@ -997,7 +1022,8 @@ int main(int argc, const char *argv[]) {
     }
   }
   if ((resize_w | resize_h) > 0) {
-    if (!WebPPictureRescale(&picture, resize_w, resize_h)) {
+    if (!WebPPictureRescaleWithFilter(&picture, resize_w, resize_h,
+                                      resize_filter, config.thread_level)) {
       fprintf(stderr, "Error! Cannot resize picture\n");
       goto Error;
     }
@@ -1016,6 +1042,7 @@ int main(int argc, const char *argv[]) {
 
   // Compress.
   if (verbose) {
+    config.stage_stats = &stage_stats;
     StopwatchReset(&stop_watch);
   }
   if (!WebPEncode(&config, &picture)) {
@@ -1027,6 +1054,7 @@ int main(int argc, const char *argv[]) {
   if (verbose) {
     const double encode_time = StopwatchReadAndReset(&stop_watch);
     fprintf(stderr, "Time to encode picture: %.3fs\n", encode_time);
+    PrintStageStats(&stage_stats);
   }
 
   // Write info
@@ -0,0 +1,1908 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Conformance check and micro-benchmark of the DSP functions.
+//
+//  Each function pointer set up by the DSP init functions is exercised with
+//  every implementation the CPU supports (plain C, SSE2, SSE4.1, AVX2, NEON,
+//  MIPS...) on random inputs. The results are compared bit for bit with the
+//  plain-C ones and the speed is reported in cycles (or nanoseconds) per
+//  pixel. The exit code is non-zero if any implementation mismatches.
+//
+//  Usage: dsp_bench [options] [function_name ...]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "webp/decode.h"
+#include "dec/common.h"
+#include "dsp/dsp.h"
+#include "dsp/lossless.h"
+#include "enc/histogram.h"
+#include "enc/vp8enci.h"
+#include "utils/rescaler.h"
+#include "./example_util.h"
+#include "./stopwatch.h"
+
+//------------------------------------------------------------------------------
+// Timing
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+static WEBP_INLINE uint64_t ReadTicks(void) {
+  uint32_t lo, hi;
+  __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+#define TICKS_UNIT "cycles"
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+static WEBP_INLINE uint64_t ReadTicks(void) { return __rdtsc(); }
+#define TICKS_UNIT "cycles"
+#else
+static WEBP_INLINE uint64_t ReadTicks(void) {
+  Stopwatch watch;
+  StopwatchReset(&watch);
+#if defined(_WIN32) && !defined(__GNUC__)
+  return (uint64_t)(watch.QuadPart);   // in performance counter units
+#else
+  return (uint64_t)watch.tv_sec * 1000000000u + watch.tv_usec * 1000u;
+#endif
+}
+#define TICKS_UNIT "ns"
+#endif
+
+//------------------------------------------------------------------------------
+// Instruction set levels
+
+static VP8CPUInfo host_cpu_info = NULL;   // VP8GetCPUInfo() at start-up
+
+static int HasFeature(CPUFeature feature) {
+  return (host_cpu_info != NULL) && host_cpu_info(feature);
+}
+
+// Each level has its own function, so that the DSP init functions notice the
+// change of VP8GetCPUInfo and set their pointers up again.
+static int LevelC(CPUFeature feature) {
+  (void)feature;
+  return 0;
+}
+static int LevelSSE2(CPUFeature feature) {
+  return (feature == kSSE2) && HasFeature(feature);
+}
+static int LevelSSE41(CPUFeature feature) {
+  return (feature <= kSSE4_1) && HasFeature(feature);
+}
+static int LevelAVX2(CPUFeature feature) {
+  return (feature <= kAVX2) && HasFeature(feature);
+}
+static int LevelNEON(CPUFeature feature) {
+  return (feature == kNEON) && HasFeature(feature);
+}
+static int LevelMIPS32(CPUFeature feature) {
+  return (feature == kMIPS32) && HasFeature(feature);
+}
+static int LevelMIPSdspR2(CPUFeature feature) {
+  return (feature == kMIPS32 || feature == kMIPSdspR2) && HasFeature(feature);
+}
+static int LevelMSA(CPUFeature feature) {
+  return (feature == kMIPS32 || feature == kMSA) && HasFeature(feature);
+}
+
+typedef struct {
+  const char* name;
+  VP8CPUInfo cpu_info;
+  CPUFeature feature;     // needed by the level (unused for C)
+} Level;
+
+static const Level kLevels[] = {
+  { "C", LevelC, kSSE2 },
+  { "SSE2", LevelSSE2, kSSE2 },
+  { "SSE4.1", LevelSSE41, kSSE4_1 },
+  { "AVX2", LevelAVX2, kAVX2 },
+  { "NEON", LevelNEON, kNEON },
+  { "MIPS32", LevelMIPS32, kMIPS32 },
+  { "MIPSdspR2", LevelMIPSdspR2, kMIPSdspR2 },
+  { "MSA", LevelMSA, kMSA }
+};
+#define NUM_LEVELS ((int)(sizeof(kLevels) / sizeof(kLevels[0])))
+
+static int IsLevelAvailable(int level) {
+  return (level == 0) || HasFeature(kLevels[level].feature);
+}
+
+static void SetLevel(int level) {
+  VP8GetCPUInfo = kLevels[level].cpu_info;
+  VP8DspInit();
+  VP8EncDspInit();
+  VP8SSIMDspInit();
+  VP8EncDspCostInit();
+  VP8EncDspARGBInit();
+  WebPInitSamplers();
+  WebPInitUpsamplers();
+  WebPInitYUV444Converters();
+  WebPInitConvertARGBToYUV();
+  WebPRescalerDspInit();
+  WebPInitAlphaProcessing();
+  VP8FiltersInit();
+  VP8LDspInit();
+  VP8LEncDspInit();
+}
+
+//------------------------------------------------------------------------------
+// Test context
+
+#define BUF_SIZE (16 * 1024)   // size of each buffer
+#define NUM_SRC 4
+#define MAX_RETURNS 16
+#define ROW_LEN 253            // odd, to exercise the tails of the SIMD loops
+#define NUM_LOSSLESS_CODES 256
+
+// Rescaler test dimensions.
+#define RESCALE_SRC_W 67
+#define RESCALE_SRC_H 17
+#define RESCALE_DST_W 29
+#define RESCALE_DST_H 7
+
+typedef struct {
+  uint8_t* src[NUM_SRC];      // inputs, 32b-aligned
+  uint8_t* dst;               // output compared with the plain-C one
+  size_t dst_size;            // number of bytes of 'dst' to compare
+  double ret[MAX_RETURNS];    // returned values, also compared
+  uint32_t seed;
+  int params[4];              // random parameters (thresholds, sizes...)
+  VP8Matrix mtx;
+  VP8LMultipliers mult;
+  WebPRescaler rescaler;
+  rescaler_t work[2 * 4 * 2 * RESCALE_SRC_W];
+  VP8LHistogram* histo[3];
+  uint8_t* mem;
+} Context;
+
+static uint32_t Random(Context* const ctx) {
+  // xorshift32
+  ctx->seed ^= ctx->seed << 13;
+  ctx->seed ^= ctx->seed >> 17;
+  ctx->seed ^= ctx->seed << 5;
+  return ctx->seed;
+}
+
+// Returns a random value in [min, max].
+static int RandomRange(Context* const ctx, int min, int max) {
+  return min + (int)(Random(ctx) % (uint32_t)(max - min + 1));
+}
+
+static void FillRandom(Context* const ctx, uint8_t* const buf, size_t size) {
+  size_t i;
+  for (i = 0; i < size; ++i) buf[i] = (uint8_t)(Random(ctx) >> 24);
+}
+
+// Fills with a noisy gradient, for filters that only act on smooth areas.
+static void FillSmooth(Context* const ctx, uint8_t* const buf, size_t size,
+                       int noise) {
+  int v = RandomRange(ctx, 0, 255);
+  size_t i;
+  for (i = 0; i < size; ++i) {
+    v += RandomRange(ctx, -noise, noise);
+    buf[i] = (uint8_t)((v < 0) ? 0 : (v > 255) ? 255 : v);
+  }
+}
+
+// Fills 'rows' rows of 'stride' pixels with 4x4 blocks of levels at most
+// 2 * 'step' apart, plus some noise: like a picture before loop filtering, so
+// that the filters act on the block edges with all kinds of deltas.
+static void FillBlocky(Context* const ctx, uint8_t* const buf, int stride,
+                       int rows, int step, int noise) {
+  const int base = RandomRange(ctx, step, 255 - step);
+  int x, y;
+  for (y = 0; y < rows; y += 4) {
+    for (x = 0; x < stride; x += 4) {
+      const int level = base + RandomRange(ctx, -step, step);
+      int i, j;
+      for (j = 0; j < 4 && y + j < rows; ++j) {
+        for (i = 0; i < 4 && x + i < stride; ++i) {
+          const int v = level + RandomRange(ctx, -noise, noise);
+          buf[(y + j) * stride + x + i] =
+              (uint8_t)((v < 0) ? 0 : (v > 255) ? 255 : v);
+        }
+      }
+    }
+  }
+}
+
+static void FillRandom16(Context* const ctx, int16_t* const buf, int size,
+                         int min, int max) {
+  int i;
+  for (i = 0; i < size; ++i) buf[i] = (int16_t)RandomRange(ctx, min, max);
+}
+
+// Premultiplied ARGB: the color channels don't exceed alpha.
+static void FillPremultiplied(Context* const ctx, uint32_t* const buf,
+                              int size) {
+  int i;
+  for (i = 0; i < size; ++i) {
+    const int a = (Random(ctx) & 3) ? RandomRange(ctx, 0, 255) : 0xff;
+    buf[i] = ((uint32_t)a << 24) |
+             ((uint32_t)RandomRange(ctx, 0, a) << 16) |
+             ((uint32_t)RandomRange(ctx, 0, a) << 8) |
+             (uint32_t)RandomRange(ctx, 0, a);
+  }
+}
+
+// Histogram-like population with runs of zeros and repeated values.
+static void FillPopulation(Context* const ctx, uint32_t* const buf, int size,
+                           uint32_t max) {
+  int i = 0;
+  while (i < size) {
+    const int run = RandomRange(ctx, 1, 8);
+    const uint32_t v = (Random(ctx) & 1) ? 0 : Random(ctx) % (max + 1);
+    int j;
+    for (j = 0; j < run && i < size; ++j) buf[i++] = v;
+  }
+}
+
+static int InitContext(Context* const ctx) {
+  int i;
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->mem = (uint8_t*)malloc((NUM_SRC + 1) * BUF_SIZE + 31);
+  if (ctx->mem == NULL) return 0;
+  for (i = 0; i < NUM_SRC; ++i) {
+    ctx->src[i] = (uint8_t*)(((uintptr_t)ctx->mem + 31) & ~(uintptr_t)31) +
+                  i * BUF_SIZE;
+  }
+  ctx->dst = ctx->src[NUM_SRC - 1] + BUF_SIZE;
+  for (i = 0; i < 3; ++i) {
+    ctx->histo[i] = VP8LAllocateHistogram(0);
+    if (ctx->histo[i] == NULL) return 0;
+  }
+  return 1;
+}
+
+static void ClearContext(Context* const ctx) {
+  int i;
+  for (i = 0; i < 3; ++i) VP8LFreeHistogram(ctx->histo[i]);
+  free(ctx->mem);
+}
+
+// Prepares the inputs of a test. 'index' is the entry of the function table.
+typedef void (*SetupFunc)(Context* const ctx, int index);
+// Calls the function under test once.
+typedef void (*CallFunc)(Context* const ctx, int index);
+// Returns the function currently installed, or NULL if there is none. Used to
+// recognize the levels sharing an implementation.
+typedef void (*GenericFunc)(void);
+typedef GenericFunc (*GetFunc)(int index);
+
+#define FUNC(f) ((GenericFunc)(f))
+
+typedef struct {
+  const char* name;
+  int num_entries;        // number of entries of the function table, or 1
+  int pixels;             // pixels (or coefficients) processed per call
+  double tolerance;       // relative tolerance on 'ret', for floating point
+  SetupFunc setup;
+  CallFunc call;
+  GetFunc get;            // NULL for tests covering several functions
+  CallFunc collect;       // if not NULL, gathers the outputs into 'dst'
+} DspTest;
+
+//------------------------------------------------------------------------------
+// Decoding: transforms, intra predictions, loop filters, dithering
+
+#define COEFFS(ctx) ((int16_t*)(ctx)->src[0])
+
+static void SetupTransform(Context* const ctx, int index) {
+  int i;
+  FillRandom16(ctx, COEFFS(ctx), 64, -1024, 1023);
+  if (index == 1) {   // AC3: only in[0], in[1] and in[4]
+    for (i = 0; i < 16; ++i) {
+      if (i != 0 && i != 1 && i != 4) COEFFS(ctx)[i] = 0;
+    }
+  } else if (index == 2) {   // DC-only, for each of the four blocks
+    for (i = 0; i < 64; ++i) {
+      if (i & 15) COEFFS(ctx)[i] = 0;
+    }
+  }
+  FillRandom(ctx, ctx->dst, 8 * BPS);
+  ctx->dst_size = 8 * BPS;
+}
+
+static void CallTransform(Context* const ctx, int index) {
+  (void)index;
+  VP8Transform(COEFFS(ctx), ctx->dst, 1);
+}
+static GenericFunc GetTransform(int index) {
+  (void)index;
+  return FUNC(VP8Transform);
+}
+
+static void SetupTransformAC3(Context* const ctx, int index) {
+  (void)index;
+  SetupTransform(ctx, 1);
+}
+static void CallTransformAC3(Context* const ctx, int index) {
+  (void)index;
+  VP8TransformAC3(COEFFS(ctx), ctx->dst);
+}
+static GenericFunc GetTransformAC3(int index) {
+  (void)index;
+  return FUNC(VP8TransformAC3);
+}
+
+static void CallTransformUV(Context* const ctx, int index) {
+  (void)index;
+  VP8TransformUV(COEFFS(ctx), ctx->dst);
+}
+static GenericFunc GetTransformUV(int index) {
+  (void)index;
+  return FUNC(VP8TransformUV);
+}
+
+static void SetupTransformDC(Context* const ctx, int index) {
+  (void)index;
+  SetupTransform(ctx, 2);
+}
+static void CallTransformDC(Context* const ctx, int index) {
+  (void)index;
+  VP8TransformDC(COEFFS(ctx), ctx->dst);
+}
+static GenericFunc GetTransformDC(int index) {
+  (void)index;
+  return FUNC(VP8TransformDC);
+}
+
+static void CallTransformDCUV(Context* const ctx, int index) {
+  (void)index;
+  VP8TransformDCUV(COEFFS(ctx), ctx->dst);
+}
+static GenericFunc GetTransformDCUV(int index) {
+  (void)index;
+  return FUNC(VP8TransformDCUV);
+}
+
+static void SetupTransformWHT(Context* const ctx, int index) {
+  (void)index;
+  FillRandom16(ctx, COEFFS(ctx), 16, -2048, 2047);
+  memset(ctx->dst, 0, 256 * sizeof(int16_t));
+  ctx->dst_size = 256 * sizeof(int16_t);
+}
+static void CallTransformWHT(Context* const ctx, int index) {
+  (void)index;
+  VP8TransformWHT(COEFFS(ctx), (int16_t*)ctx->dst);
+}
+static GenericFunc GetTransformWHT(int index) {
+  (void)index;
+  return FUNC(VP8TransformWHT);
+}
+
+// The predicted block is at 'dst + PRED_OFFSET', with its top row and left
+// column available.
+#define PRED_OFFSET (BPS + 8)
+
+static void SetupPred(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->dst, 18 * BPS);
+  ctx->dst_size = 18 * BPS;
+}
+
+static void CallPredLuma4(Context* const ctx, int index) {
+  VP8PredLuma4[index](ctx->dst + PRED_OFFSET);
+}
+static GenericFunc GetPredLuma4(int index) {
+  return FUNC(VP8PredLuma4[index]);
+}
+
+static void CallPredLuma16(Context* const ctx, int index) {
+  VP8PredLuma16[index](ctx->dst + PRED_OFFSET);
+}
+static GenericFunc GetPredLuma16(int index) {
+  return FUNC(VP8PredLuma16[index]);
+}
+
+static void CallPredChroma8(Context* const ctx, int index) {
+  VP8PredChroma8[index](ctx->dst + PRED_OFFSET);
+}
+static GenericFunc GetPredChroma8(int index) {
+  return FUNC(VP8PredChroma8[index]);
+}
+
+// The edge is at 'dst + FILTER_OFFSET', with 4 rows and columns before it and
+// 16 after it. The U and V planes are FILTER_PLANE bytes apart.
+#define FILTER_STRIDE BPS
+#define FILTER_OFFSET (4 * FILTER_STRIDE + 8)
+#define FILTER_PLANE (24 * FILTER_STRIDE)
+
+static void SetupFilter(Context* const ctx, int index) {
+  (void)index;
+  if (RandomRange(ctx, 0, 1)) {
+    FillSmooth(ctx, ctx->dst, 2 * FILTER_PLANE, RandomRange(ctx, 1, 12));
+  } else {
+    FillBlocky(ctx, ctx->dst, FILTER_STRIDE, 2 * FILTER_PLANE / FILTER_STRIDE,
+               RandomRange(ctx, 1, 40), RandomRange(ctx, 0, 3));
+  }
+  ctx->params[0] = RandomRange(ctx, 0, 100);   // thresh
+  ctx->params[1] = RandomRange(ctx, 0, 63);    // ithresh
+  ctx->params[2] = RandomRange(ctx, 0, 2);     // hev_thresh
+  ctx->dst_size = 2 * FILTER_PLANE;
+}
+
+static VP8SimpleFilterFunc* const kSimpleFilters[4] = {
+  &VP8SimpleVFilter16, &VP8SimpleHFilter16,
+  &VP8SimpleVFilter16i, &VP8SimpleHFilter16i
+};
+static const char* const kSimpleFilterNames[4] = {
+  "VP8SimpleVFilter16", "VP8SimpleHFilter16",
+  "VP8SimpleVFilter16i", "VP8SimpleHFilter16i"
+};
+static VP8LumaFilterFunc* const kLumaFilters[4] = {
+  &VP8VFilter16, &VP8HFilter16, &VP8VFilter16i, &VP8HFilter16i
+};
+static const char* const kLumaFilterNames[4] = {
+  "VP8VFilter16", "VP8HFilter16", "VP8VFilter16i", "VP8HFilter16i"
+};
+static VP8ChromaFilterFunc* const kChromaFilters[4] = {
+  &VP8VFilter8, &VP8HFilter8, &VP8VFilter8i, &VP8HFilter8i
+};
+static const char* const kChromaFilterNames[4] = {
+  "VP8VFilter8", "VP8HFilter8", "VP8VFilter8i", "VP8HFilter8i"
+};
+
+static void CallSimpleFilter(Context* const ctx, int index) {
+  (*kSimpleFilters[index])(ctx->dst + FILTER_OFFSET, FILTER_STRIDE,
+                           ctx->params[0]);
+}
+static GenericFunc GetSimpleFilter(int index) {
+  return FUNC(*kSimpleFilters[index]);
+}
+
+static void CallLumaFilter(Context* const ctx, int index) {
+  (*kLumaFilters[index])(ctx->dst + FILTER_OFFSET, FILTER_STRIDE,
+                         ctx->params[0], ctx->params[1], ctx->params[2]);
+}
+static GenericFunc GetLumaFilter(int index) {
+  return FUNC(*kLumaFilters[index]);
+}
+
+static void CallChromaFilter(Context* const ctx, int index) {
+  (*kChromaFilters[index])(ctx->dst + FILTER_OFFSET,
+                           ctx->dst + FILTER_PLANE + FILTER_OFFSET,
+                           FILTER_STRIDE,
+                           ctx->params[0], ctx->params[1], ctx->params[2]);
+}
+static GenericFunc GetChromaFilter(int index) {
+  return FUNC(*kChromaFilters[index]);
+}
+
+static void SetupDither(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->src[0], 64);
+  FillRandom(ctx, ctx->dst, 8 * BPS);
+  ctx->dst_size = 8 * BPS;
+}
+static void CallDither(Context* const ctx, int index) {
+  (void)index;
+  VP8DitherCombine8x8(ctx->src[0], ctx->dst, BPS);
+}
+static GenericFunc GetDither(int index) {
+  (void)index;
+  return FUNC(VP8DitherCombine8x8);
+}
+
+//------------------------------------------------------------------------------
+// Encoding: transforms, metrics, quantization, predictions, SSIM
+
+// VP8TDisto*() weights: a symmetric 4x4 matrix.
+static void SetupWeights(Context* const ctx, uint16_t* const weights) {
+  int i, j;
+  for (i = 0; i < 4; ++i) {
+    for (j = i; j < 4; ++j) {
+      weights[4 * i + j] = weights[4 * j + i] =
+          (uint16_t)RandomRange(ctx, 0, 63);
+    }
+  }
+}
+
+// Two 16x16 blocks with stride BPS, in src[1] and src[2], coefficients in
+// src[0] and weights in src[3].
+static void SetupBlocks(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->src[1], 16 * BPS);
+  FillSmooth(ctx, ctx->src[2], 16 * BPS, 40);
+  FillRandom16(ctx, COEFFS(ctx), 256, -2048, 2047);
+  SetupWeights(ctx, (uint16_t*)ctx->src[3]);
+  memset(ctx->dst, 0, 16 * BPS);
+  ctx->dst_size = 16 * BPS;
+}
+
+static void SetupITransform(Context* const ctx, int index) {
+  SetupBlocks(ctx, index);
+  FillRandom16(ctx, COEFFS(ctx), 32, -1024, 1023);
+}
+
+static void CallITransform(Context* const ctx, int index) {
+  (void)index;
+  VP8ITransform(ctx->src[1], COEFFS(ctx), ctx->dst, 1);
+}
+static GenericFunc GetITransform(int index) {
+  (void)index;
+  return FUNC(VP8ITransform);
+}
+
+static void CallFTransform(Context* const ctx, int index) {
+  (void)index;
+  VP8FTransform(ctx->src[1], ctx->src[2], (int16_t*)ctx->dst);
+}
+static GenericFunc GetFTransform(int index) {
+  (void)index;
+  return FUNC(VP8FTransform);
+}
+
+static void CallFTransform2(Context* const ctx, int index) {
+  (void)index;
+  VP8FTransform2(ctx->src[1], ctx->src[2], (int16_t*)ctx->dst);
+}
+static GenericFunc GetFTransform2(int index) {
+  (void)index;
+  return FUNC(VP8FTransform2);
+}
+
+static void CallFTransformWHT(Context* const ctx, int index) {
+  (void)index;
+  VP8FTransformWHT(COEFFS(ctx), (int16_t*)ctx->dst);
+}
+static GenericFunc GetFTransformWHT(int index) {
+  (void)index;
+  return FUNC(VP8FTransformWHT);
+}
+
+static VP8Metric* const kMetrics[6] = {
+  &VP8SSE16x16, &VP8SSE16x8, &VP8SSE8x8, &VP8SSE4x4, &VP8SAD16x16, &VP8SAD16x8
+};
+static const char* const kMetricNames[6] = {
+  "VP8SSE16x16", "VP8SSE16x8", "VP8SSE8x8", "VP8SSE4x4",
+  "VP8SAD16x16", "VP8SAD16x8"
+};
+
+static void CallMetric(Context* const ctx, int index) {
+  ctx->ret[0] = (*kMetrics[index])(ctx->src[1], ctx->src[2]);
+}
+static GenericFunc GetMetric(int index) {
+  return FUNC(*kMetrics[index]);
+}
+
+static void CallTDisto4x4(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] = VP8TDisto4x4(ctx->src[1], ctx->src[2],
+                             (const uint16_t*)ctx->src[3]);
+}
+static GenericFunc GetTDisto4x4(int index) {
+  (void)index;
+  return FUNC(VP8TDisto4x4);
+}
+
+static void CallTDisto16x16(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] = VP8TDisto16x16(ctx->src[1], ctx->src[2],
+                               (const uint16_t*)ctx->src[3]);
+}
+static GenericFunc GetTDisto16x16(int index) {
+  (void)index;
+  return FUNC(VP8TDisto16x16);
+}
+
+static void CallCopy4x4(Context* const ctx, int index) {
+  (void)index;
+  VP8Copy4x4(ctx->src[1], ctx->dst);
+}
+static GenericFunc GetCopy4x4(int index) {
+  (void)index;
+  return FUNC(VP8Copy4x4);
+}
+
+static void CallCopy16x8(Context* const ctx, int index) {
+  (void)index;
+  VP8Copy16x8(ctx->src[1], ctx->dst);
+}
+static GenericFunc GetCopy16x8(int index) {
+  (void)index;
+  return FUNC(VP8Copy16x8);
+}
+
+// The coefficients, quantized in place, are in 'dst'.
+static void SetupQuantize(Context* const ctx, int index) {
+  int i;
+  (void)index;
+  for (i = 0; i < 16; ++i) {
+    VP8Matrix* const m = &ctx->mtx;
+    m->q_[i] = (uint16_t)RandomRange(ctx, 4, 127);
+    m->iq_[i] = (uint16_t)((1 << QFIX) / m->q_[i]);
+    m->bias_[i] = BIAS(RandomRange(ctx, 0, 127));
+    m->zthresh_[i] = ((1 << QFIX) - 1 - m->bias_[i]) / m->iq_[i];
+    m->sharpen_[i] = (uint16_t)RandomRange(ctx, 0, 3);
+  }
+  FillRandom16(ctx, (int16_t*)ctx->dst, 32, -2048, 2047);
+  memset(ctx->dst + 32 * sizeof(int16_t), 0, 32 * sizeof(int16_t));
+  ctx->dst_size = 64 * sizeof(int16_t);
+}
+
+// The WHT quantization is done without sharpening.
+static void SetupQuantizeWHT(Context* const ctx, int index) {
+  SetupQuantize(ctx, index);
+  memset(ctx->mtx.sharpen_, 0, sizeof(ctx->mtx.sharpen_));
+}
+
+#define QUANT_IN(ctx) ((int16_t*)(ctx)->dst)
+#define QUANT_OUT(ctx) ((int16_t*)(ctx)->dst + 32)
+
+static void CallQuantizeBlock(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] = VP8EncQuantizeBlock(QUANT_IN(ctx), QUANT_OUT(ctx), &ctx->mtx);
+}
+static GenericFunc GetQuantizeBlock(int index) {
+  (void)index;
+  return FUNC(VP8EncQuantizeBlock);
+}
+
+static void CallQuantize2Blocks(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] =
+      VP8EncQuantize2Blocks(QUANT_IN(ctx), QUANT_OUT(ctx), &ctx->mtx);
+}
+static GenericFunc GetQuantize2Blocks(int index) {
+  (void)index;
+  return FUNC(VP8EncQuantize2Blocks);
+}
+
+static void CallQuantizeBlockWHT(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] =
+      VP8EncQuantizeBlockWHT(QUANT_IN(ctx), QUANT_OUT(ctx), &ctx->mtx);
+}
+static GenericFunc GetQuantizeBlockWHT(int index) {
+  (void)index;
+  return FUNC(VP8EncQuantizeBlockWHT);
+}
+
+// 'index' selects the blocks: all the luma ones, a single one (as for the
+// intra4 analysis) or the chroma ones.
+static const int kHistogramBlocks[3][2] = { { 0, 16 }, { 0, 1 }, { 16, 24 } };
+
+static void CallCollectHistogram(Context* const ctx, int index) {
+  VP8Histogram histo;
+  VP8CollectHistogram(ctx->src[1], ctx->src[2], kHistogramBlocks[index][0],
+                      kHistogramBlocks[index][1], &histo);
+  ctx->ret[0] = histo.max_value;
+  ctx->ret[1] = histo.last_non_zero;
+}
+static GenericFunc GetCollectHistogram(int index) {
+  (void)index;
+  return FUNC(VP8CollectHistogram);
+}
+
+// The encoder writes all the predictions in a PRED_SIZE_ENC area. The 'left'
+// and 'top' samples are in src[0] and src[1], with room around them.
+static void SetupEncPred(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->src[0], 64);
+  FillRandom(ctx, ctx->src[1], 64);
+  memset(ctx->dst, 0, PRED_SIZE_ENC);
+  ctx->dst_size = PRED_SIZE_ENC;
+}
+
+static void CallEncPredLuma4(Context* const ctx, int index) {
+  (void)index;
+  VP8EncPredLuma4(ctx->dst, ctx->src[1] + 32);
+}
+static GenericFunc GetEncPredLuma4(int index) {
+  (void)index;
+  return FUNC(VP8EncPredLuma4);
+}
+
+// 'index' selects the available neighbours: bit 0 for left, bit 1 for top.
+static void CallEncPredLuma16(Context* const ctx, int index) {
+  VP8EncPredLuma16(ctx->dst, (index & 1) ? ctx->src[0] + 32 : NULL,
+                   (index & 2) ? ctx->src[1] + 32 : NULL);
+}
+static GenericFunc GetEncPredLuma16(int index) {
+  (void)index;
+  return FUNC(VP8EncPredLuma16);
+}
+
+static void CallEncPredChroma8(Context* const ctx, int index) {
+  VP8EncPredChroma8(ctx->dst, (index & 1) ? ctx->src[0] + 32 : NULL,
+                    (index & 2) ? ctx->src[1] + 32 : NULL);
+}
+static GenericFunc GetEncPredChroma8(int index) {
+  (void)index;
+  return FUNC(VP8EncPredChroma8);
+}
+
+#define SSIM_STRIDE 32
+#define SSIM_W 32
+#define SSIM_H 16
+
+static void SetupSSIM(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->src[1], SSIM_STRIDE * SSIM_H);
+  FillSmooth(ctx, ctx->src[2], SSIM_STRIDE * SSIM_H, 20);
+  ctx->params[0] = RandomRange(ctx, 0, SSIM_W - 1);
+  ctx->params[1] = RandomRange(ctx, 0, SSIM_H - 1);
+  ctx->dst_size = 0;
+}
+
+static void StoreStats(Context* const ctx, const VP8DistoStats* const stats) {
+  ctx->ret[0] = stats->w;
+  ctx->ret[1] = stats->xm;
+  ctx->ret[2] = stats->ym;
+  ctx->ret[3] = stats->xxm;
+  ctx->ret[4] = stats->xym;
+  ctx->ret[5] = stats->yym;
+}
+
+static void CallSSIMAccumulate(Context* const ctx, int index) {
+  VP8DistoStats stats;
+  (void)index;
+  memset(&stats, 0, sizeof(stats));
+  VP8SSIMAccumulate(ctx->src[1], SSIM_STRIDE, ctx->src[2], SSIM_STRIDE,
+                    &stats);
+  StoreStats(ctx, &stats);
+}
+static GenericFunc GetSSIMAccumulate(int index) {
+  (void)index;
+  return FUNC(VP8SSIMAccumulate);
+}
+
+static void CallSSIMAccumulateClipped(Context* const ctx, int index) {
+  VP8DistoStats stats;
+  (void)index;
+  memset(&stats, 0, sizeof(stats));
+  VP8SSIMAccumulateClipped(ctx->src[1], SSIM_STRIDE,
+                           ctx->src[2], SSIM_STRIDE,
+                           ctx->params[0], ctx->params[1], SSIM_W, SSIM_H,
+                           &stats);
+  StoreStats(ctx, &stats);
+}
+static GenericFunc GetSSIMAccumulateClipped(int index) {
+  (void)index;
+  return FUNC(VP8SSIMAccumulateClipped);
+}
+
+//------------------------------------------------------------------------------
+// YUV <-> RGB conversions
+
+// Planes of ROW_LEN luma samples (two rows) and (ROW_LEN + 1) / 2 chroma
+// samples (two rows for each of U and V), and two rows of alpha.
+#define Y_ROW(ctx, i) ((ctx)->src[0] + (i) * 512)
+#define U_ROW(ctx, i) ((ctx)->src[1] + (i) * 512)
+#define V_ROW(ctx, i) ((ctx)->src[1] + 1024 + (i) * 512)
+#define A_ROW(ctx, i) ((ctx)->src[2] + (i) * 512)
+
+static void SetupYUV(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->src[0], BUF_SIZE);
+  FillRandom(ctx, ctx->src[1], BUF_SIZE);
+  FillRandom(ctx, ctx->src[2], BUF_SIZE);
+  FillRandom(ctx, ctx->dst, 2 * 4 * ROW_LEN);
+  ctx->dst_size = 2 * 4 * ROW_LEN;
+}
+
+static void CallSampler(Context* const ctx, int index) {
+  WebPSamplers[index](Y_ROW(ctx, 0), U_ROW(ctx, 0), V_ROW(ctx, 0), ctx->dst,
+                      ROW_LEN);
+}
+static GenericFunc GetSampler(int index) {
+  return WebPIsRGBMode((WEBP_CSP_MODE)index) ? FUNC(WebPSamplers[index])
+                                              : NULL;
+}
+
+static void CallSamplerPremultiplied(Context* const ctx, int index) {
+  WebPSamplersPremultiplied[index](Y_ROW(ctx, 0), U_ROW(ctx, 0),
+                                   V_ROW(ctx, 0), A_ROW(ctx, 0), ctx->dst,
+                                   ROW_LEN);
+}
+static GenericFunc GetSamplerPremultiplied(int index) {
+  return WebPIsRGBMode((WEBP_CSP_MODE)index)
+      ? FUNC(WebPSamplersPremultiplied[index]) : NULL;
+}
+
+static void CallUpsampler(Context* const ctx, int index) {
+  WebPUpsamplers[index](Y_ROW(ctx, 0), Y_ROW(ctx, 1),
+                        U_ROW(ctx, 0), V_ROW(ctx, 0),
+                        U_ROW(ctx, 1), V_ROW(ctx, 1),
+                        ctx->dst, ctx->dst + 4 * ROW_LEN, ROW_LEN);
+}
+static GenericFunc GetUpsampler(int index) {
+  return WebPIsRGBMode((WEBP_CSP_MODE)index) ? FUNC(WebPUpsamplers[index])
+                                              : NULL;
+}
+
+static void CallUpsamplerPremultiplied(Context* const ctx, int index) {
+  WebPUpsamplersPremultiplied[index](Y_ROW(ctx, 0), Y_ROW(ctx, 1),
+                                     U_ROW(ctx, 0), V_ROW(ctx, 0),
+                                     U_ROW(ctx, 1), V_ROW(ctx, 1),
+                                     A_ROW(ctx, 0), A_ROW(ctx, 1),
+                                     ctx->dst, ctx->dst + 4 * ROW_LEN,
+                                     ROW_LEN);
+}
+static GenericFunc GetUpsamplerPremultiplied(int index) {
+  return WebPIsRGBMode((WEBP_CSP_MODE)index)
+      ? FUNC(WebPUpsamplersPremultiplied[index]) : NULL;
+}
+
+static void CallYUV444Converter(Context* const ctx, int index) {
+  WebPYUV444Converters[index](Y_ROW(ctx, 0), U_ROW(ctx, 0), V_ROW(ctx, 0),
+                              ctx->dst, ROW_LEN);
+}
+static GenericFunc GetYUV444Converter(int index) {
+  return WebPIsRGBMode((WEBP_CSP_MODE)index)
+      ? FUNC(WebPYUV444Converters[index]) : NULL;
+}
+
+static void CallInterleaveUV(Context* const ctx, int index) {
+  (void)index;
+  WebPInterleaveUV(U_ROW(ctx, 0), V_ROW(ctx, 0), ctx->dst, ROW_LEN);
+}
+static GenericFunc GetInterleaveUV(int index) {
+  (void)index;
+  return FUNC(WebPInterleaveUV);
+}
+
+// RGB -> YUV. The U and V outputs are in 'dst', 256 bytes apart.
+static void SetupRGBToYUV(Context* const ctx, int index) {
+  int i;
+  uint16_t* const rgba32 = (uint16_t*)ctx->src[1];
+  (void)index;
+  FillRandom(ctx, ctx->src[0], BUF_SIZE);
+  for (i = 0; i < 4 * ROW_LEN; ++i) {
+    rgba32[i] = (uint16_t)RandomRange(ctx, 0, 4 * 255);
+  }
+  FillRandom(ctx, ctx->dst, 2 * 256);
+  ctx->dst_size = 2 * 256;
+}
+
+static void CallConvertARGBToY(Context* const ctx, int index) {
+  (void)index;
+  WebPConvertARGBToY((const uint32_t*)ctx->src[0], ctx->dst, ROW_LEN);
+}
+static GenericFunc GetConvertARGBToY(int index) {
+  (void)index;
+  return FUNC(WebPConvertARGBToY);
+}
+
+// 'index' is the 'do_store' flag.
+static void CallConvertARGBToUV(Context* const ctx, int index) {
+  WebPConvertARGBToUV((const uint32_t*)ctx->src[0], ctx->dst, ctx->dst + 256,
+                      ROW_LEN, index);
+}
+static GenericFunc GetConvertARGBToUV(int index) {
+  (void)index;
+  return FUNC(WebPConvertARGBToUV);
+}
+
+static void CallConvertRGBA32ToUV(Context* const ctx, int index) {
+  (void)index;
+  WebPConvertRGBA32ToUV((const uint16_t*)ctx->src[1], ctx->dst,
+                        ctx->dst + 256, (ROW_LEN + 1) / 2);
+}
+static GenericFunc GetConvertRGBA32ToUV(int index) {
+  (void)index;
+  return FUNC(WebPConvertRGBA32ToUV);
+}
+
+static void CallConvertRGB24ToY(Context* const ctx, int index) {
+  (void)index;
+  WebPConvertRGB24ToY(ctx->src[0], ctx->dst, ROW_LEN);
+}
+static GenericFunc GetConvertRGB24ToY(int index) {
+  (void)index;
+  return FUNC(WebPConvertRGB24ToY);
+}
+
+static void CallConvertBGR24ToY(Context* const ctx, int index) {
+  (void)index;
+  WebPConvertBGR24ToY(ctx->src[0], ctx->dst, ROW_LEN);
+}
+static GenericFunc GetConvertBGR24ToY(int index) {
+  (void)index;
+  return FUNC(WebPConvertBGR24ToY);
+}
+
+//------------------------------------------------------------------------------
+// Rescaler. The import and export functions are tested together, through the
+// rescaling of a whole RGBA picture.
+
+static void SetupRescaler(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->src[0], RESCALE_SRC_W * RESCALE_SRC_H * 4);
+  memset(ctx->dst, 0, RESCALE_SRC_W * RESCALE_SRC_H * 4);
+  ctx->dst_size = RESCALE_SRC_W * RESCALE_SRC_H * 4;
+}
+
+// 'index' 0 shrinks the picture, 1 enlarges it.
+static void CallRescaler(Context* const ctx, int index) {
+  const int src_w = index ? RESCALE_DST_W : RESCALE_SRC_W;
+  const int src_h = index ? RESCALE_DST_H : RESCALE_SRC_H;
+  const int dst_w = index ? RESCALE_SRC_W : RESCALE_DST_W;
+  const int dst_h = index ? RESCALE_SRC_H : RESCALE_DST_H;
+  WebPRescaler* const wrk = &ctx->rescaler;
+  int y = 0;
+  WebPRescalerInit(wrk, src_w, src_h, ctx->dst, dst_w, dst_h, dst_w * 4, 4,
+                   ctx->work);
+  while (y < src_h) {
+    y += WebPRescalerImport(wrk, src_h - y, ctx->src[0] + y * src_w * 4,
+                            src_w * 4);
+    WebPRescalerExport(wrk);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Alpha processing and ARGB packing
+
+#define ALPHA_W 61
+#define ALPHA_H 4
+
+static void SetupAlpha(Context* const ctx, int index) {
+  (void)index;
+  FillPremultiplied(ctx, (uint32_t*)ctx->src[0], ALPHA_W * ALPHA_H);
+  FillRandom(ctx, ctx->src[1], ALPHA_W * ALPHA_H);
+  if ((Random(ctx) & 3) == 0) {    // opaque, for the early exits
+    memset(ctx->src[1], 0xff, ALPHA_W * ALPHA_H);
+  }
+  memcpy(ctx->dst, ctx->src[0], ALPHA_W * ALPHA_H * 4);
+  ctx->dst_size = ALPHA_W * ALPHA_H * 4;
+}
+
+// 'index' is the 'alpha_first' flag.
+static void CallApplyAlphaMultiply(Context* const ctx, int index) {
+  WebPApplyAlphaMultiply(ctx->dst, index, ALPHA_W, ALPHA_H, ALPHA_W * 4);
+}
+static GenericFunc GetApplyAlphaMultiply(int index) {
+  (void)index;
+  return FUNC(WebPApplyAlphaMultiply);
+}
+
+static void CallApplyAlphaMultiply4444(Context* const ctx, int index) {
+  (void)index;
+  WebPApplyAlphaMultiply4444(ctx->dst, ALPHA_W, ALPHA_H, ALPHA_W * 2);
+}
+static GenericFunc GetApplyAlphaMultiply4444(int index) {
+  (void)index;
+  return FUNC(WebPApplyAlphaMultiply4444);
+}
+
+static void CallDispatchAlpha(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] = WebPDispatchAlpha(ctx->src[1], ALPHA_W, ALPHA_W, ALPHA_H,
+                                  ctx->dst, ALPHA_W * 4);
+}
+static GenericFunc GetDispatchAlpha(int index) {
+  (void)index;
+  return FUNC(WebPDispatchAlpha);
+}
+
+static void CallDispatchAlphaToGreen(Context* const ctx, int index) {
+  (void)index;
+  WebPDispatchAlphaToGreen(ctx->src[1], ALPHA_W, ALPHA_W, ALPHA_H,
+                           (uint32_t*)ctx->dst, ALPHA_W);
+}
+static GenericFunc GetDispatchAlphaToGreen(int index) {
+  (void)index;
+  return FUNC(WebPDispatchAlphaToGreen);
+}
+
+static void SetupExtractAlpha(Context* const ctx, int index) {
+  int i;
+  SetupAlpha(ctx, index);
+  if (ctx->src[1][0] == 0xff) {
+    for (i = 0; i < ALPHA_W * ALPHA_H; ++i) ctx->src[0][4 * i + 3] = 0xff;
+  }
+}
+static void CallExtractAlpha(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] = WebPExtractAlpha(ctx->src[0], ALPHA_W * 4, ALPHA_W, ALPHA_H,
+                                 ctx->dst, ALPHA_W);
+}
+static GenericFunc GetExtractAlpha(int index) {
+  (void)index;
+  return FUNC(WebPExtractAlpha);
+}
+
+// 'index' is the 'inverse' flag.
+static void CallMultARGBRow(Context* const ctx, int index) {
+  WebPMultARGBRow((uint32_t*)ctx->dst, ALPHA_W * ALPHA_H, index);
+}
+static GenericFunc GetMultARGBRow(int index) {
+  (void)index;
+  return FUNC(WebPMultARGBRow);
+}
+
+static void SetupMultRow(Context* const ctx, int index) {
+  int i;
+  SetupAlpha(ctx, index);
+  for (i = 0; i < ALPHA_W * ALPHA_H; ++i) {   // premultiplied samples
+    ctx->dst[i] = (uint8_t)RandomRange(ctx, 0, ctx->src[1][i]);
+  }
+}
+static void CallMultRow(Context* const ctx, int index) {
+  WebPMultRow(ctx->dst, ctx->src[1], ALPHA_W * ALPHA_H, index);
+}
+static GenericFunc GetMultRow(int index) {
+  (void)index;
+  return FUNC(WebPMultRow);
+}
+
+static void CallPackARGB(Context* const ctx, int index) {
+  const uint8_t* const rgba = ctx->src[0];
+  (void)index;
+  VP8PackARGB(rgba + 3, rgba + 0, rgba + 1, rgba + 2, ALPHA_W * ALPHA_H,
+              (uint32_t*)ctx->dst);
+}
+static GenericFunc GetPackARGB(int index) {
+  (void)index;
+  return FUNC(VP8PackARGB);
+}
+
+// 'index' 0 and 1 are for a step of 3 and 4.
+static void CallPackRGB(Context* const ctx, int index) {
+  const uint8_t* const rgb = ctx->src[0];
+  VP8PackRGB(rgb + 0, rgb + 1, rgb + 2, ALPHA_W * ALPHA_H, 3 + index,
+             (uint32_t*)ctx->dst);
+}
+static GenericFunc GetPackRGB(int index) {
+  (void)index;
+  return FUNC(VP8PackRGB);
+}
+
+//------------------------------------------------------------------------------
+// Alpha plane filters
+
+#define FILTERS_W 61
+#define FILTERS_H 8
+
+static void SetupFilters(Context* const ctx, int index) {
+  (void)index;
+  FillSmooth(ctx, ctx->src[0], FILTERS_W * FILTERS_H, 16);
+  FillRandom(ctx, ctx->src[1], FILTERS_W);
+  FillRandom(ctx, ctx->dst, FILTERS_W * FILTERS_H);
+  ctx->dst_size = FILTERS_W * FILTERS_H;
+}
+
+static void CallFilter(Context* const ctx, int index) {
+  WebPFilters[index](ctx->src[0], FILTERS_W, FILTERS_H, FILTERS_W, ctx->dst);
+}
+static GenericFunc GetFilter(int index) {
+  return (index == WEBP_FILTER_NONE) ? NULL : FUNC(WebPFilters[index]);
+}
+
+// Unfilters the second row of 'dst', the previous row being the first one.
+static void CallUnfilter(Context* const ctx, int index) {
+  WebPUnfilters[index](ctx->dst, ctx->src[1], ctx->dst + FILTERS_W,
+                       FILTERS_W);
+}
+static GenericFunc GetUnfilter(int index) {
+  return (index == WEBP_FILTER_NONE) ? NULL : FUNC(WebPUnfilters[index]);
+}
+
+//------------------------------------------------------------------------------
+// Lossless decoding
+
+// ROW_LEN pixels of residuals, with the row above in src[1]. The output has
+// its left neighbour at 'out[-1]'.
+#define ARGB_IN(ctx) ((uint32_t*)(ctx)->src[0])
+#define ARGB_UPPER(ctx) ((uint32_t*)(ctx)->src[1] + 4)
+#define ARGB_OUT(ctx) ((uint32_t*)(ctx)->dst + 4)
+
+static void SetupARGB(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->src[0], 4 * (ROW_LEN + 8));
+  FillRandom(ctx, ctx->src[1], 4 * (ROW_LEN + 8));
+  FillRandom(ctx, ctx->src[2], 4 * (ROW_LEN + 8));
+  FillRandom(ctx, ctx->dst, 4 * (ROW_LEN + 8));
+  ctx->mult.green_to_red_ = (uint8_t)Random(ctx);
+  ctx->mult.green_to_blue_ = (uint8_t)Random(ctx);
+  ctx->mult.red_to_blue_ = (uint8_t)Random(ctx);
+  ctx->dst_size = 4 * (ROW_LEN + 8);
+}
+
+static void CallPredictor(Context* const ctx, int index) {
+  const uint32_t* const in = ARGB_IN(ctx);
+  const uint32_t* const upper = ARGB_UPPER(ctx);
+  uint32_t* const out = ARGB_OUT(ctx);
+  const VP8LPredictorFunc pred = VP8LPredictors[index];
+  int x;
+  for (x = 0; x < ROW_LEN; ++x) out[x] = pred(in[x], upper + x);
+}
+static GenericFunc GetPredictor(int index) {
+  return FUNC(VP8LPredictors[index]);
+}
+
+static void CallPredictorAdd(Context* const ctx, int index) {
+  VP8LPredictorsAdd[index](ARGB_IN(ctx), ARGB_UPPER(ctx), ROW_LEN,
+                           ARGB_OUT(ctx));
+}
+static GenericFunc GetPredictorAdd(int index) {
+  return FUNC(VP8LPredictorsAdd[index]);
+}
+
+static void CallAddGreen(Context* const ctx, int index) {
+  (void)index;
+  VP8LAddGreenToBlueAndRed(ARGB_OUT(ctx), ROW_LEN);
+}
+static GenericFunc GetAddGreen(int index) {
+  (void)index;
+  return FUNC(VP8LAddGreenToBlueAndRed);
+}
+
+static void CallTransformColorInverse(Context* const ctx, int index) {
+  (void)index;
+  VP8LTransformColorInverse(&ctx->mult, ARGB_OUT(ctx), ROW_LEN);
+}
+static GenericFunc GetTransformColorInverse(int index) {
+  (void)index;
+  return FUNC(VP8LTransformColorInverse);
+}
+
+static VP8LConvertFunc* const kConverters[5] = {
+  &VP8LConvertBGRAToRGB, &VP8LConvertBGRAToRGBA, &VP8LConvertBGRAToRGBA4444,
+  &VP8LConvertBGRAToRGB565, &VP8LConvertBGRAToBGR
+};
+static const char* const kConverterNames[5] = {
+  "VP8LConvertBGRAToRGB", "VP8LConvertBGRAToRGBA",
+  "VP8LConvertBGRAToRGBA4444", "VP8LConvertBGRAToRGB565",
+  "VP8LConvertBGRAToBGR"
+};
+
+static void CallConverter(Context* const ctx, int index) {
+  (*kConverters[index])(ARGB_IN(ctx), ROW_LEN, ctx->dst);
+}
+static GenericFunc GetConverter(int index) {
+  return FUNC(*kConverters[index]);
+}
+
+// Color-indexed rows: MAP_H rows of MAP_W pixels, with the color map in
+// src[1].
+#define MAP_W 64
+#define MAP_H 4
+
+static void SetupMapColor(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->src[0], 4 * MAP_W * MAP_H);
+  FillRandom(ctx, ctx->src[1], 4 * 256);
+  FillRandom(ctx, ctx->dst, 4 * MAP_W * MAP_H);
+  ctx->dst_size = 4 * MAP_W * MAP_H;
+}
+
+static void CallMapColor32b(Context* const ctx, int index) {
+  (void)index;
+  VP8LMapColor32b(ARGB_IN(ctx), (const uint32_t*)ctx->src[1],
+                  (uint32_t*)ctx->dst, 0, MAP_H, MAP_W);
+}
+static GenericFunc GetMapColor32b(int index) {
+  (void)index;
+  return FUNC(VP8LMapColor32b);
+}
+
+static void CallMapColor8b(Context* const ctx, int index) {
+  (void)index;
+  VP8LMapColor8b(ctx->src[0], (const uint32_t*)ctx->src[1], ctx->dst,
+                 0, MAP_H, MAP_W);
+}
+static GenericFunc GetMapColor8b(int index) {
+  (void)index;
+  return FUNC(VP8LMapColor8b);
+}
+
+// Whole pictures transformed in place, the way VP8LInverseTransform() does:
+// 'params[0]' rows of 'params[1]' pixels at 'ARGB_ROWS', cut into tiles of
+// 1 << 'params[2]' pixels. The first row and the first column use the left
+// and top predictors. 'params[3]' shifts the rows off the 32b alignment. The
+// widths go down to a single pixel, to reach all the tails of the SIMD loops.
+#define ROWS_H 8
+#define ROWS_SIZE (4 * (ROW_LEN * ROWS_H + 16))
+#define ARGB_ROWS(ctx) ((uint32_t*)(ctx)->dst + 4 + (ctx)->params[3])
+
+// Random, near-zero or extreme samples: as residuals, the latter two give
+// the ties of the Select predictor and the clamping of the ClampedAdd ones.
+static void FillARGBRows(Context* const ctx, uint8_t* const buf, size_t size) {
+  static const uint8_t kExtremes[6] = { 0x00, 0x01, 0x7f, 0x80, 0xfe, 0xff };
+  const int kind = RandomRange(ctx, 0, 2);
+  size_t i;
+  for (i = 0; i < size; ++i) {
+    buf[i] = (kind == 0) ? (uint8_t)(Random(ctx) >> 24)
+           : (kind == 1) ? (uint8_t)RandomRange(ctx, -2, 2)
+           : kExtremes[RandomRange(ctx, 0, 5)];
+  }
+}
+
+static void SetupARGBRows(Context* const ctx, int index) {
+  (void)index;
+  ctx->params[0] = RandomRange(ctx, 1, ROWS_H);
+  ctx->params[1] = (Random(ctx) & 1) ? RandomRange(ctx, 1, 17)
+                                     : RandomRange(ctx, 18, ROW_LEN);
+  ctx->params[2] = RandomRange(ctx, 2, 5);
+  ctx->params[3] = RandomRange(ctx, 0, 7);
+  FillRandom(ctx, ctx->src[0], 4 * ROW_LEN * ROWS_H);  // 8b indices, codes
+  FillARGBRows(ctx, ctx->src[1], 4 * 256);              // color map
+  FillRandom(ctx, ctx->dst, ROWS_SIZE);
+  FillARGBRows(ctx, (uint8_t*)ARGB_ROWS(ctx),
+               4 * (size_t)ctx->params[0] * ctx->params[1]);
+  ctx->dst_size = ROWS_SIZE;
+}
+
+// The interior of the rows uses VP8LPredictorsAdd[index], tile by tile.
+static void CallPredictorAddRows(Context* const ctx, int index) {
+  const int height = ctx->params[0], width = ctx->params[1];
+  const int tile_width = 1 << ctx->params[2];
+  uint32_t* data = ARGB_ROWS(ctx);
+  int x, y;
+  VP8LPredictorsAdd[0](data, NULL, 1, data);
+  VP8LPredictorsAdd[1](data + 1, NULL, width - 1, data + 1);
+  for (y = 1; y < height; ++y) {
+    data += width;
+    VP8LPredictorsAdd[2](data, data - width, 1, data);
+    for (x = 1; x < width;) {
+      int x_end = (x & ~(tile_width - 1)) + tile_width;
+      if (x_end > width) x_end = width;
+      VP8LPredictorsAdd[index](data + x, data + x - width, x_end - x,
+                               data + x);
+      x = x_end;
+    }
+  }
+}
+
+static void CallAddGreenRows(Context* const ctx, int index) {
+  (void)index;
+  VP8LAddGreenToBlueAndRed(ARGB_ROWS(ctx), ctx->params[0] * ctx->params[1]);
+}
+
+// Each tile has its own multipliers, taken from the random bytes of src[0].
+static void CallTransformColorInverseRows(Context* const ctx, int index) {
+  const int height = ctx->params[0], width = ctx->params[1];
+  const int tile_width = 1 << ctx->params[2];
+  const uint8_t* codes = ctx->src[0];
+  uint32_t* data = ARGB_ROWS(ctx);
+  int x, y;
+  (void)index;
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; x += tile_width, codes += 3) {
+      const int len = (x + tile_width > width) ? width - x : tile_width;
+      VP8LMultipliers m;
+      m.green_to_red_ = codes[0];
+      m.green_to_blue_ = codes[1];
+      m.red_to_blue_ = codes[2];
+      VP8LTransformColorInverse(&m, data + x, len);
+    }
+    data += width;
+  }
+}
+
+static void CallMapColor32bRows(Context* const ctx, int index) {
+  uint32_t* const data = ARGB_ROWS(ctx);
+  (void)index;
+  VP8LMapColor32b(data, (const uint32_t*)ctx->src[1], data, 0,
+                  ctx->params[0], ctx->params[1]);
+}
+
+static void CallMapColor8bRows(Context* const ctx, int index) {
+  (void)index;
+  VP8LMapColor8b(ctx->src[0], (const uint32_t*)ctx->src[1],
+                 (uint8_t*)ARGB_ROWS(ctx), 0, ctx->params[0], ctx->params[1]);
+}
+
+//------------------------------------------------------------------------------
+// Lossless encoding
+
+static void CallSubtractGreen(Context* const ctx, int index) {
+  (void)index;
+  VP8LSubtractGreenFromBlueAndRed(ARGB_OUT(ctx), ROW_LEN);
+}
+static GenericFunc GetSubtractGreen(int index) {
+  (void)index;
+  return FUNC(VP8LSubtractGreenFromBlueAndRed);
+}
+
+static void CallTransformColor(Context* const ctx, int index) {
+  (void)index;
+  VP8LTransformColor(&ctx->mult, ARGB_OUT(ctx), ROW_LEN);
+}
+static GenericFunc GetTransformColor(int index) {
+  (void)index;
+  return FUNC(VP8LTransformColor);
+}
+
+// A tile of 32x8 pixels, with a stride of 64 pixels.
+static void SetupCollectColor(Context* const ctx, int index) {
+  (void)index;
+  FillRandom(ctx, ctx->src[0], 4 * 64 * 8);
+  ctx->params[0] = RandomRange(ctx, -128, 127);
+  ctx->params[1] = RandomRange(ctx, -128, 127);
+  memset(ctx->dst, 0, 256 * sizeof(int));
+  ctx->dst_size = 256 * sizeof(int);
+}
+
+static void CallCollectColorBlue(Context* const ctx, int index) {
+  (void)index;
+  VP8LCollectColorBlueTransforms(ARGB_IN(ctx), 64, 32, 8, ctx->params[0],
+                                 ctx->params[1], (int*)ctx->dst);
+}
+static GenericFunc GetCollectColorBlue(int index) {
+  (void)index;
+  return FUNC(VP8LCollectColorBlueTransforms);
+}
+
+static void CallCollectColorRed(Context* const ctx, int index) {
+  (void)index;
+  VP8LCollectColorRedTransforms(ARGB_IN(ctx), 64, 32, 8, ctx->params[0],
+                                (int*)ctx->dst);
+}
+static GenericFunc GetCollectColorRed(int index) {
+  (void)index;
+  return FUNC(VP8LCollectColorRedTransforms);
+}
+
+static void SetupLog2(Context* const ctx, int index) {
+  int i;
+  uint32_t* const values = (uint32_t*)ctx->src[0];
+  (void)index;
+  for (i = 0; i < MAX_RETURNS; ++i) {
+    values[i] = LOG_LOOKUP_IDX_MAX + Random(ctx) % (1u << (4 + 27 * i / 15));
+  }
+  ctx->dst_size = 0;
+}
+
+static void CallFastLog2Slow(Context* const ctx, int index) {
+  const uint32_t* const values = (const uint32_t*)ctx->src[0];
+  int i;
+  (void)index;
+  for (i = 0; i < MAX_RETURNS; ++i) ctx->ret[i] = VP8LFastLog2Slow(values[i]);
+}
+static GenericFunc GetFastLog2Slow(int index) {
+  (void)index;
+  return FUNC(VP8LFastLog2Slow);
+}
+
+static void CallFastSLog2Slow(Context* const ctx, int index) {
+  const uint32_t* const values = (const uint32_t*)ctx->src[0];
+  int i;
+  (void)index;
+  for (i = 0; i < MAX_RETURNS; ++i) ctx->ret[i] = VP8LFastSLog2Slow(values[i]);
+}
+static GenericFunc GetFastSLog2Slow(int index) {
+  (void)index;
+  return FUNC(VP8LFastSLog2Slow);
+}
+
+// Two populations of NUM_LOSSLESS_CODES symbols, in src[0] and src[1].
+static void SetupPopulation(Context* const ctx, int index) {
+  (void)index;
+  FillPopulation(ctx, (uint32_t*)ctx->src[0], NUM_LOSSLESS_CODES, 1 << 16);
+  FillPopulation(ctx, (uint32_t*)ctx->src[1], NUM_LOSSLESS_CODES, 1 << 16);
+  ctx->dst_size = 0;
+}
+
+#define POPULATION(ctx, i) ((const uint32_t*)(ctx)->src[i])
+
+static void CallExtraCost(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] = VP8LExtraCost(POPULATION(ctx, 0), NUM_DISTANCE_CODES);
+}
+static GenericFunc GetExtraCost(int index) {
+  (void)index;
+  return FUNC(VP8LExtraCost);
+}
+
+static void CallExtraCostCombined(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] = VP8LExtraCostCombined(POPULATION(ctx, 0), POPULATION(ctx, 1),
+                                      NUM_DISTANCE_CODES);
+}
+static GenericFunc GetExtraCostCombined(int index) {
+  (void)index;
+  return FUNC(VP8LExtraCostCombined);
+}
+
+static void CallCombinedShannonEntropy(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] = VP8LCombinedShannonEntropy((const int*)POPULATION(ctx, 0),
+                                           (const int*)POPULATION(ctx, 1));
+}
+static GenericFunc GetCombinedShannonEntropy(int index) {
+  (void)index;
+  return FUNC(VP8LCombinedShannonEntropy);
+}
+
+static void StoreStreaks(Context* const ctx, const VP8LStreaks* const stats,
+                         int first) {
+  ctx->ret[first + 0] = stats->counts[0];
+  ctx->ret[first + 1] = stats->counts[1];
+  ctx->ret[first + 2] = stats->streaks[0][0];
+  ctx->ret[first + 3] = stats->streaks[0][1];
+  ctx->ret[first + 4] = stats->streaks[1][0];
+  ctx->ret[first + 5] = stats->streaks[1][1];
+}
+
+// 'index' 0 is for VP8LGetEntropyUnrefined(), 1 for the combined version.
+static void CallEntropyUnrefined(Context* const ctx, int index) {
+  VP8LBitEntropy entropy;
+  VP8LStreaks stats;
+  if (index == 0) {
+    VP8LGetEntropyUnrefined(POPULATION(ctx, 0), NUM_LOSSLESS_CODES,
+                            &entropy, &stats);
+  } else {
+    VP8LGetCombinedEntropyUnrefined(POPULATION(ctx, 0), POPULATION(ctx, 1),
+                                    NUM_LOSSLESS_CODES, &entropy, &stats);
+  }
+  ctx->ret[0] = entropy.entropy;
+  ctx->ret[1] = entropy.sum;
+  ctx->ret[2] = entropy.nonzeros;
+  ctx->ret[3] = entropy.max_val;
+  ctx->ret[4] = entropy.nonzero_code;
+  StoreStreaks(ctx, &stats, 5);
+}
+static GenericFunc GetEntropyUnrefinedHelper(int index) {
+  (void)index;
+  return FUNC(VP8LGetEntropyUnrefinedHelper);
+}
+
+static void SetupHistogramAdd(Context* const ctx, int index) {
+  int i;
+  const int num_literals = VP8LHistogramNumCodes(0);
+  (void)index;
+  for (i = 0; i < 2; ++i) {
+    VP8LHistogram* const h = ctx->histo[i];
+    FillPopulation(ctx, h->literal_, num_literals, 1 << 20);
+    FillPopulation(ctx, h->red_, NUM_LITERAL_CODES, 1 << 20);
+    FillPopulation(ctx, h->blue_, NUM_LITERAL_CODES, 1 << 20);
+    FillPopulation(ctx, h->alpha_, NUM_LITERAL_CODES, 1 << 20);
+    FillPopulation(ctx, h->distance_, NUM_DISTANCE_CODES, 1 << 20);
+  }
+  ctx->dst_size = (num_literals + 3 * NUM_LITERAL_CODES +
+                   NUM_DISTANCE_CODES) * sizeof(uint32_t);
+}
+
+static void CallHistogramAdd(Context* const ctx, int index) {
+  (void)index;
+  VP8LHistogramAdd(ctx->histo[0], ctx->histo[1], ctx->histo[2]);
+}
+static GenericFunc GetHistogramAdd(int index) {
+  (void)index;
+  return FUNC(VP8LHistogramAdd);
+}
+
+static void CollectHistogramAdd(Context* const ctx, int index) {
+  const VP8LHistogram* const h = ctx->histo[2];
+  const int num_literals = VP8LHistogramNumCodes(0);
+  uint8_t* dst = ctx->dst;
+  (void)index;
+  memcpy(dst, h->literal_, num_literals * sizeof(uint32_t));
+  dst += num_literals * sizeof(uint32_t);
+  memcpy(dst, h->red_, sizeof(h->red_));
+  dst += sizeof(h->red_);
+  memcpy(dst, h->blue_, sizeof(h->blue_));
+  dst += sizeof(h->blue_);
+  memcpy(dst, h->alpha_, sizeof(h->alpha_));
+  dst += sizeof(h->alpha_);
+  memcpy(dst, h->distance_, sizeof(h->distance_));
+}
+
+static void SetupVectorMismatch(Context* const ctx, int index) {
+  const int mismatch = RandomRange(ctx, 0, ROW_LEN);
+  (void)index;
+  FillRandom(ctx, ctx->src[0], 4 * ROW_LEN);
+  memcpy(ctx->src[1], ctx->src[0], 4 * ROW_LEN);
+  if (mismatch < ROW_LEN) ctx->src[1][4 * mismatch] ^= 1;
+  ctx->dst_size = 0;
+}
+
+static void CallVectorMismatch(Context* const ctx, int index) {
+  (void)index;
+  ctx->ret[0] = VP8LVectorMismatch((const uint32_t*)ctx->src[0],
+                                   (const uint32_t*)ctx->src[1], ROW_LEN);
+}
+static GenericFunc GetVectorMismatch(int index) {
+  (void)index;
+  return FUNC(VP8LVectorMismatch);
+}
+
+//------------------------------------------------------------------------------
+// Test list
+
+static const DspTest kTests[] = {
+  // decoding
+  { "VP8Transform", 1, 32, 0., SetupTransform, CallTransform, GetTransform,
+    NULL },
+  { "VP8TransformAC3", 1, 16, 0., SetupTransformAC3, CallTransformAC3,
+    GetTransformAC3, NULL },
+  { "VP8TransformUV", 1, 64, 0., SetupTransform, CallTransformUV,
+    GetTransformUV, NULL },
+  { "VP8TransformDC", 1, 16, 0., SetupTransformDC, CallTransformDC,
+    GetTransformDC, NULL },
+  { "VP8TransformDCUV", 1, 64, 0., SetupTransformDC, CallTransformDCUV,
+    GetTransformDCUV, NULL },
+  { "VP8TransformWHT", 1, 16, 0., SetupTransformWHT, CallTransformWHT,
+    GetTransformWHT, NULL },
+  { "VP8PredLuma4", NUM_BMODES, 16, 0., SetupPred, CallPredLuma4,
+    GetPredLuma4, NULL },
+  { "VP8PredLuma16", NUM_B_DC_MODES, 256, 0., SetupPred, CallPredLuma16,
+    GetPredLuma16, NULL },
+  { "VP8PredChroma8", NUM_B_DC_MODES, 64, 0., SetupPred, CallPredChroma8,
+    GetPredChroma8, NULL },
+  { NULL, 4, 16, 0., SetupFilter, CallSimpleFilter, GetSimpleFilter, NULL },
+  { NULL, 4, 16, 0., SetupFilter, CallLumaFilter, GetLumaFilter, NULL },
+  { NULL, 4, 16, 0., SetupFilter, CallChromaFilter, GetChromaFilter, NULL },
+  { "VP8DitherCombine8x8", 1, 64, 0., SetupDither, CallDither, GetDither,
+    NULL },
+  // encoding
+  { "VP8ITransform", 1, 32, 0., SetupITransform, CallITransform, GetITransform,
+    NULL },
+  { "VP8FTransform", 1, 16, 0., SetupBlocks, CallFTransform, GetFTransform,
+    NULL },
+  { "VP8FTransform2", 1, 32, 0., SetupBlocks, CallFTransform2,
+    GetFTransform2, NULL },
+  { "VP8FTransformWHT", 1, 16, 0., SetupBlocks, CallFTransformWHT,
+    GetFTransformWHT, NULL },
+  { NULL, 6, 0, 0., SetupBlocks, CallMetric, GetMetric, NULL },
+  { "VP8TDisto4x4", 1, 16, 0., SetupBlocks, CallTDisto4x4, GetTDisto4x4,
+    NULL },
+  { "VP8TDisto16x16", 1, 256, 0., SetupBlocks, CallTDisto16x16,
+    GetTDisto16x16, NULL },
+  { "VP8Copy4x4", 1, 16, 0., SetupBlocks, CallCopy4x4, GetCopy4x4, NULL },
+  { "VP8Copy16x8", 1, 128, 0., SetupBlocks, CallCopy16x8, GetCopy16x8, NULL },
+  { "VP8EncQuantizeBlock", 1, 16, 0., SetupQuantize, CallQuantizeBlock,
+    GetQuantizeBlock, NULL },
+  { "VP8EncQuantize2Blocks", 1, 32, 0., SetupQuantize, CallQuantize2Blocks,
+    GetQuantize2Blocks, NULL },
+  { "VP8EncQuantizeBlockWHT", 1, 16, 0., SetupQuantizeWHT,
+    CallQuantizeBlockWHT, GetQuantizeBlockWHT, NULL },
+  { "VP8CollectHistogram", 3, 256, 0., SetupBlocks, CallCollectHistogram,
+    GetCollectHistogram, NULL },
+  { "VP8EncPredLuma4", 1, 10 * 16, 0., SetupEncPred, CallEncPredLuma4,
+    GetEncPredLuma4, NULL },
+  { "VP8EncPredLuma16", 4, 4 * 256, 0., SetupEncPred, CallEncPredLuma16,
+    GetEncPredLuma16, NULL },
+  { "VP8EncPredChroma8", 4, 8 * 64, 0., SetupEncPred, CallEncPredChroma8,
+    GetEncPredChroma8, NULL },
+  { "VP8SSIMAccumulate", 1, 49, 1e-9, SetupSSIM, CallSSIMAccumulate,
+    GetSSIMAccumulate, NULL },
+  { "VP8SSIMAccumulateClipped", 1, 49, 1e-9, SetupSSIM,
+    CallSSIMAccumulateClipped, GetSSIMAccumulateClipped, NULL },
+  // YUV <-> RGB
+  { "WebPSamplers", MODE_LAST, ROW_LEN, 0., SetupYUV, CallSampler,
+    GetSampler, NULL },
+  { "WebPSamplersPremultiplied", MODE_LAST, ROW_LEN, 0., SetupYUV,
+    CallSamplerPremultiplied, GetSamplerPremultiplied, NULL },
+  { "WebPUpsamplers", MODE_LAST, 2 * ROW_LEN, 0., SetupYUV, CallUpsampler,
+    GetUpsampler, NULL },
+  { "WebPUpsamplersPremultiplied", MODE_LAST, 2 * ROW_LEN, 0., SetupYUV,
+    CallUpsamplerPremultiplied, GetUpsamplerPremultiplied, NULL },
+  { "WebPYUV444Converters", MODE_LAST, ROW_LEN, 0., SetupYUV,
+    CallYUV444Converter, GetYUV444Converter, NULL },
+  { "WebPInterleaveUV", 1, ROW_LEN, 0., SetupYUV, CallInterleaveUV,
+    GetInterleaveUV, NULL },
+  { "WebPConvertARGBToY", 1, ROW_LEN, 0., SetupRGBToYUV, CallConvertARGBToY,
+    GetConvertARGBToY, NULL },
+  { "WebPConvertARGBToUV", 2, ROW_LEN, 0., SetupRGBToYUV,
+    CallConvertARGBToUV, GetConvertARGBToUV, NULL },
+  { "WebPConvertRGBA32ToUV", 1, ROW_LEN, 0., SetupRGBToYUV,
+    CallConvertRGBA32ToUV, GetConvertRGBA32ToUV, NULL },
+  { "WebPConvertRGB24ToY", 1, ROW_LEN, 0., SetupRGBToYUV,
+    CallConvertRGB24ToY, GetConvertRGB24ToY, NULL },
+  { "WebPConvertBGR24ToY", 1, ROW_LEN, 0., SetupRGBToYUV,
+    CallConvertBGR24ToY, GetConvertBGR24ToY, NULL },
+  // rescaler
+  { "WebPRescalerImportRow/ExportRow", 2, RESCALE_SRC_W * RESCALE_SRC_H, 0.,
+    SetupRescaler, CallRescaler, NULL, NULL },
+  // alpha
+  { "WebPApplyAlphaMultiply", 2, ALPHA_W * ALPHA_H, 0., SetupAlpha,
+    CallApplyAlphaMultiply, GetApplyAlphaMultiply, NULL },
+  { "WebPApplyAlphaMultiply4444", 1, ALPHA_W * ALPHA_H, 0., SetupAlpha,
+    CallApplyAlphaMultiply4444, GetApplyAlphaMultiply4444, NULL },
+  { "WebPDispatchAlpha", 1, ALPHA_W * ALPHA_H, 0., SetupAlpha,
+    CallDispatchAlpha, GetDispatchAlpha, NULL },
+  { "WebPDispatchAlphaToGreen", 1, ALPHA_W * ALPHA_H, 0., SetupAlpha,
+    CallDispatchAlphaToGreen, GetDispatchAlphaToGreen, NULL },
+  { "WebPExtractAlpha", 1, ALPHA_W * ALPHA_H, 0., SetupExtractAlpha,
+    CallExtractAlpha, GetExtractAlpha, NULL },
+  { "WebPMultARGBRow", 2, ALPHA_W * ALPHA_H, 0., SetupAlpha, CallMultARGBRow,
+    GetMultARGBRow, NULL },
+  { "WebPMultRow", 2, ALPHA_W * ALPHA_H, 0., SetupMultRow, CallMultRow,
+    GetMultRow, NULL },
+  { "VP8PackARGB", 1, ALPHA_W * ALPHA_H, 0., SetupAlpha, CallPackARGB,
+    GetPackARGB, NULL },
+  { "VP8PackRGB", 2, ALPHA_W * ALPHA_H, 0., SetupAlpha, CallPackRGB,
+    GetPackRGB, NULL },
+  // filters
+  { "WebPFilters", WEBP_FILTER_LAST, FILTERS_W * FILTERS_H, 0., SetupFilters,
+    CallFilter, GetFilter, NULL },
+  { "WebPUnfilters", WEBP_FILTER_LAST, FILTERS_W, 0., SetupFilters,
+    CallUnfilter, GetUnfilter, NULL },
+  // lossless decoding
+  { "VP8LPredictors", 16, ROW_LEN, 0., SetupARGB, CallPredictor,
+    GetPredictor, NULL },
+  { "VP8LPredictorsAdd", 16, ROW_LEN, 0., SetupARGB, CallPredictorAdd,
+    GetPredictorAdd, NULL },
+  { "VP8LAddGreenToBlueAndRed", 1, ROW_LEN, 0., SetupARGB, CallAddGreen,
+    GetAddGreen, NULL },
+  { "VP8LTransformColorInverse", 1, ROW_LEN, 0., SetupARGB,
+    CallTransformColorInverse, GetTransformColorInverse, NULL },
+  { NULL, 5, ROW_LEN, 0., SetupARGB, CallConverter, GetConverter, NULL },
+  { "VP8LMapColor32b", 1, MAP_W * MAP_H, 0., SetupMapColor, CallMapColor32b,
+    GetMapColor32b, NULL },
+  { "VP8LMapColor8b", 1, MAP_W * MAP_H, 0., SetupMapColor, CallMapColor8b,
+    GetMapColor8b, NULL },
+  { "VP8LPredictorsAdd/rows", 16, 0, 0., SetupARGBRows, CallPredictorAddRows,
+    GetPredictorAdd, NULL },
+  { "VP8LAddGreenToBlueAndRed/rows", 1, 0, 0., SetupARGBRows,
+    CallAddGreenRows, GetAddGreen, NULL },
+  { "VP8LTransformColorInverse/rows", 1, 0, 0., SetupARGBRows,
+    CallTransformColorInverseRows, GetTransformColorInverse, NULL },
+  { "VP8LMapColor32b/rows", 1, 0, 0., SetupARGBRows, CallMapColor32bRows,
+    GetMapColor32b, NULL },
+  { "VP8LMapColor8b/rows", 1, 0, 0., SetupARGBRows, CallMapColor8bRows,
+    GetMapColor8b, NULL },
+  // lossless encoding
+  { "VP8LSubtractGreenFromBlueAndRed", 1, ROW_LEN, 0., SetupARGB,
+    CallSubtractGreen, GetSubtractGreen, NULL },
+  { "VP8LTransformColor", 1, ROW_LEN, 0., SetupARGB, CallTransformColor,
+    GetTransformColor, NULL },
+  { "VP8LCollectColorBlueTransforms", 1, 32 * 8, 0., SetupCollectColor,
+    CallCollectColorBlue, GetCollectColorBlue, NULL },
+  { "VP8LCollectColorRedTransforms", 1, 32 * 8, 0., SetupCollectColor,
+    CallCollectColorRed, GetCollectColorRed, NULL },
+  { "VP8LFastLog2Slow", 1, MAX_RETURNS, 1e-6, SetupLog2, CallFastLog2Slow,
+    GetFastLog2Slow, NULL },
+  { "VP8LFastSLog2Slow", 1, MAX_RETURNS, 1e-6, SetupLog2, CallFastSLog2Slow,
+    GetFastSLog2Slow, NULL },
+  { "VP8LExtraCost", 1, NUM_DISTANCE_CODES, 1e-9, SetupPopulation,
+    CallExtraCost, GetExtraCost, NULL },
+  { "VP8LExtraCostCombined", 1, NUM_DISTANCE_CODES, 1e-9, SetupPopulation,
+    CallExtraCostCombined, GetExtraCostCombined, NULL },
+  { "VP8LCombinedShannonEntropy", 1, 256, 1e-6, SetupPopulation,
+    CallCombinedShannonEntropy, GetCombinedShannonEntropy, NULL },
+  { "VP8LGetEntropyUnrefinedHelper", 2, NUM_LOSSLESS_CODES, 1e-6,
+    SetupPopulation, CallEntropyUnrefined, GetEntropyUnrefinedHelper, NULL },
+  { "VP8LHistogramAdd", 1, NUM_LOSSLESS_CODES, 0., SetupHistogramAdd,
+    CallHistogramAdd, GetHistogramAdd, CollectHistogramAdd },
+  { "VP8LVectorMismatch", 1, ROW_LEN, 0., SetupVectorMismatch,
+    CallVectorMismatch, GetVectorMismatch, NULL }
+};
+#define NUM_TESTS ((int)(sizeof(kTests) / sizeof(kTests[0])))
+
+// Tests with a NULL name cover tables of differently-named pointers.
+static const char* GetTestName(const DspTest* const test, int index,
+                               char name[], size_t size) {
+  if (test->name == NULL) {
+    if (test->call == CallSimpleFilter) return kSimpleFilterNames[index];
+    if (test->call == CallLumaFilter) return kLumaFilterNames[index];
+    if (test->call == CallChromaFilter) return kChromaFilterNames[index];
+    if (test->call == CallMetric) return kMetricNames[index];
+    return kConverterNames[index];
+  }
+  if (test->num_entries == 1) return test->name;
+  snprintf(name, size, "%s[%d]", test->name, index);
+  return name;
+}
+
+// Pixels per call of the tests covering tables of different block sizes.
+static int GetTestPixels(const DspTest* const test, int index) {
+  static const int kMetricPixels[6] = { 256, 128, 64, 16, 256, 128 };
+  if (test->call == CallMetric) return kMetricPixels[index];
+  if (test->call == CallChromaFilter) return 2 * test->pixels;
+  return test->pixels;
+}
+
+//------------------------------------------------------------------------------
+
+typedef struct {
+  int num_trials;
+  int num_calls;          // calls per timing run
+  int check_only;
+  uint32_t seed;
+  const char* const* filters;
+  int num_filters;
+} Options;
+
+typedef struct {
+  uint8_t* dst;           // reference outputs, one BUF_SIZE slot per trial
+  double* ret;            // reference returned values
+} Reference;
+
+static int IsSelected(const Options* const opt, const char* const name) {
+  int i;
+  if (opt->num_filters == 0) return 1;
+  for (i = 0; i < opt->num_filters; ++i) {
+    if (strstr(name, opt->filters[i]) != NULL) return 1;
+  }
+  return 0;
+}
+
+static int SameValue(double a, double b, double tolerance) {
+  const double max = (fabs(a) > fabs(b)) ? fabs(a) : fabs(b);
+  if (tolerance == 0.) return (a == b);
+  return (fabs(a - b) <= tolerance * ((max > 1.) ? max : 1.));
+}
+
+// Returns true if the outputs of the trial match the reference.
+static int CheckTrial(const DspTest* const test, const Context* const ctx,
+                      const Reference* const ref, int trial) {
+  int i;
+  if (memcmp(ctx->dst, ref->dst + (size_t)trial * BUF_SIZE, ctx->dst_size)) {
+    return 0;
+  }
+  for (i = 0; i < MAX_RETURNS; ++i) {
+    if (!SameValue(ctx->ret[i], ref->ret[trial * MAX_RETURNS + i],
+                   test->tolerance)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void RunTrial(const DspTest* const test, Context* const ctx,
+                     const Options* const opt, int index, int trial) {
+  ctx->seed = opt->seed + 0x9e3779b9u * (uint32_t)(trial + 1);
+  Random(ctx);
+  memset(ctx->ret, 0, sizeof(ctx->ret));
+  test->setup(ctx, index);
+  test->call(ctx, index);
+  if (test->collect != NULL) test->collect(ctx, index);
+}
+
+// Returns the best time of one call, in ticks.
+static double TimeFunction(const DspTest* const test, Context* const ctx,
+                           const Options* const opt, int index) {
+  double best = 0.;
+  int run, n;
+  RunTrial(test, ctx, opt, index, 0);
+  for (run = 0; run < 5; ++run) {
+    const uint64_t start = ReadTicks();
+    double ticks;
+    for (n = 0; n < opt->num_calls; ++n) test->call(ctx, index);
+    ticks = (double)(ReadTicks() - start) / opt->num_calls;
+    if (run == 0 || ticks < best) best = ticks;
+  }
+  return best;
+}
+
+// Returns false if an implementation doesn't match the plain-C one.
+static int RunTest(const DspTest* const test, int index, Context* const ctx,
+                   const Options* const opt, Reference* const ref) {
+  char buf[64];
+  const char* const name = GetTestName(test, index, buf, sizeof(buf));
+  const int pixels = GetTestPixels(test, index);
+  GenericFunc funcs[NUM_LEVELS];
+  double c_ticks = 0.;
+  int ok = 1;
+  int level, trial, i;
+
+  if (!IsSelected(opt, name)) return 1;
+  for (level = 0; level < NUM_LEVELS; ++level) {
+    int level_ok = 1;
+    double ticks = 0.;
+    funcs[level] = NULL;
+    if (!IsLevelAvailable(level)) continue;
+    SetLevel(level);
+    if (test->get != NULL) {
+      funcs[level] = test->get(index);
+      if (funcs[level] == NULL) return 1;   // unused table entry
+      for (i = 0; i < level; ++i) {
+        if (funcs[i] == funcs[level]) break;
+      }
+      if (i < level) continue;    // same implementation as a lower level
+    }
+    for (trial = 0; trial < opt->num_trials; ++trial) {
+      RunTrial(test, ctx, opt, index, trial);
+      if (level == 0) {
+        memcpy(ref->dst + (size_t)trial * BUF_SIZE, ctx->dst, ctx->dst_size);
+        memcpy(ref->ret + trial * MAX_RETURNS, ctx->ret, sizeof(ctx->ret));
+      } else if (!CheckTrial(test, ctx, ref, trial)) {
+        level_ok = 0;
+        break;
+      }
+    }
+    if (!opt->check_only) {
+      ticks = TimeFunction(test, ctx, opt, index);
+      if (level == 0) c_ticks = ticks;
+    }
+    printf("%-36s %-9s %s", (level == 0) ? name : "", kLevels[level].name,
+           level_ok ? "ok" : "MISMATCH");
+    if (!level_ok) printf(" (trial %d)", trial);
+    if (!opt->check_only && pixels > 0) {
+      printf("%s %9.3f %s/pixel  %5.2fx", level_ok ? "      " : "",
+             ticks / pixels, TICKS_UNIT, (ticks > 0.) ? c_ticks / ticks : 0.);
+    }
+    printf("\n");
+    ok &= level_ok;
+  }
+  return ok;
+}
+
+static void Help(void) {
+  printf("Usage: dsp_bench [options] [function_name ...]\n"
+         "Options:\n"
+         "  -trials <n> .. number of random inputs checked (default: 64)\n"
+         "  -calls <n> ... number of calls per timing (default: 2000)\n"
+         "  -seed <n> .... random seed (default: 1)\n"
+         "  -check ....... only check the conformance, without timing\n"
+         "  -h ........... this help message\n"
+         "\n"
+         "Only the functions whose name contains one of the 'function_name'\n"
+         "arguments are tested, if any. The implementations tested are the\n"
+         "ones allowed by the CPU and by the WEBP_MAX_ISA environment\n"
+         "variable, if set (e.g. WEBP_MAX_ISA=sse2).\n");
+}
+
+int main(int argc, const char* argv[]) {
+  Options opt;
+  Context ctx;
+  Reference ref;
+  int parse_error = 0;
+  int ok = 1;
+  int c, t, i;
+
+  opt.num_trials = 64;
+  opt.num_calls = 2000;
+  opt.check_only = 0;
+  opt.seed = 1;
+  opt.filters = NULL;
+  opt.num_filters = 0;
+  for (c = 1; c < argc && argv[c][0] == '-'; ++c) {
+    if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
+      Help();
+      return 0;
+    } else if (!strcmp(argv[c], "-trials") && c < argc - 1) {
+      opt.num_trials = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-calls") && c < argc - 1) {
+      opt.num_calls = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-seed") && c < argc - 1) {
+      opt.seed = ExUtilGetUInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-check")) {
+      opt.check_only = 1;
+    } else {
+      fprintf(stderr, "Unknown option '%s'\n", argv[c]);
+      parse_error = 1;
+    }
+    if (parse_error) break;
+  }
+  if (parse_error || opt.num_trials < 1 || opt.num_calls < 1 ||
+      opt.seed == 0) {
+    Help();
+    return -1;
+  }
+  opt.filters = argv + c;
+  opt.num_filters = argc - c;
+
+  ref.dst = (uint8_t*)malloc((size_t)opt.num_trials * BUF_SIZE);
+  ref.ret = (double*)malloc(opt.num_trials * MAX_RETURNS * sizeof(*ref.ret));
+  if (ref.dst == NULL || ref.ret == NULL || !InitContext(&ctx)) {
+    fprintf(stderr, "Memory allocation failed.\n");
+    return -1;
+  }
+
+  host_cpu_info = VP8GetCPUInfo;
+  printf("Levels:");
+  for (i = 0; i < NUM_LEVELS; ++i) {
+    if (IsLevelAvailable(i)) printf(" %s", kLevels[i].name);
+  }
+  printf("\n");
+  for (t = 0; t < NUM_TESTS; ++t) {
+    for (i = 0; i < kTests[t].num_entries; ++i) {
+      ok &= RunTest(&kTests[t], i, &ctx, &opt, &ref);
+    }
+  }
+  VP8GetCPUInfo = host_cpu_info;
+
+  printf("%s\n", ok ? "All implementations match."
+                    : "Some implementations MISMATCH.");
+  ClearContext(&ctx);
+  free(ref.dst);
+  free(ref.ret);
+  return ok ? 0 : 1;
+}
@@ -73,7 +73,8 @@ typedef enum {
   RGB, RGBA, BGR, BGRA, ARGB,
   RGBA_4444, RGB_565,
   rgbA, bgrA, Argb, rgbA_4444,
-  YUV, YUVA
+  YUV, YUVA,
+  NV12, NV21
 } OutputFileFormat;
 
 #ifdef HAVE_WINCODEC_H
@@ -486,6 +487,27 @@ static int WritePGMOrYUV(FILE* fout, const WebPDecBuffer* const buffer,
   return ok;
 }
 
+// format=NV12/NV21: save the luma plane followed by the interleaved chroma
+// one, without header.
+static int WriteSemiPlanar(FILE* fout, const WebPDecBuffer* const buffer) {
+  const int width = buffer->width;
+  const int height = buffer->height;
+  const WebPYUVABuffer* const yuv = &buffer->u.YUVA;
+  const uint8_t* const uv =
+      (buffer->colorspace == MODE_NV12) ? yuv->u : yuv->v;
+  const int uv_width = 2 * ((width + 1) / 2);
+  const int uv_height = (height + 1) / 2;
+  int ok = 1;
+  int y;
+  for (y = 0; ok && y < height; ++y) {
+    ok &= (fwrite(yuv->y + y * yuv->y_stride, width, 1, fout) == 1);
+  }
+  for (y = 0; ok && y < uv_height; ++y) {
+    ok &= (fwrite(uv + y * yuv->u_stride, uv_width, 1, fout) == 1);
+  }
+  return ok;
+}
+
 static int SaveOutput(const WebPDecBuffer* const buffer,
                       OutputFileFormat format, const char* const out_file) {
   FILE* fout = NULL;
@@ -531,6 +553,8 @@ static int SaveOutput(const WebPDecBuffer* const buffer,
   } else if (format == PGM || format == RAW_YUV ||
              format == YUV || format == YUVA) {
     ok &= WritePGMOrYUV(fout, buffer, format == RAW_YUV ? RAW_YUV : PGM);
+  } else if (format == NV12 || format == NV21) {
+    ok &= WriteSemiPlanar(fout, buffer);
   } else if (format == ALPHA_PLANE_ONLY) {
     ok &= WriteAlphaPlane(fout, buffer);
   }
@@ -559,6 +583,23 @@ static int SaveOutput(const WebPDecBuffer* const buffer,
   return ok;
 }
 
+// The timings are only available if libwebp was built with WEBP_STAGE_TIMING.
+static void PrintStageStats(const WebPDecStageStats* const stats) {
+  const double ms = 1e-6;
+  if (stats->total_ns == 0) return;
+  fprintf(stderr, "Decoding stages (ms): header %.3f, tokens %.3f, "
+                  "reconstruction %.3f, filtering %.3f\n",
+          stats->header_ns * ms, stats->tokens_ns * ms,
+          stats->reconstruct_ns * ms, stats->filter_ns * ms);
+  fprintf(stderr, "                      conversion %.3f, alpha %.3f, "
+                  "rescaling %.3f, total %.3f\n",
+          stats->convert_ns * ms, stats->alpha_ns * ms,
+          stats->rescale_ns * ms, stats->total_ns * ms);
+  fprintf(stderr, "Input: %u bytes (alpha: %u), %d macroblocks\n",
+          (uint32_t)stats->bytes_in, (uint32_t)stats->alpha_bytes,
+          stats->num_mbs);
+}
+
 static void Help(void) {
   printf("Usage: dwebp in_file [options] [-o out_file]\n\n"
          "Decodes the WebP image file to PNG format [Default]\n"
@@ -579,9 +620,14 @@ static void Help(void) {
          "  -dither <d> .. dithering strength (in 0..100)\n"
          "  -alpha_dither  use alpha-plane dithering if needed\n"
          "  -mt .......... use multi-threading\n"
+         "  -threads <n> . use up to <n> threads for lossy decoding (implies\n"
+         "                 -mt)\n"
          "  -crop <x> <y> <w> <h> ... crop output with the given rectangle\n"
          "  -resize <w> <h> ......... scale the output (*after* any cropping)\n"
+         "  -lanczos ..... use a Lanczos filter for -resize (sharper)\n"
          "  -flip ........ flip the output vertically\n"
+         "  -thumbnail ... fast, approximate 1/4-scale decoding of lossy\n"
+         "                 pictures (crop and resize apply to this size)\n"
          "  -alpha ....... only save the alpha plane\n"
          "  -incremental . use incremental decoding (useful for tests)\n"
          "  -h ........... this help message\n"
@@ -622,6 +668,27 @@ static uint8_t* AllocateExternalBuffer(WebPDecoderConfig* config,
     output_buffer->u.RGBA.stride = stride;
     output_buffer->u.RGBA.size = stride * h;
     output_buffer->u.RGBA.rgba = external_buffer;
+  } else if (format == NV12 || format == NV21) {
+    // odd strides, so that the rows are not aligned
+    const uint32_t stride = w + 3;
+    const uint32_t uv_stride = 2 * ((w + 1) / 2) + 13;
+    const uint32_t uv_size = uv_stride * ((h + 1) / 2);
+    const int u_first = (format == NV12);
+    uint8_t* uv;
+    external_buffer = (uint8_t*)malloc(stride * h + uv_size);
+    if (external_buffer == NULL) return NULL;
+    uv = external_buffer + stride * h;
+    output_buffer->u.YUVA.y = external_buffer;
+    output_buffer->u.YUVA.y_stride = stride;
+    output_buffer->u.YUVA.y_size = stride * h;
+    output_buffer->u.YUVA.u = uv + (u_first ? 0 : 1);
+    output_buffer->u.YUVA.u_stride = uv_stride;
+    output_buffer->u.YUVA.u_size = uv_size - (u_first ? 0 : 1);
+    output_buffer->u.YUVA.v = uv + (u_first ? 1 : 0);
+    output_buffer->u.YUVA.v_stride = uv_stride;
+    output_buffer->u.YUVA.v_size = uv_size - (u_first ? 1 : 0);
+    output_buffer->u.YUVA.a = NULL;
+    output_buffer->u.YUVA.a_stride = 0;
   } else {    // YUV and YUVA
     const int has_alpha = WebPIsAlphaMode(output_buffer->colorspace);
     uint8_t* tmp;
@@ -667,6 +734,7 @@ int main(int argc, const char *argv[]) {
   const char *out_file = NULL;
 
   WebPDecoderConfig config;
+  WebPDecStageStats stage_stats;
   WebPDecBuffer* const output_buffer = &config.output;
   WebPBitstreamFeatures* const bitstream = &config.input;
   OutputFileFormat format = PNG;
@@ -729,6 +797,8 @@ int main(int argc, const char *argv[]) {
       else if (!strcmp(fmt, "rgbA_4444")) format = rgbA_4444;
       else if (!strcmp(fmt, "YUV"))  format = YUV;
       else if (!strcmp(fmt, "YUVA")) format = YUVA;
+      else if (!strcmp(fmt, "NV12")) format = NV12;
+      else if (!strcmp(fmt, "NV21")) format = NV21;
       else {
         fprintf(stderr, "Can't parse pixel_format %s\n", fmt);
         parse_error = 1;
@@ -741,6 +811,9 @@ int main(int argc, const char *argv[]) {
       }
     } else if (!strcmp(argv[c], "-mt")) {
       config.options.use_threads = 1;
+    } else if (!strcmp(argv[c], "-threads") && c < argc - 1) {
+      config.options.use_threads = 1;
+      config.options.num_threads = ExUtilGetInt(argv[++c], 0, &parse_error);
     } else if (!strcmp(argv[c], "-alpha_dither")) {
       config.options.alpha_dithering_strength = 100;
     } else if (!strcmp(argv[c], "-nodither")) {
@@ -759,8 +832,12 @@ int main(int argc, const char *argv[]) {
       config.options.use_scaling = 1;
       config.options.scaled_width  = ExUtilGetInt(argv[++c], 0, &parse_error);
       config.options.scaled_height = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-lanczos")) {
+      config.options.rescaling_filter = WEBP_RESCALE_LANCZOS3;
     } else if (!strcmp(argv[c], "-flip")) {
       config.options.flip = 1;
+    } else if (!strcmp(argv[c], "-thumbnail")) {
+      config.options.use_quarter_thumbnail = 1;
     } else if (!strcmp(argv[c], "-v")) {
       verbose = 1;
 #ifndef WEBP_DLL
@@ -843,6 +920,8 @@ int main(int argc, const char *argv[]) {
       case rgbA_4444: output_buffer->colorspace = MODE_rgbA_4444; break;
       case YUV: output_buffer->colorspace = MODE_YUV; break;
       case YUVA: output_buffer->colorspace = MODE_YUVA; break;
+      case NV12: output_buffer->colorspace = MODE_NV12; break;
+      case NV21: output_buffer->colorspace = MODE_NV21; break;
       default: goto Exit;
     }
 
@@ -852,6 +931,10 @@ int main(int argc, const char *argv[]) {
       if (external_buffer == NULL) goto Exit;
     }
 
+    if (verbose) {
+      memset(&stage_stats, 0, sizeof(stage_stats));
+      config.options.stage_stats = &stage_stats;
+    }
     if (incremental) {
       status = ExUtilDecodeWebPIncremental(data, data_size, verbose, &config);
     } else {
@@ -863,6 +946,7 @@ int main(int argc, const char *argv[]) {
       ExUtilPrintWebPError(in_file, status);
       goto Exit;
     }
+    if (verbose) PrintStageStats(&stage_stats);
   }
 
   if (out_file != NULL) {
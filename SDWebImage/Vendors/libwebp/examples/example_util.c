@@ -158,9 +158,11 @@ int ExUtilWriteFile(const char* const file_name,
 //------------------------------------------------------------------------------
 // WebP decoding
 
-static const char* const kStatusMessages[VP8_STATUS_NOT_ENOUGH_DATA + 1] = {
+static const char* const
+    kStatusMessages[VP8_STATUS_MEMORY_BUDGET_EXCEEDED + 1] = {
   "OK", "OUT_OF_MEMORY", "INVALID_PARAM", "BITSTREAM_ERROR",
-  "UNSUPPORTED_FEATURE", "SUSPENDED", "USER_ABORT", "NOT_ENOUGH_DATA"
+  "UNSUPPORTED_FEATURE", "SUSPENDED", "USER_ABORT", "NOT_ENOUGH_DATA",
+  "MEMORY_BUDGET_EXCEEDED"
 };
 
 static void PrintAnimationWarning(const WebPDecoderConfig* const config) {
@@ -175,7 +177,7 @@ static void PrintAnimationWarning(const WebPDecoderConfig* const config) {
 void ExUtilPrintWebPError(const char* const in_file, int status) {
   fprintf(stderr, "Decoding of %s failed.\n", in_file);
   fprintf(stderr, "Status: %d", status);
-  if (status >= VP8_STATUS_OK && status <= VP8_STATUS_NOT_ENOUGH_DATA) {
+  if (status >= VP8_STATUS_OK && status <= VP8_STATUS_MEMORY_BUDGET_EXCEEDED) {
     fprintf(stderr, "(%s)", kStatusMessages[status]);
   }
   fprintf(stderr, "\n");
@@ -0,0 +1,119 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Measures the per-picture decoding latency of multi-threaded decoding,
+//  with the default worker interface (one thread spawned per worker and per
+//  picture) and with the pooled one (persistent threads).
+//
+//  Usage: pool_bench [options] in_file.webp [in_file2.webp ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "webp/decode.h"
+#include "utils/thread.h"
+#include "./example_util.h"
+#include "./stopwatch.h"
+
+static void Help(void) {
+  printf("Usage: pool_bench [options] in_file.webp [in_file2.webp ...]\n"
+         "Options:\n"
+         "  -loops <n> ... number of decodes per file and mode (default: 100)\n"
+         "  -threads <n> . number of decoding threads (default: 4)\n"
+         "  -pool <n> .... number of threads in the pool (default: 4)\n"
+         "  -h ........... this help message\n");
+}
+
+// Returns the average decoding time of 'data', in microseconds, or a negative
+// value in case of error.
+static double TimeDecode(const uint8_t* const data, size_t data_size,
+                         int loops, int num_threads) {
+  WebPDecoderConfig config;
+  Stopwatch stop_watch;
+  int n;
+  if (!WebPInitDecoderConfig(&config)) return -1.;
+  config.options.use_threads = 1;
+  config.options.num_threads = num_threads;
+  config.output.colorspace = MODE_RGBA;
+  StopwatchReset(&stop_watch);
+  for (n = 0; n < loops; ++n) {
+    const VP8StatusCode status = WebPDecode(data, data_size, &config);
+    WebPFreeDecBuffer(&config.output);
+    if (status != VP8_STATUS_OK) return -1.;
+  }
+  return StopwatchReadAndReset(&stop_watch) * 1e6 / loops;
+}
+
+int main(int argc, const char* argv[]) {
+  int loops = 100;
+  int num_threads = 4;
+  int pool_size = 4;
+  int parse_error = 0;
+  int ok = 1;
+  int c;
+  const WebPWorkerInterface default_interface = *WebPGetWorkerInterface();
+  const WebPWorkerInterface* pool_interface;
+
+  for (c = 1; c < argc && argv[c][0] == '-'; ++c) {
+    if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
+      Help();
+      return 0;
+    } else if (!strcmp(argv[c], "-loops") && c < argc - 1) {
+      loops = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-threads") && c < argc - 1) {
+      num_threads = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-pool") && c < argc - 1) {
+      pool_size = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else {
+      fprintf(stderr, "Unknown option '%s'\n", argv[c]);
+      parse_error = 1;
+    }
+    if (parse_error) break;
+  }
+  if (parse_error || c == argc || loops < 1) {
+    Help();
+    return -1;
+  }
+
+  pool_interface = WebPWorkerPoolStart(pool_size);
+  if (pool_interface == NULL) {
+    fprintf(stderr, "Could not start a pool of %d threads.\n", pool_size);
+    return -1;
+  }
+
+  printf("%-32s %9s %14s %14s %8s\n",
+         "file", "size", "default (us)", "pooled (us)", "speedup");
+  for (; c < argc; ++c) {
+    const uint8_t* data = NULL;
+    size_t data_size = 0;
+    double default_time, pooled_time;
+    if (!ExUtilReadFile(argv[c], &data, &data_size)) {
+      ok = 0;
+      continue;
+    }
+    // warm-up
+    TimeDecode(data, data_size, 1, num_threads);
+    WebPSetWorkerInterface(&default_interface);
+    default_time = TimeDecode(data, data_size, loops, num_threads);
+    WebPSetWorkerInterface(pool_interface);
+    pooled_time = TimeDecode(data, data_size, loops, num_threads);
+    WebPSetWorkerInterface(&default_interface);
+    if (default_time < 0. || pooled_time < 0.) {
+      fprintf(stderr, "Decoding of %s failed.\n", argv[c]);
+      ok = 0;
+    } else {
+      printf("%-32s %9d %14.1f %14.1f %7.2fx\n", argv[c], (int)data_size,
+             default_time, pooled_time, default_time / pooled_time);
+    }
+    free((void*)data);
+  }
+  WebPWorkerPoolStop();
+  return ok ? 0 : -1;
+}
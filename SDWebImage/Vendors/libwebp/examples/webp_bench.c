@@ -0,0 +1,664 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  End-to-end benchmark of the decoder and the encoder over a corpus of
+//  images, reporting the throughput, the latency percentiles and the peak
+//  memory usage as JSON.
+//
+//  The WebP files of the corpus are decoded in every output colorspace, with
+//  and without threads, at full size, downscaled by 2 and cropped to their
+//  center. The other images (PNG, JPEG, TIFF) are encoded once, lossy and
+//  lossless, to be decoded the same way. All the images are then encoded with
+//  every method, lossy and lossless, at several qualities.
+//
+//  Usage: webp_bench [options] dir_or_file [dir_or_file2 ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+#include "webp/decode.h"
+#include "webp/encode.h"
+#include "./example_util.h"
+#include "./image_dec.h"
+#include "./stopwatch.h"
+
+#define MAX_SETTINGS 16
+
+static int verbose = 0;
+
+static void Help(void) {
+  printf("Usage: webp_bench [options] dir_or_file [dir_or_file2 ...]\n"
+         "Options:\n"
+         "  -iter <n> .... runs per picture and setting (default: 3)\n"
+         "  -m <list> .... encoding methods, -1 for realtime\n"
+         "                 (default: 0,1,2,3,4,5,6)\n"
+         "  -q <list> .... lossy encoding qualities (default: 50,75,95)\n"
+         "  -lq <list> ... lossless encoding qualities (default: 25,75)\n"
+         "  -mt .......... use multi-threaded encoding\n"
+         "  -no_decode ... skip the decoding benchmarks\n"
+         "  -no_encode ... skip the encoding benchmarks\n"
+         "  -o <file> .... write the JSON report to this file (default: "
+         "stdout)\n"
+         "  -v ........... print the progress\n"
+         "  -h ........... this help message\n"
+         "\n"
+         "Lists are comma-separated, e.g. '-q 50,90'. The throughput is given "
+         "in megapixels\nof output (decoding) or input (encoding) per second. "
+         "The latencies are those\nof one picture.\n");
+}
+
+//------------------------------------------------------------------------------
+// Corpus
+
+typedef struct {
+  char* name;
+  uint8_t* data;          // bitstream to decode
+  size_t data_size;
+  int width, height;
+} DecInput;
+
+typedef struct {
+  char* name;
+  WebPPicture pic;        // ARGB samples to encode
+} EncInput;
+
+typedef struct {
+  DecInput* dec;
+  int num_dec;
+  EncInput* enc;
+  int num_enc;
+} Corpus;
+
+static char* CopyString(const char* const str, const char* const suffix) {
+  const size_t len = strlen(str);
+  char* const copy = (char*)malloc(len + strlen(suffix) + 1);
+  if (copy != NULL) {
+    memcpy(copy, str, len);
+    strcpy(copy + len, suffix);
+  }
+  return copy;
+}
+
+// Takes ownership of 'data' (allocated with malloc()).
+static int AddDecInput(Corpus* const corpus, const char* const name,
+                       const char* const suffix,
+                       uint8_t* const data, size_t data_size) {
+  DecInput* const inputs = (DecInput*)realloc(
+      corpus->dec, (corpus->num_dec + 1) * sizeof(*inputs));
+  DecInput* in;
+  if (inputs == NULL) {
+    free(data);
+    return 0;
+  }
+  corpus->dec = inputs;
+  in = &inputs[corpus->num_dec];
+  if (!WebPGetInfo(data, data_size, &in->width, &in->height)) {
+    free(data);
+    return 0;
+  }
+  in->name = CopyString(name, suffix);
+  if (in->name == NULL) {
+    free(data);
+    return 0;
+  }
+  in->data = data;
+  in->data_size = data_size;
+  ++corpus->num_dec;
+  return 1;
+}
+
+// Encodes 'pic' to add it to the decoding inputs.
+static int AddEncodedInput(Corpus* const corpus, const char* const name,
+                           const WebPPicture* const pic, int lossless) {
+  WebPConfig config;
+  WebPPicture tmp;
+  WebPMemoryWriter writer;
+  int ok;
+  if (!WebPConfigInit(&config) || !WebPPictureInit(&tmp)) return 0;
+  config.lossless = lossless;
+  WebPMemoryWriterInit(&writer);
+  ok = WebPPictureCopy(pic, &tmp);
+  if (ok) {
+    tmp.writer = WebPMemoryWrite;
+    tmp.custom_ptr = &writer;
+    ok = WebPEncode(&config, &tmp);
+  }
+  WebPPictureFree(&tmp);
+  if (!ok) {
+    WebPMemoryWriterClear(&writer);
+    return 0;
+  }
+  return AddDecInput(corpus, name, lossless ? " (lossless)" : " (lossy)",
+                     writer.mem, writer.size);
+}
+
+static int AddFile(Corpus* const corpus, const char* const file_name) {
+  const uint8_t* data = NULL;
+  size_t data_size = 0;
+  WebPImageReader reader;
+  EncInput* inputs;
+  EncInput* in;
+  int is_webp;
+  int ok = 0;
+
+  if (!ExUtilReadFile(file_name, &data, &data_size)) return 0;
+  reader = WebPGuessImageReader(data, data_size);
+  if (reader == NULL) {
+    if (verbose) fprintf(stderr, "Skipping %s (unknown format).\n", file_name);
+    free((void*)data);
+    return 1;
+  }
+  inputs = (EncInput*)realloc(corpus->enc,
+                              (corpus->num_enc + 1) * sizeof(*inputs));
+  if (inputs == NULL) goto End;
+  corpus->enc = inputs;
+  in = &inputs[corpus->num_enc];
+  if (!WebPPictureInit(&in->pic)) goto End;
+  in->pic.use_argb = 1;
+  if (!reader(data, data_size, &in->pic, 1, NULL)) {
+    fprintf(stderr, "Could not read %s.\n", file_name);
+    WebPPictureFree(&in->pic);
+    goto End;
+  }
+  in->name = CopyString(file_name, "");
+  if (in->name == NULL) {
+    WebPPictureFree(&in->pic);
+    goto End;
+  }
+  ++corpus->num_enc;
+
+  is_webp = (WebPGuessImageType(data, data_size) == WEBP_WEBP_FORMAT);
+  if (is_webp) {
+    ok = AddDecInput(corpus, file_name, "", (uint8_t*)data, data_size);
+    data = NULL;   // now owned by the corpus
+  } else {
+    ok = AddEncodedInput(corpus, file_name, &in->pic, 0) &&
+         AddEncodedInput(corpus, file_name, &in->pic, 1);
+  }
+  if (!ok) fprintf(stderr, "Could not add %s to the corpus.\n", file_name);
+
+ End:
+  free((void*)data);
+  return ok;
+}
+
+static int CompareNames(const void* a, const void* b) {
+  return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+// Appends a copy of 'dir'/'name' to the list. Returns false on error.
+static int AppendPath(const char* const dir, const char* const name,
+                      char*** const files, int* const num_files,
+                      int* const max_files) {
+  char* const path = (char*)malloc(strlen(dir) + strlen(name) + 2);
+  if (path == NULL) return 0;
+  sprintf(path, "%s/%s", dir, name);
+  if (*num_files == *max_files) {
+    const int new_max = 2 * *max_files + 16;
+    char** const tmp = (char**)realloc(*files, new_max * sizeof(*tmp));
+    if (tmp == NULL) {
+      free(path);
+      return 0;
+    }
+    *files = tmp;
+    *max_files = new_max;
+  }
+  (*files)[(*num_files)++] = path;
+  return 1;
+}
+
+// Lists the regular files of 'dir', in alphabetical order. Returns the number
+// of files, or -1 if 'dir' is not a directory.
+static int ListDirectory(const char* const dir, char*** const files) {
+  int num_files = 0;
+  int max_files = 0;
+#if defined(_WIN32)
+  WIN32_FIND_DATAA entry;
+  HANDLE handle;
+  char* const pattern = CopyString(dir, "\\*");
+  if (pattern == NULL) return -1;
+  handle = FindFirstFileA(pattern, &entry);
+  free(pattern);
+  if (handle == INVALID_HANDLE_VALUE) return -1;
+  *files = NULL;
+  do {
+    if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+    if (!AppendPath(dir, entry.cFileName, files, &num_files, &max_files)) {
+      break;
+    }
+  } while (FindNextFileA(handle, &entry));
+  FindClose(handle);
+#else
+  struct dirent* entry;
+  DIR* const handle = opendir(dir);
+  if (handle == NULL) return -1;
+  *files = NULL;
+  while ((entry = readdir(handle)) != NULL) {
+    if (entry->d_name[0] == '.') continue;   // hidden files, '.' and '..'
+    if (!AppendPath(dir, entry->d_name, files, &num_files, &max_files)) {
+      break;
+    }
+    {
+      struct stat st;
+      if (stat((*files)[num_files - 1], &st) != 0 || !S_ISREG(st.st_mode)) {
+        free((*files)[--num_files]);
+      }
+    }
+  }
+  closedir(handle);
+#endif
+  if (num_files > 0) qsort(*files, num_files, sizeof(**files), CompareNames);
+  return num_files;
+}
+
+static int AddPath(Corpus* const corpus, const char* const path) {
+  char** files = NULL;
+  const int num_files = ListDirectory(path, &files);
+  int ok = 1;
+  int i;
+  if (num_files < 0) return AddFile(corpus, path);
+  for (i = 0; i < num_files; ++i) {
+    ok &= AddFile(corpus, files[i]);
+    free(files[i]);
+  }
+  free(files);
+  return ok;
+}
+
+static void ClearCorpus(Corpus* const corpus) {
+  int i;
+  for (i = 0; i < corpus->num_dec; ++i) {
+    free(corpus->dec[i].name);
+    free(corpus->dec[i].data);
+  }
+  for (i = 0; i < corpus->num_enc; ++i) {
+    free(corpus->enc[i].name);
+    WebPPictureFree(&corpus->enc[i].pic);
+  }
+  free(corpus->dec);
+  free(corpus->enc);
+  memset(corpus, 0, sizeof(*corpus));
+}
+
+//------------------------------------------------------------------------------
+// Measurements
+
+typedef struct {
+  double* times;          // latency of each run, in seconds
+  int num_times;
+  double total_time;
+  double megapixels;      // total over the runs
+  double bytes;           // compressed size, total over the corpus
+  int num_errors;
+} Result;
+
+static int InitResult(Result* const result, int max_runs) {
+  memset(result, 0, sizeof(*result));
+  result->times = (double*)malloc(max_runs * sizeof(*result->times));
+  return (result->times != NULL);
+}
+
+static void AddRun(Result* const result, double time, int width, int height) {
+  result->times[result->num_times++] = time;
+  result->total_time += time;
+  result->megapixels += (double)width * height / 1e6;
+}
+
+static int CompareTimes(const void* a, const void* b) {
+  const double ta = *(const double*)a;
+  const double tb = *(const double*)b;
+  return (ta < tb) ? -1 : (ta > tb) ? 1 : 0;
+}
+
+// Nearest-rank percentile of the sorted times, in milliseconds.
+static double Percentile(const Result* const result, int percent) {
+  int rank = (result->num_times * percent + 99) / 100;
+  if (result->num_times == 0) return 0.;
+  if (rank < 1) rank = 1;
+  return result->times[rank - 1] * 1000.;
+}
+
+static double PeakRSSKiB(void) {
+#if defined(_WIN32)
+  return 0.;    // not available
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.;
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024.;   // in bytes
+#else
+  return (double)usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void PrintJSONString(FILE* const out, const char* str) {
+  fputc('"', out);
+  for (; *str != '\0'; ++str) {
+    if (*str == '"' || *str == '\\') {
+      fprintf(out, "\\%c", *str);
+    } else if ((unsigned char)*str < 0x20) {
+      fprintf(out, "\\u%04x", *str);
+    } else {
+      fputc(*str, out);
+    }
+  }
+  fputc('"', out);
+}
+
+// Prints the result of one setting and releases its memory.
+static void PrintResult(FILE* const out, const char* const op,
+                        const char* const name, Result* const result,
+                        int* const is_first) {
+  qsort(result->times, result->num_times, sizeof(*result->times),
+        CompareTimes);
+  fprintf(out, "%s\n    {\"op\": \"%s\", \"name\": ",
+          *is_first ? "" : ",", op);
+  PrintJSONString(out, name);
+  fprintf(out, ", \"runs\": %d, \"errors\": %d, "
+               "\"megapixels_per_s\": %.3f, \"p50_ms\": %.3f, "
+               "\"p99_ms\": %.3f",
+          result->num_times, result->num_errors,
+          (result->total_time > 0.) ? result->megapixels / result->total_time
+                                    : 0.,
+          Percentile(result, 50), Percentile(result, 99));
+  if (result->bytes > 0.) fprintf(out, ", \"bytes\": %.0f", result->bytes);
+  fprintf(out, "}");
+  if (verbose) {
+    fprintf(stderr, "%-8s %-36s %9.2f MP/s  p50 %9.3f ms  p99 %9.3f ms\n",
+            op, name,
+            (result->total_time > 0.) ? result->megapixels / result->total_time
+                                      : 0.,
+            Percentile(result, 50), Percentile(result, 99));
+  }
+  free(result->times);
+  result->times = NULL;
+  *is_first = 0;
+}
+
+//------------------------------------------------------------------------------
+// Decoding
+
+static const char* const kModeNames[MODE_LAST] = {
+  "RGB", "RGBA", "BGR", "BGRA", "ARGB", "RGBA_4444", "RGB_565",
+  "rgbA", "bgrA", "Argb", "rgbA_4444", "YUV", "YUVA", "NV12", "NV21"
+};
+
+typedef enum { FULL_SIZE = 0, SCALED, CROPPED, NUM_SIZES } OutputSize;
+static const char* const kSizeNames[NUM_SIZES] = { "full", "scaled", "crop" };
+
+static void SetupDecoding(const DecInput* const in, WEBP_CSP_MODE mode,
+                          int use_threads, OutputSize size,
+                          WebPDecoderConfig* const config,
+                          int* const width, int* const height) {
+  WebPDecoderOptions* const options = &config->options;
+  config->output.colorspace = mode;
+  options->use_threads = use_threads;
+  *width = in->width;
+  *height = in->height;
+  if (size == SCALED) {
+    options->use_scaling = 1;
+    options->scaled_width = *width = (in->width + 1) / 2;
+    options->scaled_height = *height = (in->height + 1) / 2;
+  } else if (size == CROPPED) {
+    options->use_cropping = 1;
+    options->crop_left = in->width / 4;
+    options->crop_top = in->height / 4;
+    options->crop_width = *width = (in->width > 1) ? in->width / 2 : 1;
+    options->crop_height = *height = (in->height > 1) ? in->height / 2 : 1;
+  }
+}
+
+static int BenchDecoding(const Corpus* const corpus, int num_iterations,
+                         FILE* const out, int* const is_first) {
+  int mode, use_threads, size;
+  for (mode = MODE_RGB; mode < MODE_LAST; ++mode) {
+    for (use_threads = 0; use_threads <= 1; ++use_threads) {
+      for (size = FULL_SIZE; size < NUM_SIZES; ++size) {
+        Result result;
+        char name[64];
+        int i, n;
+        if (!InitResult(&result, corpus->num_dec * num_iterations)) return 0;
+        for (n = 0; n < num_iterations; ++n) {
+          for (i = 0; i < corpus->num_dec; ++i) {
+            const DecInput* const in = &corpus->dec[i];
+            WebPDecoderConfig config;
+            Stopwatch stop_watch;
+            int width, height;
+            VP8StatusCode status;
+            double time;
+            if (!WebPInitDecoderConfig(&config)) return 0;
+            SetupDecoding(in, (WEBP_CSP_MODE)mode, use_threads,
+                          (OutputSize)size, &config, &width, &height);
+            StopwatchReset(&stop_watch);
+            status = WebPDecode(in->data, in->data_size, &config);
+            time = StopwatchReadAndReset(&stop_watch);
+            WebPFreeDecBuffer(&config.output);
+            if (status != VP8_STATUS_OK) {
+              if (n == 0) ExUtilPrintWebPError(in->name, status);
+              ++result.num_errors;
+              continue;
+            }
+            AddRun(&result, time, width, height);
+          }
+        }
+        snprintf(name, sizeof(name), "%s/%s/%s", kModeNames[mode],
+                 use_threads ? "mt" : "st", kSizeNames[size]);
+        PrintResult(out, "decode", name, &result, is_first);
+      }
+    }
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Encoding
+
+// Returns the size of the encoded picture, or 0 in case of error. Only
+// WebPEncode() is timed.
+static size_t EncodeOnce(const WebPConfig* const config,
+                         const WebPPicture* const src, double* const time) {
+  WebPPicture pic;
+  WebPMemoryWriter writer;
+  Stopwatch stop_watch;
+  size_t size = 0;
+  if (!WebPPictureInit(&pic)) return 0;
+  WebPMemoryWriterInit(&writer);
+  if (WebPPictureCopy(src, &pic)) {
+    int ok;
+    pic.writer = WebPMemoryWrite;
+    pic.custom_ptr = &writer;
+    StopwatchReset(&stop_watch);
+    ok = WebPEncode(config, &pic);
+    *time = StopwatchReadAndReset(&stop_watch);
+    if (ok) size = writer.size;
+  }
+  WebPPictureFree(&pic);
+  WebPMemoryWriterClear(&writer);
+  return size;
+}
+
+static int BenchEncoding(const Corpus* const corpus, int num_iterations,
+                         const int methods[], int num_methods,
+                         const int qualities[], int num_qualities,
+                         const int lossless_qualities[],
+                         int num_lossless_qualities,
+                         int use_threads, FILE* const out,
+                         int* const is_first) {
+  int lossless, m, q;
+  for (lossless = 0; lossless <= 1; ++lossless) {
+    const int* const quality_list =
+        lossless ? lossless_qualities : qualities;
+    const int num_quality = lossless ? num_lossless_qualities : num_qualities;
+    for (m = 0; m < num_methods; ++m) {
+      for (q = 0; q < num_quality; ++q) {
+        WebPConfig config;
+        Result result;
+        char name[64];
+        int i, n;
+        if (!WebPConfigInit(&config)) return 0;
+        config.lossless = lossless;
+        config.method = methods[m];
+        config.quality = (float)quality_list[q];
+        config.thread_level = use_threads;
+        if (!WebPValidateConfig(&config)) return 0;
+        if (!InitResult(&result, corpus->num_enc * num_iterations)) return 0;
+        for (n = 0; n < num_iterations; ++n) {
+          for (i = 0; i < corpus->num_enc; ++i) {
+            const WebPPicture* const pic = &corpus->enc[i].pic;
+            double time = 0.;
+            const size_t size = EncodeOnce(&config, pic, &time);
+            if (size == 0) {
+              if (n == 0) {
+                fprintf(stderr, "Encoding of %s failed.\n",
+                        corpus->enc[i].name);
+              }
+              ++result.num_errors;
+              continue;
+            }
+            if (n == 0) result.bytes += (double)size;
+            AddRun(&result, time, pic->width, pic->height);
+          }
+        }
+        snprintf(name, sizeof(name), "%s/m%d/q%d",
+                 lossless ? "lossless" : "lossy", methods[m], quality_list[q]);
+        PrintResult(out, "encode", name, &result, is_first);
+      }
+    }
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+
+// Parses a comma-separated list of integers in [min, max].
+static int ParseList(const char* str, int min, int max,
+                     int values[MAX_SETTINGS], int* const num_values) {
+  *num_values = 0;
+  while (*str != '\0') {
+    char* end;
+    const long value = strtol(str, &end, 10);
+    if (end == str || value < min || value > max) return 0;
+    if (*num_values == MAX_SETTINGS) return 0;
+    values[(*num_values)++] = (int)value;
+    if (*end == ',') ++end;
+    else if (*end != '\0') return 0;
+    str = end;
+  }
+  return (*num_values > 0);
+}
+
+int main(int argc, const char* argv[]) {
+  int num_iterations = 3;
+  int methods[MAX_SETTINGS] = { 0, 1, 2, 3, 4, 5, 6 };
+  int num_methods = 7;
+  int qualities[MAX_SETTINGS] = { 50, 75, 95 };
+  int num_qualities = 3;
+  int lossless_qualities[MAX_SETTINGS] = { 25, 75 };
+  int num_lossless_qualities = 2;
+  int use_threads = 0;
+  int no_decode = 0, no_encode = 0;
+  const char* out_file = NULL;
+  FILE* out = stdout;
+  Corpus corpus;
+  int parse_error = 0;
+  int is_first = 1;
+  int ok = 1;
+  int c, i;
+
+  memset(&corpus, 0, sizeof(corpus));
+  for (c = 1; c < argc && argv[c][0] == '-'; ++c) {
+    if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
+      Help();
+      return 0;
+    } else if (!strcmp(argv[c], "-iter") && c < argc - 1) {
+      num_iterations = ExUtilGetInt(argv[++c], 0, &parse_error);
+    } else if (!strcmp(argv[c], "-m") && c < argc - 1) {
+      parse_error = !ParseList(argv[++c], -1, 6, methods, &num_methods);
+    } else if (!strcmp(argv[c], "-q") && c < argc - 1) {
+      parse_error = !ParseList(argv[++c], 0, 100, qualities, &num_qualities);
+    } else if (!strcmp(argv[c], "-lq") && c < argc - 1) {
+      parse_error = !ParseList(argv[++c], 0, 100, lossless_qualities,
+                               &num_lossless_qualities);
+    } else if (!strcmp(argv[c], "-mt")) {
+      use_threads = 1;
+    } else if (!strcmp(argv[c], "-no_decode")) {
+      no_decode = 1;
+    } else if (!strcmp(argv[c], "-no_encode")) {
+      no_encode = 1;
+    } else if (!strcmp(argv[c], "-o") && c < argc - 1) {
+      out_file = argv[++c];
+    } else if (!strcmp(argv[c], "-v")) {
+      verbose = 1;
+    } else {
+      fprintf(stderr, "Unknown option '%s'\n", argv[c]);
+      parse_error = 1;
+    }
+    if (parse_error) break;
+  }
+  if (parse_error || c == argc || num_iterations < 1) {
+    Help();
+    return -1;
+  }
+
+  for (i = c; i < argc; ++i) ok &= AddPath(&corpus, argv[i]);
+  if (corpus.num_dec == 0 && corpus.num_enc == 0) {
+    fprintf(stderr, "No usable picture found.\n");
+    ClearCorpus(&corpus);
+    return -1;
+  }
+
+  if (out_file != NULL) {
+    out = fopen(out_file, "w");
+    if (out == NULL) {
+      fprintf(stderr, "Could not open '%s' for writing.\n", out_file);
+      ClearCorpus(&corpus);
+      return -1;
+    }
+  }
+  {
+    const int version = WebPGetDecoderVersion();
+    fprintf(out, "{\n  \"version\": \"%d.%d.%d\",\n  \"iterations\": %d,\n",
+            (version >> 16) & 0xff, (version >> 8) & 0xff, version & 0xff,
+            num_iterations);
+  }
+  fprintf(out, "  \"decode_inputs\": [");
+  for (i = 0; i < corpus.num_dec; ++i) {
+    fprintf(out, "%s", (i > 0) ? ", " : "");
+    PrintJSONString(out, corpus.dec[i].name);
+  }
+  fprintf(out, "],\n  \"encode_inputs\": [");
+  for (i = 0; i < corpus.num_enc; ++i) {
+    fprintf(out, "%s", (i > 0) ? ", " : "");
+    PrintJSONString(out, corpus.enc[i].name);
+  }
+  fprintf(out, "],\n  \"results\": [");
+  if (!no_decode && corpus.num_dec > 0) {
+    ok &= BenchDecoding(&corpus, num_iterations, out, &is_first);
+  }
+  if (!no_encode && corpus.num_enc > 0) {
+    ok &= BenchEncoding(&corpus, num_iterations, methods, num_methods,
+                        qualities, num_qualities, lossless_qualities,
+                        num_lossless_qualities, use_threads, out, &is_first);
+  }
+  fprintf(out, "\n  ],\n  \"peak_rss_kb\": %.0f\n}\n", PeakRSSKiB());
+
+  if (out != stdout) fclose(out);
+  ClearCorpus(&corpus);
+  return ok ? 0 : -1;
+}
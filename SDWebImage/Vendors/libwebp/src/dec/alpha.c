@@ -153,7 +153,8 @@ static int AllocateAlphaPlane(VP8Decoder* const dec, const VP8Io* const io) {
   const uint64_t alpha_size = (uint64_t)stride * height;
   assert(dec->alpha_plane_mem_ == NULL);
   dec->alpha_plane_mem_ =
-      (uint8_t*)WebPSafeMalloc(alpha_size, sizeof(*dec->alpha_plane_));
+      (uint8_t*)WebPDecContextAlloc(dec->context_, WEBP_DEC_MEM_ALPHA,
+                                    alpha_size, sizeof(*dec->alpha_plane_));
   if (dec->alpha_plane_mem_ == NULL) {
     return 0;
   }
@@ -164,13 +165,133 @@ static int AllocateAlphaPlane(VP8Decoder* const dec, const VP8Io* const io) {
 
 void WebPDeallocateAlphaMemory(VP8Decoder* const dec) {
   assert(dec != NULL);
-  WebPSafeFree(dec->alpha_plane_mem_);
+  WebPGetWorkerInterface()->End(&dec->alpha_worker_);  // before freeing
+  dec->use_alpha_worker_ = 0;
+  WebPDecContextFree(dec->context_, WEBP_DEC_MEM_ALPHA, dec->alpha_plane_mem_);
   dec->alpha_plane_mem_ = NULL;
   dec->alpha_plane_ = NULL;
   ALPHDelete(dec->alph_dec_);
   dec->alph_dec_ = NULL;
 }
 
+// Allocates the alpha plane and sets up the alpha decoder. Returns false in
+// case of error.
+static int InitAlphaDecoding(VP8Decoder* const dec, const VP8Io* const io) {
+  dec->alph_dec_ = ALPHNew();
+  if (dec->alph_dec_ == NULL) return 0;
+  dec->alph_dec_->context_ = dec->context_;
+  if (!AllocateAlphaPlane(dec, io)) return 0;
+  if (!ALPHInit(dec->alph_dec_, dec->alpha_data_, dec->alpha_data_size_,
+                io, dec->alpha_plane_)) {
+    return 0;
+  }
+  // if we allowed use of alpha dithering, check whether it's needed at all
+  if (dec->alph_dec_->pre_processing_ != ALPHA_PREPROCESSED_LEVELS) {
+    dec->alpha_dithering_ = 0;   // disable dithering
+  }
+  return 1;
+}
+
+// Decodes *at least* 'num_rows' rows starting from row number 'row', and
+// dequantizes the plane once it is complete. Returns false in case of error.
+static int DecodeAlphaRows(VP8Decoder* const dec, const VP8Io* const io,
+                           int row, int num_rows) {
+  const int width = io->width;
+  const int height = io->crop_bottom;
+  const uint64_t start = WebPTimerStart();
+  int ok;
+  if (dec->alpha_dithering_ > 0) {
+    num_rows = height - row;     // decode everything in one pass
+  }
+  assert(dec->alph_dec_ != NULL);
+  assert(row + num_rows <= height);
+  ok = ALPHDecode(dec, row, num_rows);
+
+  if (ok && dec->is_alpha_decoded_ && dec->alpha_dithering_ > 0) {
+    uint8_t* const alpha = dec->alpha_plane_ + io->crop_top * width
+                         + io->crop_left;
+    ok = WebPDequantizeLevels(alpha,
+                              io->crop_right - io->crop_left,
+                              io->crop_bottom - io->crop_top,
+                              width, dec->alpha_dithering_);
+  }
+  WebPTimerAdd(&dec->stats_.alpha_ns, start);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Alpha worker.
+//
+// When the rows are emitted by a worker thread (mt_method_ > 0), the alpha
+// plane is decoded concurrently by 'alpha_worker_', in jobs of ALPHA_JOB_ROWS
+// rows. The first job is launched before the first macroblock row is parsed.
+// When the emitter needs rows past 'alpha_row_', it waits for the running job
+// to complete and launches the next one right away, so that the worker stays
+// one job ahead. Rows below 'alpha_row_' are not written anymore, and can be
+// read by the emitter while the next job runs.
+// The alpha decoder is set up and released by the decoding thread only, as
+// its memory comes from the memory scope of the caller (see utils.h).
+
+#define ALPHA_JOB_ROWS 32
+
+static int AlphaJob(VP8Decoder* const dec, void* const unused) {
+  (void)unused;
+  return DecodeAlphaRows(dec, &dec->alpha_io_, dec->alpha_row_,
+                         dec->alpha_job_row_ - dec->alpha_row_);
+}
+
+static void LaunchAlphaJob(VP8Decoder* const dec) {
+  const int height = dec->alpha_io_.crop_bottom;
+  const int last_row = dec->alpha_row_ + ALPHA_JOB_ROWS;
+  assert(dec->alpha_row_ < height);
+  dec->alpha_job_row_ =
+      (last_row < height && dec->alpha_dithering_ == 0) ? last_row : height;
+  WebPGetWorkerInterface()->Launch(&dec->alpha_worker_);
+}
+
+#undef ALPHA_JOB_ROWS
+
+// Waits until the rows before 'last_row' are decoded. Returns false in case
+// of error.
+static int WaitForAlphaRows(VP8Decoder* const dec, int last_row) {
+  while (dec->alpha_row_ < last_row) {
+    if (!WebPGetWorkerInterface()->Sync(&dec->alpha_worker_)) return 0;
+    dec->alpha_row_ = dec->alpha_job_row_;
+    if (dec->alpha_row_ < dec->alpha_io_.crop_bottom) LaunchAlphaJob(dec);
+  }
+  return 1;
+}
+
+int VP8StartAlphaWorker(VP8Decoder* const dec, const VP8Io* const io) {
+  WebPWorker* const worker = &dec->alpha_worker_;
+  assert(dec->alpha_data_ != NULL && dec->alph_dec_ == NULL);
+  dec->use_alpha_worker_ = 0;
+  if (!InitAlphaDecoding(dec, io)) {
+    // Let VP8DecompressAlphaRows() report the error.
+    WebPDeallocateAlphaMemory(dec);
+    return 1;
+  }
+  if (!WebPGetWorkerInterface()->Reset(worker)) return 0;
+  worker->hook = (WebPWorkerHook)AlphaJob;
+  worker->data1 = dec;
+  worker->data2 = NULL;
+  dec->alpha_io_ = *io;
+  dec->alpha_row_ = 0;
+  dec->use_alpha_worker_ = 1;
+  LaunchAlphaJob(dec);
+  return 1;
+}
+
+void VP8SyncAlphaWorker(VP8Decoder* const dec) {
+  if (!dec->use_alpha_worker_) return;
+  // A decoding error is reported to the emitter by its next Sync() call.
+  WebPGetWorkerInterface()->Sync(&dec->alpha_worker_);
+  if (dec->is_alpha_decoded_) {
+    ALPHDelete(dec->alph_dec_);
+    dec->alph_dec_ = NULL;
+  }
+}
+
 //------------------------------------------------------------------------------
 // Main entry point.
 
@@ -186,40 +307,18 @@ const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
     return NULL;    // sanity check.
   }
 
-  if (!dec->is_alpha_decoded_) {
+  if (dec->use_alpha_worker_) {
+    // On error, the memory is released later on by the decoding thread.
+    if (!WaitForAlphaRows(dec, row + num_rows)) return NULL;
+  } else if (!dec->is_alpha_decoded_) {
     if (dec->alph_dec_ == NULL) {    // Initialize decoder.
-      dec->alph_dec_ = ALPHNew();
-      if (dec->alph_dec_ == NULL) return NULL;
-      if (!AllocateAlphaPlane(dec, io)) goto Error;
-      if (!ALPHInit(dec->alph_dec_, dec->alpha_data_, dec->alpha_data_size_,
-                    io, dec->alpha_plane_)) {
-        goto Error;
-      }
-      // if we allowed use of alpha dithering, check whether it's needed at all
-      if (dec->alph_dec_->pre_processing_ != ALPHA_PREPROCESSED_LEVELS) {
-        dec->alpha_dithering_ = 0;   // disable dithering
-      } else {
-        num_rows = height - row;     // decode everything in one pass
-      }
+      if (!InitAlphaDecoding(dec, io)) goto Error;
     }
-
-    assert(dec->alph_dec_ != NULL);
-    assert(row + num_rows <= height);
-    if (!ALPHDecode(dec, row, num_rows)) goto Error;
+    if (!DecodeAlphaRows(dec, io, row, num_rows)) goto Error;
 
     if (dec->is_alpha_decoded_) {   // finished?
       ALPHDelete(dec->alph_dec_);
       dec->alph_dec_ = NULL;
-      if (dec->alpha_dithering_ > 0) {
-        uint8_t* const alpha = dec->alpha_plane_ + io->crop_top * width
-                             + io->crop_left;
-        if (!WebPDequantizeLevels(alpha,
-                                  io->crop_right - io->crop_left,
-                                  io->crop_bottom - io->crop_top,
-                                  width, dec->alpha_dithering_)) {
-          goto Error;
-        }
-      }
     }
   }
 
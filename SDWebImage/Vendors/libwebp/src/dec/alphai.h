@@ -37,6 +37,7 @@ struct ALPHDecoder {
                        // 4 bytes per pixel internally during decode.
   uint8_t* output_;
   const uint8_t* prev_line_;   // last output row (or NULL)
+  WebPDecContext* context_;    // passed to vp8l_dec_
 };
 
 //------------------------------------------------------------------------------
@@ -11,10 +11,13 @@
 //
 // Author: Skal (pascal.massimino@gmail.com)
 
+#include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "./vp8i.h"
 #include "./webpi.h"
+#include "../dsp/dsp.h"
 #include "../utils/utils.h"
 
 //------------------------------------------------------------------------------
@@ -24,7 +27,8 @@
 static const int kModeBpp[MODE_LAST] = {
   3, 4, 3, 4, 4, 2, 2,
   4, 4, 4, 2,    // pre-multiplied modes
-  1, 1 };
+  1, 1,          // planar modes
+  1, 1 };        // semi-planar modes
 
 // Check that webp_csp_mode is within the bounds of WEBP_CSP_MODE.
 // Convert to an integer to handle both the unsigned/signed enum cases
@@ -38,6 +42,12 @@ static int IsValidColorspace(int webp_csp_mode) {
 #define MIN_BUFFER_SIZE(WIDTH, HEIGHT, STRIDE)       \
     (uint64_t)(STRIDE) * ((HEIGHT) - 1) + (WIDTH)
 
+// Returns the start of the interleaved chroma plane of a semi-planar buffer.
+static uint8_t* SemiPlanarUV(const WebPDecBuffer* const buffer) {
+  const WebPYUVABuffer* const buf = &buffer->u.YUVA;
+  return (buffer->colorspace == MODE_NV12) ? buf->u : buf->v;
+}
+
 static VP8StatusCode CheckDecBuffer(const WebPDecBuffer* const buffer) {
   int ok = 1;
   const WEBP_CSP_MODE mode = buffer->colorspace;
@@ -58,14 +68,27 @@ static VP8StatusCode CheckDecBuffer(const WebPDecBuffer* const buffer) {
     const uint64_t v_size = MIN_BUFFER_SIZE(uv_width, uv_height, v_stride);
     const uint64_t a_size = MIN_BUFFER_SIZE(width, height, a_stride);
     ok &= (y_size <= buf->y_size);
-    ok &= (u_size <= buf->u_size);
-    ok &= (v_size <= buf->v_size);
     ok &= (y_stride >= width);
-    ok &= (u_stride >= uv_width);
-    ok &= (v_stride >= uv_width);
     ok &= (buf->y != NULL);
     ok &= (buf->u != NULL);
     ok &= (buf->v != NULL);
+    if (WebPIsSemiPlanarMode(mode)) {
+      // Each pointer reaches the last sample of its row, 2 * uv_width - 1
+      // bytes further.
+      const uint64_t uv_size =
+          MIN_BUFFER_SIZE(2 * uv_width - 1, uv_height, u_stride);
+      ok &= (buf->u_stride == buf->v_stride);
+      ok &= (u_stride >= 2 * uv_width);
+      ok &= (uv_size <= buf->u_size);
+      ok &= (uv_size <= buf->v_size);
+      ok &= (mode == MODE_NV12) ? (buf->v == buf->u + 1)
+                                : (buf->u == buf->v + 1);
+    } else {
+      ok &= (u_size <= buf->u_size);
+      ok &= (v_size <= buf->v_size);
+      ok &= (u_stride >= uv_width);
+      ok &= (v_stride >= uv_width);
+    }
     if (mode == MODE_YUVA) {
       ok &= (a_stride >= width);
       ok &= (a_size <= buf->a_size);
@@ -101,7 +124,10 @@ static VP8StatusCode AllocateBuffer(WebPDecBuffer* const buffer) {
     const int stride = w * kModeBpp[mode];
     const uint64_t size = (uint64_t)stride * h;
 
-    if (!WebPIsRGBMode(mode)) {
+    if (WebPIsSemiPlanarMode(mode)) {
+      uv_stride = 2 * ((w + 1) / 2);
+      uv_size = (uint64_t)uv_stride * ((h + 1) / 2);
+    } else if (!WebPIsRGBMode(mode)) {
       uv_stride = (w + 1) / 2;
       uv_size = (uint64_t)uv_stride * ((h + 1) / 2);
       if (mode == MODE_YUVA) {
@@ -109,16 +135,32 @@ static VP8StatusCode AllocateBuffer(WebPDecBuffer* const buffer) {
         a_size = (uint64_t)a_stride * h;
       }
     }
-    total_size = size + 2 * uv_size + a_size;
+    total_size = size + (WebPIsSemiPlanarMode(mode) ? 1 : 2) * uv_size + a_size;
 
-    // Security/sanity checks
-    output = (uint8_t*)WebPSafeMalloc(total_size, sizeof(*output));
+    // Security/sanity checks. The output is returned to the caller, hence
+    // never comes from a memory policy.
+    output = (uint8_t*)WebPSafeMallocPersistent(total_size, sizeof(*output));
     if (output == NULL) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
     buffer->private_memory = output;
 
-    if (!WebPIsRGBMode(mode)) {   // YUVA initialization
+    if (WebPIsSemiPlanarMode(mode)) {   // NV12/NV21 initialization
+      WebPYUVABuffer* const buf = &buffer->u.YUVA;
+      const int u_first = (mode == MODE_NV12);
+      buf->y = output;
+      buf->y_stride = stride;
+      buf->y_size = (size_t)size;
+      buf->u = output + size + (u_first ? 0 : 1);
+      buf->u_stride = uv_stride;
+      buf->u_size = (size_t)uv_size - (u_first ? 0 : 1);
+      buf->v = output + size + (u_first ? 1 : 0);
+      buf->v_stride = uv_stride;
+      buf->v_size = (size_t)uv_size - (u_first ? 1 : 0);
+      buf->a = NULL;
+      buf->a_size = 0;
+      buf->a_stride = 0;
+    } else if (!WebPIsRGBMode(mode)) {   // YUVA initialization
       WebPYUVABuffer* const buf = &buffer->u.YUVA;
       buf->y = output;
       buf->y_stride = stride;
@@ -169,36 +211,47 @@ VP8StatusCode WebPFlipBuffer(WebPDecBuffer* const buffer) {
   return VP8_STATUS_OK;
 }
 
+// Applies the cropping and scaling 'options' (if any) to the 'w' x 'h'
+// picture. On return, '*in_h' is the height before scaling.
+static VP8StatusCode GetOutputSize(const WebPDecoderOptions* const options,
+                                   int* const w, int* const h,
+                                   int* const in_h) {
+  if (options != NULL && options->use_cropping) {
+    const int cw = options->crop_width;
+    const int ch = options->crop_height;
+    const int x = options->crop_left & ~1;
+    const int y = options->crop_top & ~1;
+    if (x < 0 || y < 0 || cw <= 0 || ch <= 0 || x + cw > *w || y + ch > *h) {
+      return VP8_STATUS_INVALID_PARAM;   // out of frame boundary.
+    }
+    *w = cw;
+    *h = ch;
+  }
+  *in_h = *h;
+  if (options != NULL && options->use_scaling) {
+    int scaled_width = options->scaled_width;
+    int scaled_height = options->scaled_height;
+    if (!WebPRescalerGetScaledDimensions(
+            *w, *h, &scaled_width, &scaled_height)) {
+      return VP8_STATUS_INVALID_PARAM;
+    }
+    *w = scaled_width;
+    *h = scaled_height;
+  }
+  return VP8_STATUS_OK;
+}
+
 VP8StatusCode WebPAllocateDecBuffer(int w, int h,
                                     const WebPDecoderOptions* const options,
                                     WebPDecBuffer* const out) {
   VP8StatusCode status;
+  int in_h;
   if (out == NULL || w <= 0 || h <= 0) {
     return VP8_STATUS_INVALID_PARAM;
   }
-  if (options != NULL) {    // First, apply options if there is any.
-    if (options->use_cropping) {
-      const int cw = options->crop_width;
-      const int ch = options->crop_height;
-      const int x = options->crop_left & ~1;
-      const int y = options->crop_top & ~1;
-      if (x < 0 || y < 0 || cw <= 0 || ch <= 0 || x + cw > w || y + ch > h) {
-        return VP8_STATUS_INVALID_PARAM;   // out of frame boundary.
-      }
-      w = cw;
-      h = ch;
-    }
-    if (options->use_scaling) {
-      int scaled_width = options->scaled_width;
-      int scaled_height = options->scaled_height;
-      if (!WebPRescalerGetScaledDimensions(
-              w, h, &scaled_width, &scaled_height)) {
-        return VP8_STATUS_INVALID_PARAM;
-      }
-      w = scaled_width;
-      h = scaled_height;
-    }
-  }
+  // First, apply options if there is any.
+  status = GetOutputSize(options, &w, &h, &in_h);
+  if (status != VP8_STATUS_OK) return status;
   out->width = w;
   out->height = h;
 
@@ -213,6 +266,92 @@ VP8StatusCode WebPAllocateDecBuffer(int w, int h,
   return status;
 }
 
+//------------------------------------------------------------------------------
+// Band output (see WebPDecodeRows())
+
+// Upper bound on the number of input rows handed to the output functions in a
+// single call: a VP8 macroblock row plus the filtering delay (24 rows), or a
+// VP8L cache of 16 rows, plus the row held back by the fancy upsampler.
+#define MAX_INPUT_ROWS_PER_CALL 32
+
+VP8StatusCode WebPAllocateDecBand(int w, int h, WebPDecParams* const params) {
+  const WebPDecoderOptions* const options = params->options;
+  WebPDecBuffer* const out = params->output;
+  VP8StatusCode status;
+  int in_h, band_h;
+  if (out == NULL || w <= 0 || h <= 0) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  if (out->is_external_memory > 0 || (options != NULL && options->flip)) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  status = GetOutputSize(options, &w, &h, &in_h);
+  if (status != VP8_STATUS_OK) return status;
+  // The band must hold the output rows of one call, plus the (at most 2)
+  // incomplete rows carried over from the previous one.
+  band_h = (int)(((uint64_t)MAX_INPUT_ROWS_PER_CALL * h + in_h - 1) / in_h) + 4;
+  if (band_h > h) band_h = h;
+  out->width = w;
+  out->height = band_h;
+  params->band_y = 0;
+  params->band_last_y = h;
+  return AllocateBuffer(out);
+}
+
+#undef MAX_INPUT_ROWS_PER_CALL
+
+static void MoveRows(uint8_t* const dst, int stride, int from, int num_rows,
+                     int row_size) {
+  if (num_rows > 0 && from > 0) {
+    memmove(dst, dst + (size_t)from * stride,
+            (size_t)(num_rows - 1) * stride + row_size);
+  }
+}
+
+int WebPEmitDecBand(WebPDecParams* const params, int num_rows,
+                    int num_uv_rows) {
+  WebPDecBuffer* const band = params->output;
+  const int band_y = params->band_y;
+  int y_end = num_rows;   // end of the rows that are complete
+  assert(params->put_rows != NULL);
+  if (!WebPIsRGBMode(band->colorspace)) {
+    if (y_end > 2 * num_uv_rows) y_end = 2 * num_uv_rows;
+    if (y_end < params->band_last_y) y_end &= ~1;   // keep 'band_y' even
+  }
+  if (y_end > band_y) {
+    const int done = y_end - band_y;
+    WebPDecBuffer rows = *band;
+    rows.height = done;
+    rows.is_external_memory = 1;
+    rows.private_memory = NULL;
+    if (!params->put_rows(&rows, band_y, params->put_rows_data)) return 0;
+    // Move the rows already written past 'y_end' on top of the band.
+    if (WebPIsRGBMode(band->colorspace)) {
+      const WebPRGBABuffer* const buf = &band->u.RGBA;
+      MoveRows(buf->rgba, buf->stride, done, num_rows - y_end,
+               band->width * kModeBpp[band->colorspace]);
+    } else {
+      const WebPYUVABuffer* const buf = &band->u.YUVA;
+      const int uv_w = (band->width + 1) >> 1;
+      MoveRows(buf->y, buf->y_stride, done, num_rows - y_end, band->width);
+      if (WebPIsSemiPlanarMode(band->colorspace)) {
+        MoveRows(SemiPlanarUV(band), buf->u_stride, done >> 1,
+                 num_uv_rows - (y_end >> 1), 2 * uv_w);
+      } else {
+        MoveRows(buf->u, buf->u_stride, done >> 1, num_uv_rows - (y_end >> 1),
+                 uv_w);
+        MoveRows(buf->v, buf->v_stride, done >> 1, num_uv_rows - (y_end >> 1),
+                 uv_w);
+      }
+      if (buf->a != NULL) {
+        MoveRows(buf->a, buf->a_stride, done, num_rows - y_end, band->width);
+      }
+    }
+    params->band_y = y_end;
+  }
+  return 1;
+}
+
 //------------------------------------------------------------------------------
 // constructors / destructors
 
@@ -277,10 +416,16 @@ VP8StatusCode WebPCopyDecBufferPixels(const WebPDecBuffer* const src_buf,
     const WebPYUVABuffer* const dst = &dst_buf->u.YUVA;
     WebPCopyPlane(src->y, src->y_stride, dst->y, dst->y_stride,
                   src_buf->width, src_buf->height);
-    WebPCopyPlane(src->u, src->u_stride, dst->u, dst->u_stride,
-                  (src_buf->width + 1) / 2, (src_buf->height + 1) / 2);
-    WebPCopyPlane(src->v, src->v_stride, dst->v, dst->v_stride,
-                  (src_buf->width + 1) / 2, (src_buf->height + 1) / 2);
+    if (WebPIsSemiPlanarMode(src_buf->colorspace)) {
+      WebPCopyPlane(SemiPlanarUV(src_buf), src->u_stride,
+                    SemiPlanarUV(dst_buf), dst->u_stride,
+                    2 * ((src_buf->width + 1) / 2), (src_buf->height + 1) / 2);
+    } else {
+      WebPCopyPlane(src->u, src->u_stride, dst->u, dst->u_stride,
+                    (src_buf->width + 1) / 2, (src_buf->height + 1) / 2);
+      WebPCopyPlane(src->v, src->v_stride, dst->v, dst->v_stride,
+                    (src_buf->width + 1) / 2, (src_buf->height + 1) / 2);
+    }
     if (WebPIsAlphaMode(src_buf->colorspace)) {
       WebPCopyPlane(src->a, src->a_stride, dst->a, dst->a_stride,
                     src_buf->width, src_buf->height);
@@ -289,6 +434,19 @@ VP8StatusCode WebPCopyDecBufferPixels(const WebPDecBuffer* const src_buf,
   return VP8_STATUS_OK;
 }
 
+void WebPStoreSemiPlanarUV(const WebPDecBuffer* const buffer, int uv_y,
+                           const uint8_t* const u, const uint8_t* const v,
+                           int len) {
+  const WebPYUVABuffer* const buf = &buffer->u.YUVA;
+  uint8_t* const dst = SemiPlanarUV(buffer) + uv_y * buf->u_stride;
+  assert(WebPIsSemiPlanarMode(buffer->colorspace));
+  if (buffer->colorspace == MODE_NV12) {
+    WebPInterleaveUV(u, v, dst, len);
+  } else {
+    WebPInterleaveUV(v, u, dst, len);
+  }
+}
+
 int WebPAvoidSlowMemory(const WebPDecBuffer* const output,
                         const WebPBitstreamFeatures* const features) {
   assert(output != NULL);
@@ -100,6 +100,7 @@ struct VP8Io {
   // Scaling parameters.
   int use_scaling;
   int scaled_width, scaled_height;
+  WebPRescalingFilter rescaling_filter;
 
   // If non NULL, pointer to the alpha data (if present) corresponding to the
   // start of the current row (That is: it is pre-offset by mb_y and takes
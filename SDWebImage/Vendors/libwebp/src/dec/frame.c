@@ -68,38 +68,57 @@ static void DoUVTransform(uint32_t bits, const int16_t* const src,
   }
 }
 
-static void ReconstructRow(const VP8Decoder* const dec,
-                           const VP8ThreadContext* ctx) {
+// The macroblock (x, y) is predicted from its left, top-left, top and (for
+// i4x4) top-right neighbours. Hence, it only depends on the macroblocks
+// (x', y') with y' <= y and x' <= x + y - y'. When cropping, the rows are only
+// decoded down to 'br_mb_y_', and only the macroblocks on the left of
+// 'br_mb_x_' are output: returns the end of the macroblocks of row 'mb_y'
+// these depend on. The ones past it are parsed but not reconstructed.
+static WEBP_INLINE int ReconstructEnd(const VP8Decoder* const dec, int mb_y) {
+  const int mb_x_end = dec->br_mb_x_ + (dec->br_mb_y_ - 1 - mb_y);
+  return (mb_x_end < dec->mb_w_) ? mb_x_end : dec->mb_w_;
+}
+
+// Reconstruct the macroblocks [mb_x_start, mb_x_end) of a row, using the
+// 'yuv_b' scratch block. When starting in the middle of a row, 'yuv_b' must
+// still hold the samples of the macroblock on the left.
+static void ReconstructMBs(const VP8Decoder* const dec,
+                           const VP8ThreadContext* ctx, uint8_t* const yuv_b,
+                           int mb_x_start, int mb_x_end) {
   int j;
   int mb_x;
   const int mb_y = ctx->mb_y_;
+  const int mb_x_max = ReconstructEnd(dec, mb_y);
   const int cache_id = ctx->id_;
-  uint8_t* const y_dst = dec->yuv_b_ + Y_OFF;
-  uint8_t* const u_dst = dec->yuv_b_ + U_OFF;
-  uint8_t* const v_dst = dec->yuv_b_ + V_OFF;
-
-  // Initialize left-most block.
-  for (j = 0; j < 16; ++j) {
-    y_dst[j * BPS - 1] = 129;
-  }
-  for (j = 0; j < 8; ++j) {
-    u_dst[j * BPS - 1] = 129;
-    v_dst[j * BPS - 1] = 129;
-  }
+  uint8_t* const y_dst = yuv_b + Y_OFF;
+  uint8_t* const u_dst = yuv_b + U_OFF;
+  uint8_t* const v_dst = yuv_b + V_OFF;
+
+  if (mb_x_start == 0) {
+    // Initialize left-most block.
+    for (j = 0; j < 16; ++j) {
+      y_dst[j * BPS - 1] = 129;
+    }
+    for (j = 0; j < 8; ++j) {
+      u_dst[j * BPS - 1] = 129;
+      v_dst[j * BPS - 1] = 129;
+    }
 
-  // Init top-left sample on left column too.
-  if (mb_y > 0) {
-    y_dst[-1 - BPS] = u_dst[-1 - BPS] = v_dst[-1 - BPS] = 129;
-  } else {
-    // we only need to do this init once at block (0,0).
-    // Afterward, it remains valid for the whole topmost row.
-    memset(y_dst - BPS - 1, 127, 16 + 4 + 1);
-    memset(u_dst - BPS - 1, 127, 8 + 1);
-    memset(v_dst - BPS - 1, 127, 8 + 1);
+    // Init top-left sample on left column too.
+    if (mb_y > 0) {
+      y_dst[-1 - BPS] = u_dst[-1 - BPS] = v_dst[-1 - BPS] = 129;
+    } else {
+      // we only need to do this init once at block (0,0).
+      // Afterward, it remains valid for the whole topmost row.
+      memset(y_dst - BPS - 1, 127, 16 + 4 + 1);
+      memset(u_dst - BPS - 1, 127, 8 + 1);
+      memset(v_dst - BPS - 1, 127, 8 + 1);
+    }
   }
 
-  // Reconstruct one row.
-  for (mb_x = 0; mb_x < dec->mb_w_; ++mb_x) {
+  // Reconstruct the macroblocks.
+  if (mb_x_end > mb_x_max) mb_x_end = mb_x_max;
+  for (mb_x = mb_x_start; mb_x < mb_x_end; ++mb_x) {
     const VP8MBData* const block = ctx->mb_data_ + mb_x;
 
     // Rotate in the left samples from previously decoded block. We move four
@@ -190,6 +209,13 @@ static void ReconstructRow(const VP8Decoder* const dec,
   }
 }
 
+static void ReconstructRow(VP8Decoder* const dec,
+                           const VP8ThreadContext* ctx) {
+  const uint64_t start = WebPTimerStart();
+  ReconstructMBs(dec, ctx, dec->yuv_b_, 0, dec->mb_w_);
+  WebPTimerAdd(&dec->stats_.reconstruct_ns, start);
+}
+
 //------------------------------------------------------------------------------
 // Filtering
 
@@ -200,8 +226,9 @@ static void ReconstructRow(const VP8Decoder* const dec,
 //                 U/V, so it's 8 samples total (because of the 2x upsampling).
 static const uint8_t kFilterExtraRows[3] = { 0, 2, 8 };
 
-static void DoFilter(const VP8Decoder* const dec, int mb_x, int mb_y) {
-  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
+static void DoFilter(const VP8Decoder* const dec,
+                     const VP8ThreadContext* const ctx, int mb_x) {
+  const int mb_y = ctx->mb_y_;
   const int cache_id = ctx->id_;
   const int y_bps = dec->cache_y_stride_;
   const VP8FInfo* const f_info = ctx->f_info_ + mb_x;
@@ -249,16 +276,24 @@ static void DoFilter(const VP8Decoder* const dec, int mb_x, int mb_y) {
   }
 }
 
-// Filter the decoded macroblock row (if needed)
-static void FilterRow(const VP8Decoder* const dec) {
+// Filter the macroblocks [mb_x_start, mb_x_end) of a decoded row
+static void FilterMBs(const VP8Decoder* const dec,
+                      const VP8ThreadContext* const ctx,
+                      int mb_x_start, int mb_x_end) {
   int mb_x;
-  const int mb_y = dec->thread_ctx_.mb_y_;
-  assert(dec->thread_ctx_.filter_row_);
-  for (mb_x = dec->tl_mb_x_; mb_x < dec->br_mb_x_; ++mb_x) {
-    DoFilter(dec, mb_x, mb_y);
+  assert(ctx->filter_row_);
+  if (mb_x_start < dec->tl_mb_x_) mb_x_start = dec->tl_mb_x_;
+  if (mb_x_end > dec->br_mb_x_) mb_x_end = dec->br_mb_x_;
+  for (mb_x = mb_x_start; mb_x < mb_x_end; ++mb_x) {
+    DoFilter(dec, ctx, mb_x);
   }
 }
 
+// Filter the decoded macroblock row (if needed)
+static void FilterRow(const VP8Decoder* const dec) {
+  FilterMBs(dec, &dec->thread_ctx_, 0, dec->mb_w_);
+}
+
 //------------------------------------------------------------------------------
 // Precompute the filtering strength for each segment and each i4x4/i16x16 mode.
 
@@ -386,6 +421,129 @@ static void DitherRow(VP8Decoder* const dec) {
   }
 }
 
+//------------------------------------------------------------------------------
+// Thumbnail
+//
+// The macroblocks are reconstructed without loop-filtering, and each 4x4
+// block is then emitted as a single pixel: the average of its samples. The
+// DC coefficient alone would give this average if the predictions were made
+// from exact samples, but they are not: dropping the AC coefficients makes
+// the error drift across blocks, so the transforms are kept complete. The
+// output (colorspace conversion, alpha, rescaling) is done at 1/4 scale.
+
+void VP8InitThumbnail(const WebPDecoderOptions* const options,
+                      VP8Decoder* const dec, VP8Io* const io) {
+  assert(dec != NULL && io != NULL);
+  dec->thumbnail_ = (options != NULL) && options->use_quarter_thumbnail;
+  if (dec->thumbnail_) {
+    io->width = (dec->pic_hdr_.width_ + 3) >> 2;
+    io->height = (dec->pic_hdr_.height_ + 3) >> 2;
+    io->crop_right = io->width;
+    io->crop_bottom = io->height;
+    io->scaled_width = io->width;
+    io->scaled_height = io->height;
+    io->mb_w = io->width;
+    io->mb_h = io->height;
+  }
+}
+
+// Stores the rounded averages of the 4x4 blocks of the 'w' x 4 samples at
+// 'src' into 'dst'. 'w' must be a multiple of 4.
+static void AverageRow4x4(const uint8_t* src, int stride, int w,
+                          uint8_t* dst) {
+  int x;
+  for (x = 0; x < w; x += 4) {
+    int sum = 0;
+    int j;
+    for (j = 0; j < 4; ++j) {
+      const uint8_t* const s = src + x + j * stride;
+      sum += s[0] + s[1] + s[2] + s[3];
+    }
+    *dst++ = (sum + 8) >> 4;
+  }
+}
+
+// Averages the reconstructed samples of the row into 'thumb_y_' (4 rows) and
+// 'thumb_u_'/'thumb_v_' (2 rows each).
+static void BuildThumbnailRow(const VP8Decoder* const dec,
+                              const VP8ThreadContext* const ctx) {
+  const int y_bps = dec->cache_y_stride_;
+  const int uv_bps = dec->cache_uv_stride_;
+  const uint8_t* const ysrc = dec->cache_y_ + ctx->id_ * 16 * y_bps;
+  const uint8_t* const usrc = dec->cache_u_ + ctx->id_ * 8 * uv_bps;
+  const uint8_t* const vsrc = dec->cache_v_ + ctx->id_ * 8 * uv_bps;
+  const int y_w = 16 * dec->br_mb_x_;
+  const int uv_w = 8 * dec->br_mb_x_;
+  int j;
+  for (j = 0; j < 4; ++j) {
+    AverageRow4x4(ysrc + 4 * j * y_bps, y_bps, y_w,
+                  dec->thumb_y_ + j * (y_bps >> 2));
+  }
+  for (j = 0; j < 2; ++j) {
+    AverageRow4x4(usrc + 4 * j * uv_bps, uv_bps, uv_w,
+                  dec->thumb_u_ + j * (uv_bps >> 2));
+    AverageRow4x4(vsrc + 4 * j * uv_bps, uv_bps, uv_w,
+                  dec->thumb_v_ + j * (uv_bps >> 2));
+  }
+}
+
+// The alpha plane of thumbnails is decoded at full resolution.
+static void GetThumbnailAlphaIo(const VP8Decoder* const dec,
+                                const VP8Io* const io, VP8Io* const alpha_io) {
+  const int width = dec->pic_hdr_.width_;
+  const int height = dec->pic_hdr_.height_;
+  *alpha_io = *io;
+  alpha_io->width = width;
+  alpha_io->height = height;
+  alpha_io->crop_left = 4 * io->crop_left;
+  alpha_io->crop_top = 4 * io->crop_top;
+  alpha_io->crop_right = 4 * io->crop_right;
+  alpha_io->crop_bottom = 4 * io->crop_bottom;
+  if (alpha_io->crop_right > width) alpha_io->crop_right = width;
+  if (alpha_io->crop_bottom > height) alpha_io->crop_bottom = height;
+}
+
+// Decodes the alpha rows of the macroblock row 'mb_y' and returns their 4x4
+// averages, as 'num_rows' rows of stride io->width. Returns NULL in case of
+// error. The row preceding the returned ones holds the last row of the
+// previous call, as the alpha emitters expect persistent data (see io.c).
+static const uint8_t* ThumbnailAlphaRows(VP8Decoder* const dec,
+                                         const VP8Io* const io,
+                                         int mb_y, int num_rows) {
+  const int width = dec->pic_hdr_.width_;
+  const int row = 16 * mb_y;
+  const uint8_t* alpha;
+  int last_row;
+  int x, y;
+  VP8Io alpha_io;
+  GetThumbnailAlphaIo(dec, io, &alpha_io);
+  last_row = row + 16;
+  if (last_row > alpha_io.crop_bottom) last_row = alpha_io.crop_bottom;
+  alpha = VP8DecompressAlphaRows(dec, &alpha_io, row, last_row - row);
+  if (alpha == NULL) return NULL;
+  if (mb_y > dec->tl_mb_y_) {
+    memcpy(dec->thumb_a_ - io->width, dec->thumb_a_ + 3 * io->width,
+           io->width);
+  }
+
+  // The blocks on the right and bottom borders can be partial.
+  for (y = 0; y < num_rows; ++y) {
+    const uint8_t* const src = alpha + 4 * y * width;
+    const int h = (row + 4 * y + 4 > last_row) ? last_row - row - 4 * y : 4;
+    uint8_t* const dst = dec->thumb_a_ + y * io->width;
+    for (x = 0; x < io->width; ++x) {
+      const int w = (4 * x + 4 > width) ? width - 4 * x : 4;
+      int sum = 0;
+      int i, j;
+      for (j = 0; j < h; ++j) {
+        for (i = 0; i < w; ++i) sum += src[4 * x + i + j * width];
+      }
+      dst[x] = (2 * sum + w * h) / (2 * w * h);
+    }
+  }
+  return dec->thumb_a_;
+}
+
 //------------------------------------------------------------------------------
 // This function is called after a row of macroblocks is finished decoding.
 // It also takes into account the following restrictions:
@@ -399,10 +557,10 @@ static void DitherRow(VP8Decoder* const dec) {
 
 #define MACROBLOCK_VPOS(mb_y)  ((mb_y) * 16)    // vertical position of a MB
 
-// Finalize and transmit a complete row. Return false in case of user-abort.
-static int FinishRow(VP8Decoder* const dec, VP8Io* const io) {
+// Transmit the finalized samples of a row. Return false in case of user-abort.
+static int EmitRow(VP8Decoder* const dec, const VP8ThreadContext* const ctx,
+                   VP8Io* const io) {
   int ok = 1;
-  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
   const int cache_id = ctx->id_;
   const int extra_y_rows = kFilterExtraRows[dec->filter_type_];
   const int ysize = extra_y_rows * dec->cache_y_stride_;
@@ -416,22 +574,18 @@ static int FinishRow(VP8Decoder* const dec, VP8Io* const io) {
   const int is_first_row = (mb_y == 0);
   const int is_last_row = (mb_y >= dec->br_mb_y_ - 1);
 
-  if (dec->mt_method_ == 2) {
-    ReconstructRow(dec, ctx);
-  }
-
-  if (ctx->filter_row_) {
-    FilterRow(dec);
-  }
-
-  if (dec->dither_) {
-    DitherRow(dec);
-  }
-
   if (io->put != NULL) {
     int y_start = MACROBLOCK_VPOS(mb_y);
     int y_end = MACROBLOCK_VPOS(mb_y + 1);
-    if (!is_first_row) {
+    if (dec->thumbnail_) {
+      // There is no filtering, hence no extra rows.
+      y_start = mb_y * 4;
+      y_end = (mb_y + 1) * 4;
+      BuildThumbnailRow(dec, ctx);
+      io->y = dec->thumb_y_;
+      io->u = dec->thumb_u_;
+      io->v = dec->thumb_v_;
+    } else if (!is_first_row) {
       y_start -= extra_y_rows;
       io->y = ydst;
       io->u = udst;
@@ -452,7 +606,9 @@ static int FinishRow(VP8Decoder* const dec, VP8Io* const io) {
     if (dec->alpha_data_ != NULL && y_start < y_end) {
       // TODO(skal): testing presence of alpha with dec->alpha_data_ is not a
       // good idea.
-      io->a = VP8DecompressAlphaRows(dec, io, y_start, y_end - y_start);
+      io->a = dec->thumbnail_ ?
+          ThumbnailAlphaRows(dec, io, mb_y, y_end - y_start) :
+          VP8DecompressAlphaRows(dec, io, y_start, y_end - y_start);
       if (io->a == NULL) {
         return VP8SetError(dec, VP8_STATUS_BITSTREAM_ERROR,
                            "Could not decode alpha data.");
@@ -462,9 +618,9 @@ static int FinishRow(VP8Decoder* const dec, VP8Io* const io) {
       const int delta_y = io->crop_top - y_start;
       y_start = io->crop_top;
       assert(!(delta_y & 1));
-      io->y += dec->cache_y_stride_ * delta_y;
-      io->u += dec->cache_uv_stride_ * (delta_y >> 1);
-      io->v += dec->cache_uv_stride_ * (delta_y >> 1);
+      io->y += io->y_stride * delta_y;
+      io->u += io->uv_stride * (delta_y >> 1);
+      io->v += io->uv_stride * (delta_y >> 1);
       if (io->a != NULL) {
         io->a += io->width * delta_y;
       }
@@ -479,9 +635,49 @@ static int FinishRow(VP8Decoder* const dec, VP8Io* const io) {
       io->mb_y = y_start - io->crop_top;
       io->mb_w = io->crop_right - io->crop_left;
       io->mb_h = y_end - y_start;
-      ok = io->put(io);
+      {
+        const uint64_t start = WebPTimerStart();
+        ok = io->put(io);
+        WebPTimerAdd(io->use_scaling ? &dec->stats_.rescale_ns
+                                     : &dec->stats_.convert_ns, start);
+      }
     }
   }
+  return ok;
+}
+
+// Finalize and transmit a complete row. Return false in case of user-abort.
+static int FinishRow(VP8Decoder* const dec, VP8Io* const io) {
+  int ok;
+  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
+  const int cache_id = ctx->id_;
+  const int extra_y_rows = kFilterExtraRows[dec->filter_type_];
+  const int ysize = extra_y_rows * dec->cache_y_stride_;
+  const int uvsize = (extra_y_rows / 2) * dec->cache_uv_stride_;
+  const int y_offset = cache_id * 16 * dec->cache_y_stride_;
+  const int uv_offset = cache_id * 8 * dec->cache_uv_stride_;
+  uint8_t* const ydst = dec->cache_y_ - ysize + y_offset;
+  uint8_t* const udst = dec->cache_u_ - uvsize + uv_offset;
+  uint8_t* const vdst = dec->cache_v_ - uvsize + uv_offset;
+  const int is_last_row = (ctx->mb_y_ >= dec->br_mb_y_ - 1);
+  uint64_t start;
+
+  if (dec->mt_method_ == 2) {
+    ReconstructRow(dec, ctx);
+  }
+
+  start = WebPTimerStart();
+  if (ctx->filter_row_) {
+    FilterRow(dec);
+  }
+
+  if (dec->dither_) {
+    DitherRow(dec);
+  }
+  WebPTimerAdd(&dec->stats_.filter_ns, start);
+
+  ok = EmitRow(dec, ctx, io);
+
   // rotate top samples if needed
   if (cache_id + 1 == dec->num_caches_) {
     if (!is_last_row) {
@@ -496,6 +692,165 @@ static int FinishRow(VP8Decoder* const dec, VP8Io* const io) {
 
 #undef MACROBLOCK_VPOS
 
+//------------------------------------------------------------------------------
+// N-way decoding (mt_method_ = 3).
+//
+// The main thread only parses the bitstream. Each parsed row is handed over to
+// a context of the 'thread_ctxs_' ring (one per cache row) and is then split
+// into 2 x num_jobs_ segments which are reconstructed and filtered by the
+// segment workers in a wavefront: segment 's' of row 'y' is processed during
+// the step 'tick = 2 * y + s'. Hence, when a segment is processed, the
+// previous row has already been reconstructed and filtered up to at least one
+// macroblock past the segment's end. This is what the top-right intra
+// prediction and the in-loop filtering of the segment need. Segments being
+// processed during the same step never overlap (nor do the pixels their
+// filtering modifies), so the steps are synchronized using the plain
+// WebPWorker Launch()/Sync() calls. Row 'y' is complete after the step
+// '2 * y + 2 * num_jobs_ - 1', and is emitted by 'worker_' during the next
+// step, in order.
+// With 'num_jobs_ + 2' cache rows, the cache row of 'y' is only reused once
+// 'y' and the bottom samples it leaves for the next row have been emitted.
+// The bottom samples of the last cache row are copied above the first one by
+// each segment (instead of after the whole row has been emitted), right
+// before it filters the row below.
+// The main thread parses half a row per step. Dithering needs the rows to be
+// processed in order, so it falls back to mt_method_ = 2.
+
+static int ProcessSegment(VP8Decoder* const dec, VP8SegmentJob* const job) {
+  const VP8ThreadContext* const ctx = job->ctx_;
+  const int mb_x = job->mb_x_;
+  const int mb_x_end = job->mb_x_end_;
+  uint64_t start = WebPTimerStart();
+  if (ctx->id_ == 0 && ctx->mb_y_ > 0) {
+    // Bring the previous row's bottom samples above the first cache row.
+    const int extra_y_rows = kFilterExtraRows[dec->filter_type_];
+    const int extra_uv_rows = extra_y_rows / 2;
+    const int y_bps = dec->cache_y_stride_;
+    const int uv_bps = dec->cache_uv_stride_;
+    const int y_last = (16 * dec->num_caches_ - extra_y_rows) * y_bps;
+    const int uv_last = (8 * dec->num_caches_ - extra_uv_rows) * uv_bps;
+    int j;
+    for (j = 0; j < extra_y_rows; ++j) {
+      uint8_t* const dst = dec->cache_y_ + (j - extra_y_rows) * y_bps;
+      memcpy(dst + mb_x * 16, dst + y_last + extra_y_rows * y_bps + mb_x * 16,
+             (mb_x_end - mb_x) * 16);
+    }
+    for (j = 0; j < extra_uv_rows; ++j) {
+      uint8_t* const u_dst = dec->cache_u_ + (j - extra_uv_rows) * uv_bps;
+      uint8_t* const v_dst = dec->cache_v_ + (j - extra_uv_rows) * uv_bps;
+      const int off = uv_last + extra_uv_rows * uv_bps + mb_x * 8;
+      memcpy(u_dst + mb_x * 8, u_dst + off, (mb_x_end - mb_x) * 8);
+      memcpy(v_dst + mb_x * 8, v_dst + off, (mb_x_end - mb_x) * 8);
+    }
+  }
+  ReconstructMBs(dec, ctx, ctx->yuv_b_, mb_x, mb_x_end);
+  WebPTimerAdd(&job->reconstruct_ns_, start);
+  if (ctx->filter_row_) {
+    start = WebPTimerStart();
+    FilterMBs(dec, ctx, mb_x, mb_x_end);
+    WebPTimerAdd(&job->filter_ns_, start);
+  }
+  return 1;
+}
+
+static int EmitRowJob(VP8Decoder* const dec, VP8ThreadContext* const ctx) {
+  return EmitRow(dec, ctx, &ctx->io_);
+}
+
+static int SyncJobs(VP8Decoder* const dec) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  int ok = winterface->Sync(&dec->worker_);
+  int i;
+  for (i = 0; i < dec->num_jobs_; ++i) {
+    ok &= winterface->Sync(&dec->jobs_[i].worker_);
+  }
+  return ok;
+}
+
+// Wait for the current step to finish and launch the next one.
+static int LaunchTick(VP8Decoder* const dec, VP8Io* const io) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  const int tick = dec->tick_;
+  const int num_segments = 2 * dec->num_jobs_;
+  int i;
+  if (!SyncJobs(dec)) return 0;
+  if (tick >= num_segments && !((tick - num_segments) & 1)) {
+    const int mb_y = (tick - num_segments) >> 1;
+    if (mb_y < dec->br_mb_y_) {
+      VP8ThreadContext* const ctx =
+          &dec->thread_ctxs_[mb_y % dec->num_caches_];
+      assert(ctx->mb_y_ == mb_y);
+      ctx->io_ = *io;
+      dec->worker_.data2 = ctx;
+      winterface->Launch(&dec->worker_);
+    }
+  }
+  for (i = 0; i < dec->num_jobs_; ++i) {
+    const int mb_y = (tick >> 1) - i;
+    if (mb_y >= 0 && mb_y < dec->br_mb_y_) {
+      VP8SegmentJob* const job = &dec->jobs_[i];
+      const int segment = (tick & 1) + 2 * i;
+      job->ctx_ = &dec->thread_ctxs_[mb_y % dec->num_caches_];
+      assert(job->ctx_->mb_y_ == mb_y);
+      job->mb_x_ = segment * dec->mb_w_ / num_segments;
+      job->mb_x_end_ = (segment + 1) * dec->mb_w_ / num_segments;
+      winterface->Launch(&job->worker_);
+    }
+  }
+  ++dec->tick_;
+  return 1;
+}
+
+// Hand the freshly parsed row over to the workers. The cache row's context
+// gives back the (now unused) data of the row it held previously.
+static int HandOverRow(VP8Decoder* const dec, VP8Io* const io,
+                       int filter_row) {
+  VP8ThreadContext* const ctx = &dec->thread_ctxs_[dec->cache_id_];
+  VP8MBData* const mb_data = ctx->mb_data_;
+  VP8FInfo* const f_info = ctx->f_info_;
+  ctx->mb_data_ = dec->mb_data_;
+  ctx->f_info_ = dec->f_info_;
+  dec->mb_data_ = mb_data;
+  dec->f_info_ = f_info;
+  ctx->mb_y_ = dec->mb_y_;
+  ctx->filter_row_ = filter_row;
+  if (++dec->cache_id_ == dec->num_caches_) {
+    dec->cache_id_ = 0;
+  }
+  while (dec->tick_ <= 2 * ctx->mb_y_) {
+    if (!LaunchTick(dec, io)) return 0;
+  }
+  return 1;
+}
+
+int VP8ProcessTick(VP8Decoder* const dec, VP8Io* const io) {
+  if (dec->mt_method_ == 3 && dec->tick_ < 2 * dec->mb_y_) {
+    return LaunchTick(dec, io);
+  }
+  return 1;
+}
+
+// Run the remaining steps, until the last row is emitted.
+static int FlushRows(VP8Decoder* const dec, VP8Io* const io) {
+  const int last_tick = 2 * (dec->br_mb_y_ - 1) + 2 * dec->num_jobs_;
+  while (dec->tick_ <= last_tick) {
+    if (!LaunchTick(dec, io)) return 0;
+  }
+  return SyncJobs(dec);
+}
+
+void VP8EndSegmentJobs(VP8Decoder* const dec) {
+  if (dec->jobs_ != NULL) {
+    int i;
+    for (i = 0; i < dec->num_jobs_; ++i) {
+      WebPGetWorkerInterface()->End(&dec->jobs_[i].worker_);
+    }
+    WebPSafeFree(dec->jobs_);
+    dec->jobs_ = NULL;
+  }
+  dec->num_jobs_ = 0;
+}
+
 //------------------------------------------------------------------------------
 
 int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io) {
@@ -504,7 +859,9 @@ int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io) {
   const int filter_row =
       (dec->filter_type_ > 0) &&
       (dec->mb_y_ >= dec->tl_mb_y_) && (dec->mb_y_ <= dec->br_mb_y_);
-  if (dec->mt_method_ == 0) {
+  if (dec->mt_method_ == 3) {
+    ok = HandOverRow(dec, io, filter_row);
+  } else if (dec->mt_method_ == 0) {
     // ctx->id_ and ctx->f_info_ are already set
     ctx->mb_y_ = dec->mb_y_;
     ctx->filter_row_ = filter_row;
@@ -558,6 +915,11 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
   if (io->bypass_filtering) {
     dec->filter_type_ = 0;
   }
+  // Thumbnails are neither filtered nor dithered.
+  if (dec->thumbnail_) {
+    dec->filter_type_ = 0;
+    dec->dither_ = 0;
+  }
   // TODO(skal): filter type / strength / sharpness forcing
 
   // Define the area where we can skip in-loop filtering, in case of cropping.
@@ -573,6 +935,12 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
   // a 1:1 bit-exactness for complex filtering?
   {
     const int extra_pixels = kFilterExtraRows[dec->filter_type_];
+    // The cropping area of thumbnails is in 1/4-scale units.
+    const int shift = dec->thumbnail_ ? 2 : 0;
+    const int crop_left = io->crop_left << shift;
+    const int crop_top = io->crop_top << shift;
+    const int crop_right = io->crop_right << shift;
+    const int crop_bottom = io->crop_bottom << shift;
     if (dec->filter_type_ == 2) {
       // For complex filter, we need to preserve the dependency chain.
       dec->tl_mb_x_ = 0;
@@ -582,14 +950,14 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
       // We include 'extra_pixels' on the other side of the boundary, since
       // vertical or horizontal filtering of the previous macroblock can
       // modify some abutting pixels.
-      dec->tl_mb_x_ = (io->crop_left - extra_pixels) >> 4;
-      dec->tl_mb_y_ = (io->crop_top - extra_pixels) >> 4;
+      dec->tl_mb_x_ = (crop_left - extra_pixels) >> 4;
+      dec->tl_mb_y_ = (crop_top - extra_pixels) >> 4;
       if (dec->tl_mb_x_ < 0) dec->tl_mb_x_ = 0;
       if (dec->tl_mb_y_ < 0) dec->tl_mb_y_ = 0;
     }
     // We need some 'extra' pixels on the right/bottom.
-    dec->br_mb_y_ = (io->crop_bottom + 15 + extra_pixels) >> 4;
-    dec->br_mb_x_ = (io->crop_right + 15 + extra_pixels) >> 4;
+    dec->br_mb_y_ = (crop_bottom + 15 + extra_pixels) >> 4;
+    dec->br_mb_x_ = (crop_right + 15 + extra_pixels) >> 4;
     if (dec->br_mb_x_ > dec->mb_w_) {
       dec->br_mb_x_ = dec->mb_w_;
     }
@@ -601,11 +969,35 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
   return VP8_STATUS_OK;
 }
 
+// Adds the timings of the (idle) workers to dec->stats_.
+static void MergeStageStats(VP8Decoder* const dec) {
+  WebPDecStageStats* const stats = &dec->stats_;
+  int i;
+  for (i = 0; i < dec->num_jobs_; ++i) {
+    VP8SegmentJob* const job = &dec->jobs_[i];
+    stats->reconstruct_ns += job->reconstruct_ns_;
+    stats->filter_ns += job->filter_ns_;
+    job->reconstruct_ns_ = job->filter_ns_ = 0;
+  }
+  for (i = 0; i < dec->num_part_jobs_; ++i) {
+    stats->tokens_ns += dec->part_jobs_[i].tokens_ns_;
+    dec->part_jobs_[i].tokens_ns_ = 0;
+  }
+  stats->num_mbs = dec->mb_y_ * dec->mb_w_;
+  stats->alpha_bytes = dec->alpha_data_size_;
+}
+
 int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io) {
   int ok = 1;
-  if (dec->mt_method_ > 0) {
+  if (dec->mt_method_ == 3) {
+    // Only flush the pending rows if all of them have been handed over.
+    ok = (dec->status_ == VP8_STATUS_OK && dec->mb_y_ >= dec->br_mb_y_) ?
+         FlushRows(dec, io) : SyncJobs(dec);
+  } else if (dec->mt_method_ > 0) {
     ok = WebPGetWorkerInterface()->Sync(&dec->worker_);
   }
+  VP8SyncAlphaWorker(dec);
+  MergeStageStats(dec);
 
   if (io->teardown != NULL) {
     io->teardown(io);
@@ -641,9 +1033,57 @@ int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io) {
 #define ST_CACHE_LINES 1   // 1 cache row only for single-threaded case
 
 // Initialize multi/single-thread worker
+static int InitSegmentJobs(VP8Decoder* const dec) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  WebPWorker* const worker = &dec->worker_;
+  int num_jobs = dec->num_threads_ - 2;
+  int i;
+  if (num_jobs > dec->mb_w_ / 2) num_jobs = dec->mb_w_ / 2;
+  if (num_jobs < 1) num_jobs = 1;
+  if (dec->jobs_ != NULL && dec->num_jobs_ != num_jobs) {
+    VP8EndSegmentJobs(dec);
+  }
+  if (dec->jobs_ == NULL) {
+    dec->jobs_ = (VP8SegmentJob*)WebPSafeCalloc(num_jobs, sizeof(*dec->jobs_));
+    if (dec->jobs_ == NULL) {
+      return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                         "thread initialization failed.");
+    }
+    for (i = 0; i < num_jobs; ++i) {
+      winterface->Init(&dec->jobs_[i].worker_);
+    }
+    dec->num_jobs_ = num_jobs;
+  }
+  for (i = 0; i < num_jobs; ++i) {
+    VP8SegmentJob* const job = &dec->jobs_[i];
+    if (!winterface->Reset(&job->worker_)) {
+      return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                         "thread initialization failed.");
+    }
+    job->worker_.data1 = dec;
+    job->worker_.data2 = job;
+    job->worker_.hook = (WebPWorkerHook)ProcessSegment;
+  }
+  if (!winterface->Reset(worker)) {
+    return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                       "thread initialization failed.");
+  }
+  worker->data1 = dec;
+  worker->data2 = NULL;   // set to the emitted row's context
+  worker->hook = (WebPWorkerHook)EmitRowJob;
+  dec->num_caches_ = num_jobs + 2;
+  dec->tick_ = 0;
+  return 1;
+}
+
 static int InitThreadContext(VP8Decoder* const dec) {
   dec->cache_id_ = 0;
-  if (dec->mt_method_ > 0) {
+  if (dec->mt_method_ == 3 && dec->dither_) {
+    dec->mt_method_ = 2;   // dithering must process the rows in order
+  }
+  if (dec->mt_method_ == 3) {
+    return InitSegmentJobs(dec);
+  } else if (dec->mt_method_ > 0) {
     WebPWorker* const worker = &dec->worker_;
     if (!WebPGetWorkerInterface()->Reset(worker)) {
       return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
@@ -676,6 +1116,7 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
 #if 0
   if (height < 2 * width) return 2;
 #endif
+  if (options->num_threads > 2) return 3;
   return 2;
 #else   // !WEBP_USE_THREAD
   return 0;
@@ -695,35 +1136,50 @@ static int AllocateMemory(VP8Decoder* const dec) {
   const size_t intra_pred_mode_size = 4 * mb_w * sizeof(uint8_t);
   const size_t top_size = sizeof(VP8TopSamples) * mb_w;
   const size_t mb_info_size = (mb_w + 1) * sizeof(VP8MB);
+  // With mt_method_ = 3, each cache row has its own context.
+  const int num_ctxs = (dec->mt_method_ == 3) ? num_caches : 0;
+  // Rows of parsed data in use by the reconstruction, plus the ones being
+  // parsed by the partition jobs.
+  const int num_f_info_rows =
+      ((num_ctxs > 0) ? num_ctxs + 1 : (dec->mt_method_ > 0) ? 2 : 1)
+      + dec->num_part_jobs_;
+  const int num_mb_data_rows =
+      ((num_ctxs > 0) ? num_ctxs + 1 : (dec->mt_method_ == 2) ? 2 : 1)
+      + dec->num_part_jobs_;
   const size_t f_info_size =
-      (dec->filter_type_ > 0) ?
-          mb_w * (dec->mt_method_ > 0 ? 2 : 1) * sizeof(VP8FInfo)
-        : 0;
-  const size_t yuv_size = YUV_SIZE * sizeof(*dec->yuv_b_);
+      (dec->filter_type_ > 0) ? mb_w * num_f_info_rows * sizeof(VP8FInfo) : 0;
+  const size_t yuv_size =
+      (num_ctxs > 0 ? num_ctxs : 1) * YUV_SIZE * sizeof(*dec->yuv_b_);
   const size_t mb_data_size =
-      (dec->mt_method_ == 2 ? 2 : 1) * mb_w * sizeof(*dec->mb_data_);
+      num_mb_data_rows * mb_w * sizeof(*dec->mb_data_);
+  const size_t ctxs_size = num_ctxs * sizeof(*dec->thread_ctxs_);
   const size_t cache_height = (16 * num_caches
                             + kFilterExtraRows[dec->filter_type_]) * 3 / 2;
   const size_t cache_size = top_size * cache_height;
+  // 4 rows of luma, 2 rows of each chroma and 1 + 4 rows of alpha at 1/4
+  // scale.
+  const size_t thumb_size = dec->thumbnail_ ? (4 + 2 + 1 + 4) * 4 * mb_w : 0;
   // alpha_size is the only one that scales as width x height.
   const uint64_t alpha_size = (dec->alpha_data_ != NULL) ?
       (uint64_t)dec->pic_hdr_.width_ * dec->pic_hdr_.height_ : 0ULL;
   const uint64_t needed = (uint64_t)intra_pred_mode_size
                         + top_size + mb_info_size + f_info_size
-                        + yuv_size + mb_data_size
-                        + cache_size + alpha_size + WEBP_ALIGN_CST;
+                        + yuv_size + mb_data_size + ctxs_size
+                        + cache_size + thumb_size + alpha_size
+                        + 2 * WEBP_ALIGN_CST;
   uint8_t* mem;
 
   if (needed != (size_t)needed) return 0;  // check for overflow
   if (needed > dec->mem_size_) {
-    WebPSafeFree(dec->mem_);
+    WebPDecContextFree(dec->context_, WEBP_DEC_MEM_VP8, dec->mem_);
     dec->mem_size_ = 0;
-    dec->mem_ = WebPSafeMalloc(needed, sizeof(uint8_t));
+    dec->mem_ = WebPDecContextAlloc(dec->context_, WEBP_DEC_MEM_VP8,
+                                    needed, sizeof(uint8_t));
     if (dec->mem_ == NULL) {
       return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
                          "no memory during frame initialization.");
     }
-    // down-cast is ok, thanks to WebPSafeAlloc() above.
+    // down-cast is ok, thanks to WebPDecContextAlloc() above.
     dec->mem_size_ = (size_t)needed;
   }
 
@@ -760,6 +1216,36 @@ static int AllocateMemory(VP8Decoder* const dec) {
   }
   mem += mb_data_size;
 
+  if (num_ctxs > 0) {
+    int i;
+    mem = (uint8_t*)WEBP_ALIGN(mem);
+    dec->thread_ctxs_ = (VP8ThreadContext*)mem;
+    for (i = 0; i < num_ctxs; ++i) {
+      VP8ThreadContext* const ctx = &dec->thread_ctxs_[i];
+      memset(ctx, 0, sizeof(*ctx));
+      ctx->id_ = i;
+      ctx->mb_y_ = -1;
+      ctx->f_info_ = f_info_size ? dec->f_info_ + (i + 1) * mb_w : NULL;
+      ctx->mb_data_ = dec->mb_data_ + (i + 1) * mb_w;
+      ctx->yuv_b_ = dec->yuv_b_ + i * YUV_SIZE;
+    }
+  } else {
+    dec->thread_ctxs_ = NULL;
+  }
+  mem += ctxs_size;
+
+  {
+    int i;
+    const int first_f_info_row = num_f_info_rows - dec->num_part_jobs_;
+    const int first_mb_data_row = num_mb_data_rows - dec->num_part_jobs_;
+    for (i = 0; i < dec->num_part_jobs_; ++i) {
+      VP8PartitionJob* const job = &dec->part_jobs_[i];
+      job->f_info_ =
+          f_info_size ? dec->f_info_ + (first_f_info_row + i) * mb_w : NULL;
+      job->mb_data_ = dec->mb_data_ + (first_mb_data_row + i) * mb_w;
+    }
+  }
+
   dec->cache_y_stride_ = 16 * mb_w;
   dec->cache_uv_stride_ = 8 * mb_w;
   {
@@ -775,6 +1261,14 @@ static int AllocateMemory(VP8Decoder* const dec) {
   }
   mem += cache_size;
 
+  if (thumb_size > 0) {
+    dec->thumb_y_ = (uint8_t*)mem;
+    dec->thumb_u_ = dec->thumb_y_ + 4 * 4 * mb_w;
+    dec->thumb_v_ = dec->thumb_u_ + 2 * 2 * mb_w;
+    dec->thumb_a_ = dec->thumb_v_ + 2 * 2 * mb_w + 4 * mb_w;
+  }
+  mem += thumb_size;
+
   // alpha plane
   dec->alpha_plane_ = alpha_size ? (uint8_t*)mem : NULL;
   mem += alpha_size;
@@ -798,15 +1292,51 @@ static void InitIo(VP8Decoder* const dec, VP8Io* io) {
   io->v = dec->cache_v_;
   io->y_stride = dec->cache_y_stride_;
   io->uv_stride = dec->cache_uv_stride_;
+  if (dec->thumbnail_) {
+    io->y = dec->thumb_y_;
+    io->u = dec->thumb_u_;
+    io->v = dec->thumb_v_;
+    io->y_stride >>= 2;
+    io->uv_stride >>= 2;
+  }
   io->a = NULL;
 }
 
+// With a worker thread emitting the rows, the alpha plane is decoded on its
+// own worker.
+static int InitAlphaWorker(VP8Decoder* const dec, const VP8Io* const io) {
+  if (dec->mt_method_ > 0 && dec->alpha_data_ != NULL && io->put != NULL) {
+    VP8Io alpha_io;
+    if (dec->thumbnail_) {
+      GetThumbnailAlphaIo(dec, io, &alpha_io);
+    } else {
+      alpha_io = *io;
+    }
+    if (!VP8StartAlphaWorker(dec, &alpha_io)) {
+      return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                         "thread initialization failed.");
+    }
+  }
+  return 1;
+}
+
 int VP8InitFrame(VP8Decoder* const dec, VP8Io* const io) {
   if (!InitThreadContext(dec)) return 0;  // call first. Sets dec->num_caches_.
   if (!AllocateMemory(dec)) return 0;
   InitIo(dec, io);
   VP8DspInit();  // Init critical function pointers and look-up tables.
-  return 1;
+  return InitAlphaWorker(dec, io);
+}
+
+int VP8SyncWorkers(VP8Decoder* const dec) {
+  int ok = 1;
+  if (dec->mt_method_ == 3) {
+    ok = SyncJobs(dec);
+  } else if (dec->mt_method_ > 0) {
+    ok = WebPGetWorkerInterface()->Sync(&dec->worker_);
+  }
+  VP8SyncAlphaWorker(dec);   // once the emitter can't launch it anymore
+  return ok;
 }
 
 //------------------------------------------------------------------------------
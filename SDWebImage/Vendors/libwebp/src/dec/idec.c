@@ -24,6 +24,8 @@
 // Needs to be a power of 2.
 #define CHUNK_SIZE 4096
 #define MAX_MB_SIZE 4096
+// In segments mode, initial size of the contiguous view to parse headers from.
+#define HEADERS_VIEW_SIZE 1024
 
 //------------------------------------------------------------------------------
 // Data structures for memory and states
@@ -47,10 +49,14 @@ typedef enum {
 typedef enum {
   MEM_MODE_NONE = 0,
   MEM_MODE_APPEND,
-  MEM_MODE_MAP
+  MEM_MODE_MAP,
+  MEM_MODE_SEGMENTS
 } MemBufferMode;
 
 // storage for partition #0 and partial data (in a rolling fashion)
+// In segments mode, start_ and end_ are positions in the segments, buf_ and
+// part0_buf_ only hold the headers and partition #0 when they had to be
+// gathered from several segments.
 typedef struct {
   MemBufferMode mode_;  // Operation mode
   size_t start_;        // start location of the data to be decoded
@@ -58,8 +64,10 @@ typedef struct {
   size_t buf_size_;     // size of the allocated buffer
   uint8_t* buf_;        // We don't own this buffer in case WebPIUpdate()
 
-  size_t part0_size_;         // size of partition #0
-  const uint8_t* part0_buf_;  // buffer to store partition #0
+  size_t part0_size_;   // size of partition #0
+  uint8_t* part0_buf_;  // buffer to store partition #0
+
+  VP8InputChain chain_;  // caller's segments, in segments mode
 } MemBuffer;
 
 struct WebPIDecoder {
@@ -76,6 +84,7 @@ struct WebPIDecoder {
   size_t chunk_size_;      // Compressed VP8/VP8L size extracted from Header.
 
   int last_mb_y_;          // last row reached for intra-mode decoding
+  uint64_t total_ns_;      // time spent in IDecode() so far
 };
 
 // MB context to restore in case VP8DecodeMB() fails
@@ -201,6 +210,70 @@ static int AppendToMemBuffer(WebPIDecoder* const idec,
   return 1;
 }
 
+// Records a new segment of caller's memory, at the end of the input.
+static int AppendSegment(MemBuffer* const mem,
+                         const uint8_t* const data, size_t data_size) {
+  VP8InputChain* const chain = &mem->chain_;
+  VP8InputSegment* segment;
+  assert(mem->mode_ == MEM_MODE_SEGMENTS);
+  if (data_size == 0) return 1;
+  if (data_size > MAX_CHUNK_PAYLOAD) return 0;  // same safeguard as above
+  if (chain->num_segments_ == chain->max_segments_) {
+    const int max_segments =
+        (chain->max_segments_ > 0) ? 2 * chain->max_segments_ : 16;
+    VP8InputSegment* const segments = (VP8InputSegment*)WebPSafeMalloc(
+        max_segments, sizeof(*segments));
+    if (segments == NULL) return 0;
+    if (chain->num_segments_ > 0) {
+      memcpy(segments, chain->segments_,
+             chain->num_segments_ * sizeof(*segments));
+    }
+    WebPSafeFree(chain->segments_);
+    chain->segments_ = segments;
+    chain->max_segments_ = max_segments;
+  }
+  segment = &chain->segments_[chain->num_segments_++];
+  segment->buf_ = data;
+  segment->size_ = data_size;
+  segment->pos_ = chain->size_;
+  chain->size_ += data_size;
+  mem->end_ = chain->size_;
+  return 1;
+}
+
+// Returns the 'size' bytes of segmented input starting at 'pos', in a
+// contiguous memory. If they span several segments, they are gathered into
+// '*copy', which is (re)allocated.
+static const uint8_t* GetSegmentsView(const MemBuffer* const mem,
+                                      size_t pos, size_t size,
+                                      uint8_t** const copy) {
+  const VP8InputChain* const chain = &mem->chain_;
+  const VP8InputSegment* segment;
+  uint8_t* dst;
+  assert(mem->mode_ == MEM_MODE_SEGMENTS);
+  assert(size > 0 && pos + size <= chain->size_);
+  segment = &chain->segments_[VP8InputChainFind(chain, pos)];
+  WebPSafeFree(*copy);
+  *copy = NULL;
+  if (pos + size <= segment->pos_ + segment->size_) {
+    return segment->buf_ + (pos - segment->pos_);   // zero-copy
+  }
+  dst = (uint8_t*)WebPSafeMalloc(1ULL, size);
+  if (dst == NULL) return NULL;
+  *copy = dst;
+  while (size > 0) {
+    const size_t offset = pos - segment->pos_;
+    size_t n = segment->size_ - offset;
+    if (n > size) n = size;
+    memcpy(dst, segment->buf_ + offset, n);
+    dst += n;
+    pos += n;
+    size -= n;
+    ++segment;
+  }
+  return *copy;
+}
+
 static int RemapMemBuffer(WebPIDecoder* const idec,
                           const uint8_t* const data, size_t data_size) {
   MemBuffer* const mem = &idec->mem_;
@@ -223,14 +296,16 @@ static void InitMemBuffer(MemBuffer* const mem) {
   mem->buf_size_   = 0;
   mem->part0_buf_  = NULL;
   mem->part0_size_ = 0;
+  memset(&mem->chain_, 0, sizeof(mem->chain_));
 }
 
 static void ClearMemBuffer(MemBuffer* const mem) {
   assert(mem);
-  if (mem->mode_ == MEM_MODE_APPEND) {
+  if (mem->mode_ == MEM_MODE_APPEND || mem->mode_ == MEM_MODE_SEGMENTS) {
     WebPSafeFree(mem->buf_);
-    WebPSafeFree((void*)mem->part0_buf_);
+    WebPSafeFree(mem->part0_buf_);
   }
+  WebPSafeFree(mem->chain_.segments_);
 }
 
 static int CheckMemBufferMode(MemBuffer* const mem, MemBufferMode expected) {
@@ -298,22 +373,49 @@ static void ChangeState(WebPIDecoder* const idec, DecState new_state,
   idec->state_ = new_state;
   mem->start_ += consumed_bytes;
   assert(mem->start_ <= mem->end_);
-  idec->io_.data = mem->buf_ + mem->start_;
-  idec->io_.data_size = MemDataSize(mem);
+  if (mem->mode_ != MEM_MODE_SEGMENTS) {  // else: io_.data is set when needed
+    idec->io_.data = mem->buf_ + mem->start_;
+    idec->io_.data_size = MemDataSize(mem);
+  }
+}
+
+// Parses the headers out of the segments. These are usually small, so the
+// contiguous view on the segments only grows while they are truncated.
+static VP8StatusCode ParseSegmentedHeaders(MemBuffer* const mem,
+                                           WebPHeaderStructure* const headers) {
+  const size_t curr_size = MemDataSize(mem);
+  size_t size = (curr_size < HEADERS_VIEW_SIZE) ? curr_size
+                                                : HEADERS_VIEW_SIZE;
+  VP8StatusCode status = VP8_STATUS_NOT_ENOUGH_DATA;
+  while (size > 0) {
+    // The view must remain valid past this call, as the alpha data points
+    // into it.
+    headers->data = GetSegmentsView(mem, mem->start_, size, &mem->buf_);
+    if (headers->data == NULL) return VP8_STATUS_OUT_OF_MEMORY;
+    headers->data_size = size;
+    headers->have_all_data = 0;
+    status = WebPParseHeaders(headers);
+    if (status != VP8_STATUS_NOT_ENOUGH_DATA || size == curr_size) break;
+    size = (size < curr_size / 2) ? 2 * size : curr_size;
+  }
+  return status;
 }
 
 // Headers
 static VP8StatusCode DecodeWebPHeaders(WebPIDecoder* const idec) {
   MemBuffer* const mem = &idec->mem_;
-  const uint8_t* data = mem->buf_ + mem->start_;
-  size_t curr_size = MemDataSize(mem);
   VP8StatusCode status;
   WebPHeaderStructure headers;
 
-  headers.data = data;
-  headers.data_size = curr_size;
-  headers.have_all_data = 0;
-  status = WebPParseHeaders(&headers);
+  if (mem->mode_ == MEM_MODE_SEGMENTS) {
+    status = ParseSegmentedHeaders(mem, &headers);
+    if (status == VP8_STATUS_OUT_OF_MEMORY) return status;
+  } else {
+    headers.data = mem->buf_ + mem->start_;
+    headers.data_size = MemDataSize(mem);
+    headers.have_all_data = 0;
+    status = WebPParseHeaders(&headers);
+  }
   if (status == VP8_STATUS_NOT_ENOUGH_DATA) {
     return VP8_STATUS_SUSPENDED;  // We haven't found a VP8 chunk yet.
   } else if (status != VP8_STATUS_OK) {
@@ -343,8 +445,9 @@ static VP8StatusCode DecodeWebPHeaders(WebPIDecoder* const idec) {
 }
 
 static VP8StatusCode DecodeVP8FrameHeader(WebPIDecoder* const idec) {
-  const uint8_t* data = idec->mem_.buf_ + idec->mem_.start_;
-  const size_t curr_size = MemDataSize(&idec->mem_);
+  MemBuffer* const mem = &idec->mem_;
+  const uint8_t* data;
+  size_t curr_size = MemDataSize(mem);
   int width, height;
   uint32_t bits;
 
@@ -352,12 +455,19 @@ static VP8StatusCode DecodeVP8FrameHeader(WebPIDecoder* const idec) {
     // Not enough data bytes to extract VP8 Frame Header.
     return VP8_STATUS_SUSPENDED;
   }
+  if (mem->mode_ == MEM_MODE_SEGMENTS) {
+    curr_size = VP8_FRAME_HEADER_SIZE;
+    data = GetSegmentsView(mem, mem->start_, curr_size, &mem->part0_buf_);
+    if (data == NULL) return VP8_STATUS_OUT_OF_MEMORY;
+  } else {
+    data = mem->buf_ + mem->start_;
+  }
   if (!VP8GetInfo(data, curr_size, idec->chunk_size_, &width, &height)) {
     return IDecError(idec, VP8_STATUS_BITSTREAM_ERROR);
   }
 
   bits = data[0] | (data[1] << 8) | (data[2] << 16);
-  idec->mem_.part0_size_ = (bits >> 5) + VP8_FRAME_HEADER_SIZE;
+  mem->part0_size_ = (bits >> 5) + VP8_FRAME_HEADER_SIZE;
 
   idec->io_.data = data;
   idec->io_.data_size = curr_size;
@@ -366,13 +476,50 @@ static VP8StatusCode DecodeVP8FrameHeader(WebPIDecoder* const idec) {
 }
 
 // Partition #0
+
+// Points io_.data to a contiguous view on the frame header and partition #0,
+// plus the partition sizes that VP8GetHeaders() also needs. The partitions
+// themselves are set up by SetSegmentsPartitions().
+static int SetSegmentsPart0View(WebPIDecoder* const idec) {
+  MemBuffer* const mem = &idec->mem_;
+  const size_t max_size = mem->part0_size_ + 3 * (MAX_NUM_PARTITIONS - 1);
+  const size_t curr_size = MemDataSize(mem);
+  const size_t size = (curr_size < max_size) ? curr_size : max_size;
+  const uint8_t* const data =
+      GetSegmentsView(mem, mem->start_, size, &mem->part0_buf_);
+  if (data == NULL) return 0;
+  idec->io_.data = data;
+  idec->io_.data_size = size;
+  return 1;
+}
+
+// Points the token partitions straight to the segments. Unlike
+// ParsePartitions(), their sizes aren't clipped to the data available so far.
+static void SetSegmentsPartitions(WebPIDecoder* const idec) {
+  VP8Decoder* const dec = (VP8Decoder*)idec->dec_;
+  MemBuffer* const mem = &idec->mem_;
+  const uint32_t last_part = dec->num_parts_minus_one_;
+  const uint8_t* sz = idec->io_.data + mem->part0_size_;
+  size_t pos = mem->start_ + mem->part0_size_ + 3 * last_part;
+  uint32_t p;
+  mem->start_ = pos;
+  for (p = 0; p < last_part; ++p) {
+    const size_t psize = sz[0] | (sz[1] << 8) | (sz[2] << 16);
+    VP8InitBitReaderChain(dec->parts_ + p, &mem->chain_, pos, pos + psize);
+    pos += psize;
+    sz += 3;
+  }
+  VP8InitBitReaderChain(dec->parts_ + last_part, &mem->chain_, pos,
+                        VP8_INPUT_CHAIN_END);
+}
+
 static VP8StatusCode CopyParts0Data(WebPIDecoder* const idec) {
   VP8Decoder* const dec = (VP8Decoder*)idec->dec_;
   VP8BitReader* const br = &dec->br_;
   const size_t part_size = br->buf_end_ - br->buf_;
   MemBuffer* const mem = &idec->mem_;
   assert(!idec->is_lossless_);
-  assert(mem->part0_buf_ == NULL);
+  assert(mem->part0_buf_ == NULL || mem->mode_ == MEM_MODE_SEGMENTS);
   // the following is a format limitation, no need for runtime check:
   assert(part_size <= mem->part0_size_);
   if (part_size == 0) {   // can't have zero-size partition #0
@@ -387,6 +534,10 @@ static VP8StatusCode CopyParts0Data(WebPIDecoder* const idec) {
     memcpy(part0_buf, br->buf_, part_size);
     mem->part0_buf_ = part0_buf;
     VP8BitReaderSetBuffer(br, part0_buf, part_size);
+  } else if (mem->mode_ == MEM_MODE_SEGMENTS) {
+    // Partition #0 stays in its view, which won't move.
+    SetSegmentsPartitions(idec);
+    return VP8_STATUS_OK;
   } else {
     // Else: just keep pointers to the partition #0's data in dec_->br_.
   }
@@ -404,6 +555,10 @@ static VP8StatusCode DecodePartition0(WebPIDecoder* const idec) {
   if (MemDataSize(&idec->mem_) < idec->mem_.part0_size_) {
     return VP8_STATUS_SUSPENDED;
   }
+  if (idec->mem_.mode_ == MEM_MODE_SEGMENTS) {
+    if (!SetSegmentsPart0View(idec)) return VP8_STATUS_OUT_OF_MEMORY;
+    dec->external_parts_ = 1;
+  }
 
   if (!VP8GetHeaders(dec, io)) {
     const VP8StatusCode status = dec->status_;
@@ -414,6 +569,7 @@ static VP8StatusCode DecodePartition0(WebPIDecoder* const idec) {
     }
     return IDecError(idec, status);
   }
+  VP8InitThumbnail(params->options, dec, io);
 
   // Allocate/Verify output buffer now
   dec->status_ = WebPAllocateDecBuffer(io->width, io->height, params->options,
@@ -424,6 +580,8 @@ static VP8StatusCode DecodePartition0(WebPIDecoder* const idec) {
   // This change must be done before calling VP8InitFrame()
   dec->mt_method_ = VP8GetThreadMethod(params->options, NULL,
                                        io->width, io->height);
+  dec->num_threads_ =
+      (params->options != NULL) ? params->options->num_threads : 0;
   VP8InitDithering(params->options, dec);
 
   dec->status_ = CopyParts0Data(idec);
@@ -453,6 +611,7 @@ static VP8StatusCode DecodeRemaining(WebPIDecoder* const idec) {
 
   assert(dec->ready_);
   for (; dec->mb_y_ < dec->mb_h_; ++dec->mb_y_) {
+    const uint64_t start = WebPTimerStart();
     if (idec->last_mb_y_ != dec->mb_y_) {
       if (!VP8ParseIntraModeRow(&dec->br_, dec)) {
         // note: normally, error shouldn't occur since we already have the whole
@@ -474,15 +633,24 @@ static VP8StatusCode DecodeRemaining(WebPIDecoder* const idec) {
           return IDecError(idec, VP8_STATUS_BITSTREAM_ERROR);
         }
         RestoreContext(&context, dec, token_br);
+        WebPTimerAdd(&dec->stats_.tokens_ns, start);
+        // The alpha data can move before the next call: stop reading it.
+        if (dec->alpha_data_ != NULL && !VP8SyncWorkers(dec)) {
+          return IDecError(idec, VP8_STATUS_USER_ABORT);
+        }
         return VP8_STATUS_SUSPENDED;
       }
       // Release buffer only if there is only one partition
       if (dec->num_parts_minus_one_ == 0) {
-        idec->mem_.start_ = token_br->buf_ - idec->mem_.buf_;
+        idec->mem_.start_ =
+            (idec->mem_.mode_ == MEM_MODE_SEGMENTS)
+                ? token_br->next_pos_ - (token_br->buf_end_ - token_br->buf_)
+                : (size_t)(token_br->buf_ - idec->mem_.buf_);
         assert(idec->mem_.start_ <= idec->mem_.end_);
       }
     }
     VP8InitScanline(dec);   // Prepare for next scanline
+    WebPTimerAdd(&dec->stats_.tokens_ns, start);
 
     // Reconstruct, filter and emit the row.
     if (!VP8ProcessRow(dec, io)) {
@@ -518,6 +686,11 @@ static VP8StatusCode DecodeVP8LHeader(WebPIDecoder* const idec) {
     dec->status_ = VP8_STATUS_SUSPENDED;
     return ErrorStatusLossless(idec, dec->status_);
   }
+  if (idec->mem_.mode_ == MEM_MODE_SEGMENTS) {
+    // Read the bitstream straight from the segments.
+    dec->chain_ = &idec->mem_.chain_;
+    dec->chain_start_ = idec->mem_.start_;
+  }
 
   if (!VP8LDecodeHeader(dec, io)) {
     if (dec->status_ == VP8_STATUS_BITSTREAM_ERROR &&
@@ -553,9 +726,22 @@ static VP8StatusCode DecodeVP8LData(WebPIDecoder* const idec) {
                                                 : FinishDecoding(idec);
 }
 
+// Exports the stage timings once the picture is decoded, if requested.
+static void StoreStageStats(const WebPIDecoder* const idec) {
+  const WebPDecoderOptions* const options = idec->params_.options;
+  if (options != NULL && options->stage_stats != NULL) {
+    WebPDecStageStats* const stats = options->stage_stats;
+    *stats = idec->is_lossless_ ? ((const VP8LDecoder*)idec->dec_)->stats_
+                                : ((const VP8Decoder*)idec->dec_)->stats_;
+    stats->bytes_in = idec->mem_.end_;
+    stats->total_ns = idec->total_ns_;
+  }
+}
+
   // Main decoding loop
 static VP8StatusCode IDecode(WebPIDecoder* idec) {
   VP8StatusCode status = VP8_STATUS_SUSPENDED;
+  const uint64_t start = WebPTimerStart();
 
   if (idec->state_ == STATE_WEBP_HEADER) {
     status = DecodeWebPHeaders(idec);
@@ -579,6 +765,10 @@ static VP8StatusCode IDecode(WebPIDecoder* idec) {
   if (idec->state_ == STATE_VP8L_DATA) {
     status = DecodeVP8LData(idec);
   }
+  WebPTimerAdd(&idec->total_ns_, start);
+  if (status == VP8_STATUS_OK && idec->state_ == STATE_DONE) {
+    StoreStageStats(idec);
+  }
   return status;
 }
 
@@ -632,6 +822,11 @@ WebPIDecoder* WebPIDecode(const uint8_t* data, size_t data_size,
       (config == NULL) ? &tmp_features : &config->input;
   memset(&tmp_features, 0, sizeof(tmp_features));
 
+  // Memory policies span a single call, which incremental decoding can't honor.
+  if (config != NULL && config->options.memory != NULL) {
+    return NULL;
+  }
+
   // Parse the bitstream's features, if requested:
   if (data != NULL && data_size > 0) {
     if (WebPGetFeatures(data, data_size, features) != VP8_STATUS_OK) {
@@ -783,6 +978,37 @@ VP8StatusCode WebPIAppend(WebPIDecoder* idec,
   return IDecode(idec);
 }
 
+VP8StatusCode WebPIAppendSegments(WebPIDecoder* idec,
+                                  const WebPISegment* segments,
+                                  int num_segments) {
+  VP8StatusCode status;
+  int i;
+  if (idec == NULL || num_segments < 0 ||
+      (segments == NULL && num_segments > 0)) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  for (i = 0; i < num_segments; ++i) {
+    if (segments[i].data == NULL && segments[i].size > 0) {
+      return VP8_STATUS_INVALID_PARAM;
+    }
+  }
+  status = IDecCheckStatus(idec);
+  if (status != VP8_STATUS_SUSPENDED) {
+    return status;
+  }
+  // Check mixed calls with the other input modes.
+  if (!CheckMemBufferMode(&idec->mem_, MEM_MODE_SEGMENTS)) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  // Record the segments, without copying them.
+  for (i = 0; i < num_segments; ++i) {
+    if (!AppendSegment(&idec->mem_, segments[i].data, segments[i].size)) {
+      return VP8_STATUS_OUT_OF_MEMORY;
+    }
+  }
+  return IDecode(idec);
+}
+
 VP8StatusCode WebPIUpdate(WebPIDecoder* idec,
                           const uint8_t* data, size_t data_size) {
   VP8StatusCode status;
@@ -17,6 +17,7 @@
 #include "./webpi.h"
 #include "../dsp/dsp.h"
 #include "../dsp/yuv.h"
+#include "../utils/thread.h"
 #include "../utils/utils.h"
 
 //------------------------------------------------------------------------------
@@ -25,9 +26,10 @@
 static int EmitYUV(const VP8Io* const io, WebPDecParams* const p) {
   WebPDecBuffer* output = p->output;
   const WebPYUVABuffer* const buf = &output->u.YUVA;
-  uint8_t* const y_dst = buf->y + io->mb_y * buf->y_stride;
-  uint8_t* const u_dst = buf->u + (io->mb_y >> 1) * buf->u_stride;
-  uint8_t* const v_dst = buf->v + (io->mb_y >> 1) * buf->v_stride;
+  const int y = io->mb_y - p->band_y;
+  uint8_t* const y_dst = buf->y + y * buf->y_stride;
+  uint8_t* const u_dst = buf->u + (y >> 1) * buf->u_stride;
+  uint8_t* const v_dst = buf->v + (y >> 1) * buf->v_stride;
   const int mb_w = io->mb_w;
   const int mb_h = io->mb_h;
   const int uv_w = (mb_w + 1) / 2;
@@ -36,6 +38,13 @@ static int EmitYUV(const VP8Io* const io, WebPDecParams* const p) {
   for (j = 0; j < mb_h; ++j) {
     memcpy(y_dst + j * buf->y_stride, io->y + j * io->y_stride, mb_w);
   }
+  if (WebPIsSemiPlanarMode(output->colorspace)) {
+    for (j = 0; j < uv_h; ++j) {
+      WebPStoreSemiPlanarUV(output, (y >> 1) + j, io->u + j * io->uv_stride,
+                            io->v + j * io->uv_stride, uv_w);
+    }
+    return io->mb_h;
+  }
   for (j = 0; j < uv_h; ++j) {
     memcpy(u_dst + j * buf->u_stride, io->u + j * io->uv_stride, uv_w);
     memcpy(v_dst + j * buf->v_stride, io->v + j * io->uv_stride, uv_w);
@@ -47,7 +56,7 @@ static int EmitYUV(const VP8Io* const io, WebPDecParams* const p) {
 static int EmitSampledRGB(const VP8Io* const io, WebPDecParams* const p) {
   WebPDecBuffer* const output = p->output;
   WebPRGBABuffer* const buf = &output->u.RGBA;
-  uint8_t* const dst = buf->rgba + io->mb_y * buf->stride;
+  uint8_t* const dst = buf->rgba + (io->mb_y - p->band_y) * buf->stride;
   WebPSamplerProcessPlane(io->y, io->y_stride,
                           io->u, io->v, io->uv_stride,
                           dst, buf->stride, io->mb_w, io->mb_h,
@@ -55,6 +64,33 @@ static int EmitSampledRGB(const VP8Io* const io, WebPDecParams* const p) {
   return io->mb_h;
 }
 
+// Same for the premultiplied modes, multiplying the alpha in on the fly.
+static int EmitSampledRGBPremultiplied(const VP8Io* const io,
+                                       WebPDecParams* const p) {
+  WebPDecBuffer* const output = p->output;
+  WebPRGBABuffer* const buf = &output->u.RGBA;
+  const WebPSamplerAlphaRowFunc sample =
+      WebPSamplersPremultiplied[output->colorspace];
+  const uint8_t* y = io->y;
+  const uint8_t* u = io->u;
+  const uint8_t* v = io->v;
+  const uint8_t* a = io->a;
+  uint8_t* dst = buf->rgba + (io->mb_y - p->band_y) * buf->stride;
+  int j;
+  if (a == NULL) return EmitSampledRGB(io, p);   // opaque picture
+  for (j = 0; j < io->mb_h; ++j) {
+    sample(y, u, v, a, dst, io->mb_w);
+    y += io->y_stride;
+    a += io->width;
+    if (j & 1) {
+      u += io->uv_stride;
+      v += io->uv_stride;
+    }
+    dst += buf->stride;
+  }
+  return io->mb_h;
+}
+
 //------------------------------------------------------------------------------
 // Fancy upsampling
 
@@ -62,7 +98,7 @@ static int EmitSampledRGB(const VP8Io* const io, WebPDecParams* const p) {
 static int EmitFancyRGB(const VP8Io* const io, WebPDecParams* const p) {
   int num_lines_out = io->mb_h;   // a priori guess
   const WebPRGBABuffer* const buf = &p->output->u.RGBA;
-  uint8_t* dst = buf->rgba + io->mb_y * buf->stride;
+  uint8_t* dst = buf->rgba + (io->mb_y - p->band_y) * buf->stride;
   WebPUpsampleLinePairFunc upsample = WebPUpsamplers[p->output->colorspace];
   const uint8_t* cur_y = io->y;
   const uint8_t* cur_u = io->u;
@@ -115,6 +151,71 @@ static int EmitFancyRGB(const VP8Io* const io, WebPDecParams* const p) {
   return num_lines_out;
 }
 
+// Same as EmitFancyRGB() for the premultiplied modes, multiplying the alpha in
+// on the fly. The alpha rows are persistent, so the row left over from the
+// previous call can still be accessed.
+static int EmitFancyRGBPremultiplied(const VP8Io* const io,
+                                     WebPDecParams* const p) {
+  int num_lines_out = io->mb_h;   // a priori guess
+  const WebPRGBABuffer* const buf = &p->output->u.RGBA;
+  uint8_t* dst = buf->rgba + (io->mb_y - p->band_y) * buf->stride;
+  const WebPUpsampleAlphaLinePairFunc upsample =
+      WebPUpsamplersPremultiplied[p->output->colorspace];
+  const uint8_t* cur_y = io->y;
+  const uint8_t* cur_u = io->u;
+  const uint8_t* cur_v = io->v;
+  const uint8_t* cur_a = io->a;
+  const uint8_t* top_u = p->tmp_u;
+  const uint8_t* top_v = p->tmp_v;
+  int y = io->mb_y;
+  const int y_end = io->mb_y + io->mb_h;
+  const int mb_w = io->mb_w;
+  const int uv_w = (mb_w + 1) / 2;
+
+  if (cur_a == NULL) return EmitFancyRGB(io, p);   // opaque picture
+  if (y == 0) {
+    // First line is special cased. We mirror the u/v samples at boundary.
+    upsample(cur_y, NULL, cur_u, cur_v, cur_u, cur_v, cur_a, NULL,
+             dst, NULL, mb_w);
+  } else {
+    // We can finish the left-over line from previous call.
+    upsample(p->tmp_y, cur_y, top_u, top_v, cur_u, cur_v,
+             cur_a - io->width, cur_a, dst - buf->stride, dst, mb_w);
+    ++num_lines_out;
+  }
+  // Loop over each output pairs of row.
+  for (; y + 2 < y_end; y += 2) {
+    top_u = cur_u;
+    top_v = cur_v;
+    cur_u += io->uv_stride;
+    cur_v += io->uv_stride;
+    dst += 2 * buf->stride;
+    cur_y += 2 * io->y_stride;
+    cur_a += 2 * io->width;
+    upsample(cur_y - io->y_stride, cur_y,
+             top_u, top_v, cur_u, cur_v,
+             cur_a - io->width, cur_a,
+             dst - buf->stride, dst, mb_w);
+  }
+  // move to last row
+  cur_y += io->y_stride;
+  cur_a += io->width;
+  if (io->crop_top + y_end < io->crop_bottom) {
+    // Save the unfinished samples for next call (as we're not done yet).
+    memcpy(p->tmp_y, cur_y, mb_w * sizeof(*p->tmp_y));
+    memcpy(p->tmp_u, cur_u, uv_w * sizeof(*p->tmp_u));
+    memcpy(p->tmp_v, cur_v, uv_w * sizeof(*p->tmp_v));
+    num_lines_out--;
+  } else {
+    // Process the very last row of even-sized picture
+    if (!(y_end & 1)) {
+      upsample(cur_y, NULL, cur_u, cur_v, cur_u, cur_v, cur_a, NULL,
+               dst + buf->stride, NULL, mb_w);
+    }
+  }
+  return num_lines_out;
+}
+
 #endif    /* FANCY_UPSAMPLING */
 
 //------------------------------------------------------------------------------
@@ -133,7 +234,7 @@ static int EmitAlphaYUV(const VP8Io* const io, WebPDecParams* const p,
   const WebPYUVABuffer* const buf = &p->output->u.YUVA;
   const int mb_w = io->mb_w;
   const int mb_h = io->mb_h;
-  uint8_t* dst = buf->a + io->mb_y * buf->a_stride;
+  uint8_t* dst = buf->a + (io->mb_y - p->band_y) * buf->a_stride;
   int j;
   (void)expected_num_lines_out;
   assert(expected_num_lines_out == mb_h);
@@ -187,7 +288,8 @@ static int EmitAlphaRGB(const VP8Io* const io, WebPDecParams* const p,
     const WebPRGBABuffer* const buf = &p->output->u.RGBA;
     int num_rows;
     const int start_y = GetAlphaSourceRow(io, &alpha, &num_rows);
-    uint8_t* const base_rgba = buf->rgba + start_y * buf->stride;
+    uint8_t* const base_rgba =
+        buf->rgba + (start_y - p->band_y) * buf->stride;
     uint8_t* const dst = base_rgba + (alpha_first ? 0 : 3);
     const int has_alpha = WebPDispatchAlpha(alpha, io->width, mb_w,
                                             num_rows, dst, buf->stride);
@@ -211,7 +313,8 @@ static int EmitAlphaRGBA4444(const VP8Io* const io, WebPDecParams* const p,
     const WebPRGBABuffer* const buf = &p->output->u.RGBA;
     int num_rows;
     const int start_y = GetAlphaSourceRow(io, &alpha, &num_rows);
-    uint8_t* const base_rgba = buf->rgba + start_y * buf->stride;
+    uint8_t* const base_rgba =
+        buf->rgba + (start_y - p->band_y) * buf->stride;
 #ifdef WEBP_SWAP_16BIT_CSP
     uint8_t* alpha_dst = base_rgba;
 #else
@@ -238,6 +341,64 @@ static int EmitAlphaRGBA4444(const VP8Io* const io, WebPDecParams* const p,
   return 0;
 }
 
+//------------------------------------------------------------------------------
+// Multi-threaded rescaling
+
+// With a separable filter, each output column only depends on the source
+// columns under its weights: the output is split into column strips, each
+// one rescaled on its own worker through a copy of the WebPDecParams.
+struct WebPDecStrip {
+  WebPDecParams params;   // 'output' points to the field below
+  WebPDecBuffer output;   // the output buffer, offset to the first column
+  WebPWorker worker;
+};
+
+#define MAX_STRIPS 16
+#define MIN_STRIP_WIDTH 64   // in output pixels
+
+// Returns the number of strips to rescale the output in, 0 if it's not split.
+// The banded output of WebPDecodeRows() and the semi-planar modes (which
+// interleave the u/v rows as they are exported) are not split.
+static int GetNumStrips(const VP8Io* const io,
+                        const WebPDecParams* const p) {
+#if defined(WEBP_USE_THREAD)
+  const WebPDecoderOptions* const options = p->options;
+  int num_strips;
+  if (!io->use_scaling || io->rescaling_filter == WEBP_RESCALE_BOX ||
+      options == NULL || !options->use_threads || p->put_rows != NULL ||
+      WebPIsSemiPlanarMode(p->output->colorspace)) {
+    return 0;
+  }
+  num_strips = (options->num_threads > 2) ? options->num_threads : 2;
+  if (num_strips > MAX_STRIPS) num_strips = MAX_STRIPS;
+  if (num_strips > io->scaled_width / MIN_STRIP_WIDTH) {
+    num_strips = io->scaled_width / MIN_STRIP_WIDTH;
+  }
+  return (num_strips > 1) ? num_strips : 0;
+#else
+  (void)io;
+  (void)p;
+  return 0;
+#endif
+}
+
+#undef MAX_STRIPS
+#undef MIN_STRIP_WIDTH
+
+// Allocates p->memory: the p->num_strips strips, followed by 'size' bytes
+// for the rescalers. Returns the latter, or NULL in case of memory error.
+static rescaler_t* AllocRescalerMemory(WebPDecParams* const p, uint64_t size) {
+  const uint64_t strips_size = (uint64_t)p->num_strips * sizeof(*p->strips);
+  p->memory = WebPDecContextAlloc(p->context, WEBP_DEC_MEM_IO,
+                                  strips_size + size, 1);
+  if (p->memory == NULL) {
+    p->num_strips = 0;
+    return NULL;
+  }
+  p->strips = (p->num_strips > 0) ? (WebPDecStrip*)p->memory : NULL;
+  return (rescaler_t*)((uint8_t*)p->memory + strips_size);
+}
+
 //------------------------------------------------------------------------------
 // YUV rescaling (no final RGB conversion needed)
 
@@ -253,85 +414,148 @@ static int Rescale(const uint8_t* src, int src_stride,
   return num_lines_out;
 }
 
-static int EmitRescaledYUV(const VP8Io* const io, WebPDecParams* const p) {
-  const int mb_h = io->mb_h;
-  const int uv_mb_h = (mb_h + 1) >> 1;
-  WebPRescaler* const scaler = &p->scaler_y;
-  int num_lines_out = 0;
+// Same as Rescale() for both chroma planes of the semi-planar modes: the u/v
+// rescalers output into single rows, interleaved as they are exported.
+static void RescaleSemiPlanarUV(const uint8_t* u, const uint8_t* v,
+                                int src_stride, int new_lines,
+                                WebPDecParams* const p) {
+  WebPRescaler* const scaler_u = &p->scaler_u;
+  WebPRescaler* const scaler_v = &p->scaler_v;
+  while (new_lines > 0) {
+    const int lines_in = WebPRescalerImport(scaler_u, new_lines, u, src_stride);
+    const int v_lines_in =
+        WebPRescalerImport(scaler_v, new_lines, v, src_stride);
+    (void)v_lines_in;   // remove a gcc warning
+    assert(lines_in == v_lines_in);
+    u += lines_in * src_stride;
+    v += lines_in * src_stride;
+    new_lines -= lines_in;
+    while (WebPRescalerHasPendingOutput(scaler_u)) {
+      const int uv_y = scaler_u->dst_y - p->band_y / 2;
+      WebPRescalerExportRow(scaler_u);
+      WebPRescalerExportRow(scaler_v);
+      WebPStoreSemiPlanarUV(p->output, uv_y, scaler_u->dst, scaler_v->dst,
+                            scaler_u->dst_width);
+    }
+  }
+}
+
+static void PremultiplyY(const VP8Io* const io, WebPDecParams* const p) {
   if (WebPIsAlphaMode(p->output->colorspace) && io->a != NULL) {
     // Before rescaling, we premultiply the luma directly into the io->y
     // internal buffer. This is OK since these samples are not used for
     // intra-prediction (the top samples are saved in cache_y_/u_/v_).
     // But we need to cast the const away, though.
     WebPMultRows((uint8_t*)io->y, io->y_stride,
-                 io->a, io->width, io->mb_w, mb_h, 0);
+                 io->a, io->width, io->mb_w, io->mb_h, 0);
+  }
+}
+
+// Rescales the (premultiplied) Y and the U/V samples.
+static int RescaleYUVRows(const VP8Io* const io, WebPDecParams* const p) {
+  const int mb_h = io->mb_h;
+  const int uv_mb_h = (mb_h + 1) >> 1;
+  const int num_lines_out = Rescale(io->y, io->y_stride, mb_h, &p->scaler_y);
+  if (WebPIsSemiPlanarMode(p->output->colorspace)) {
+    RescaleSemiPlanarUV(io->u, io->v, io->uv_stride, uv_mb_h, p);
+  } else {
+    Rescale(io->u, io->uv_stride, uv_mb_h, &p->scaler_u);
+    Rescale(io->v, io->uv_stride, uv_mb_h, &p->scaler_v);
   }
-  num_lines_out = Rescale(io->y, io->y_stride, mb_h, scaler);
-  Rescale(io->u, io->uv_stride, uv_mb_h, &p->scaler_u);
-  Rescale(io->v, io->uv_stride, uv_mb_h, &p->scaler_v);
   return num_lines_out;
 }
 
+static int EmitRescaledYUV(const VP8Io* const io, WebPDecParams* const p) {
+  PremultiplyY(io, p);
+  return RescaleYUVRows(io, p);
+}
+
 static int EmitRescaledAlphaYUV(const VP8Io* const io, WebPDecParams* const p,
                                 int expected_num_lines_out) {
   const WebPYUVABuffer* const buf = &p->output->u.YUVA;
   if (io->a != NULL) {
-    uint8_t* dst_y = buf->y + p->last_y * buf->y_stride;
-    const uint8_t* src_a = buf->a + p->last_y * buf->a_stride;
+    const int y = p->last_y - p->band_y;
+    uint8_t* dst_y = buf->y + y * buf->y_stride;
+    const uint8_t* src_a = buf->a + y * buf->a_stride;
     const int num_lines_out = Rescale(io->a, io->width, io->mb_h, &p->scaler_a);
     (void)expected_num_lines_out;
     assert(expected_num_lines_out == num_lines_out);
     if (num_lines_out > 0) {   // unmultiply the Y
+      if (p->scaler_a.filter != WEBP_RESCALE_BOX) {
+        WebPClampToAlphaRows(dst_y, buf->y_stride, src_a, buf->a_stride,
+                             p->scaler_a.dst_width, num_lines_out);
+      }
       WebPMultRows(dst_y, buf->y_stride, src_a, buf->a_stride,
                    p->scaler_a.dst_width, num_lines_out, 1);
     }
   } else if (buf->a != NULL) {
     // the user requested alpha, but there is none, set it to opaque.
     assert(p->last_y + expected_num_lines_out <= io->scaled_height);
-    FillAlphaPlane(buf->a + p->last_y * buf->a_stride,
-                   io->scaled_width, expected_num_lines_out, buf->a_stride);
+    FillAlphaPlane(buf->a + (p->last_y - p->band_y) * buf->a_stride,
+                   p->scaler_a.dst_width, expected_num_lines_out,
+                   buf->a_stride);
   }
   return 0;
 }
 
 static int InitYUVRescaler(const VP8Io* const io, WebPDecParams* const p) {
   const int has_alpha = WebPIsAlphaMode(p->output->colorspace);
+  const int is_semi_planar = WebPIsSemiPlanarMode(p->output->colorspace);
   const WebPYUVABuffer* const buf = &p->output->u.YUVA;
+  const WebPRescalingFilter filter = io->rescaling_filter;
   const int out_width  = io->scaled_width;
   const int out_height = io->scaled_height;
   const int uv_out_width  = (out_width + 1) >> 1;
   const int uv_out_height = (out_height + 1) >> 1;
   const int uv_in_width  = (io->mb_w + 1) >> 1;
   const int uv_in_height = (io->mb_h + 1) >> 1;
-  const size_t work_size = 2 * out_width;   // scratch memory for luma rescaler
-  const size_t uv_work_size = 2 * uv_out_width;  // and for each u/v ones
-  size_t tmp_size;
+  // scratch memory for luma rescaler
+  const uint64_t work_size =
+      WebPRescalerWorkSize(io->mb_w, io->mb_h, out_width, out_height, 1,
+                           filter);
+  // and for each u/v ones
+  const uint64_t uv_work_size =
+      WebPRescalerWorkSize(uv_in_width, uv_in_height,
+                           uv_out_width, uv_out_height, 1, filter);
+  uint64_t tmp_size, work_total_size;
   rescaler_t* work;
+  uint8_t* u_dst = buf->u;
+  uint8_t* v_dst = buf->v;
+  int u_stride = buf->u_stride, v_stride = buf->v_stride;
 
-  tmp_size = (work_size + 2 * uv_work_size) * sizeof(*work);
+  work_total_size = work_size + 2 * uv_work_size;
   if (has_alpha) {
-    tmp_size += work_size * sizeof(*work);
+    work_total_size += work_size;
   }
-  p->memory = WebPSafeMalloc(1ULL, tmp_size);
-  if (p->memory == NULL) {
+  tmp_size = work_total_size * sizeof(*work);
+  if (is_semi_planar) {
+    tmp_size += 2 * uv_out_width;   // u/v rows waiting to be interleaved
+  }
+  work = AllocRescalerMemory(p, tmp_size);
+  if (work == NULL) {
     return 0;   // memory error
   }
-  work = (rescaler_t*)p->memory;
-  WebPRescalerInit(&p->scaler_y, io->mb_w, io->mb_h,
-                   buf->y, out_width, out_height, buf->y_stride, 1,
-                   work);
-  WebPRescalerInit(&p->scaler_u, uv_in_width, uv_in_height,
-                   buf->u, uv_out_width, uv_out_height, buf->u_stride, 1,
-                   work + work_size);
-  WebPRescalerInit(&p->scaler_v, uv_in_width, uv_in_height,
-                   buf->v, uv_out_width, uv_out_height, buf->v_stride, 1,
-                   work + work_size + uv_work_size);
+  if (is_semi_planar) {
+    u_dst = (uint8_t*)(work + work_total_size);
+    v_dst = u_dst + uv_out_width;
+    u_stride = v_stride = 0;
+    WebPInitSamplers();
+  }
+  WebPRescalerInitFilter(&p->scaler_y, io->mb_w, io->mb_h,
+                         buf->y, out_width, out_height, buf->y_stride, 1,
+                         filter, work);
+  WebPRescalerInitFilter(&p->scaler_u, uv_in_width, uv_in_height,
+                         u_dst, uv_out_width, uv_out_height, u_stride, 1,
+                         filter, work + work_size);
+  WebPRescalerInitFilter(&p->scaler_v, uv_in_width, uv_in_height,
+                         v_dst, uv_out_width, uv_out_height, v_stride, 1,
+                         filter, work + work_size + uv_work_size);
   p->emit = EmitRescaledYUV;
 
   if (has_alpha) {
-    WebPRescalerInit(&p->scaler_a, io->mb_w, io->mb_h,
-                     buf->a, out_width, out_height, buf->a_stride, 1,
-                     work + work_size + 2 * uv_work_size);
+    WebPRescalerInitFilter(&p->scaler_a, io->mb_w, io->mb_h,
+                           buf->a, out_width, out_height, buf->a_stride, 1,
+                           filter, work + work_size + 2 * uv_work_size);
     p->emit_alpha = EmitRescaledAlphaYUV;
     WebPInitAlphaProcessing();
   }
@@ -345,13 +569,13 @@ static int ExportRGB(WebPDecParams* const p, int y_pos) {
   const WebPYUV444Converter convert =
       WebPYUV444Converters[p->output->colorspace];
   const WebPRGBABuffer* const buf = &p->output->u.RGBA;
-  uint8_t* dst = buf->rgba + y_pos * buf->stride;
+  uint8_t* dst = buf->rgba + (y_pos - p->band_y) * buf->stride;
   int num_lines_out = 0;
   // For RGB rescaling, because of the YUV420, current scan position
   // U/V can be +1/-1 line from the Y one.  Hence the double test.
   while (WebPRescalerHasPendingOutput(&p->scaler_y) &&
          WebPRescalerHasPendingOutput(&p->scaler_u)) {
-    assert(y_pos + num_lines_out < p->output->height);
+    assert(y_pos - p->band_y + num_lines_out < p->output->height);
     assert(p->scaler_u.y_accum == p->scaler_v.y_accum);
     WebPRescalerExportRow(&p->scaler_y);
     WebPRescalerExportRow(&p->scaler_u);
@@ -369,6 +593,21 @@ static int EmitRescaledRGB(const VP8Io* const io, WebPDecParams* const p) {
   const int uv_mb_h = (mb_h + 1) >> 1;
   int j = 0, uv_j = 0;
   int num_lines_out = 0;
+  if (p->scaler_y.filter != WEBP_RESCALE_BOX) {
+    // The u/v rescalers then have the same geometry as the luma one (see
+    // InitRGBRescaler()), and each u/v row is imported twice, in step.
+    while (j < mb_h) {
+      const int uv_offset = (j >> 1) * io->uv_stride;
+      if (WebPRescalerImport(&p->scaler_y, 1,
+                             io->y + j * io->y_stride, io->y_stride)) {
+        WebPRescalerImport(&p->scaler_u, 1, io->u + uv_offset, io->uv_stride);
+        WebPRescalerImport(&p->scaler_v, 1, io->v + uv_offset, io->uv_stride);
+        ++j;
+      }
+      num_lines_out += ExportRGB(p, p->last_y + num_lines_out);
+    }
+    return num_lines_out;
+  }
   while (j < mb_h) {
     const int y_lines_in =
         WebPRescalerImport(&p->scaler_y, mb_h - j,
@@ -392,7 +631,7 @@ static int EmitRescaledRGB(const VP8Io* const io, WebPDecParams* const p) {
 
 static int ExportAlpha(WebPDecParams* const p, int y_pos, int max_lines_out) {
   const WebPRGBABuffer* const buf = &p->output->u.RGBA;
-  uint8_t* const base_rgba = buf->rgba + y_pos * buf->stride;
+  uint8_t* const base_rgba = buf->rgba + (y_pos - p->band_y) * buf->stride;
   const WEBP_CSP_MODE colorspace = p->output->colorspace;
   const int alpha_first =
       (colorspace == MODE_ARGB || colorspace == MODE_Argb);
@@ -404,7 +643,7 @@ static int ExportAlpha(WebPDecParams* const p, int y_pos, int max_lines_out) {
 
   while (WebPRescalerHasPendingOutput(&p->scaler_a) &&
          num_lines_out < max_lines_out) {
-    assert(y_pos + num_lines_out < p->output->height);
+    assert(y_pos - p->band_y + num_lines_out < p->output->height);
     WebPRescalerExportRow(&p->scaler_a);
     non_opaque |= WebPDispatchAlpha(p->scaler_a.dst, 0, width, 1, dst, 0);
     dst += buf->stride;
@@ -420,7 +659,7 @@ static int ExportAlpha(WebPDecParams* const p, int y_pos, int max_lines_out) {
 static int ExportAlphaRGBA4444(WebPDecParams* const p, int y_pos,
                                int max_lines_out) {
   const WebPRGBABuffer* const buf = &p->output->u.RGBA;
-  uint8_t* const base_rgba = buf->rgba + y_pos * buf->stride;
+  uint8_t* const base_rgba = buf->rgba + (y_pos - p->band_y) * buf->stride;
 #ifdef WEBP_SWAP_16BIT_CSP
   uint8_t* alpha_dst = base_rgba;
 #else
@@ -435,7 +674,7 @@ static int ExportAlphaRGBA4444(WebPDecParams* const p, int y_pos,
   while (WebPRescalerHasPendingOutput(&p->scaler_a) &&
          num_lines_out < max_lines_out) {
     int i;
-    assert(y_pos + num_lines_out < p->output->height);
+    assert(y_pos - p->band_y + num_lines_out < p->output->height);
     WebPRescalerExportRow(&p->scaler_a);
     for (i = 0; i < width; ++i) {
       // Fill in the alpha value (converted to 4 bits).
@@ -470,44 +709,52 @@ static int EmitRescaledAlphaRGB(const VP8Io* const io, WebPDecParams* const p,
 
 static int InitRGBRescaler(const VP8Io* const io, WebPDecParams* const p) {
   const int has_alpha = WebPIsAlphaMode(p->output->colorspace);
+  const WebPRescalingFilter filter = io->rescaling_filter;
   const int out_width  = io->scaled_width;
   const int out_height = io->scaled_height;
   const int uv_in_width  = (io->mb_w + 1) >> 1;
-  const int uv_in_height = (io->mb_h + 1) >> 1;
-  const size_t work_size = 2 * out_width;   // scratch memory for one rescaler
+  // vertically, the u/v planes are upsampled first for separable filters
+  const int uv_in_height =
+      (filter == WEBP_RESCALE_BOX) ? (io->mb_h + 1) >> 1 : io->mb_h;
+  // scratch memory for the luma (or alpha) rescaler and for each u/v ones
+  const uint64_t work_size =
+      WebPRescalerWorkSize(io->mb_w, io->mb_h, out_width, out_height, 1,
+                           filter);
+  const uint64_t uv_work_size =
+      WebPRescalerWorkSize(uv_in_width, uv_in_height, out_width, out_height, 1,
+                           filter);
   rescaler_t* work;  // rescalers work area
   uint8_t* tmp;   // tmp storage for scaled YUV444 samples before RGB conversion
-  size_t tmp_size1, tmp_size2, total_size;
+  uint64_t tmp_size1, tmp_size2, total_size;
 
-  tmp_size1 = 3 * work_size;
+  tmp_size1 = work_size + 2 * uv_work_size;
   tmp_size2 = 3 * out_width;
   if (has_alpha) {
     tmp_size1 += work_size;
     tmp_size2 += out_width;
   }
   total_size = tmp_size1 * sizeof(*work) + tmp_size2 * sizeof(*tmp);
-  p->memory = WebPSafeMalloc(1ULL, total_size);
-  if (p->memory == NULL) {
+  work = AllocRescalerMemory(p, total_size);
+  if (work == NULL) {
     return 0;   // memory error
   }
-  work = (rescaler_t*)p->memory;
   tmp = (uint8_t*)(work + tmp_size1);
-  WebPRescalerInit(&p->scaler_y, io->mb_w, io->mb_h,
-                   tmp + 0 * out_width, out_width, out_height, 0, 1,
-                   work + 0 * work_size);
-  WebPRescalerInit(&p->scaler_u, uv_in_width, uv_in_height,
-                   tmp + 1 * out_width, out_width, out_height, 0, 1,
-                   work + 1 * work_size);
-  WebPRescalerInit(&p->scaler_v, uv_in_width, uv_in_height,
-                   tmp + 2 * out_width, out_width, out_height, 0, 1,
-                   work + 2 * work_size);
+  WebPRescalerInitFilter(&p->scaler_y, io->mb_w, io->mb_h,
+                         tmp + 0 * out_width, out_width, out_height, 0, 1,
+                         filter, work);
+  WebPRescalerInitFilter(&p->scaler_u, uv_in_width, uv_in_height,
+                         tmp + 1 * out_width, out_width, out_height, 0, 1,
+                         filter, work + work_size);
+  WebPRescalerInitFilter(&p->scaler_v, uv_in_width, uv_in_height,
+                         tmp + 2 * out_width, out_width, out_height, 0, 1,
+                         filter, work + work_size + uv_work_size);
   p->emit = EmitRescaledRGB;
   WebPInitYUV444Converters();
 
   if (has_alpha) {
-    WebPRescalerInit(&p->scaler_a, io->mb_w, io->mb_h,
-                     tmp + 3 * out_width, out_width, out_height, 0, 1,
-                     work + 3 * work_size);
+    WebPRescalerInitFilter(&p->scaler_a, io->mb_w, io->mb_h,
+                           tmp + 3 * out_width, out_width, out_height, 0, 1,
+                           filter, work + work_size + 2 * uv_work_size);
     p->emit_alpha = EmitRescaledAlphaRGB;
     if (p->output->colorspace == MODE_RGBA_4444 ||
         p->output->colorspace == MODE_rgbA_4444) {
@@ -520,6 +767,106 @@ static int InitRGBRescaler(const VP8Io* const io, WebPDecParams* const p) {
   return 1;
 }
 
+//------------------------------------------------------------------------------
+// Multi-threaded rescaling (continued)
+
+static int GetRGBBytesPerPixel(WEBP_CSP_MODE mode) {
+  switch (mode) {
+    case MODE_RGB: case MODE_BGR: return 3;
+    case MODE_RGBA_4444: case MODE_rgbA_4444: case MODE_RGB_565: return 2;
+    default: return 4;
+  }
+}
+
+static int EmitStrip(WebPDecParams* const p, const VP8Io* const io) {
+  const int num_lines_out = p->emit(io, p);
+  if (p->emit_alpha != NULL) {
+    p->emit_alpha(io, p, num_lines_out);
+  }
+  p->last_y += num_lines_out;
+  return 1;
+}
+
+static int EmitStrips(const VP8Io* const io, WebPDecParams* const p) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  int i;
+  if (!WebPIsRGBMode(p->output->colorspace)) {
+    PremultiplyY(io, p);   // once, before the strips read io->y
+  }
+  for (i = 0; i < p->num_strips; ++i) {
+    WebPDecStrip* const strip = &p->strips[i];
+    strip->params.last_y = p->last_y;
+    strip->worker.data2 = (void*)io;
+    if (i > 0) winterface->Launch(&strip->worker);
+  }
+  winterface->Execute(&p->strips[0].worker);
+  for (i = 1; i < p->num_strips; ++i) {
+    winterface->Sync(&p->strips[i].worker);
+    assert(p->strips[i].params.last_y == p->strips[0].params.last_y);
+  }
+  return p->strips[0].params.last_y - p->last_y;
+}
+
+// Splits the output rescaling of the freshly initialized rescalers into the
+// p->num_strips strips allocated by AllocRescalerMemory(). The output is not
+// split if a worker can't be started.
+static void InitStrips(WebPDecParams* const p) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  const WEBP_CSP_MODE colorspace = p->output->colorspace;
+  const int is_rgb = WebPIsRGBMode(colorspace);
+  const int has_alpha = WebPIsAlphaMode(colorspace);
+  const int num_strips = p->num_strips;
+  const int width = p->scaler_y.dst_width;
+  const int uv_width = p->scaler_u.dst_width;
+  int i;
+  for (i = 0; i < num_strips; ++i) {
+    winterface->Init(&p->strips[i].worker);
+    if (i > 0 && !winterface->Reset(&p->strips[i].worker)) {
+      while (i > 0) winterface->End(&p->strips[i--].worker);
+      p->num_strips = 0;
+      p->strips = NULL;
+      return;
+    }
+  }
+  for (i = 0; i < num_strips; ++i) {
+    WebPDecStrip* const strip = &p->strips[i];
+    WebPDecParams* const params = &strip->params;
+    const int x = width * i / num_strips;
+    const int w = width * (i + 1) / num_strips - x;
+    const int uv_x = uv_width * i / num_strips;
+    const int uv_w = uv_width * (i + 1) / num_strips - uv_x;
+    *params = *p;
+    params->num_strips = 0;
+    params->strips = NULL;
+    params->memory = NULL;
+    strip->output = *p->output;
+    params->output = &strip->output;
+    WebPRescalerInitStrip(&params->scaler_y, &p->scaler_y, x, w);
+    if (is_rgb) {
+      // the u/v rescalers have the output width too (see InitRGBRescaler())
+      strip->output.u.RGBA.rgba += x * GetRGBBytesPerPixel(colorspace);
+      WebPRescalerInitStrip(&params->scaler_u, &p->scaler_u, x, w);
+      WebPRescalerInitStrip(&params->scaler_v, &p->scaler_v, x, w);
+    } else {
+      WebPYUVABuffer* const buf = &strip->output.u.YUVA;
+      buf->y += x;
+      buf->u += uv_x;
+      buf->v += uv_x;
+      if (buf->a != NULL) buf->a += x;
+      WebPRescalerInitStrip(&params->scaler_u, &p->scaler_u, uv_x, uv_w);
+      WebPRescalerInitStrip(&params->scaler_v, &p->scaler_v, uv_x, uv_w);
+      params->emit = RescaleYUVRows;   // EmitStrips() premultiplies io->y
+    }
+    if (has_alpha) {
+      WebPRescalerInitStrip(&params->scaler_a, &p->scaler_a, x, w);
+    }
+    strip->worker.data1 = params;
+    strip->worker.hook = (WebPWorkerHook)EmitStrip;
+  }
+  p->emit = EmitStrips;
+  p->emit_alpha = NULL;   // done by each strip
+}
+
 //------------------------------------------------------------------------------
 // Default custom functions
 
@@ -528,44 +875,57 @@ static int CustomSetup(VP8Io* io) {
   const WEBP_CSP_MODE colorspace = p->output->colorspace;
   const int is_rgb = WebPIsRGBMode(colorspace);
   const int is_alpha = WebPIsAlphaMode(colorspace);
+  const int is_premult_alpha = WebPIsPremultipliedMode(colorspace);
 
   p->memory = NULL;
+  p->num_strips = 0;
+  p->strips = NULL;
   p->emit = NULL;
   p->emit_alpha = NULL;
   p->emit_alpha_row = NULL;
   if (!WebPIoInitFromOptions(p->options, io, is_alpha ? MODE_YUV : MODE_YUVA)) {
     return 0;
   }
-  if (is_alpha && WebPIsPremultipliedMode(colorspace)) {
+  if (is_premult_alpha) {
     WebPInitUpsamplers();
   }
   if (io->use_scaling) {
-    const int ok = is_rgb ? InitRGBRescaler(io, p) : InitYUVRescaler(io, p);
+    int ok;
+    p->num_strips = GetNumStrips(io, p);
+    ok = is_rgb ? InitRGBRescaler(io, p) : InitYUVRescaler(io, p);
     if (!ok) {
       return 0;    // memory error
     }
+    if (p->num_strips > 0) InitStrips(p);
   } else {
     if (is_rgb) {
       WebPInitSamplers();
-      p->emit = EmitSampledRGB;   // default
+      // The premultiplied modes get the alpha multiplied in during the
+      // conversion, so they don't need a separate p->emit_alpha pass.
+      p->emit = is_premult_alpha ? EmitSampledRGBPremultiplied
+                                 : EmitSampledRGB;   // default
       if (io->fancy_upsampling) {
 #ifdef FANCY_UPSAMPLING
         const int uv_width = (io->mb_w + 1) >> 1;
-        p->memory = WebPSafeMalloc(1ULL, (size_t)(io->mb_w + 2 * uv_width));
+        p->memory = WebPDecContextAlloc(p->context, WEBP_DEC_MEM_IO, 1ULL,
+                                        (size_t)(io->mb_w + 2 * uv_width));
         if (p->memory == NULL) {
           return 0;   // memory error.
         }
         p->tmp_y = (uint8_t*)p->memory;
         p->tmp_u = p->tmp_y + io->mb_w;
         p->tmp_v = p->tmp_u + uv_width;
-        p->emit = EmitFancyRGB;
+        p->emit = is_premult_alpha ? EmitFancyRGBPremultiplied : EmitFancyRGB;
         WebPInitUpsamplers();
 #endif
       }
     } else {
       p->emit = EmitYUV;
+      if (WebPIsSemiPlanarMode(colorspace)) {
+        WebPInitSamplers();   // for WebPInterleaveUV()
+      }
     }
-    if (is_alpha) {  // need transparency output
+    if (is_alpha && !is_premult_alpha) {  // need transparency output
       p->emit_alpha =
           (colorspace == MODE_RGBA_4444 || colorspace == MODE_rgbA_4444) ?
               EmitAlphaRGBA4444
@@ -583,6 +943,32 @@ static int CustomSetup(VP8Io* io) {
   return 1;
 }
 
+//------------------------------------------------------------------------------
+// Band output
+
+// Hands the rows that are complete over to p->put_rows.
+static int EmitBand(WebPDecParams* const p) {
+  const int is_rescaled_yuv = (p->emit == EmitRescaledYUV);
+  const int num_uv_rows =
+      is_rescaled_yuv ? p->scaler_u.dst_y : (p->last_y + 1) >> 1;
+  if (!WebPEmitDecBand(p, p->last_y, num_uv_rows)) return 0;
+  if (is_rescaled_yuv) {
+    // Re-anchor the rescalers' output on the rows that were moved up.
+    const WebPYUVABuffer* const buf = &p->output->u.YUVA;
+    const int y = p->band_y;
+    p->scaler_y.dst = buf->y + (p->scaler_y.dst_y - y) * buf->y_stride;
+    if (!WebPIsSemiPlanarMode(p->output->colorspace)) {
+      // (the semi-planar u/v rows are stored by RescaleSemiPlanarUV())
+      p->scaler_u.dst = buf->u + (p->scaler_u.dst_y - y / 2) * buf->u_stride;
+      p->scaler_v.dst = buf->v + (p->scaler_v.dst_y - y / 2) * buf->v_stride;
+    }
+    if (WebPIsAlphaMode(p->output->colorspace)) {
+      p->scaler_a.dst = buf->a + (p->scaler_a.dst_y - y) * buf->a_stride;
+    }
+  }
+  return 1;
+}
+
 //------------------------------------------------------------------------------
 
 static int CustomPut(const VP8Io* io) {
@@ -600,6 +986,9 @@ static int CustomPut(const VP8Io* io) {
     p->emit_alpha(io, p, num_lines_out);
   }
   p->last_y += num_lines_out;
+  if (p->put_rows != NULL && !EmitBand(p)) {
+    return 0;
+  }
   return 1;
 }
 
@@ -607,7 +996,13 @@ static int CustomPut(const VP8Io* io) {
 
 static void CustomTeardown(const VP8Io* io) {
   WebPDecParams* const p = (WebPDecParams*)io->opaque;
-  WebPSafeFree(p->memory);
+  int i;
+  for (i = 1; i < p->num_strips; ++i) {
+    WebPGetWorkerInterface()->End(&p->strips[i].worker);
+  }
+  p->num_strips = 0;
+  p->strips = NULL;
+  WebPDecContextFree(p->context, WEBP_DEC_MEM_IO, p->memory);
   p->memory = NULL;
 }
 
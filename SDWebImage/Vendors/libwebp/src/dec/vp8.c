@@ -47,8 +47,13 @@ int VP8InitIoInternal(VP8Io* const io, int version) {
 VP8Decoder* VP8New(void) {
   VP8Decoder* const dec = (VP8Decoder*)WebPSafeCalloc(1ULL, sizeof(*dec));
   if (dec != NULL) {
+    int i;
     SetOk(dec);
     WebPGetWorkerInterface()->Init(&dec->worker_);
+    WebPGetWorkerInterface()->Init(&dec->alpha_worker_);
+    for (i = 0; i < MAX_NUM_PARTITIONS; ++i) {
+      WebPGetWorkerInterface()->Init(&dec->part_jobs_[i].worker_);
+    }
     dec->ready_ = 0;
     dec->num_parts_minus_one_ = 0;
   }
@@ -200,6 +205,11 @@ static VP8StatusCode ParsePartitions(VP8Decoder* const dec,
     // we can't even read the sizes with sz[]! That's a failure.
     return VP8_STATUS_NOT_ENOUGH_DATA;
   }
+  if (dec->external_parts_) {
+    // The partitions don't need to be in 'buf': the caller points parts_[]
+    // to their data, using the sizes in sz[].
+    return VP8_STATUS_OK;
+  }
   part_start = buf + last_part * 3;
   size_left -= last_part * 3;
   for (p = 0; p < last_part; ++p) {
@@ -241,8 +251,7 @@ static int ParseFilterHeader(VP8BitReader* br, VP8Decoder* const dec) {
   return !br->eof_;
 }
 
-// Topmost call
-int VP8GetHeaders(VP8Decoder* const dec, VP8Io* const io) {
+static int GetHeaders(VP8Decoder* const dec, VP8Io* const io) {
   const uint8_t* buf;
   size_t buf_size;
   VP8FrameHeader* frm_hdr;
@@ -374,6 +383,14 @@ int VP8GetHeaders(VP8Decoder* const dec, VP8Io* const io) {
   return 1;
 }
 
+// Topmost call
+int VP8GetHeaders(VP8Decoder* const dec, VP8Io* const io) {
+  const uint64_t start = WebPTimerStart();
+  const int ok = GetHeaders(dec, io);
+  if (dec != NULL) WebPTimerAdd(&dec->stats_.header_ns, start);
+  return ok;
+}
+
 //------------------------------------------------------------------------------
 // Residual decoding (Paragraph 13.2 / 13.3)
 
@@ -453,14 +470,14 @@ static WEBP_INLINE uint32_t NzCodeBits(uint32_t nz_coeffs, int nz, int dc_nz) {
   return nz_coeffs;
 }
 
-static int ParseResiduals(VP8Decoder* const dec,
-                          VP8MB* const mb, VP8BitReader* const token_br) {
-  const VP8BandProbas* (* const bands)[16 + 1] = dec->proba_.bands_ptr_;
+static int ParseResiduals(const VP8Decoder* const dec,
+                          VP8MB* const mb, VP8MB* const left_mb,
+                          VP8MBData* const block,
+                          VP8BitReader* const token_br) {
+  const VP8BandProbas* const (* const bands)[16 + 1] = dec->proba_.bands_ptr_;
   const VP8BandProbas* const * ac_proba;
-  VP8MBData* const block = dec->mb_data_ + dec->mb_x_;
   const VP8QuantMatrix* const q = &dec->dqm_[block->segment_];
   int16_t* dst = block->coeffs_;
-  VP8MB* const left_mb = dec->mb_info_ - 1;
   uint8_t tnz, lnz;
   uint32_t non_zero_y = 0;
   uint32_t non_zero_uv = 0;
@@ -547,14 +564,17 @@ static int ParseResiduals(VP8Decoder* const dec,
 //------------------------------------------------------------------------------
 // Main loop
 
-int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
-  VP8MB* const left = dec->mb_info_ - 1;
-  VP8MB* const mb = dec->mb_info_ + dec->mb_x_;
-  VP8MBData* const block = dec->mb_data_ + dec->mb_x_;
+// Parse the residuals of the macroblock 'mb_x' of a row, given its left
+// non-zero context, parsed data and filter strengths.
+static int DecodeMB(const VP8Decoder* const dec, int mb_x, VP8MB* const left,
+                    VP8MBData* const mb_data, VP8FInfo* const f_info,
+                    VP8BitReader* const token_br) {
+  VP8MB* const mb = dec->mb_info_ + mb_x;
+  VP8MBData* const block = mb_data + mb_x;
   int skip = dec->use_skip_proba_ ? block->skip_ : 0;
 
   if (!skip) {
-    skip = ParseResiduals(dec, mb, token_br);
+    skip = ParseResiduals(dec, mb, left, block, token_br);
   } else {
     left->nz_ = mb->nz_ = 0;
     if (!block->is_i4x4_) {
@@ -566,7 +586,7 @@ int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
   }
 
   if (dec->filter_type_ > 0) {  // store filter info
-    VP8FInfo* const finfo = dec->f_info_ + dec->mb_x_;
+    VP8FInfo* const finfo = f_info + mb_x;
     *finfo = dec->fstrengths_[block->segment_][block->is_i4x4_];
     finfo->f_inner_ |= !skip;
   }
@@ -574,6 +594,11 @@ int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
   return !token_br->eof_;
 }
 
+int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
+  return DecodeMB(dec, dec->mb_x_, dec->mb_info_ - 1, dec->mb_data_,
+                  dec->f_info_, token_br);
+}
+
 void VP8InitScanline(VP8Decoder* const dec) {
   VP8MB* const left = dec->mb_info_ - 1;
   left->nz_ = 0;
@@ -582,11 +607,134 @@ void VP8InitScanline(VP8Decoder* const dec) {
   dec->mb_x_ = 0;
 }
 
+//------------------------------------------------------------------------------
+// Parallel parsing of the token partitions.
+//
+// Row 'y' is coded in the token partition 'y % num_parts', but parsing one of
+// its macroblocks still needs the non-zero context left by the row above.
+// The rows are hence split into 'num_parts' segments which are parsed in a
+// wavefront: segment 's' of row 'y' is parsed during the step 'y + s', by the
+// worker of the row's partition. The rows being parsed during a given step
+// all belong to different partitions. Meanwhile, the main thread parses the
+// intra modes (partition 0) and hands the completed rows over to
+// VP8ProcessRow(), in order.
+
+static int ParseSegment(const VP8Decoder* const dec,
+                        VP8PartitionJob* const job) {
+  const uint64_t start = WebPTimerStart();
+  int ok = 1;
+  int mb_x;
+  for (mb_x = job->mb_x_; ok && mb_x < job->mb_x_end_; ++mb_x) {
+    ok = DecodeMB(dec, mb_x, &job->left_, job->mb_data_, job->f_info_,
+                  job->br_);
+  }
+  WebPTimerAdd(&job->tokens_ns_, start);
+  return ok;
+}
+
+static int SyncPartitionJobs(VP8Decoder* const dec) {
+  int ok = 1;
+  int i;
+  for (i = 0; i < dec->num_part_jobs_; ++i) {
+    ok &= WebPGetWorkerInterface()->Sync(&dec->part_jobs_[i].worker_);
+  }
+  return ok;
+}
+
+static void LaunchSegment(VP8Decoder* const dec, int mb_y, int segment) {
+  VP8PartitionJob* const job =
+      &dec->part_jobs_[mb_y & dec->num_parts_minus_one_];
+  const int num_segments = dec->num_part_jobs_;
+  assert(job->mb_y_ == mb_y);
+  job->mb_x_ = segment * dec->mb_w_ / num_segments;
+  job->mb_x_end_ = (segment + 1) * dec->mb_w_ / num_segments;
+  WebPGetWorkerInterface()->Launch(&job->worker_);
+}
+
+// Exchange the row data held by 'dec' and 'job'.
+static void SwapRowData(VP8Decoder* const dec, VP8PartitionJob* const job) {
+  VP8MBData* const mb_data = job->mb_data_;
+  VP8FInfo* const f_info = job->f_info_;
+  job->mb_data_ = dec->mb_data_;
+  job->f_info_ = dec->f_info_;
+  dec->mb_data_ = mb_data;
+  dec->f_info_ = f_info;
+}
+
+static int ParseFramePartitions(VP8Decoder* const dec, VP8Io* io) {
+  const int num_parts = dec->num_part_jobs_;
+  const int last_tick = dec->br_mb_y_ + num_parts - 1;
+  int tick;
+  int i;
+  for (i = 0; i < num_parts; ++i) {
+    VP8PartitionJob* const job = &dec->part_jobs_[i];
+    if (!WebPGetWorkerInterface()->Reset(&job->worker_)) {
+      return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                         "thread initialization failed.");
+    }
+    job->worker_.hook = (WebPWorkerHook)ParseSegment;
+    job->worker_.data1 = dec;
+    job->worker_.data2 = job;
+    job->br_ = &dec->parts_[i];
+    job->mb_y_ = -1;
+  }
+  for (tick = 0; tick <= last_tick; ++tick) {
+    int mb_y;
+    if (!SyncPartitionJobs(dec)) {
+      return VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
+                         "Premature end-of-file encountered.");
+    }
+    // Go on with the rows started during the previous steps.
+    for (mb_y = tick - num_parts + 1; mb_y < tick; ++mb_y) {
+      if (mb_y >= 0 && mb_y < dec->br_mb_y_) {
+        LaunchSegment(dec, mb_y, tick - mb_y);
+      }
+    }
+    // Reconstruct, filter and emit the row completed during the last step.
+    if (tick >= num_parts) {
+      dec->mb_y_ = tick - num_parts;
+      SwapRowData(dec, &dec->part_jobs_[dec->mb_y_ & (num_parts - 1)]);
+      if (!VP8ProcessRow(dec, io)) {
+        SyncPartitionJobs(dec);
+        return VP8SetError(dec, VP8_STATUS_USER_ABORT, "Output aborted.");
+      }
+    }
+    // Parse the intra modes of a new row, and start parsing its residuals.
+    if (tick < dec->br_mb_y_) {
+      VP8PartitionJob* const job = &dec->part_jobs_[tick & (num_parts - 1)];
+      const uint64_t start = WebPTimerStart();
+      if (!VP8ParseIntraModeRow(&dec->br_, dec)) {
+        SyncPartitionJobs(dec);
+        return VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
+                           "Premature end-of-partition0 encountered.");
+      }
+      WebPTimerAdd(&dec->stats_.tokens_ns, start);
+      VP8InitScanline(dec);   // Prepare for next scanline
+      SwapRowData(dec, job);
+      job->mb_y_ = tick;
+      job->left_.nz_ = 0;
+      job->left_.nz_dc_ = 0;
+      LaunchSegment(dec, tick, 0);
+    }
+  }
+  dec->mb_y_ = dec->br_mb_y_;
+  if (dec->mt_method_ > 0) {
+    if (!WebPGetWorkerInterface()->Sync(&dec->worker_)) return 0;
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+
 static int ParseFrame(VP8Decoder* const dec, VP8Io* io) {
+  if (dec->num_part_jobs_ > 0) {
+    return ParseFramePartitions(dec, io);
+  }
   for (dec->mb_y_ = 0; dec->mb_y_ < dec->br_mb_y_; ++dec->mb_y_) {
     // Parse bitstream for this row.
     VP8BitReader* const token_br =
         &dec->parts_[dec->mb_y_ & dec->num_parts_minus_one_];
+    uint64_t start = WebPTimerStart();
     if (!VP8ParseIntraModeRow(&dec->br_, dec)) {
       return VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
                          "Premature end-of-partition0 encountered.");
@@ -596,8 +744,17 @@ static int ParseFrame(VP8Decoder* const dec, VP8Io* io) {
         return VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
                            "Premature end-of-file encountered.");
       }
+      // N-way decoding: let the workers proceed while we parse this row.
+      if (dec->mb_x_ == dec->mb_w_ / 2) {
+        WebPTimerAdd(&dec->stats_.tokens_ns, start);
+        if (!VP8ProcessTick(dec, io)) {
+          return VP8SetError(dec, VP8_STATUS_USER_ABORT, "Output aborted.");
+        }
+        start = WebPTimerStart();
+      }
     }
     VP8InitScanline(dec);   // Prepare for next scanline
+    WebPTimerAdd(&dec->stats_.tokens_ns, start);
 
     // Reconstruct, filter and emit the row.
     if (!VP8ProcessRow(dec, io)) {
@@ -632,6 +789,9 @@ int VP8Decode(VP8Decoder* const dec, VP8Io* const io) {
   // Finish setting up the decoding parameter. Will call io->setup().
   ok = (VP8EnterCritical(dec, io) == VP8_STATUS_OK);
   if (ok) {   // good to go.
+    // Parse the token partitions in parallel, if there are several.
+    dec->num_part_jobs_ = (dec->mt_method_ > 0 && dec->num_parts_minus_one_ > 0)
+                        ? (int)dec->num_parts_minus_one_ + 1 : 0;
     // Will allocate memory and prepare everything.
     if (ok) ok = VP8InitFrame(dec, io);
 
@@ -652,12 +812,17 @@ int VP8Decode(VP8Decoder* const dec, VP8Io* const io) {
 }
 
 void VP8Clear(VP8Decoder* const dec) {
+  int i;
   if (dec == NULL) {
     return;
   }
   WebPGetWorkerInterface()->End(&dec->worker_);
+  VP8EndSegmentJobs(dec);
+  for (i = 0; i < MAX_NUM_PARTITIONS; ++i) {
+    WebPGetWorkerInterface()->End(&dec->part_jobs_[i].worker_);
+  }
   WebPDeallocateAlphaMemory(dec);
-  WebPSafeFree(dec->mem_);
+  WebPDecContextFree(dec->context_, WEBP_DEC_MEM_VP8, dec->mem_);
   dec->mem_ = NULL;
   dec->mem_size_ = 0;
   memset(&dec->br_, 0, sizeof(dec->br_));
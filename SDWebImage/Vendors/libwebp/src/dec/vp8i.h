@@ -164,14 +164,38 @@ typedef struct {
 
 // Persistent information needed by the parallel processing
 typedef struct {
-  int id_;              // cache row to process (in [0..2])
+  int id_;              // cache row to process (in [0..num_caches_-1])
   int mb_y_;            // macroblock position of the row
   int filter_row_;      // true if row-filtering is needed
   VP8FInfo* f_info_;    // filter strengths (swapped with dec->f_info_)
   VP8MBData* mb_data_;  // reconstruction data (swapped with dec->mb_data_)
+  uint8_t* yuv_b_;      // reconstruction scratch block (N-way decoding only)
   VP8Io io_;            // copy of the VP8Io to pass to put()
 } VP8ThreadContext;
 
+// Worker reconstructing and filtering a segment of a macroblock row, for the
+// N-way decoding method (mt_method_ = 3).
+typedef struct {
+  WebPWorker worker_;
+  VP8ThreadContext* ctx_;   // row to process
+  int mb_x_, mb_x_end_;     // range of macroblocks to process
+  uint64_t reconstruct_ns_;  // stage timings of the worker, merged into
+  uint64_t filter_ns_;       // dec->stats_ by VP8ExitCritical()
+} VP8SegmentJob;
+
+// Worker parsing the residuals of the rows coded in one token partition,
+// when several partitions are decoded in parallel (see ParseFrame() in vp8.c).
+typedef struct {
+  WebPWorker worker_;
+  VP8BitReader* br_;        // token partition
+  int mb_y_;                // row being parsed
+  int mb_x_, mb_x_end_;     // range of macroblocks to parse
+  VP8MB left_;              // left non-zero context of the row
+  VP8MBData* mb_data_;      // parsed data of the row
+  VP8FInfo* f_info_;        // filter strengths of the row
+  uint64_t tokens_ns_;      // parsing time of the worker
+} VP8PartitionJob;
+
 // Saved top samples, per macroblock. Fits into a cache-line.
 typedef struct {
   uint8_t y[16], u[8], v[8];
@@ -198,10 +222,18 @@ struct VP8Decoder {
   WebPWorker worker_;
   int mt_method_;      // multi-thread method: 0=off, 1=[parse+recon][filter]
                        // 2=[parse][recon+filter]
+                       // 3=[parse][N x (recon+filter)][output], see frame.c
   int cache_id_;       // current cache row
-  int num_caches_;     // number of cached rows of 16 pixels (1, 2 or 3)
+  int num_caches_;     // number of cached rows of 16 pixels (1, 2, 3 or more)
   VP8ThreadContext thread_ctx_;  // Thread context
 
+  // N-way decoding (mt_method_ = 3). 'worker_' is then used to emit the rows.
+  int num_threads_;               // requested number of threads
+  int num_jobs_;                  // number of segment workers
+  VP8SegmentJob* jobs_;           // segment workers
+  VP8ThreadContext* thread_ctxs_;  // one context per cache row
+  int tick_;                      // next wavefront step to launch
+
   // dimension, in macroblock units.
   int mb_w_, mb_h_;
 
@@ -213,11 +245,24 @@ struct VP8Decoder {
   uint32_t num_parts_minus_one_;
   // per-partition boolean decoders.
   VP8BitReader parts_[MAX_NUM_PARTITIONS];
+  // if true, VP8GetHeaders() only reads the partition sizes, and the caller
+  // sets parts_[] up itself (segmented incremental decoding).
+  int external_parts_;
+  // per-partition residual parsing workers (multi-threaded decoding only).
+  int num_part_jobs_;
+  VP8PartitionJob part_jobs_[MAX_NUM_PARTITIONS];
 
   // Dithering strength, deduced from decoding options
   int dither_;                // whether to use dithering or not
   VP8Random dithering_rg_;    // random generator for dithering
 
+  // thumbnail decoding (see frame.c), deduced from decoding options
+  int thumbnail_;             // true if decoding a 1/4-scale thumbnail
+  uint8_t* thumb_y_;          // 4x4-averaged samples of the emitted row
+  uint8_t* thumb_u_;
+  uint8_t* thumb_v_;
+  uint8_t* thumb_a_;          // 4x4-averaged alpha of the emitted row
+
   // dequantization (one set of DC/AC dequant factor per segment)
   VP8QuantMatrix dqm_[NUM_MB_SEGMENTS];
 
@@ -245,6 +290,7 @@ struct VP8Decoder {
   // main memory chunk for the above data. Persistent.
   void* mem_;
   size_t mem_size_;
+  WebPDecContext* context_;   // if not NULL, provides the memory chunks
 
   // Per macroblock non-persistent infos.
   int mb_x_, mb_y_;       // current position, in macroblock units
@@ -263,6 +309,17 @@ struct VP8Decoder {
   uint8_t* alpha_plane_;      // output. Persistent, contains the whole data.
   const uint8_t* alpha_prev_line_;  // last decoded alpha row (or NULL)
   int alpha_dithering_;       // derived from decoding options (0=off, 100=full)
+  // When multi-threaded, the alpha plane is decoded ahead of the emitted rows
+  // by this worker (see alpha.c).
+  int use_alpha_worker_;
+  WebPWorker alpha_worker_;
+  VP8Io alpha_io_;            // alpha decoding parameters of the worker
+  int alpha_row_;             // number of alpha rows available to the emitter
+  int alpha_job_row_;         // same, once the running job is completed
+
+  // Stage timings. Each field is only updated by one thread at a time, the
+  // segment and partition workers having their own (see VP8ExitCritical()).
+  WebPDecStageStats stats_;
 };
 
 //------------------------------------------------------------------------------
@@ -288,8 +345,8 @@ int VP8InitFrame(VP8Decoder* const dec, VP8Io* const io);
 // same parameters. Both functions should be used in pair. Returns VP8_STATUS_OK
 // if ok, otherwise sets and returns the error status on *dec.
 VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io);
-// Must always be called in pair with VP8EnterCritical().
-// Returns false in case of error.
+// Must always be called in pair with VP8EnterCritical(). Also merges the stage
+// timings of the workers into dec->stats_. Returns false in case of error.
 int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io);
 // Return the multi-threading method to use (0=off), depending
 // on options and bitstream size. Only for lossy decoding.
@@ -299,8 +356,21 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
 // Initialize dithering post-process if needed.
 void VP8InitDithering(const WebPDecoderOptions* const options,
                       VP8Decoder* const dec);
+// Set up the thumbnail decoding if requested by 'options'. Must be
+// called right after VP8GetHeaders(), as it updates the dimensions in 'io'.
+void VP8InitThumbnail(const WebPDecoderOptions* const options,
+                      VP8Decoder* const dec, VP8Io* const io);
 // Process the last decoded row (filtering + output).
 int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io);
+// For N-way decoding only: launch the next wavefront step if it doesn't need
+// the row being currently parsed. Returns false in case of error.
+int VP8ProcessTick(VP8Decoder* const dec, VP8Io* const io);
+// Stop and release the N-way decoding workers, if any.
+void VP8EndSegmentJobs(VP8Decoder* const dec);
+// Wait for the running jobs of all the workers, e.g. before the input moves.
+// The rows handed over so far are not necessarily emitted. Returns false in
+// case of error.
+int VP8SyncWorkers(VP8Decoder* const dec);
 // To be called at the start of a new scanline, to initialize predictors.
 void VP8InitScanline(VP8Decoder* const dec);
 // Decode one macroblock. Returns false if there is not enough data.
@@ -310,6 +380,13 @@ int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br);
 const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
                                       const VP8Io* const io,
                                       int row, int num_rows);
+// Set up the alpha decoder and start decoding the alpha plane in the alpha
+// worker. 'io' holds the alpha plane's parameters, and must be the same in
+// the calls to VP8DecompressAlphaRows(). Returns false in case of error.
+int VP8StartAlphaWorker(VP8Decoder* const dec, const VP8Io* const io);
+// Wait for the alpha worker's running job, if any. It must not be started
+// again by the emitter during this call.
+void VP8SyncAlphaWorker(VP8Decoder* const dec);
 
 //------------------------------------------------------------------------------
 
@@ -402,8 +402,9 @@ static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
     }
   }
 
-  huffman_tables = (HuffmanCode*)WebPSafeMalloc(num_htree_groups * table_size,
-                                                sizeof(*huffman_tables));
+  huffman_tables = (HuffmanCode*)WebPDecContextAlloc(
+      dec->context_, WEBP_DEC_MEM_HUFFMAN, num_htree_groups * table_size,
+      sizeof(*huffman_tables));
   htree_groups = VP8LHtreeGroupsNew(num_htree_groups);
   code_lengths = (int*)WebPSafeCalloc((uint64_t)max_alphabet_size,
                                       sizeof(*code_lengths));
@@ -476,7 +477,7 @@ static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
  Error:
   WebPSafeFree(code_lengths);
   WebPSafeFree(huffman_image);
-  WebPSafeFree(huffman_tables);
+  WebPDecContextFree(dec->context_, WEBP_DEC_MEM_HUFFMAN, huffman_tables);
   VP8LHtreeGroupsFree(htree_groups);
   return 0;
 }
@@ -490,14 +491,17 @@ static int AllocateAndInitRescaler(VP8LDecoder* const dec, VP8Io* const io) {
   const int out_width = io->scaled_width;
   const int in_height = io->mb_h;
   const int out_height = io->scaled_height;
-  const uint64_t work_size = 2 * num_channels * (uint64_t)out_width;
+  const uint64_t work_size =
+      WebPRescalerWorkSize(in_width, in_height, out_width, out_height,
+                           num_channels, io->rescaling_filter);
   rescaler_t* work;        // Rescaler work area.
   const uint64_t scaled_data_size = (uint64_t)out_width;
   uint32_t* scaled_data;  // Temporary storage for scaled BGRA data.
   const uint64_t memory_size = sizeof(*dec->rescaler) +
                                work_size * sizeof(*work) +
                                scaled_data_size * sizeof(*scaled_data);
-  uint8_t* memory = (uint8_t*)WebPSafeMalloc(memory_size, sizeof(*memory));
+  uint8_t* memory = (uint8_t*)WebPDecContextAlloc(
+      dec->context_, WEBP_DEC_MEM_RESCALER, memory_size, sizeof(*memory));
   if (memory == NULL) {
     dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
     return 0;
@@ -511,14 +515,24 @@ static int AllocateAndInitRescaler(VP8LDecoder* const dec, VP8Io* const io) {
   memory += work_size * sizeof(*work);
   scaled_data = (uint32_t*)memory;
 
-  WebPRescalerInit(dec->rescaler, in_width, in_height, (uint8_t*)scaled_data,
-                   out_width, out_height, 0, num_channels, work);
+  WebPRescalerInitFilter(dec->rescaler, in_width, in_height,
+                         (uint8_t*)scaled_data, out_width, out_height, 0,
+                         num_channels, io->rescaling_filter, work);
   return 1;
 }
 
 //------------------------------------------------------------------------------
 // Export to ARGB
 
+// Un-premultiplies the 'row' exported by 'rescaler'.
+static void UnmultiplyRow(const WebPRescaler* const rescaler,
+                          uint32_t* const row) {
+  if (rescaler->filter != WEBP_RESCALE_BOX) {
+    WebPClampToAlphaARGBRows((uint8_t*)row, 0, rescaler->dst_width, 1);
+  }
+  WebPMultARGBRow(row, rescaler->dst_width, 1);
+}
+
 // We have special "export" function since we need to convert from BGRA
 static int Export(WebPRescaler* const rescaler, WEBP_CSP_MODE colorspace,
                   int rgba_stride, uint8_t* const rgba) {
@@ -528,7 +542,7 @@ static int Export(WebPRescaler* const rescaler, WEBP_CSP_MODE colorspace,
   while (WebPRescalerHasPendingOutput(rescaler)) {
     uint8_t* const dst = rgba + num_lines_out * rgba_stride;
     WebPRescalerExportRow(rescaler);
-    WebPMultARGBRow(src, dst_width, 1);
+    UnmultiplyRow(rescaler, src);
     VP8LConvertFromBGRA(src, dst_width, colorspace, dst);
     ++num_lines_out;
   }
@@ -575,15 +589,29 @@ static int EmitRows(WEBP_CSP_MODE colorspace,
 //------------------------------------------------------------------------------
 // Export to YUVA
 
-static void ConvertToYUVA(const uint32_t* const src, int width, int y_pos,
-                          const WebPDecBuffer* const output) {
+// Returns the first output row held by 'dec->output_' (see WebPDecodeRows()).
+static WEBP_INLINE int BandY(const VP8LDecoder* const dec) {
+  return ((const WebPDecParams*)dec->io_->opaque)->band_y;
+}
+
+static void ConvertToYUVA(const VP8LDecoder* const dec,
+                          const uint32_t* const src, int width, int y_pos) {
+  const WebPDecBuffer* const output = dec->output_;
   const WebPYUVABuffer* const buf = &output->u.YUVA;
 
   // first, the luma plane
   WebPConvertARGBToY(src, buf->y + y_pos * buf->y_stride, width);
 
   // then U/V planes
-  {
+  if (WebPIsSemiPlanarMode(output->colorspace)) {
+    // The u/v rows are accumulated in dec->uv_cache_ the same way, and
+    // interleaved into the output every time.
+    const int uv_width = (width + 1) >> 1;
+    uint8_t* const u = dec->uv_cache_;
+    uint8_t* const v = dec->uv_cache_ + uv_width;
+    WebPConvertARGBToUV(src, u, v, width, !(y_pos & 1));
+    WebPStoreSemiPlanarUV(output, y_pos >> 1, u, v, uv_width);
+  } else {
     uint8_t* const u = buf->u + (y_pos >> 1) * buf->u_stride;
     uint8_t* const v = buf->v + (y_pos >> 1) * buf->v_stride;
     // even lines: store values
@@ -608,8 +636,8 @@ static int ExportYUVA(const VP8LDecoder* const dec, int y_pos) {
   int num_lines_out = 0;
   while (WebPRescalerHasPendingOutput(rescaler)) {
     WebPRescalerExportRow(rescaler);
-    WebPMultARGBRow(src, dst_width, 1);
-    ConvertToYUVA(src, dst_width, y_pos, dec->output_);
+    UnmultiplyRow(rescaler, src);
+    ConvertToYUVA(dec, src, dst_width, y_pos - BandY(dec));
     ++y_pos;
     ++num_lines_out;
   }
@@ -637,7 +665,7 @@ static int EmitRowsYUVA(const VP8LDecoder* const dec,
                         int mb_w, int num_rows) {
   int y_pos = dec->last_out_row_;
   while (num_rows-- > 0) {
-    ConvertToYUVA((const uint32_t*)in, mb_w, y_pos, dec->output_);
+    ConvertToYUVA(dec, (const uint32_t*)in, mb_w, y_pos - BandY(dec));
     in += in_stride;
     ++y_pos;
   }
@@ -715,10 +743,11 @@ static void ApplyInverseTransforms(VP8LDecoder* const dec, int num_rows,
 }
 
 // Processes (transforms, scales & color-converts) the rows decoded after the
-// last call.
-static void ProcessRows(VP8LDecoder* const dec, int row) {
+// last call. Returns false if the output was aborted.
+static int TransformAndEmitRows(VP8LDecoder* const dec, int row) {
   const uint32_t* const rows = dec->pixels_ + dec->width_ * dec->last_row_;
   const int num_rows = row - dec->last_row_;
+  int ok = 1;
 
   assert(row <= dec->io_->crop_bottom);
   // We can't process more than NUM_ARGB_CACHE_ROWS at a time (that's the size
@@ -728,15 +757,20 @@ static void ProcessRows(VP8LDecoder* const dec, int row) {
     VP8Io* const io = dec->io_;
     uint8_t* rows_data = (uint8_t*)dec->argb_cache_;
     const int in_stride = io->width * sizeof(uint32_t);  // in unit of RGBA
+    uint64_t start = WebPTimerStart();
 
     ApplyInverseTransforms(dec, num_rows, rows);
+    WebPTimerAdd(&dec->stats_.reconstruct_ns, start);
     if (!SetCropWindow(io, dec->last_row_, row, &rows_data, in_stride)) {
       // Nothing to output (this time).
     } else {
+      WebPDecParams* const params = (WebPDecParams*)io->opaque;
       const WebPDecBuffer* const output = dec->output_;
+      start = WebPTimerStart();
       if (WebPIsRGBMode(output->colorspace)) {  // convert to RGBA
         const WebPRGBABuffer* const buf = &output->u.RGBA;
-        uint8_t* const rgba = buf->rgba + dec->last_out_row_ * buf->stride;
+        uint8_t* const rgba =
+            buf->rgba + (dec->last_out_row_ - params->band_y) * buf->stride;
         const int num_rows_out = io->use_scaling ?
             EmitRescaledRowsRGBA(dec, rows_data, in_stride, io->mb_h,
                                  rgba, buf->stride) :
@@ -749,13 +783,70 @@ static void ProcessRows(VP8LDecoder* const dec, int row) {
             EmitRescaledRowsYUVA(dec, rows_data, in_stride, io->mb_h) :
             EmitRowsYUVA(dec, rows_data, in_stride, io->mb_w, io->mb_h);
       }
-      assert(dec->last_out_row_ <= output->height);
+      WebPTimerAdd(io->use_scaling ? &dec->stats_.rescale_ns
+                                   : &dec->stats_.convert_ns, start);
+      assert(dec->last_out_row_ - params->band_y <= output->height);
+      if (params->put_rows != NULL &&
+          !WebPEmitDecBand(params, dec->last_out_row_,
+                           (dec->last_out_row_ + 1) >> 1)) {
+        ok = 0;
+      }
     }
   }
 
   // Update 'last_row_'.
   dec->last_row_ = row;
   assert(dec->last_row_ <= dec->height_);
+  return ok;
+}
+
+static void ProcessRows(VP8LDecoder* const dec, int row) {
+  const uint64_t start = WebPTimerStart();
+  if (!TransformAndEmitRows(dec, row)) dec->status_ = VP8_STATUS_USER_ABORT;
+  WebPTimerAdd(&dec->process_ns_, start);
+}
+
+// Multi-threaded version of ProcessRows(): the worker owns 'last_row_',
+// 'last_out_row_', the cache, the rescaler and the output while it runs.
+static int ProcessRowsHook(VP8LDecoder* const dec, void* const unused) {
+  (void)unused;
+  return TransformAndEmitRows(dec, dec->worker_row_);
+}
+
+static void ProcessRowsMT(VP8LDecoder* const dec, int row) {
+  const WebPWorkerInterface* const winterface = WebPGetWorkerInterface();
+  const uint64_t start = WebPTimerStart();
+  // The previous rows must be output first.
+  if (!winterface->Sync(&dec->worker_)) {
+    dec->status_ = VP8_STATUS_USER_ABORT;
+  } else {
+    dec->worker_row_ = row;
+    winterface->Launch(&dec->worker_);
+  }
+  WebPTimerAdd(&dec->process_ns_, start);
+}
+
+// Multi-threading is worth it if there are several row batches to pipeline.
+static int InitThreads(VP8LDecoder* const dec,
+                       const WebPDecoderOptions* const options) {
+  dec->use_threads_ = 0;
+#if defined(WEBP_USE_THREAD)
+  if (options != NULL && options->use_threads &&
+      dec->height_ > NUM_ARGB_CACHE_ROWS) {
+    WebPWorker* const worker = &dec->worker_;
+    if (!WebPGetWorkerInterface()->Reset(worker)) {
+      dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
+      return 0;
+    }
+    worker->hook = (WebPWorkerHook)ProcessRowsHook;
+    worker->data1 = dec;
+    worker->data2 = NULL;
+    dec->use_threads_ = 1;
+  }
+#else
+  (void)options;
+#endif
+  return 1;
 }
 
 // Row-processing for the special case when alpha data contains only one
@@ -1107,6 +1198,7 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
         if (process_func != NULL) {
           if (row <= last_row && (row % NUM_ARGB_CACHE_ROWS == 0)) {
             process_func(dec, row);
+            if (dec->status_ == VP8_STATUS_USER_ABORT) return 0;
           }
         }
         if (color_cache != NULL) {
@@ -1137,6 +1229,7 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
         if (process_func != NULL) {
           if (row <= last_row && (row % NUM_ARGB_CACHE_ROWS == 0)) {
             process_func(dec, row);
+            if (dec->status_ == VP8_STATUS_USER_ABORT) return 0;
           }
         }
       }
@@ -1169,6 +1262,7 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
     // Process the remaining rows corresponding to last row-block.
     if (process_func != NULL) {
       process_func(dec, row > last_row ? last_row : row);
+      if (dec->status_ == VP8_STATUS_USER_ABORT) return 0;
     }
     dec->status_ = VP8_STATUS_OK;
     dec->last_pixel_ = (int)(src - data);  // end-of-scan marker
@@ -1279,11 +1373,11 @@ static void InitMetadata(VP8LMetadata* const hdr) {
   memset(hdr, 0, sizeof(*hdr));
 }
 
-static void ClearMetadata(VP8LMetadata* const hdr) {
-  assert(hdr != NULL);
+static void ClearMetadata(VP8LDecoder* const dec) {
+  VP8LMetadata* const hdr = &dec->hdr_;
 
   WebPSafeFree(hdr->huffman_image_);
-  WebPSafeFree(hdr->huffman_tables_);
+  WebPDecContextFree(dec->context_, WEBP_DEC_MEM_HUFFMAN, hdr->huffman_tables_);
   VP8LHtreeGroupsFree(hdr->htree_groups_);
   VP8LColorCacheClear(&hdr->color_cache_);
   VP8LColorCacheClear(&hdr->saved_color_cache_);
@@ -1298,6 +1392,7 @@ VP8LDecoder* VP8LNew(void) {
   if (dec == NULL) return NULL;
   dec->status_ = VP8_STATUS_OK;
   dec->state_ = READ_DIM;
+  WebPGetWorkerInterface()->Init(&dec->worker_);
 
   VP8LDspInit();  // Init critical function pointers.
 
@@ -1307,9 +1402,11 @@ VP8LDecoder* VP8LNew(void) {
 void VP8LClear(VP8LDecoder* const dec) {
   int i;
   if (dec == NULL) return;
-  ClearMetadata(&dec->hdr_);
+  WebPGetWorkerInterface()->End(&dec->worker_);  // before freeing its buffers
+  dec->use_threads_ = 0;
+  ClearMetadata(dec);
 
-  WebPSafeFree(dec->pixels_);
+  WebPDecContextFree(dec->context_, WEBP_DEC_MEM_PIXELS, dec->pixels_);
   dec->pixels_ = NULL;
   for (i = 0; i < dec->next_transform_; ++i) {
     ClearTransform(&dec->transforms_[i]);
@@ -1317,7 +1414,8 @@ void VP8LClear(VP8LDecoder* const dec) {
   dec->next_transform_ = 0;
   dec->transforms_seen_ = 0;
 
-  WebPSafeFree(dec->rescaler_memory);
+  WebPDecContextFree(dec->context_, WEBP_DEC_MEM_RESCALER,
+                     dec->rescaler_memory);
   dec->rescaler_memory = NULL;
 
   dec->output_ = NULL;   // leave no trace behind
@@ -1413,7 +1511,7 @@ static int DecodeImageStream(int xsize, int ysize,
  End:
   if (!ok) {
     WebPSafeFree(data);
-    ClearMetadata(hdr);
+    ClearMetadata(dec);
   } else {
     if (decoded_data != NULL) {
       *decoded_data = data;
@@ -1424,13 +1522,13 @@ static int DecodeImageStream(int xsize, int ysize,
       assert(is_level0);
     }
     dec->last_pixel_ = 0;  // Reset for future DECODE_DATA_FUNC() calls.
-    if (!is_level0) ClearMetadata(hdr);  // Clean up temporary data behind.
+    if (!is_level0) ClearMetadata(dec);  // Clean up temporary data behind.
   }
   return ok;
 }
 
 //------------------------------------------------------------------------------
-// Allocate internal buffers dec->pixels_ and dec->argb_cache_.
+// Allocate internal buffers dec->pixels_, dec->argb_cache_ and dec->uv_cache_.
 static int AllocateInternalBuffers32b(VP8LDecoder* const dec, int final_width) {
   const uint64_t num_pixels = (uint64_t)dec->width_ * dec->height_;
   // Scratch buffer corresponding to top-prediction row for transforming the
@@ -1438,24 +1536,31 @@ static int AllocateInternalBuffers32b(VP8LDecoder* const dec, int final_width) {
   const uint64_t cache_top_pixels = (uint16_t)final_width;
   // Scratch buffer for temporary BGRA storage. Not needed for paletted alpha.
   const uint64_t cache_pixels = (uint64_t)final_width * NUM_ARGB_CACHE_ROWS;
+  // Scratch u/v rows (2 * ((width + 1) / 2) bytes) for semi-planar output.
+  const uint64_t uv_cache_pixels =
+      (dec->output_ != NULL && WebPIsSemiPlanarMode(dec->output_->colorspace))
+          ? ((uint64_t)dec->output_->width + 4) / 4 : 0;
   const uint64_t total_num_pixels =
-      num_pixels + cache_top_pixels + cache_pixels;
+      num_pixels + cache_top_pixels + cache_pixels + uv_cache_pixels;
 
   assert(dec->width_ <= final_width);
-  dec->pixels_ = (uint32_t*)WebPSafeMalloc(total_num_pixels, sizeof(uint32_t));
+  dec->pixels_ = (uint32_t*)WebPDecContextAlloc(
+      dec->context_, WEBP_DEC_MEM_PIXELS, total_num_pixels, sizeof(uint32_t));
   if (dec->pixels_ == NULL) {
     dec->argb_cache_ = NULL;    // for sanity check
     dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
     return 0;
   }
   dec->argb_cache_ = dec->pixels_ + num_pixels + cache_top_pixels;
+  dec->uv_cache_ = (uint8_t*)(dec->argb_cache_ + cache_pixels);
   return 1;
 }
 
 static int AllocateInternalBuffers8b(VP8LDecoder* const dec) {
   const uint64_t total_num_pixels = (uint64_t)dec->width_ * dec->height_;
   dec->argb_cache_ = NULL;    // for sanity check
-  dec->pixels_ = (uint32_t*)WebPSafeMalloc(total_num_pixels, sizeof(uint8_t));
+  dec->pixels_ = (uint32_t*)WebPDecContextAlloc(
+      dec->context_, WEBP_DEC_MEM_PIXELS, total_num_pixels, sizeof(uint8_t));
   if (dec->pixels_ == NULL) {
     dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
     return 0;
@@ -1509,6 +1614,7 @@ int VP8LDecodeAlphaHeader(ALPHDecoder* const alph_dec,
   dec->height_ = alph_dec->height_;
   dec->io_ = &alph_dec->io_;
   dec->io_->opaque = alph_dec;
+  dec->context_ = alph_dec->context_;
   dec->io_->width = alph_dec->width_;
   dec->io_->height = alph_dec->height_;
 
@@ -1564,16 +1670,23 @@ int VP8LDecodeAlphaImageStream(ALPHDecoder* const alph_dec, int last_row) {
 
 int VP8LDecodeHeader(VP8LDecoder* const dec, VP8Io* const io) {
   int width, height, has_alpha;
+  uint64_t start;
 
   if (dec == NULL) return 0;
   if (io == NULL) {
     dec->status_ = VP8_STATUS_INVALID_PARAM;
     return 0;
   }
+  start = WebPTimerStart();
 
   dec->io_ = io;
   dec->status_ = VP8_STATUS_OK;
-  VP8LInitBitReader(&dec->br_, io->data, io->data_size);
+  if (dec->chain_ != NULL) {
+    VP8LInitBitReaderChain(&dec->br_, dec->chain_, dec->chain_start_,
+                           VP8_INPUT_CHAIN_END);
+  } else {
+    VP8LInitBitReader(&dec->br_, io->data, io->data_size);
+  }
   if (!ReadImageInfo(&dec->br_, &width, &height, &has_alpha)) {
     dec->status_ = VP8_STATUS_BITSTREAM_ERROR;
     goto Error;
@@ -1583,9 +1696,11 @@ int VP8LDecodeHeader(VP8LDecoder* const dec, VP8Io* const io) {
   io->height = height;
 
   if (!DecodeImageStream(width, height, 1, dec, NULL)) goto Error;
+  WebPTimerAdd(&dec->stats_.header_ns, start);
   return 1;
 
  Error:
+  WebPTimerAdd(&dec->stats_.header_ns, start);
   VP8LClear(dec);
   assert(dec->status_ != VP8_STATUS_OK);
   return 0;
@@ -1594,6 +1709,7 @@ int VP8LDecodeHeader(VP8LDecoder* const dec, VP8Io* const io) {
 int VP8LDecodeImage(VP8LDecoder* const dec) {
   VP8Io* io = NULL;
   WebPDecParams* params = NULL;
+  int ok;
 
   // Sanity checks.
   if (dec == NULL) return 0;
@@ -1621,12 +1737,15 @@ int VP8LDecodeImage(VP8LDecoder* const dec) {
 
     if (io->use_scaling && !AllocateAndInitRescaler(dec, io)) goto Err;
 
+    if (!InitThreads(dec, params->options)) goto Err;
+
     if (io->use_scaling || WebPIsPremultipliedMode(dec->output_->colorspace)) {
       // need the alpha-multiply functions for premultiplied output or rescaling
       WebPInitAlphaProcessing();
     }
     if (!WebPIsRGBMode(dec->output_->colorspace)) {
       WebPInitConvertARGBToYUV();
+      if (WebPIsSemiPlanarMode(dec->output_->colorspace)) WebPInitSamplers();
       if (dec->output_->u.YUVA.a != NULL) WebPInitAlphaProcessing();
     }
     if (dec->incremental_) {
@@ -1643,10 +1762,22 @@ int VP8LDecodeImage(VP8LDecoder* const dec) {
   }
 
   // Decode.
-  if (!DecodeImageData(dec, dec->pixels_, dec->width_, dec->height_,
-                       io->crop_bottom, ProcessRows)) {
-    goto Err;
+  {
+    const uint64_t start = WebPTimerStart();
+    const uint64_t process_ns = dec->process_ns_;
+    ok = DecodeImageData(dec, dec->pixels_, dec->width_, dec->height_,
+                         io->crop_bottom,
+                         dec->use_threads_ ? ProcessRowsMT : ProcessRows);
+    // Leave the row processing out.
+    WebPTimerAdd(&dec->stats_.tokens_ns,
+                 start + (dec->process_ns_ - process_ns));
+  }
+  // Wait for the last rows to be output.
+  if (dec->use_threads_ && !WebPGetWorkerInterface()->Sync(&dec->worker_)) {
+    if (ok) dec->status_ = VP8_STATUS_USER_ABORT;
+    ok = 0;
   }
+  if (!ok) goto Err;
 
   params->last_y = dec->last_out_row_;
   return 1;
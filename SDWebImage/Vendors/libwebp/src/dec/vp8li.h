@@ -20,6 +20,7 @@
 #include "../utils/bit_reader.h"
 #include "../utils/color_cache.h"
 #include "../utils/huffman.h"
+#include "../utils/thread.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -65,8 +66,11 @@ struct VP8LDecoder {
   uint32_t        *pixels_;        // Internal data: either uint8_t* for alpha
                                    // or uint32_t* for BGRA.
   uint32_t        *argb_cache_;    // Scratch buffer for temporary BGRA storage.
+  uint8_t         *uv_cache_;      // U/V rows for the semi-planar output.
 
   VP8LBitReader    br_;
+  const VP8InputChain* chain_;     // if not NULL, the input to read instead
+  size_t           chain_start_;   // of io->data, from this position.
   int              incremental_;   // if true, incremental decoding is expected
   VP8LBitReader    saved_br_;      // note: could be local variables too
   int              saved_last_pixel_;
@@ -88,6 +92,20 @@ struct VP8LDecoder {
 
   uint8_t         *rescaler_memory;  // Working memory for rescaling work.
   WebPRescaler    *rescaler;         // Common rescaler for all channels.
+
+  // When multi-threaded, the decoded rows are inverse-transformed and output
+  // by this worker, while the following rows are being decoded.
+  int              use_threads_;
+  WebPWorker       worker_;
+  int              worker_row_;    // last row to be processed by the worker
+
+  // Stage timings. The worker only updates the reconstruction and output
+  // fields. 'process_ns_' is the time spent by the decoding thread in the
+  // row-processing calls, and is excluded from 'stats_.tokens_ns'.
+  WebPDecStageStats stats_;
+  uint64_t         process_ns_;
+
+  WebPDecContext  *context_;       // if not NULL, provides the memory buffers
 };
 
 //------------------------------------------------------------------------------
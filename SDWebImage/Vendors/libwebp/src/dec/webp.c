@@ -444,13 +444,25 @@ void WebPResetDecParams(WebPDecParams* const params) {
 //------------------------------------------------------------------------------
 // "Into" decoding variants
 
+static VP8StatusCode AllocateOutput(int width, int height,
+                                    WebPDecParams* const params) {
+  return (params->put_rows != NULL)
+             ? WebPAllocateDecBand(width, height, params)
+             : WebPAllocateDecBuffer(width, height, params->options,
+                                     params->output);
+}
+
 // Main flow
-static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
-                                WebPDecParams* const params) {
+static VP8StatusCode DecodeIntoInternal(const uint8_t* const data,
+                                        size_t data_size,
+                                        WebPDecParams* const params) {
   VP8StatusCode status;
   VP8Io io;
   WebPHeaderStructure headers;
+  WebPDecStageStats stats;
+  const uint64_t start = WebPTimerStart();
 
+  memset(&stats, 0, sizeof(stats));
   headers.data = data;
   headers.data_size = data_size;
   headers.have_all_data = 1;
@@ -472,42 +484,47 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
     }
     dec->alpha_data_ = headers.alpha_data;
     dec->alpha_data_size_ = headers.alpha_data_size;
+    dec->context_ = params->context;
 
     // Decode bitstream header, update io->width/io->height.
     if (!VP8GetHeaders(dec, &io)) {
       status = dec->status_;   // An error occurred. Grab error status.
     } else {
+      VP8InitThumbnail(params->options, dec, &io);
       // Allocate/check output buffers.
-      status = WebPAllocateDecBuffer(io.width, io.height, params->options,
-                                     params->output);
+      status = AllocateOutput(io.width, io.height, params);
       if (status == VP8_STATUS_OK) {  // Decode
         // This change must be done before calling VP8Decode()
         dec->mt_method_ = VP8GetThreadMethod(params->options, &headers,
                                              io.width, io.height);
+        dec->num_threads_ =
+            (params->options != NULL) ? params->options->num_threads : 0;
         VP8InitDithering(params->options, dec);
         if (!VP8Decode(dec, &io)) {
           status = dec->status_;
         }
       }
     }
+    stats = dec->stats_;
     VP8Delete(dec);
   } else {
     VP8LDecoder* const dec = VP8LNew();
     if (dec == NULL) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
+    dec->context_ = params->context;
     if (!VP8LDecodeHeader(dec, &io)) {
       status = dec->status_;   // An error occurred. Grab error status.
     } else {
       // Allocate/check output buffers.
-      status = WebPAllocateDecBuffer(io.width, io.height, params->options,
-                                     params->output);
+      status = AllocateOutput(io.width, io.height, params);
       if (status == VP8_STATUS_OK) {  // Decode
         if (!VP8LDecodeImage(dec)) {
           status = dec->status_;
         }
       }
     }
+    stats = dec->stats_;
     VP8LDelete(dec);
   }
 
@@ -520,6 +537,32 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
       status = WebPFlipBuffer(params->output);
     }
   }
+  if (status == VP8_STATUS_OK &&
+      params->options != NULL && params->options->stage_stats != NULL) {
+    stats.bytes_in = data_size;
+    WebPTimerAdd(&stats.total_ns, start);
+    *params->options->stage_stats = stats;
+  }
+  return status;
+}
+
+// Runs the decoding under the memory policy of the options, if any.
+static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
+                                WebPDecParams* const params) {
+  const WebPMemoryPolicy* const policy =
+      (params->options != NULL) ? params->options->memory : NULL;
+  WebPMemoryScope scope;
+  VP8StatusCode status;
+
+  if (policy == NULL) return DecodeIntoInternal(data, data_size, params);
+  if (!WebPMemoryScopeBegin(&scope, policy)) {
+    return VP8_STATUS_UNSUPPORTED_FEATURE;
+  }
+  status = DecodeIntoInternal(data, data_size, params);
+  if (status != VP8_STATUS_OK && scope.budget_exceeded_) {
+    status = VP8_STATUS_MEMORY_BUDGET_EXCEEDED;
+  }
+  WebPMemoryScopeEnd(&scope);
   return status;
 }
 
@@ -600,6 +643,53 @@ uint8_t* WebPDecodeYUVInto(const uint8_t* data, size_t data_size,
   return luma;
 }
 
+static uint8_t* DecodeIntoSemiPlanarBuffer(WEBP_CSP_MODE colorspace,
+                                           const uint8_t* const data,
+                                           size_t data_size,
+                                           uint8_t* const luma,
+                                           size_t luma_size, int luma_stride,
+                                           uint8_t* const uv,
+                                           size_t uv_size, int uv_stride) {
+  WebPDecParams params;
+  WebPDecBuffer output;
+  const int u_first = (colorspace == MODE_NV12);
+  if (luma == NULL || uv == NULL || uv_size < 2) return NULL;
+  WebPInitDecBuffer(&output);
+  WebPResetDecParams(&params);
+  params.output = &output;
+  output.colorspace      = colorspace;
+  output.u.YUVA.y        = luma;
+  output.u.YUVA.y_stride = luma_stride;
+  output.u.YUVA.y_size   = luma_size;
+  output.u.YUVA.u        = uv + (u_first ? 0 : 1);
+  output.u.YUVA.u_stride = uv_stride;
+  output.u.YUVA.u_size   = uv_size - (u_first ? 0 : 1);
+  output.u.YUVA.v        = uv + (u_first ? 1 : 0);
+  output.u.YUVA.v_stride = uv_stride;
+  output.u.YUVA.v_size   = uv_size - (u_first ? 1 : 0);
+  output.is_external_memory = 1;
+  if (DecodeInto(data, data_size, &params) != VP8_STATUS_OK) {
+    return NULL;
+  }
+  return luma;
+}
+
+uint8_t* WebPDecodeNV12Into(const uint8_t* data, size_t data_size,
+                            uint8_t* luma, size_t luma_size, int luma_stride,
+                            uint8_t* uv, size_t uv_size, int uv_stride) {
+  return DecodeIntoSemiPlanarBuffer(MODE_NV12, data, data_size,
+                                    luma, luma_size, luma_stride,
+                                    uv, uv_size, uv_stride);
+}
+
+uint8_t* WebPDecodeNV21Into(const uint8_t* data, size_t data_size,
+                            uint8_t* luma, size_t luma_size, int luma_stride,
+                            uint8_t* uv, size_t uv_size, int uv_stride) {
+  return DecodeIntoSemiPlanarBuffer(MODE_NV21, data, data_size,
+                                    luma, luma_size, luma_stride,
+                                    uv, uv_size, uv_stride);
+}
+
 //------------------------------------------------------------------------------
 
 static uint8_t* Decode(WEBP_CSP_MODE mode, const uint8_t* const data,
@@ -743,8 +833,53 @@ VP8StatusCode WebPGetFeaturesInternal(const uint8_t* data, size_t data_size,
   return GetFeatures(data, data_size, features);
 }
 
-VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
-                         WebPDecoderConfig* config) {
+//------------------------------------------------------------------------------
+// Reusable decoding context
+
+struct WebPDecContext {
+  void* mem_[WEBP_DEC_MEM_NUM];        // scratch buffers
+  size_t mem_size_[WEBP_DEC_MEM_NUM];  // and their size
+};
+
+void* WebPDecContextAlloc(WebPDecContext* const context, WebPDecMemSlot slot,
+                          uint64_t nmemb, size_t size) {
+  const uint64_t total_size = nmemb * size;
+  if (context == NULL) return WebPSafeMalloc(nmemb, size);
+  assert(slot < WEBP_DEC_MEM_NUM);
+  if (total_size > context->mem_size_[slot]) {
+    WebPSafeFree(context->mem_[slot]);
+    context->mem_size_[slot] = 0;
+    // the slot outlives the call, so it must not come from a memory policy.
+    context->mem_[slot] = WebPSafeMallocPersistent(nmemb, size);
+    if (context->mem_[slot] == NULL) return NULL;
+    // down-cast is ok, thanks to WebPSafeMallocPersistent() above.
+    context->mem_size_[slot] = (size_t)total_size;
+  }
+  return context->mem_[slot];
+}
+
+void WebPDecContextFree(WebPDecContext* const context, WebPDecMemSlot slot,
+                        void* ptr) {
+  if (context == NULL || ptr != context->mem_[slot]) WebPSafeFree(ptr);
+}
+
+WebPDecContext* WebPDecContextNew(void) {
+  return (WebPDecContext*)WebPSafeCalloc(1ULL, sizeof(WebPDecContext));
+}
+
+void WebPDecContextDelete(WebPDecContext* context) {
+  if (context != NULL) {
+    int i;
+    for (i = 0; i < WEBP_DEC_MEM_NUM; ++i) WebPSafeFree(context->mem_[i]);
+    WebPSafeFree(context);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+VP8StatusCode WebPDecodeWithContext(WebPDecContext* context,
+                                    const uint8_t* data, size_t data_size,
+                                    WebPDecoderConfig* config) {
   WebPDecParams params;
   VP8StatusCode status;
 
@@ -763,6 +898,7 @@ VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
   WebPResetDecParams(&params);
   params.options = &config->options;
   params.output = &config->output;
+  params.context = context;
   if (WebPAvoidSlowMemory(params.output, &config->input)) {
     // decoding to slow memory: use a temporary in-mem buffer to decode into.
     WebPDecBuffer in_mem_buffer;
@@ -783,6 +919,45 @@ VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
   return status;
 }
 
+VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
+                         WebPDecoderConfig* config) {
+  return WebPDecodeWithContext(NULL, data, data_size, config);
+}
+
+VP8StatusCode WebPDecodeRows(const uint8_t* data, size_t data_size,
+                             WebPDecoderConfig* config,
+                             WebPRowCallback put, void* user_data) {
+  WebPDecParams params;
+  WebPDecBuffer band;
+  VP8StatusCode status;
+
+  if (config == NULL || put == NULL ||
+      config->output.is_external_memory > 0) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+
+  status = GetFeatures(data, data_size, &config->input);
+  if (status != VP8_STATUS_OK) {
+    if (status == VP8_STATUS_NOT_ENOUGH_DATA) {
+      return VP8_STATUS_BITSTREAM_ERROR;  // Not-enough-data treated as error.
+    }
+    return status;
+  }
+
+  WebPInitDecBuffer(&band);
+  band.colorspace = config->output.colorspace;
+  WebPResetDecParams(&params);
+  params.options = &config->options;
+  params.output = &band;
+  params.put_rows = put;
+  params.put_rows_data = user_data;
+  status = DecodeInto(data, data_size, &params);
+  config->output.width = band.width;
+  config->output.height = params.band_last_y;
+  WebPFreeDecBuffer(&band);
+  return status;
+}
+
 //------------------------------------------------------------------------------
 // Cropping and rescaling.
 
@@ -824,6 +999,11 @@ int WebPIoInitFromOptions(const WebPDecoderOptions* const options,
     }
     io->scaled_width = scaled_width;
     io->scaled_height = scaled_height;
+    if (options->rescaling_filter != WEBP_RESCALE_BOX &&
+        options->rescaling_filter != WEBP_RESCALE_LANCZOS3) {
+      return 0;
+    }
+    io->rescaling_filter = options->rescaling_filter;
   }
 
   // Filter
@@ -25,6 +25,7 @@ extern "C" {
 // WebPDecParams: Decoding output parameters. Transient internal object.
 
 typedef struct WebPDecParams WebPDecParams;
+typedef struct WebPDecStrip WebPDecStrip;   // see io.c
 typedef int (*OutputFunc)(const VP8Io* const io, WebPDecParams* const p);
 typedef int (*OutputAlphaFunc)(const VP8Io* const io, WebPDecParams* const p,
                                int expected_num_out_lines);
@@ -41,6 +42,8 @@ struct WebPDecParams {
   // rescalers
   WebPRescaler scaler_y, scaler_u, scaler_v, scaler_a;
   void* memory;                  // overall scratch memory for the output work.
+  int num_strips;                // if > 0, the rescaled output is split into
+  WebPDecStrip* strips;          // column strips rescaled in parallel
 
   OutputFunc emit;               // output RGB or YUV samples
   OutputAlphaFunc emit_alpha;    // output alpha channel
@@ -51,6 +54,15 @@ struct WebPDecParams {
                                  // (this::output) and copy it here.
   WebPDecBuffer tmp_buffer;      // this::output will point to this one in case
                                  // of slow memory.
+
+  // Band output (see WebPDecodeRows()): if 'put_rows' is not NULL, 'output'
+  // only holds the rows [band_y, band_y + output->height) of the picture.
+  WebPRowCallback put_rows;
+  void* put_rows_data;
+  int band_y;                    // first picture row stored in 'output'
+  int band_last_y;               // height of the whole output picture
+
+  WebPDecContext* context;       // if not NULL, provides the scratch memory
 };
 
 // Should be called first, before any use of the WebPDecParams object.
@@ -59,6 +71,32 @@ void WebPResetDecParams(WebPDecParams* const params);
 // Delete all memory (after an error occurred, for instance)
 void WebPFreeDecParams(WebPDecParams* const params);
 
+//------------------------------------------------------------------------------
+// Reusable decoding memory (see WebPDecodeWithContext())
+
+// The scratch buffers a WebPDecContext keeps from one decoding to the next.
+// At most one buffer per slot is in use at any time.
+typedef enum {
+  WEBP_DEC_MEM_VP8 = 0,     // VP8Decoder::mem_
+  WEBP_DEC_MEM_ALPHA,       // VP8Decoder::alpha_plane_mem_
+  WEBP_DEC_MEM_IO,          // WebPDecParams::memory
+  WEBP_DEC_MEM_PIXELS,      // VP8LDecoder::pixels_
+  WEBP_DEC_MEM_HUFFMAN,     // VP8LMetadata::huffman_tables_
+  WEBP_DEC_MEM_RESCALER,    // VP8LDecoder::rescaler_memory
+  WEBP_DEC_MEM_NUM
+} WebPDecMemSlot;
+
+// Returns 'nmemb * size' bytes of uninitialized memory. If 'context' is not
+// NULL, the buffer of 'slot' is returned, after being grown if needed.
+// Otherwise, this is equivalent to WebPSafeMalloc().
+void* WebPDecContextAlloc(WebPDecContext* const context, WebPDecMemSlot slot,
+                          uint64_t nmemb, size_t size);
+
+// Releases memory returned by WebPDecContextAlloc(). The buffers belonging to
+// 'context' are kept for later use.
+void WebPDecContextFree(WebPDecContext* const context, WebPDecMemSlot slot,
+                        void* ptr);
+
 //------------------------------------------------------------------------------
 // Header parsing helpers
 
@@ -115,6 +153,25 @@ VP8StatusCode WebPAllocateDecBuffer(int width, int height,
 // Flip buffer vertically by negating the various strides.
 VP8StatusCode WebPFlipBuffer(WebPDecBuffer* const buffer);
 
+// Allocates 'params->output' to hold a band of the (cropped and scaled)
+// output picture, for use with 'params->put_rows'.
+VP8StatusCode WebPAllocateDecBand(int width, int height,
+                                  WebPDecParams* const params);
+
+// Delivers the output rows that are complete to 'params->put_rows', given that
+// the rows up to 'num_rows' (and the chroma rows up to 'num_uv_rows') have
+// been written, and moves the remaining ones on top of the band.
+// Returns false if the callback requested to abort.
+int WebPEmitDecBand(WebPDecParams* const params, int num_rows,
+                    int num_uv_rows);
+
+// Writes the 'len' samples of the 'u' and 'v' rows, interleaved, as the chroma
+// row 'uv_y' of the semi-planar (MODE_NV12 or MODE_NV21) 'buffer'.
+// WebPInitSamplers() must have been called.
+void WebPStoreSemiPlanarUV(const WebPDecBuffer* const buffer, int uv_y,
+                           const uint8_t* const u, const uint8_t* const v,
+                           int len);
+
 // Copy 'src' into 'dst' buffer, making sure 'dst' is not marked as owner of the
 // memory (still held by 'src'). No pixels are copied.
 void WebPCopyDecBuffer(const WebPDecBuffer* const src,
@@ -201,6 +201,38 @@ void WebPMultRows(uint8_t* ptr, int stride,
   }
 }
 
+void WebPClampToAlphaARGBRows(uint8_t* ptr, int stride, int width,
+                              int num_rows) {
+  int n, x;
+  for (n = 0; n < num_rows; ++n) {
+    uint32_t* const argb = (uint32_t*)ptr;
+    for (x = 0; x < width; ++x) {
+      const uint32_t alpha = argb[x] >> 24;
+      uint32_t out = argb[x] & 0xff000000u;
+      int shift;
+      for (shift = 0; shift < 24; shift += 8) {
+        const uint32_t v = (argb[x] >> shift) & 0xff;
+        out |= ((v > alpha) ? alpha : v) << shift;
+      }
+      argb[x] = out;
+    }
+    ptr += stride;
+  }
+}
+
+void WebPClampToAlphaRows(uint8_t* ptr, int stride,
+                          const uint8_t* alpha, int alpha_stride,
+                          int width, int num_rows) {
+  int n, x;
+  for (n = 0; n < num_rows; ++n) {
+    for (x = 0; x < width; ++x) {
+      if (ptr[x] > alpha[x]) ptr[x] = alpha[x];
+    }
+    ptr += stride;
+    alpha += alpha_stride;
+  }
+}
+
 //------------------------------------------------------------------------------
 // Premultiplied modes
 
@@ -13,9 +13,11 @@
 
 #include "./dsp.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #if defined(WEBP_HAVE_NEON_RTCD)
 #include <stdio.h>
-#include <string.h>
 #endif
 
 #if defined(WEBP_ANDROID_NEON)
@@ -131,7 +133,7 @@ static int x86CPUInfo(CPUFeature feature) {
   }
   return 0;
 }
-VP8CPUInfo VP8GetCPUInfo = x86CPUInfo;
+#define CPU_INFO_DETECT x86CPUInfo
 #elif defined(WEBP_ANDROID_NEON)  // NB: needs to be before generic NEON test.
 static int AndroidCPUInfo(CPUFeature feature) {
   const AndroidCpuFamily cpu_family = android_getCpuFamily();
@@ -142,7 +144,7 @@ static int AndroidCPUInfo(CPUFeature feature) {
   }
   return 0;
 }
-VP8CPUInfo VP8GetCPUInfo = AndroidCPUInfo;
+#define CPU_INFO_DETECT AndroidCPUInfo
 #elif defined(WEBP_USE_NEON)
 // define a dummy function to enable turning off NEON at runtime by setting
 // VP8DecGetCPUInfo = NULL
@@ -169,7 +171,7 @@ static int armCPUInfo(CPUFeature feature) {
   return 1;
 #endif
 }
-VP8CPUInfo VP8GetCPUInfo = armCPUInfo;
+#define CPU_INFO_DETECT armCPUInfo
 #elif defined(WEBP_USE_MIPS32) || defined(WEBP_USE_MIPS_DSP_R2) || \
       defined(WEBP_USE_MSA)
 static int mipsCPUInfo(CPUFeature feature) {
@@ -180,7 +182,56 @@ static int mipsCPUInfo(CPUFeature feature) {
   }
 
 }
-VP8CPUInfo VP8GetCPUInfo = mipsCPUInfo;
+#define CPU_INFO_DETECT mipsCPUInfo
+#endif
+
+//------------------------------------------------------------------------------
+// Run-time override.
+//
+// The WEBP_MAX_ISA environment variable restricts the optimized code to the
+// instruction sets up to the given level, among the ones the CPU supports:
+// "c" (no SIMD), "sse2", "sse3", "sse4.1", "avx", "avx2", "neon", "mips32",
+// "mips_dsp_r2" and "msa". Other values are ignored. It is read each time the
+// DSP functions are initialized, which only happens once per process.
+
+#if defined(CPU_INFO_DETECT)
+#define FEATURE(f) (1u << (f))
+
+static const struct {
+  const char* name;
+  uint32_t features;
+} kISALevels[] = {
+  { "c", 0 },
+  { "sse2", FEATURE(kSSE2) },
+  { "sse3", FEATURE(kSSE2) | FEATURE(kSSE3) },
+  { "sse4.1", FEATURE(kSSE2) | FEATURE(kSSE3) | FEATURE(kSSE4_1) },
+  { "avx", FEATURE(kSSE2) | FEATURE(kSSE3) | FEATURE(kSSE4_1) |
+           FEATURE(kAVX) },
+  { "avx2", FEATURE(kSSE2) | FEATURE(kSSE3) | FEATURE(kSSE4_1) |
+            FEATURE(kAVX) | FEATURE(kAVX2) },
+  { "neon", FEATURE(kNEON) },
+  { "mips32", FEATURE(kMIPS32) },
+  { "mips_dsp_r2", FEATURE(kMIPS32) | FEATURE(kMIPSdspR2) },
+  { "msa", FEATURE(kMIPS32) | FEATURE(kMSA) }
+};
+
+static int IsAllowedFeature(CPUFeature feature) {
+  const char* const level = getenv("WEBP_MAX_ISA");
+  size_t i;
+  if (level == NULL) return 1;
+  for (i = 0; i < sizeof(kISALevels) / sizeof(kISALevels[0]); ++i) {
+    if (!strcmp(level, kISALevels[i].name)) {
+      return (kISALevels[i].features & FEATURE(feature)) != 0;
+    }
+  }
+  return 1;
+}
+#undef FEATURE
+
+static int CappedCPUInfo(CPUFeature feature) {
+  return IsAllowedFeature(feature) && CPU_INFO_DETECT(feature);
+}
+VP8CPUInfo VP8GetCPUInfo = CappedCPUInfo;
 #else
 VP8CPUInfo VP8GetCPUInfo = NULL;
 #endif
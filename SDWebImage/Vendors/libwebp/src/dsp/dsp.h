@@ -179,6 +179,8 @@ extern VP8IntraPreds VP8EncPredChroma8;
 
 typedef int (*VP8Metric)(const uint8_t* pix, const uint8_t* ref);
 extern VP8Metric VP8SSE16x16, VP8SSE16x8, VP8SSE8x8, VP8SSE4x4;
+// Sums of absolute differences, used by the realtime mode decision.
+extern VP8Metric VP8SAD16x16, VP8SAD16x8;
 typedef int (*VP8WMetric)(const uint8_t* pix, const uint8_t* ref,
                           const uint16_t* const weights);
 // The weights for VP8TDisto4x4 and VP8TDisto16x16 contain a row-major
@@ -358,6 +360,24 @@ extern WebPUpsampleLinePairFunc WebPUpsamplers[/* MODE_LAST */];
 
 #endif    // FANCY_UPSAMPLING
 
+// Same as WebPUpsampleLinePairFunc, with the alpha rows 'top_a' and
+// 'bottom_a' being multiplied into the output in the same pass.
+typedef void (*WebPUpsampleAlphaLinePairFunc)(
+    const uint8_t* top_y, const uint8_t* bottom_y,
+    const uint8_t* top_u, const uint8_t* top_v,
+    const uint8_t* cur_u, const uint8_t* cur_v,
+    const uint8_t* top_a, const uint8_t* bottom_a,
+    uint8_t* top_dst, uint8_t* bottom_dst, int len);
+
+#ifdef FANCY_UPSAMPLING
+
+// Fancy upsampling functions to convert YUV+A to the premultiplied modes
+// (rgbA, bgrA, Argb and rgbA_4444). Other entries are NULL.
+extern WebPUpsampleAlphaLinePairFunc
+    WebPUpsamplersPremultiplied[/* MODE_LAST */];
+
+#endif    // FANCY_UPSAMPLING
+
 // Per-row point-sampling methods.
 typedef void (*WebPSamplerRowFunc)(const uint8_t* y,
                                    const uint8_t* u, const uint8_t* v,
@@ -371,6 +391,22 @@ void WebPSamplerProcessPlane(const uint8_t* y, int y_stride,
 // Sampling functions to convert rows of YUV to RGB(A)
 extern WebPSamplerRowFunc WebPSamplers[/* MODE_LAST */];
 
+// Same as WebPSamplerRowFunc, with the alpha row 'a' being multiplied into the
+// output in the same pass.
+typedef void (*WebPSamplerAlphaRowFunc)(const uint8_t* y,
+                                        const uint8_t* u, const uint8_t* v,
+                                        const uint8_t* a,
+                                        uint8_t* dst, int len);
+
+// Sampling functions to convert rows of YUV+A to the premultiplied modes.
+// Other entries are NULL.
+extern WebPSamplerAlphaRowFunc WebPSamplersPremultiplied[/* MODE_LAST */];
+
+// Interleaves the 'len' samples of 'first' and 'second' into 'dst', as
+// first[0], second[0], first[1], second[1]... (semi-planar chroma rows).
+extern void (*WebPInterleaveUV)(const uint8_t* first, const uint8_t* second,
+                                uint8_t* dst, int len);
+
 // General function for converting two lines of ARGB or RGBA.
 // 'alpha_is_last' should be true if 0xff000000 is stored in memory as
 // as 0x00, 0x00, 0x00, 0xff (little endian).
@@ -383,10 +419,12 @@ typedef void (*WebPYUV444Converter)(const uint8_t* y,
 
 extern WebPYUV444Converter WebPYUV444Converters[/* MODE_LAST */];
 
-// Must be called before using the WebPUpsamplers[] (and for premultiplied
-// colorspaces like rgbA, rgbA4444, etc)
+// Must be called before using the WebPUpsamplers[] and
+// WebPUpsamplersPremultiplied[] (and for premultiplied colorspaces like rgbA,
+// rgbA4444, etc)
 void WebPInitUpsamplers(void);
-// Must be called before using WebPSamplers[]
+// Must be called before using WebPSamplers[], WebPSamplersPremultiplied[] and
+// WebPInterleaveUV()
 void WebPInitSamplers(void);
 // Must be called before using WebPYUV444Converters[]
 void WebPInitYUV444Converters(void);
@@ -507,6 +545,14 @@ void WebPMultRows(uint8_t* ptr, int stride,
                   const uint8_t* alpha, int alpha_stride,
                   int width, int num_rows, int inverse);
 
+// Clamps premultiplied values to their alpha, which rescaling filters with
+// negative lobes can exceed. To be called before un-multiplying.
+void WebPClampToAlphaARGBRows(uint8_t* ptr, int stride, int width,
+                              int num_rows);
+void WebPClampToAlphaRows(uint8_t* ptr, int stride,
+                          const uint8_t* alpha, int alpha_stride,
+                          int width, int num_rows);
+
 // Plain-C versions, used as fallback by some implementations.
 void WebPMultRowC(uint8_t* const ptr, const uint8_t* const alpha,
                   int width, int inverse);
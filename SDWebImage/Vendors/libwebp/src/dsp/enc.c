@@ -551,6 +551,27 @@ static int SSE4x4(const uint8_t* a, const uint8_t* b) {
   return GetSSE(a, b, 4, 4);
 }
 
+static WEBP_INLINE int GetSAD(const uint8_t* a, const uint8_t* b,
+                              int w, int h) {
+  int count = 0;
+  int y, x;
+  for (y = 0; y < h; ++y) {
+    for (x = 0; x < w; ++x) {
+      count += abs((int)a[x] - b[x]);
+    }
+    a += BPS;
+    b += BPS;
+  }
+  return count;
+}
+
+static int SAD16x16(const uint8_t* a, const uint8_t* b) {
+  return GetSAD(a, b, 16, 16);
+}
+static int SAD16x8(const uint8_t* a, const uint8_t* b) {
+  return GetSAD(a, b, 16, 8);
+}
+
 //------------------------------------------------------------------------------
 // Texture distortion
 //
@@ -781,6 +802,8 @@ VP8Metric VP8SSE16x16;
 VP8Metric VP8SSE8x8;
 VP8Metric VP8SSE16x8;
 VP8Metric VP8SSE4x4;
+VP8Metric VP8SAD16x16;
+VP8Metric VP8SAD16x8;
 VP8WMetric VP8TDisto4x4;
 VP8WMetric VP8TDisto16x16;
 VP8QuantizeBlock VP8EncQuantizeBlock;
@@ -818,6 +841,8 @@ WEBP_TSAN_IGNORE_FUNCTION void VP8EncDspInit(void) {
   VP8SSE8x8 = SSE8x8;
   VP8SSE16x8 = SSE16x8;
   VP8SSE4x4 = SSE4x4;
+  VP8SAD16x16 = SAD16x16;
+  VP8SAD16x8 = SAD16x8;
   VP8TDisto4x4 = Disto4x4;
   VP8TDisto16x16 = Disto16x16;
   VP8EncQuantizeBlock = QuantizeBlock;
@@ -7,15 +7,652 @@
 // be found in the AUTHORS file in the root of the source tree.
 // -----------------------------------------------------------------------------
 //
-// AVX2 version of speed-critical encoding functions.
+// AVX2 version of speed-critical encoding functions: forward transform and
+// quantization of block pairs, SSE metrics, 16x16 texture distortion,
+// histogram collection and the 16x16 / chroma intra predictions. The other
+// ones (inverse transform, single-block transform, quantization and
+// distortion, 4x4 metric and predictions) are faster in their SSE2 or SSE4.1
+// versions.
+// All the functions are bit-exact with their SSE2 and plain-C counterparts.
 
 #include "./dsp.h"
 
 #if defined(WEBP_USE_AVX2)
 
-#endif  // WEBP_USE_AVX2
+#include <immintrin.h>
+#include <string.h>
+#include "./common_sse2.h"
+#include "../enc/vp8enci.h"
+#include "../utils/utils.h"
+
+// Returns the [lo|hi] 256-bit register made of the two 128-bit halves.
+static WEBP_INLINE __m256i Pair(const __m128i lo, const __m128i hi) {
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+static WEBP_INLINE __m128i LoHalf(const __m256i x) {
+  return _mm256_castsi256_si128(x);
+}
+
+static WEBP_INLINE __m128i HiHalf(const __m256i x) {
+  return _mm256_extracti128_si256(x, 1);
+}
+
+// Returns the sum of the eight 32b values of 'x'.
+static WEBP_INLINE int HorizontalSum32(const __m256i x) {
+  const __m128i sum4 = _mm_add_epi32(LoHalf(x), HiHalf(x));
+  const __m128i sum2 =
+      _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, _MM_SHUFFLE(1, 0, 3, 2)));
+  const __m128i sum1 =
+      _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum1);
+}
+
+//------------------------------------------------------------------------------
+// Forward transform (Paragraph 14.4)
+
+// Two horizontally adjacent 4x4 blocks are transformed at once: each half of
+// the 256-bit registers goes through exactly the same operations as
+// FTransformPass1() and FTransformPass2() in enc_sse2.c, the low half for the
+// left block and the high half for the right one.
+
+// Loads two rows of src - ref as 16b, interleaved the way FTransformPass1()
+// expects them: 00 01 10 11 02 03 12 13 | 00' 01' 10' 11' 02' 03' 12' 13'.
+// If 'do_two' is false, only the left block is loaded and the high half is
+// zero.
+static WEBP_INLINE __m256i LoadDiffRows(const uint8_t* const src,
+                                        const uint8_t* const ref, int do_two) {
+  __m128i src0, src1, ref0, ref1;
+  if (do_two) {
+    src0 = _mm_loadl_epi64((const __m128i*)&src[0 * BPS]);
+    src1 = _mm_loadl_epi64((const __m128i*)&src[1 * BPS]);
+    ref0 = _mm_loadl_epi64((const __m128i*)&ref[0 * BPS]);
+    ref1 = _mm_loadl_epi64((const __m128i*)&ref[1 * BPS]);
+  } else {
+    src0 = _mm_cvtsi32_si128(WebPMemToUint32(&src[0 * BPS]));
+    src1 = _mm_cvtsi32_si128(WebPMemToUint32(&src[1 * BPS]));
+    ref0 = _mm_cvtsi32_si128(WebPMemToUint32(&ref[0 * BPS]));
+    ref1 = _mm_cvtsi32_si128(WebPMemToUint32(&ref[1 * BPS]));
+  }
+  {
+    const __m256i src_16b =
+        _mm256_cvtepu8_epi16(_mm_unpacklo_epi16(src0, src1));
+    const __m256i ref_16b =
+        _mm256_cvtepu8_epi16(_mm_unpacklo_epi16(ref0, ref1));
+    return _mm256_sub_epi16(src_16b, ref_16b);
+  }
+}
+
+static WEBP_INLINE void FTransformPass1(const __m256i* const in01,
+                                        const __m256i* const in23,
+                                        __m256i* const out01,
+                                        __m256i* const out32) {
+  const __m256i k937 = _mm256_set1_epi32(937);
+  const __m256i k1812 = _mm256_set1_epi32(1812);
+  const __m256i k88p = _mm256_set1_epi16(8);
+  const __m256i k88m = _mm256_broadcastsi128_si256(
+      _mm_set_epi16(-8, 8, -8, 8, -8, 8, -8, 8));
+  const __m256i k5352_2217p = _mm256_broadcastsi128_si256(
+      _mm_set_epi16(2217, 5352, 2217, 5352, 2217, 5352, 2217, 5352));
+  const __m256i k5352_2217m = _mm256_broadcastsi128_si256(
+      _mm_set_epi16(-5352, 2217, -5352, 2217, -5352, 2217, -5352, 2217));
+
+  const __m256i shuf01_p =
+      _mm256_shufflehi_epi16(*in01, _MM_SHUFFLE(2, 3, 0, 1));
+  const __m256i shuf23_p =
+      _mm256_shufflehi_epi16(*in23, _MM_SHUFFLE(2, 3, 0, 1));
+  // 00 01 10 11 03 02 13 12
+  // 20 21 30 31 23 22 33 32
+  const __m256i s01 = _mm256_unpacklo_epi64(shuf01_p, shuf23_p);
+  const __m256i s32 = _mm256_unpackhi_epi64(shuf01_p, shuf23_p);
+  // 00 01 10 11 20 21 30 31
+  // 03 02 13 12 23 22 33 32
+  const __m256i a01 = _mm256_add_epi16(s01, s32);
+  const __m256i a32 = _mm256_sub_epi16(s01, s32);
+
+  const __m256i tmp0   = _mm256_madd_epi16(a01, k88p);
+  const __m256i tmp2   = _mm256_madd_epi16(a01, k88m);
+  const __m256i tmp1_1 = _mm256_madd_epi16(a32, k5352_2217p);
+  const __m256i tmp3_1 = _mm256_madd_epi16(a32, k5352_2217m);
+  const __m256i tmp1_2 = _mm256_add_epi32(tmp1_1, k1812);
+  const __m256i tmp3_2 = _mm256_add_epi32(tmp3_1, k937);
+  const __m256i tmp1   = _mm256_srai_epi32(tmp1_2, 9);
+  const __m256i tmp3   = _mm256_srai_epi32(tmp3_2, 9);
+  const __m256i s03    = _mm256_packs_epi32(tmp0, tmp2);
+  const __m256i s12    = _mm256_packs_epi32(tmp1, tmp3);
+  const __m256i s_lo   = _mm256_unpacklo_epi16(s03, s12);   // 0 1 0 1 0 1...
+  const __m256i s_hi   = _mm256_unpackhi_epi16(s03, s12);   // 2 3 2 3 2 3
+  const __m256i v23    = _mm256_unpackhi_epi32(s_lo, s_hi);
+  *out01 = _mm256_unpacklo_epi32(s_lo, s_hi);
+  *out32 = _mm256_shuffle_epi32(v23, _MM_SHUFFLE(1, 0, 3, 2));  // 3 2 3 2 ..
+}
+
+// Returns the coefficients 0..7 of each block in 'out0' and 8..15 in 'out1'.
+static WEBP_INLINE void FTransformPass2(const __m256i* const v01,
+                                        const __m256i* const v32,
+                                        __m256i* const out0,
+                                        __m256i* const out1) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i seven = _mm256_set1_epi16(7);
+  const __m256i k5352_2217 = _mm256_broadcastsi128_si256(
+      _mm_set_epi16(5352, 2217, 5352, 2217, 5352, 2217, 5352, 2217));
+  const __m256i k2217_5352 = _mm256_broadcastsi128_si256(
+      _mm_set_epi16(2217, -5352, 2217, -5352, 2217, -5352, 2217, -5352));
+  const __m256i k12000_plus_one = _mm256_set1_epi32(12000 + (1 << 16));
+  const __m256i k51000 = _mm256_set1_epi32(51000);
+
+  const __m256i a01 = _mm256_add_epi16(*v01, *v32);
+  const __m256i a32 = _mm256_sub_epi16(*v01, *v32);
+  const __m256i a11 = _mm256_unpackhi_epi64(a01, a01);
+  const __m256i a22 = _mm256_unpackhi_epi64(a32, a32);
+  const __m256i a01_plus_7 = _mm256_add_epi16(a01, seven);
+
+  // d0 = (a0 + a1 + 7) >> 4;
+  // d2 = (a0 - a1 + 7) >> 4;
+  const __m256i c0 = _mm256_add_epi16(a01_plus_7, a11);
+  const __m256i c2 = _mm256_sub_epi16(a01_plus_7, a11);
+  const __m256i d0 = _mm256_srai_epi16(c0, 4);
+  const __m256i d2 = _mm256_srai_epi16(c2, 4);
+
+  // f1 = ((b3 * 5352 + b2 * 2217 + 12000) >> 16)
+  // f3 = ((b3 * 2217 - b2 * 5352 + 51000) >> 16)
+  const __m256i b23 = _mm256_unpacklo_epi16(a22, a32);
+  const __m256i c1 = _mm256_madd_epi16(b23, k5352_2217);
+  const __m256i c3 = _mm256_madd_epi16(b23, k2217_5352);
+  const __m256i d1 = _mm256_add_epi32(c1, k12000_plus_one);
+  const __m256i d3 = _mm256_add_epi32(c3, k51000);
+  const __m256i e1 = _mm256_srai_epi32(d1, 16);
+  const __m256i e3 = _mm256_srai_epi32(d3, 16);
+  const __m256i f1 = _mm256_packs_epi32(e1, e1);
+  const __m256i f3 = _mm256_packs_epi32(e3, e3);
+  // f1 = f1 + 1 - (a3 == 0), see FTransformPass2() in enc_sse2.c
+  const __m256i g1 = _mm256_add_epi16(f1, _mm256_cmpeq_epi16(a32, zero));
+
+  *out0 = _mm256_unpacklo_epi64(d0, g1);
+  *out1 = _mm256_unpacklo_epi64(d2, f3);
+}
+
+// Transforms the block at 'src' and, if 'do_two' is true, its right
+// neighbour. The coefficients are returned in storage order: those of the
+// first block in 'out0', those of the second one in 'out1'.
+static WEBP_INLINE void FTransformBlocks(const uint8_t* const src,
+                                         const uint8_t* const ref, int do_two,
+                                         __m256i* const out0,
+                                         __m256i* const out1) {
+  const __m256i in01 = LoadDiffRows(src + 0 * BPS, ref + 0 * BPS, do_two);
+  const __m256i in23 = LoadDiffRows(src + 2 * BPS, ref + 2 * BPS, do_two);
+  __m256i v01, v32, d0_g1, d2_f3;
+  FTransformPass1(&in01, &in23, &v01, &v32);
+  FTransformPass2(&v01, &v32, &d0_g1, &d2_f3);
+  *out0 = _mm256_permute2x128_si256(d0_g1, d2_f3, 0x20);
+  *out1 = _mm256_permute2x128_si256(d0_g1, d2_f3, 0x31);
+}
+
+static void FTransform2(const uint8_t* src, const uint8_t* ref, int16_t* out) {
+  __m256i out0, out1;
+  FTransformBlocks(src, ref, 1, &out0, &out1);
+  _mm256_storeu_si256((__m256i*)&out[0], out0);
+  _mm256_storeu_si256((__m256i*)&out[16], out1);
+}
+
+//------------------------------------------------------------------------------
+// Compute susceptibility based on DCT-coeff histograms.
+
+static void CollectHistogram(const uint8_t* ref, const uint8_t* pred,
+                             int start_block, int end_block,
+                             VP8Histogram* const histo) {
+  const __m256i max_coeff_thresh = _mm256_set1_epi16(MAX_COEFF_THRESH);
+  int j = start_block;
+  int k;
+  // Two partial distributions, to shorten the chains of increments of the
+  // same (mostly zero) bin.
+  int distribution[2][MAX_COEFF_THRESH + 1];
+  memset(distribution, 0, sizeof(distribution));
+  while (j < end_block) {
+    // The blocks are transformed two by two when they are side by side.
+    const int do_two = (j + 1 < end_block) &&
+                       (VP8DspScan[j + 1] == VP8DspScan[j] + 4);
+    const int num_coeffs = do_two ? 32 : 16;
+    int16_t out[32];
+    __m256i out0, out1;
+    FTransformBlocks(ref + VP8DspScan[j], pred + VP8DspScan[j], do_two,
+                     &out0, &out1);
+    {
+      // v = abs(out) >> 3
+      const __m256i v0 = _mm256_srai_epi16(_mm256_abs_epi16(out0), 3);
+      const __m256i v1 = _mm256_srai_epi16(_mm256_abs_epi16(out1), 3);
+      // bin = min(v, MAX_COEFF_THRESH)
+      const __m256i bin0 = _mm256_min_epi16(v0, max_coeff_thresh);
+      const __m256i bin1 = _mm256_min_epi16(v1, max_coeff_thresh);
+      // Store.
+      _mm256_storeu_si256((__m256i*)&out[0], bin0);
+      _mm256_storeu_si256((__m256i*)&out[16], bin1);
+    }
+    // Convert coefficients to bin.
+    for (k = 0; k < num_coeffs; k += 2) {
+      ++distribution[0][out[k + 0]];
+      ++distribution[1][out[k + 1]];
+    }
+    j += do_two ? 2 : 1;
+  }
+  for (k = 0; k <= MAX_COEFF_THRESH; ++k) {
+    distribution[0][k] += distribution[1][k];
+  }
+  VP8SetHistogramData(distribution[0], histo);
+}
+
+//------------------------------------------------------------------------------
+// Intra predictions
+//
+// The predictions are laid out by pairs in the 32-byte wide rows of the
+// prediction area (see vp8enci.h): DC|TM and VE|HE, so that each row of two
+// modes is written with a single store.
+//
+// TrueMotion is computed in 8b as top + max(left - top_left, 0) -
+// max(top_left - left, 0) with saturations, which is exactly the clipped
+// top + left - top_left. The cases with missing samples are mapped on the same
+// computation with a different 'tm_base' and null offsets (see Intra16Preds).
+
+// Writes the 'num_rows' rows of the DC|TM and VE|HE predictions. 'he', 'plus'
+// and 'minus' hold the per-row values of the HE prediction and TrueMotion
+// offsets, broadcast to their row with the 'index' shuffle, which is
+// incremented by one for each row.
+static WEBP_INLINE void StorePredPairs(uint8_t* dst, int dc_tm, int ve_he,
+                                       int num_rows, const __m128i dc,
+                                       const __m128i ve, const __m128i he,
+                                       const __m128i tm_base,
+                                       const __m128i plus, const __m128i minus,
+                                       const __m128i index) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i dc_base = Pair(dc, tm_base);
+  const __m256i ve_ve = Pair(ve, ve);
+  const __m256i he_he = Pair(he, he);
+  // Null offsets in the low halves, so that the DC values go through as is.
+  const __m256i plus_hi = Pair(zero, plus);
+  const __m256i minus_hi = Pair(zero, minus);
+  __m256i idx = Pair(index, index);
+  int y;
+  for (y = 0; y < num_rows; ++y, dst += BPS) {
+    const __m256i add = _mm256_shuffle_epi8(plus_hi, idx);
+    const __m256i sub = _mm256_shuffle_epi8(minus_hi, idx);
+    const __m256i dc_tm_row =
+        _mm256_subs_epu8(_mm256_adds_epu8(dc_base, add), sub);
+    const __m256i ve_he_row =
+        _mm256_blend_epi32(ve_ve, _mm256_shuffle_epi8(he_he, idx), 0xf0);
+    _mm256_storeu_si256((__m256i*)(dst + dc_tm), dc_tm_row);
+    _mm256_storeu_si256((__m256i*)(dst + ve_he), ve_he_row);
+    idx = _mm256_add_epi8(idx, one);
+  }
+}
+
+//------------------------------------------------------------------------------
+// luma 16x16 prediction (paragraph 12.3)
+
+static WEBP_INLINE int DC16Value(const __m128i* const left,
+                                 const __m128i* const top) {
+  if (top != NULL) {
+    if (left != NULL) {  // top and left present
+      return (VP8HorizontalAdd8b(top) + VP8HorizontalAdd8b(left) + 16) >> 5;
+    }
+    return (VP8HorizontalAdd8b(top) + 8) >> 4;  // top, but no left
+  } else if (left != NULL) {  // left but no top
+    return (VP8HorizontalAdd8b(left) + 8) >> 4;
+  }
+  return 0x80;  // no top, no left, nothing.
+}
+
+static void Intra16Preds(uint8_t* dst,
+                         const uint8_t* left, const uint8_t* top) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i top_row = (top != NULL) ?
+      _mm_loadu_si128((const __m128i*)top) : zero;
+  const __m128i left_col = (left != NULL) ?
+      _mm_loadu_si128((const __m128i*)left) : zero;
+  const __m128i dc = _mm_set1_epi8((char)DC16Value(
+      (left != NULL) ? &left_col : NULL, (top != NULL) ? &top_row : NULL));
+  const __m128i ve = (top != NULL) ? top_row : _mm_set1_epi8(127);
+  __m128i he = _mm_set1_epi8((char)129);
+  __m128i tm_base = (top != NULL) ? top_row : he;
+  __m128i plus = zero, minus = zero;
+  if (left != NULL) {
+    he = left_col;
+    if (top != NULL) {
+      const __m128i top_left = _mm_set1_epi8((char)left[-1]);
+      plus = _mm_subs_epu8(left_col, top_left);
+      minus = _mm_subs_epu8(top_left, left_col);
+    } else {
+      // True motion without top samples is HE prediction.
+      tm_base = zero;
+      plus = left_col;
+    }
+  }
+  // Without left samples, true motion is VE prediction with the top samples,
+  // or 129 (and not 127 as in the VE case) if they are missing too.
+  StorePredPairs(dst, I16DC16, I16VE16, 16, dc, ve, he, tm_base, plus, minus,
+                 zero);
+}
+
+//------------------------------------------------------------------------------
+// Chroma 8x8 prediction (paragraph 12.2)
+//
+// The U and V blocks are predicted together, U in the low 8 bytes and V in
+// the high 8 bytes of the 128-bit registers.
+
+static WEBP_INLINE __m128i DC8uvValues(const __m128i* const left,
+                                       const __m128i* const top) {
+  // Broadcasts the low byte of each 64b half to the whole half.
+  const __m128i kSpread = _mm_set_epi8(8, 8, 8, 8, 8, 8, 8, 8,
+                                       0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i dc;
+  if (top != NULL) {
+    const __m128i top_sums = _mm_sad_epu8(*top, zero);
+    if (left != NULL) {  // top and left present
+      const __m128i sums = _mm_add_epi64(top_sums, _mm_sad_epu8(*left, zero));
+      dc = _mm_srli_epi64(_mm_add_epi64(sums, _mm_set1_epi64x(8)), 4);
+    } else {  // top, but no left
+      dc = _mm_srli_epi64(_mm_add_epi64(top_sums, _mm_set1_epi64x(4)), 3);
+    }
+  } else if (left != NULL) {  // left but no top
+    const __m128i left_sums = _mm_sad_epu8(*left, zero);
+    dc = _mm_srli_epi64(_mm_add_epi64(left_sums, _mm_set1_epi64x(4)), 3);
+  } else {  // no top, no left, nothing.
+    return _mm_set1_epi8((char)0x80);
+  }
+  return _mm_shuffle_epi8(dc, kSpread);
+}
+
+static void IntraChromaPreds(uint8_t* dst, const uint8_t* left,
+                             const uint8_t* top) {
+  const __m128i zero = _mm_setzero_si128();
+  // The V samples are at top + 8 and left + 16.
+  const __m128i top_uv = (top != NULL) ?
+      _mm_loadu_si128((const __m128i*)top) : zero;
+  const __m128i left_uv = (left != NULL) ?
+      _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)left),
+                         _mm_loadl_epi64((const __m128i*)(left + 16))) : zero;
+  const __m128i dc = DC8uvValues((left != NULL) ? &left_uv : NULL,
+                                 (top != NULL) ? &top_uv : NULL);
+  const __m128i ve = (top != NULL) ? top_uv : _mm_set1_epi8(127);
+  const __m128i index = _mm_set_epi8(8, 8, 8, 8, 8, 8, 8, 8,
+                                     0, 0, 0, 0, 0, 0, 0, 0);
+  __m128i he = _mm_set1_epi8((char)129);
+  __m128i tm_base = (top != NULL) ? top_uv : he;
+  __m128i plus = zero, minus = zero;
+  if (left != NULL) {
+    he = left_uv;
+    if (top != NULL) {
+      const __m128i top_left =
+          _mm_unpacklo_epi64(_mm_set1_epi8((char)left[-1]),
+                             _mm_set1_epi8((char)left[15]));
+      plus = _mm_subs_epu8(left_uv, top_left);
+      minus = _mm_subs_epu8(top_left, left_uv);
+    } else {
+      tm_base = zero;
+      plus = left_uv;
+    }
+  }
+  // See Intra16Preds() for the cases with missing samples.
+  StorePredPairs(dst, C8DC8, C8VE8, 8, dc, ve, he, tm_base, plus, minus,
+                 index);
+}
+
+//------------------------------------------------------------------------------
+// Metric
+
+// Returns the sum of squared differences of 'num_rows' rows of 16 pixels.
+static WEBP_INLINE int SSE_16xN(const uint8_t* a, const uint8_t* b,
+                                int num_rows) {
+  __m256i sum = _mm256_setzero_si256();
+  int i;
+  for (i = 0; i < num_rows; ++i) {
+    const __m256i a0 =
+        _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&a[i * BPS]));
+    const __m256i b0 =
+        _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&b[i * BPS]));
+    const __m256i c0 = _mm256_sub_epi16(a0, b0);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(c0, c0));
+  }
+  return HorizontalSum32(sum);
+}
+
+static int SSE16x16(const uint8_t* a, const uint8_t* b) {
+  return SSE_16xN(a, b, 16);
+}
+
+static int SSE16x8(const uint8_t* a, const uint8_t* b) {
+  return SSE_16xN(a, b, 8);
+}
+
+// Loads two rows of 8 pixels as 16b.
+#define LOAD_2x8x16b(ptr)                                                  \
+  _mm256_cvtepu8_epi16(                                                    \
+      _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(ptr)),           \
+                         _mm_loadl_epi64((const __m128i*)((ptr) + BPS))))
+
+static int SSE8x8(const uint8_t* a, const uint8_t* b) {
+  __m256i sum = _mm256_setzero_si256();
+  int i;
+  for (i = 0; i < 8; i += 2) {
+    const __m256i a01 = LOAD_2x8x16b(&a[i * BPS]);
+    const __m256i b01 = LOAD_2x8x16b(&b[i * BPS]);
+    const __m256i c01 = _mm256_sub_epi16(a01, b01);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(c01, c01));
+  }
+  return HorizontalSum32(sum);
+}
+#undef LOAD_2x8x16b
+
+//------------------------------------------------------------------------------
+// Texture distortion
+//
+// Four 4x4 blocks of inA and inB (a 16x4 strip) are processed at once: each
+// half of the 256-bit registers does the same operations as the SSE2
+// TTransform() on one pair of blocks, the low half for the blocks 0 and 2 of
+// the strip, the high half for the blocks 1 and 3.
+
+// Transposes the four 4x4 blocks, the same way VP8Transpose_2_4x4_16b() does
+// for two blocks.
+static WEBP_INLINE void Transpose_4_4x4_16b(
+    const __m256i* const in0, const __m256i* const in1,
+    const __m256i* const in2, const __m256i* const in3, __m256i* const out0,
+    __m256i* const out1, __m256i* const out2, __m256i* const out3) {
+  const __m256i transpose0_0 = _mm256_unpacklo_epi16(*in0, *in1);
+  const __m256i transpose0_1 = _mm256_unpacklo_epi16(*in2, *in3);
+  const __m256i transpose0_2 = _mm256_unpackhi_epi16(*in0, *in1);
+  const __m256i transpose0_3 = _mm256_unpackhi_epi16(*in2, *in3);
+  const __m256i transpose1_0 = _mm256_unpacklo_epi32(transpose0_0,
+                                                     transpose0_1);
+  const __m256i transpose1_1 = _mm256_unpacklo_epi32(transpose0_2,
+                                                     transpose0_3);
+  const __m256i transpose1_2 = _mm256_unpackhi_epi32(transpose0_0,
+                                                     transpose0_1);
+  const __m256i transpose1_3 = _mm256_unpackhi_epi32(transpose0_2,
+                                                     transpose0_3);
+  *out0 = _mm256_unpacklo_epi64(transpose1_0, transpose1_1);
+  *out1 = _mm256_unpackhi_epi64(transpose1_0, transpose1_1);
+  *out2 = _mm256_unpacklo_epi64(transpose1_2, transpose1_3);
+  *out3 = _mm256_unpackhi_epi64(transpose1_2, transpose1_3);
+}
+
+// Hadamard transform of the inA / inB pairs of blocks held by 'tmp' (rows
+// of inA in the low 64b, of inB in the high 64b of each half). Returns the
+// difference of the weighted sums, as four partial sums per half.
+static WEBP_INLINE __m256i TTransformDiff(const __m256i* const tmp,
+                                          const __m256i* const w_0,
+                                          const __m256i* const w_8) {
+  __m256i tmp_0, tmp_1, tmp_2, tmp_3;
+  // Vertical pass first to avoid a transpose (vertical and horizontal passes
+  // are commutative because w/kWeightY is symmetric) and subsequent transpose.
+  {
+    const __m256i a0 = _mm256_add_epi16(tmp[0], tmp[2]);
+    const __m256i a1 = _mm256_add_epi16(tmp[1], tmp[3]);
+    const __m256i a2 = _mm256_sub_epi16(tmp[1], tmp[3]);
+    const __m256i a3 = _mm256_sub_epi16(tmp[0], tmp[2]);
+    const __m256i b0 = _mm256_add_epi16(a0, a1);
+    const __m256i b1 = _mm256_add_epi16(a3, a2);
+    const __m256i b2 = _mm256_sub_epi16(a3, a2);
+    const __m256i b3 = _mm256_sub_epi16(a0, a1);
+    Transpose_4_4x4_16b(&b0, &b1, &b2, &b3, &tmp_0, &tmp_1, &tmp_2, &tmp_3);
+  }
+  // Horizontal pass and difference of weighted sums.
+  {
+    const __m256i a0 = _mm256_add_epi16(tmp_0, tmp_2);
+    const __m256i a1 = _mm256_add_epi16(tmp_1, tmp_3);
+    const __m256i a2 = _mm256_sub_epi16(tmp_1, tmp_3);
+    const __m256i a3 = _mm256_sub_epi16(tmp_0, tmp_2);
+    const __m256i b0 = _mm256_add_epi16(a0, a1);
+    const __m256i b1 = _mm256_add_epi16(a3, a2);
+    const __m256i b2 = _mm256_sub_epi16(a3, a2);
+    const __m256i b3 = _mm256_sub_epi16(a0, a1);
+
+    // Separate the transforms of inA and inB, and take abs(v) in 16b.
+    const __m256i A_b0 = _mm256_abs_epi16(_mm256_unpacklo_epi64(b0, b1));
+    const __m256i A_b2 = _mm256_abs_epi16(_mm256_unpacklo_epi64(b2, b3));
+    const __m256i B_b0 = _mm256_abs_epi16(_mm256_unpackhi_epi64(b0, b1));
+    const __m256i B_b2 = _mm256_abs_epi16(_mm256_unpackhi_epi64(b2, b3));
+
+    // weighted sums
+    const __m256i A_sum = _mm256_add_epi32(_mm256_madd_epi16(A_b0, *w_0),
+                                           _mm256_madd_epi16(A_b2, *w_8));
+    const __m256i B_sum = _mm256_add_epi32(_mm256_madd_epi16(B_b0, *w_0),
+                                           _mm256_madd_epi16(B_b2, *w_8));
+    return _mm256_sub_epi32(A_sum, B_sum);
+  }
+}
+
+static int Disto16x16(const uint8_t* const a, const uint8_t* const b,
+                      const uint16_t* const w) {
+  const __m256i w_0 =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)&w[0]));
+  const __m256i w_8 =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)&w[8]));
+  __m256i D = _mm256_setzero_si256();
+  int y, i;
+  for (y = 0; y < 16 * BPS; y += 4 * BPS) {
+    __m256i tmp01[4], tmp23[4];
+    for (i = 0; i < 4; ++i) {
+      // a0 a1 a2 a3 | b0 b1 b2 b3 rows of the blocks 0 and 1, then 2 and 3.
+      const __m128i inA = _mm_loadu_si128((const __m128i*)&a[y + i * BPS]);
+      const __m128i inB = _mm_loadu_si128((const __m128i*)&b[y + i * BPS]);
+      tmp01[i] = _mm256_cvtepu8_epi16(_mm_unpacklo_epi32(inA, inB));
+      tmp23[i] = _mm256_cvtepu8_epi16(_mm_unpackhi_epi32(inA, inB));
+    }
+    {
+      const __m256i diff01 = TTransformDiff(tmp01, &w_0, &w_8);
+      const __m256i diff23 = TTransformDiff(tmp23, &w_0, &w_8);
+      // Per-block sums: [s0 s2 s0 s2 | s1 s3 s1 s3]
+      const __m256i sum_pairs = _mm256_hadd_epi32(diff01, diff23);
+      const __m256i sums = _mm256_hadd_epi32(sum_pairs, sum_pairs);
+      // Disto4x4() = abs(diff_sum) >> 5
+      D = _mm256_add_epi32(D, _mm256_srli_epi32(_mm256_abs_epi32(sums), 5));
+    }
+  }
+  {
+    // Only the first two values of each half are distinct.
+    const __m128i D4 = _mm_add_epi32(LoHalf(D), HiHalf(D));
+    return _mm_cvtsi128_si32(D4) + _mm_extract_epi32(D4, 1);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Quantization
+//
+// One block of 16 coefficients fits in one 256-bit register. Only the
+// two-blocks version is worth it: for a single block, the set-up of the
+// constants costs as much as the gain.
+
+static int Quantize2Blocks(int16_t in[32], int16_t out[32],
+                           const VP8Matrix* const mtx) {
+  const __m256i max_coeff_2047 = _mm256_set1_epi16(MAX_LEVEL);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i iq = _mm256_loadu_si256((const __m256i*)&mtx->iq_[0]);
+  const __m256i q = _mm256_loadu_si256((const __m256i*)&mtx->q_[0]);
+  const __m256i sharpen =
+      _mm256_loadu_si256((const __m256i*)&mtx->sharpen_[0]);
+  // The 32b products below are in the order 0..3 8..11 and 4..7 12..15.
+  const __m256i bias_0 = _mm256_loadu_si256((const __m256i*)&mtx->bias_[0]);
+  const __m256i bias_8 = _mm256_loadu_si256((const __m256i*)&mtx->bias_[8]);
+  const __m256i bias_lo = _mm256_permute2x128_si256(bias_0, bias_8, 0x20);
+  const __m256i bias_hi = _mm256_permute2x128_si256(bias_0, bias_8, 0x31);
+  // Zigzag shuffles. The output is (kZigzag[]):
+  //   0 1 4 8 5 2 3 6 | 9 12 13 10 7 11 14 15
+  // The 8 of the low half and the 7 of the high half are picked from the
+  // halves-swapped register, the other ones from the register itself.
+  const __m256i kZigzagSelf = _mm256_setr_epi8(
+      0, 1, 2, 3, 8, 9, -1, -1, 10, 11, 4, 5, 6, 7, 12, 13,
+      2, 3, 8, 9, 10, 11, 4, 5, -1, -1, 6, 7, 12, 13, 14, 15);
+  const __m256i kZigzagSwap = _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, 0, 1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1);
+  int nz = 0;
+  int n;
+
+  for (n = 0; n < 2; ++n, in += 16, out += 16) {
+    const __m256i in0 = _mm256_loadu_si256((__m256i*)in);
+    // extract sign(in)  (0x0000 if positive, 0xffff if negative)
+    const __m256i sign = _mm256_cmpgt_epi16(zero, in0);
+    // coeff = abs(in) + sharpen
+    const __m256i coeff =
+        _mm256_add_epi16(_mm256_abs_epi16(in0), sharpen);
+    __m256i out0;
+
+    // out = (coeff * iQ + B) >> QFIX
+    {
+      // doing calculations with 32b precision (QFIX=17)
+      const __m256i coeff_iQH = _mm256_mulhi_epu16(coeff, iq);
+      const __m256i coeff_iQL = _mm256_mullo_epi16(coeff, iq);
+      __m256i out_lo = _mm256_unpacklo_epi16(coeff_iQL, coeff_iQH);
+      __m256i out_hi = _mm256_unpackhi_epi16(coeff_iQL, coeff_iQH);
+      out_lo = _mm256_srai_epi32(_mm256_add_epi32(out_lo, bias_lo), QFIX);
+      out_hi = _mm256_srai_epi32(_mm256_add_epi32(out_hi, bias_hi), QFIX);
+      // pack result as 16b, back in the natural order
+      out0 = _mm256_packs_epi32(out_lo, out_hi);
+      // if (coeff > 2047) coeff = 2047
+      out0 = _mm256_min_epi16(out0, max_coeff_2047);
+    }
+
+    // get sign back (if (sign[j]) out_n = -out_n)
+    out0 = _mm256_sub_epi16(_mm256_xor_si256(out0, sign), sign);
+
+    // in = out * Q
+    _mm256_storeu_si256((__m256i*)in, _mm256_mullo_epi16(out0, q));
+
+    // zigzag the output before storing it.
+    {
+      const __m256i swapped =
+          _mm256_permute4x64_epi64(out0, _MM_SHUFFLE(1, 0, 3, 2));
+      const __m256i outZ =
+          _mm256_or_si256(_mm256_shuffle_epi8(out0, kZigzagSelf),
+                          _mm256_shuffle_epi8(swapped, kZigzagSwap));
+      _mm256_storeu_si256((__m256i*)out, outZ);
+      // detect if all 'out' values are zeroes or not
+      nz |= (_mm256_movemask_epi8(_mm256_cmpeq_epi16(outZ, zero)) != -1) << n;
+    }
+  }
+  return nz;
+}
 
 //------------------------------------------------------------------------------
 // Entry point
 
+extern void VP8EncDspInitAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void VP8EncDspInitAVX2(void) {
+  VP8CollectHistogram = CollectHistogram;
+  VP8EncPredLuma16 = Intra16Preds;
+  VP8EncPredChroma8 = IntraChromaPreds;
+  VP8EncQuantize2Blocks = Quantize2Blocks;
+  VP8FTransform2 = FTransform2;
+  VP8SSE16x16 = SSE16x16;
+  VP8SSE16x8 = SSE16x8;
+  VP8SSE8x8 = SSE8x8;
+  VP8TDisto16x16 = Disto16x16;
+}
+
+#else  // !WEBP_USE_AVX2
+
 WEBP_DSP_INIT_STUB(VP8EncDspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
@@ -1045,6 +1045,35 @@ static int SSE4x4(const uint8_t* a, const uint8_t* b) {
   return (tmp[3] + tmp[2] + tmp[1] + tmp[0]);
 }
 
+static WEBP_INLINE int SAD_16xN(const uint8_t* a, const uint8_t* b,
+                                int num_pairs) {
+  __m128i sum = _mm_setzero_si128();
+  int i;
+
+  for (i = 0; i < num_pairs; ++i) {
+    const __m128i a0 = _mm_loadu_si128((const __m128i*)&a[BPS * 0]);
+    const __m128i b0 = _mm_loadu_si128((const __m128i*)&b[BPS * 0]);
+    const __m128i a1 = _mm_loadu_si128((const __m128i*)&a[BPS * 1]);
+    const __m128i b1 = _mm_loadu_si128((const __m128i*)&b[BPS * 1]);
+    // psadbw leaves two 16b partial sums, in the low and high halves
+    const __m128i sad0 = _mm_sad_epu8(a0, b0);
+    const __m128i sad1 = _mm_sad_epu8(a1, b1);
+    sum = _mm_add_epi32(sum, _mm_add_epi32(sad0, sad1));
+    a += 2 * BPS;
+    b += 2 * BPS;
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+  return _mm_cvtsi128_si32(sum);
+}
+
+static int SAD16x16(const uint8_t* a, const uint8_t* b) {
+  return SAD_16xN(a, b, 8);
+}
+
+static int SAD16x8(const uint8_t* a, const uint8_t* b) {
+  return SAD_16xN(a, b, 4);
+}
+
 //------------------------------------------------------------------------------
 // Texture distortion
 //
@@ -1329,6 +1358,8 @@ WEBP_TSAN_IGNORE_FUNCTION void VP8EncDspInitSSE2(void) {
   VP8SSE16x8 = SSE16x8;
   VP8SSE8x8 = SSE8x8;
   VP8SSE4x4 = SSE4x4;
+  VP8SAD16x16 = SAD16x16;
+  VP8SAD16x8 = SAD16x8;
   VP8TDisto4x4 = Disto4x4;
   VP8TDisto16x16 = Disto16x16;
 }
@@ -26,11 +26,6 @@
 //------------------------------------------------------------------------------
 // Image transforms.
 
-// In-place sum of each component with mod 256.
-static WEBP_INLINE void AddPixelsEq(uint32_t* a, uint32_t b) {
-  *a = VP8LAddPixels(*a, b);
-}
-
 static WEBP_INLINE uint32_t Average2(uint32_t a0, uint32_t a1) {
   return (((a0 ^ a1) & 0xfefefefeu) >> 1) + (a0 & a1);
 }
@@ -171,6 +166,50 @@ static uint32_t Predictor13(uint32_t left, const uint32_t* const top) {
   return pred;
 }
 
+//------------------------------------------------------------------------------
+// Batched predictors
+
+static void PredictorAdd0(const uint32_t* in, const uint32_t* upper,
+                          int num_pixels, uint32_t* out) {
+  int x;
+  (void)upper;
+  for (x = 0; x < num_pixels; ++x) out[x] = VP8LAddPixels(in[x], ARGB_BLACK);
+}
+static void PredictorAdd1(const uint32_t* in, const uint32_t* upper,
+                          int num_pixels, uint32_t* out) {
+  int x;
+  uint32_t left = out[-1];
+  (void)upper;
+  for (x = 0; x < num_pixels; ++x) {
+    out[x] = left = VP8LAddPixels(in[x], left);
+  }
+}
+
+// The other ones go through VP8LPredictors[], to use the fastest available.
+#define GENERATE_PREDICTOR_ADD(N)                                              \
+static void PredictorAdd##N(const uint32_t* in, const uint32_t* upper,         \
+                            int num_pixels, uint32_t* out) {                   \
+  const VP8LPredictorFunc pred_func = VP8LPredictors[N];                       \
+  int x;                                                                       \
+  for (x = 0; x < num_pixels; ++x) {                                           \
+    const uint32_t pred = pred_func(out[x - 1], upper + x);                    \
+    out[x] = VP8LAddPixels(in[x], pred);                                       \
+  }                                                                            \
+}
+GENERATE_PREDICTOR_ADD(2)
+GENERATE_PREDICTOR_ADD(3)
+GENERATE_PREDICTOR_ADD(4)
+GENERATE_PREDICTOR_ADD(5)
+GENERATE_PREDICTOR_ADD(6)
+GENERATE_PREDICTOR_ADD(7)
+GENERATE_PREDICTOR_ADD(8)
+GENERATE_PREDICTOR_ADD(9)
+GENERATE_PREDICTOR_ADD(10)
+GENERATE_PREDICTOR_ADD(11)
+GENERATE_PREDICTOR_ADD(12)
+GENERATE_PREDICTOR_ADD(13)
+#undef GENERATE_PREDICTOR_ADD
+
 //------------------------------------------------------------------------------
 
 // Inverse prediction.
@@ -178,13 +217,8 @@ static void PredictorInverseTransform(const VP8LTransform* const transform,
                                       int y_start, int y_end, uint32_t* data) {
   const int width = transform->xsize_;
   if (y_start == 0) {  // First Row follows the L (mode=1) mode.
-    int x;
-    const uint32_t pred0 = Predictor0(data[-1], NULL);
-    AddPixelsEq(data, pred0);
-    for (x = 1; x < width; ++x) {
-      const uint32_t pred1 = Predictor1(data[x - 1], NULL);
-      AddPixelsEq(data + x, pred1);
-    }
+    VP8LPredictorsAdd[0](data, NULL, 1, data);
+    VP8LPredictorsAdd[1](data + 1, NULL, width - 1, data + 1);
     data += width;
     ++y_start;
   }
@@ -193,34 +227,23 @@ static void PredictorInverseTransform(const VP8LTransform* const transform,
     int y = y_start;
     const int tile_width = 1 << transform->bits_;
     const int mask = tile_width - 1;
-    const int safe_width = width & ~mask;
     const int tiles_per_row = VP8LSubSampleSize(width, transform->bits_);
     const uint32_t* pred_mode_base =
         transform->data_ + (y >> transform->bits_) * tiles_per_row;
 
     while (y < y_end) {
-      const uint32_t pred2 = Predictor2(data[-1], data - width);
       const uint32_t* pred_mode_src = pred_mode_base;
-      VP8LPredictorFunc pred_func;
       int x = 1;
-      int t = 1;
       // First pixel follows the T (mode=2) mode.
-      AddPixelsEq(data, pred2);
-      // .. the rest:
-      while (x < safe_width) {
-        pred_func = VP8LPredictors[((*pred_mode_src++) >> 8) & 0xf];
-        for (; t < tile_width; ++t, ++x) {
-          const uint32_t pred = pred_func(data[x - 1], data + x - width);
-          AddPixelsEq(data + x, pred);
-        }
-        t = 0;
-      }
-      if (x < width) {
-        pred_func = VP8LPredictors[((*pred_mode_src++) >> 8) & 0xf];
-        for (; x < width; ++x) {
-          const uint32_t pred = pred_func(data[x - 1], data + x - width);
-          AddPixelsEq(data + x, pred);
-        }
+      VP8LPredictorsAdd[2](data, data - width, 1, data);
+      // .. the rest, by runs of pixels sharing the same tile:
+      while (x < width) {
+        const VP8LPredictorAddFunc pred_func =
+            VP8LPredictorsAdd[((*pred_mode_src++) >> 8) & 0xf];
+        int x_end = (x & ~mask) + tile_width;
+        if (x_end > width) x_end = width;
+        pred_func(data + x, data + x - width, x_end - x, data + x);
+        x = x_end;
       }
       data += width;
       ++y;
@@ -557,6 +580,8 @@ void VP8LConvertFromBGRA(const uint32_t* const in_data, int num_pixels,
 
 VP8LProcessBlueAndRedFunc VP8LAddGreenToBlueAndRed;
 VP8LPredictorFunc VP8LPredictors[16];
+VP8LPredictorAddFunc VP8LPredictorsAdd[16];
+VP8LPredictorAddFunc VP8LPredictorsAdd_C[16];
 
 VP8LTransformColorFunc VP8LTransformColorInverse;
 
@@ -570,6 +595,7 @@ VP8LMapARGBFunc VP8LMapColor32b;
 VP8LMapAlphaFunc VP8LMapColor8b;
 
 extern void VP8LDspInitSSE2(void);
+extern void VP8LDspInitAVX2(void);
 extern void VP8LDspInitNEON(void);
 extern void VP8LDspInitMIPSdspR2(void);
 
@@ -596,6 +622,24 @@ WEBP_TSAN_IGNORE_FUNCTION void VP8LDspInit(void) {
   VP8LPredictors[14] = Predictor0;     // <- padding security sentinels
   VP8LPredictors[15] = Predictor0;
 
+  VP8LPredictorsAdd_C[0] = PredictorAdd0;
+  VP8LPredictorsAdd_C[1] = PredictorAdd1;
+  VP8LPredictorsAdd_C[2] = PredictorAdd2;
+  VP8LPredictorsAdd_C[3] = PredictorAdd3;
+  VP8LPredictorsAdd_C[4] = PredictorAdd4;
+  VP8LPredictorsAdd_C[5] = PredictorAdd5;
+  VP8LPredictorsAdd_C[6] = PredictorAdd6;
+  VP8LPredictorsAdd_C[7] = PredictorAdd7;
+  VP8LPredictorsAdd_C[8] = PredictorAdd8;
+  VP8LPredictorsAdd_C[9] = PredictorAdd9;
+  VP8LPredictorsAdd_C[10] = PredictorAdd10;
+  VP8LPredictorsAdd_C[11] = PredictorAdd11;
+  VP8LPredictorsAdd_C[12] = PredictorAdd12;
+  VP8LPredictorsAdd_C[13] = PredictorAdd13;
+  VP8LPredictorsAdd_C[14] = PredictorAdd0;  // <- padding security sentinels
+  VP8LPredictorsAdd_C[15] = PredictorAdd0;
+  memcpy(VP8LPredictorsAdd, VP8LPredictorsAdd_C, sizeof(VP8LPredictorsAdd));
+
   VP8LAddGreenToBlueAndRed = VP8LAddGreenToBlueAndRed_C;
 
   VP8LTransformColorInverse = VP8LTransformColorInverse_C;
@@ -616,6 +660,11 @@ WEBP_TSAN_IGNORE_FUNCTION void VP8LDspInit(void) {
       VP8LDspInitSSE2();
     }
 #endif
+#if defined(WEBP_USE_AVX2)
+    if (VP8GetCPUInfo(kAVX2)) {
+      VP8LDspInitAVX2();
+    }
+#endif
 #if defined(WEBP_USE_NEON)
     if (VP8GetCPUInfo(kNEON)) {
       VP8LDspInitNEON();
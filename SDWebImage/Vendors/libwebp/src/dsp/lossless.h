@@ -35,6 +35,16 @@ extern "C" {
 typedef uint32_t (*VP8LPredictorFunc)(uint32_t left, const uint32_t* const top);
 extern VP8LPredictorFunc VP8LPredictors[16];
 
+// Inverse prediction of a run of 'num_pixels' pixels using a given predictor:
+// adds the predictions to the residuals 'in' and stores the result to 'out'
+// (which can be the same as 'in'). The left neighbour of the first pixel is
+// out[-1], and 'upper' is the row above, read in [-1, num_pixels]. The
+// predictors 0 and 1 don't use 'upper', which can then be NULL.
+typedef void (*VP8LPredictorAddFunc)(const uint32_t* in, const uint32_t* upper,
+                                     int num_pixels, uint32_t* out);
+extern VP8LPredictorAddFunc VP8LPredictorsAdd[16];
+extern VP8LPredictorAddFunc VP8LPredictorsAdd_C[16];
+
 typedef void (*VP8LProcessBlueAndRedFunc)(uint32_t* argb_data, int num_pixels);
 extern VP8LProcessBlueAndRedFunc VP8LAddGreenToBlueAndRed;
 
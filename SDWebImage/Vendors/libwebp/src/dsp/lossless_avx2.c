@@ -0,0 +1,378 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 variant of methods for lossless decoder: batched inverse predictors,
+// inverse color transforms and color-indexing lookups, 8 pixels at a time.
+// All the functions are bit-exact with their plain-C counterparts.
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+
+#include <immintrin.h>
+#include "./lossless.h"
+
+#define LOAD(P)  _mm256_loadu_si256((const __m256i*)(P))
+#define STORE(P, V)  _mm256_storeu_si256((__m256i*)(P), (V))
+
+// Per-channel floor((a + b) / 2), like Average2() in lossless.c.
+static WEBP_INLINE __m256i Average2_256(const __m256i a, const __m256i b) {
+  const __m256i ones = _mm256_set1_epi8(1);
+  const __m256i avg = _mm256_avg_epu8(a, b);   // rounds up: (a + b + 1) >> 1
+  const __m256i odd = _mm256_and_si256(_mm256_xor_si256(a, b), ones);
+  return _mm256_sub_epi8(avg, odd);
+}
+
+static WEBP_INLINE __m128i Average2_128(const __m128i a, const __m128i b) {
+  const __m128i ones = _mm_set1_epi8(1);
+  const __m128i avg = _mm_avg_epu8(a, b);
+  const __m128i odd = _mm_and_si128(_mm_xor_si128(a, b), ones);
+  return _mm_sub_epi8(avg, odd);
+}
+
+//------------------------------------------------------------------------------
+// Batched predictors (see VP8LPredictorsAdd[])
+//
+// The predictors that only use the upper row add 8 predictions at once. For
+// the ones using the left pixel, that is the previous output, the part of the
+// prediction coming from the upper row is computed 8 pixels at a time, and the
+// left-dependent rest pixel by pixel, in registers. The left-overs go through
+// the plain-C versions.
+
+static void PredictorAdd0(const uint32_t* in, const uint32_t* upper,
+                          int num_pixels, uint32_t* out) {
+  const __m256i black = _mm256_set1_epi32(ARGB_BLACK);
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    STORE(out + i, _mm256_add_epi8(LOAD(in + i), black));
+  }
+  if (i != num_pixels) {
+    VP8LPredictorsAdd_C[0](in + i, upper, num_pixels - i, out + i);
+  }
+}
+
+// Prefix sums of the residuals, carried over from the left pixel.
+static void PredictorAdd1(const uint32_t* in, const uint32_t* upper,
+                          int num_pixels, uint32_t* out) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i idx_3 = _mm256_set1_epi32(3);
+  const __m256i idx_7 = _mm256_set1_epi32(7);
+  __m256i left = _mm256_set1_epi32((int)out[-1]);
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    const __m256i src = LOAD(in + i);
+    // prefix sums within each 128-bit half
+    const __m256i sum0 = _mm256_add_epi8(src, _mm256_slli_si256(src, 4));
+    const __m256i sum1 = _mm256_add_epi8(sum0, _mm256_slli_si256(sum0, 8));
+    // add the sum of the low half to the high half
+    const __m256i low_sum = _mm256_permutevar8x32_epi32(sum1, idx_3);
+    const __m256i carry = _mm256_blend_epi32(zero, low_sum, 0xf0);
+    const __m256i res = _mm256_add_epi8(_mm256_add_epi8(sum1, carry), left);
+    STORE(out + i, res);
+    left = _mm256_permutevar8x32_epi32(res, idx_7);
+  }
+  if (i != num_pixels) {
+    VP8LPredictorsAdd_C[1](in + i, upper, num_pixels - i, out + i);
+  }
+}
+
+// Predictors using a single pixel of the upper row.
+#define GENERATE_PREDICTOR_TOP(N, OFFSET)                                      \
+static void PredictorAdd##N(const uint32_t* in, const uint32_t* upper,         \
+                            int num_pixels, uint32_t* out) {                   \
+  int i;                                                                       \
+  for (i = 0; i + 8 <= num_pixels; i += 8) {                                   \
+    const __m256i pred = LOAD(upper + i + (OFFSET));                           \
+    STORE(out + i, _mm256_add_epi8(LOAD(in + i), pred));                       \
+  }                                                                            \
+  if (i != num_pixels) {                                                       \
+    VP8LPredictorsAdd_C[N](in + i, upper + i, num_pixels - i, out + i);        \
+  }                                                                            \
+}
+GENERATE_PREDICTOR_TOP(2, 0)   // T
+GENERATE_PREDICTOR_TOP(3, 1)   // TR
+GENERATE_PREDICTOR_TOP(4, -1)  // TL
+#undef GENERATE_PREDICTOR_TOP
+
+// Predictors averaging two pixels of the upper row.
+#define GENERATE_PREDICTOR_AVG_TOP(N, OFFSET0, OFFSET1)                        \
+static void PredictorAdd##N(const uint32_t* in, const uint32_t* upper,         \
+                            int num_pixels, uint32_t* out) {                   \
+  int i;                                                                       \
+  for (i = 0; i + 8 <= num_pixels; i += 8) {                                   \
+    const __m256i pred = Average2_256(LOAD(upper + i + (OFFSET0)),             \
+                                      LOAD(upper + i + (OFFSET1)));            \
+    STORE(out + i, _mm256_add_epi8(LOAD(in + i), pred));                       \
+  }                                                                            \
+  if (i != num_pixels) {                                                       \
+    VP8LPredictorsAdd_C[N](in + i, upper + i, num_pixels - i, out + i);        \
+  }                                                                            \
+}
+GENERATE_PREDICTOR_AVG_TOP(8, -1, 0)   // Average2(TL, T)
+GENERATE_PREDICTOR_AVG_TOP(9, 0, 1)    // Average2(T, TR)
+#undef GENERATE_PREDICTOR_AVG_TOP
+
+// The predictors below keep the left pixel 'L' in the low 32 bits of a
+// register, and output one pixel per step.
+#define LOAD_PIXEL(P)  _mm_cvtsi32_si128((int)*(P))
+
+#define GENERATE_PREDICTOR_LEFT(N, PRED)                                       \
+static void PredictorAdd##N(const uint32_t* in, const uint32_t* upper,         \
+                            int num_pixels, uint32_t* out) {                   \
+  __m128i L = LOAD_PIXEL(out - 1);                                             \
+  int i;                                                                       \
+  for (i = 0; i < num_pixels; ++i) {                                           \
+    const __m128i pred = (PRED);                                               \
+    L = _mm_add_epi8(LOAD_PIXEL(in + i), pred);                                \
+    out[i] = (uint32_t)_mm_cvtsi128_si32(L);                                   \
+  }                                                                            \
+}
+GENERATE_PREDICTOR_LEFT(5, Average2_128(                 // Average3(L, T, TR)
+    Average2_128(L, LOAD_PIXEL(upper + i + 1)), LOAD_PIXEL(upper + i)))
+GENERATE_PREDICTOR_LEFT(6, Average2_128(L, LOAD_PIXEL(upper + i - 1)))
+GENERATE_PREDICTOR_LEFT(7, Average2_128(L, LOAD_PIXEL(upper + i)))
+#undef GENERATE_PREDICTOR_LEFT
+
+// Average4(L, TL, T, TR), with Average2(T, TR) computed 8 pixels at a time.
+static void PredictorAdd10(const uint32_t* in, const uint32_t* upper,
+                           int num_pixels, uint32_t* out) {
+  __m128i L = LOAD_PIXEL(out - 1);
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    uint32_t avg_top[8];
+    int k;
+    STORE(avg_top, Average2_256(LOAD(upper + i), LOAD(upper + i + 1)));
+    for (k = 0; k < 8; ++k) {
+      const __m128i avg_left = Average2_128(L, LOAD_PIXEL(upper + i + k - 1));
+      const __m128i pred = Average2_128(avg_left, LOAD_PIXEL(avg_top + k));
+      L = _mm_add_epi8(LOAD_PIXEL(in + i + k), pred);
+      out[i + k] = (uint32_t)_mm_cvtsi128_si32(L);
+    }
+  }
+  if (i != num_pixels) {
+    VP8LPredictorsAdd_C[10](in + i, upper + i, num_pixels - i, out + i);
+  }
+}
+
+// Returns the sum of |a - b| over the 4 channels of each pixel.
+static WEBP_INLINE __m256i SumAbsDiff_256(const __m256i a, const __m256i b) {
+  const __m256i abs_diff = _mm256_or_si256(_mm256_subs_epu8(a, b),
+                                           _mm256_subs_epu8(b, a));
+  const __m256i sum16 = _mm256_maddubs_epi16(abs_diff, _mm256_set1_epi8(1));
+  return _mm256_madd_epi16(sum16, _mm256_set1_epi16(1));
+}
+
+// Select(T, L, TL): T if sum|L - TL| <= sum|T - TL|, else L. The latter sums
+// are computed 8 pixels at a time.
+static void PredictorAdd11(const uint32_t* in, const uint32_t* upper,
+                           int num_pixels, uint32_t* out) {
+  __m128i L = LOAD_PIXEL(out - 1);
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    int32_t sum_top[8];
+    int k;
+    STORE(sum_top, SumAbsDiff_256(LOAD(upper + i), LOAD(upper + i - 1)));
+    for (k = 0; k < 8; ++k) {
+      const __m128i TL = LOAD_PIXEL(upper + i + k - 1);
+      const int sum_left = _mm_cvtsi128_si32(_mm_sad_epu8(L, TL));
+      const __m128i pred =
+          (sum_left <= sum_top[k]) ? LOAD_PIXEL(upper + i + k) : L;
+      L = _mm_add_epi8(LOAD_PIXEL(in + i + k), pred);
+      out[i + k] = (uint32_t)_mm_cvtsi128_si32(L);
+    }
+  }
+  if (i != num_pixels) {
+    VP8LPredictorsAdd_C[11](in + i, upper + i, num_pixels - i, out + i);
+  }
+}
+
+// ClampedAddSubtractFull(L, T, TL): the 16b differences T - TL are computed
+// 8 pixels at a time.
+static void PredictorAdd12(const uint32_t* in, const uint32_t* upper,
+                           int num_pixels, uint32_t* out) {
+  __m128i L = LOAD_PIXEL(out - 1);
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    int16_t diff[32];
+    int k;
+    const __m256i T = LOAD(upper + i);
+    const __m256i TL = LOAD(upper + i - 1);
+    const __m256i T_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(T));
+    const __m256i T_hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(T, 1));
+    const __m256i TL_lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(TL));
+    const __m256i TL_hi =
+        _mm256_cvtepu8_epi16(_mm256_extracti128_si256(TL, 1));
+    STORE(diff + 0, _mm256_sub_epi16(T_lo, TL_lo));
+    STORE(diff + 16, _mm256_sub_epi16(T_hi, TL_hi));
+    for (k = 0; k < 8; ++k) {
+      const __m128i sum = _mm_add_epi16(
+          _mm_cvtepu8_epi16(L), _mm_loadl_epi64((const __m128i*)(diff + 4 * k)));
+      const __m128i pred = _mm_packus_epi16(sum, sum);
+      L = _mm_add_epi8(LOAD_PIXEL(in + i + k), pred);
+      out[i + k] = (uint32_t)_mm_cvtsi128_si32(L);
+    }
+  }
+  if (i != num_pixels) {
+    VP8LPredictorsAdd_C[12](in + i, upper + i, num_pixels - i, out + i);
+  }
+}
+
+// ClampedAddSubtractHalf(L, T, TL) = clip(avg + (avg - TL) / 2), with
+// avg = Average2(L, T) and the division rounding towards zero.
+static void PredictorAdd13(const uint32_t* in, const uint32_t* upper,
+                           int num_pixels, uint32_t* out) {
+  __m128i L = LOAD_PIXEL(out - 1);
+  int i;
+  for (i = 0; i < num_pixels; ++i) {
+    const __m128i T = _mm_cvtepu8_epi16(LOAD_PIXEL(upper + i));
+    const __m128i TL = _mm_cvtepu8_epi16(LOAD_PIXEL(upper + i - 1));
+    const __m128i avg =
+        _mm_srli_epi16(_mm_add_epi16(_mm_cvtepu8_epi16(L), T), 1);
+    const __m128i A1 = _mm_sub_epi16(avg, TL);
+    const __m128i TL_gt_avg = _mm_cmpgt_epi16(TL, avg);
+    const __m128i A2 = _mm_sub_epi16(A1, TL_gt_avg);   // +1 if negative
+    const __m128i A3 = _mm_add_epi16(avg, _mm_srai_epi16(A2, 1));
+    const __m128i pred = _mm_packus_epi16(A3, A3);
+    L = _mm_add_epi8(LOAD_PIXEL(in + i), pred);
+    out[i] = (uint32_t)_mm_cvtsi128_si32(L);
+  }
+}
+
+#undef LOAD_PIXEL
+
+//------------------------------------------------------------------------------
+// Subtract-Green Transform
+
+static void AddGreenToBlueAndRed(uint32_t* argb_data, int num_pixels) {
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    const __m256i in = LOAD(argb_data + i);                     // argb
+    const __m256i A = _mm256_srli_epi16(in, 8);                 // 0 a 0 g
+    const __m256i B = _mm256_shufflelo_epi16(A, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m256i C = _mm256_shufflehi_epi16(B, _MM_SHUFFLE(2, 2, 0, 0));
+    STORE(argb_data + i, _mm256_add_epi8(in, C));               // + 0g0g
+  }
+  // fallthrough and finish off with plain-C
+  VP8LAddGreenToBlueAndRed_C(argb_data + i, num_pixels - i);
+}
+
+//------------------------------------------------------------------------------
+// Color Transform
+
+// Same as the SSE2 version in lossless_sse2.c.
+static void TransformColorInverse(const VP8LMultipliers* const m,
+                                  uint32_t* argb_data, int num_pixels) {
+  // sign-extended multiplying constants, pre-shifted by 5.
+#define CST(X)  (((int16_t)(m->X << 8)) >> 5)   // sign-extend
+  const __m256i mults_rb = _mm256_set1_epi32(
+      (int)((uint32_t)(uint16_t)CST(green_to_red_) << 16 |
+            (uint16_t)CST(green_to_blue_)));
+  const __m256i mults_b2 = _mm256_set1_epi32(
+      (int)((uint32_t)(uint16_t)CST(red_to_blue_) << 16));
+#undef CST
+  const __m256i mask_ag = _mm256_set1_epi32(0xff00ff00);  // alpha-green masks
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    const __m256i in = LOAD(argb_data + i);                  // argb
+    const __m256i A = _mm256_and_si256(in, mask_ag);         // a   0   g   0
+    const __m256i B = _mm256_shufflelo_epi16(A, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m256i C = _mm256_shufflehi_epi16(B, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m256i D = _mm256_mulhi_epi16(C, mults_rb);       // x dr  x db1
+    const __m256i E = _mm256_add_epi8(in, D);                // x r'  x   b'
+    const __m256i F = _mm256_slli_epi16(E, 8);               // r' 0   b' 0
+    const __m256i G = _mm256_mulhi_epi16(F, mults_b2);       // x db2  0  0
+    const __m256i H = _mm256_srli_epi32(G, 8);               // 0  x db2  0
+    const __m256i I = _mm256_add_epi8(H, F);                 // r' x  b'' 0
+    const __m256i J = _mm256_srli_epi16(I, 8);               // 0  r'  0  b''
+    STORE(argb_data + i, _mm256_or_si256(J, A));
+  }
+  // Fall-back to C-version for left-overs.
+  VP8LTransformColorInverse_C(m, argb_data + i, num_pixels - i);
+}
+
+//------------------------------------------------------------------------------
+// Color-indexing lookups, gathering 8 palette entries at a time.
+
+static void MapARGB(const uint32_t* src, const uint32_t* const color_map,
+                    uint32_t* dst, int y_start, int y_end, int width) {
+  const __m256i mask = _mm256_set1_epi32(0xff);
+  const int num_pixels = (y_end - y_start) * width;
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    // index = (src >> 8) & 0xff, see VP8GetARGBIndex()
+    const __m256i idx = _mm256_and_si256(_mm256_srli_epi32(LOAD(src + i), 8),
+                                         mask);
+    STORE(dst + i, _mm256_i32gather_epi32((const int*)color_map, idx, 4));
+  }
+  for (; i < num_pixels; ++i) {
+    dst[i] = VP8GetARGBValue(color_map[VP8GetARGBIndex(src[i])]);
+  }
+}
+
+static void MapAlpha(const uint8_t* src, const uint32_t* const color_map,
+                     uint8_t* dst, int y_start, int y_end, int width) {
+  // keeps the green channel of each gathered entry, see VP8GetAlphaValue()
+  const __m256i shuffle = _mm256_setr_epi8(
+      1, 5, 9, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      1, 5, 9, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m256i merge = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+  const int num_pixels = (y_end - y_start) * width;
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    const __m256i idx =
+        _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+    const __m256i argb =
+        _mm256_i32gather_epi32((const int*)color_map, idx, 4);
+    const __m256i alpha = _mm256_shuffle_epi8(argb, shuffle);
+    const __m256i packed = _mm256_permutevar8x32_epi32(alpha, merge);
+    _mm_storel_epi64((__m128i*)(dst + i), _mm256_castsi256_si128(packed));
+  }
+  for (; i < num_pixels; ++i) {
+    dst[i] = VP8GetAlphaValue(color_map[VP8GetAlphaIndex(src[i])]);
+  }
+}
+
+#undef LOAD
+#undef STORE
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8LDspInitAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void VP8LDspInitAVX2(void) {
+  VP8LPredictorsAdd[0] = PredictorAdd0;
+  VP8LPredictorsAdd[1] = PredictorAdd1;
+  VP8LPredictorsAdd[2] = PredictorAdd2;
+  VP8LPredictorsAdd[3] = PredictorAdd3;
+  VP8LPredictorsAdd[4] = PredictorAdd4;
+  VP8LPredictorsAdd[5] = PredictorAdd5;
+  VP8LPredictorsAdd[6] = PredictorAdd6;
+  VP8LPredictorsAdd[7] = PredictorAdd7;
+  VP8LPredictorsAdd[8] = PredictorAdd8;
+  VP8LPredictorsAdd[9] = PredictorAdd9;
+  VP8LPredictorsAdd[10] = PredictorAdd10;
+  VP8LPredictorsAdd[11] = PredictorAdd11;
+  VP8LPredictorsAdd[12] = PredictorAdd12;
+  VP8LPredictorsAdd[13] = PredictorAdd13;
+  VP8LPredictorsAdd[14] = PredictorAdd0;  // <- padding security sentinels
+  VP8LPredictorsAdd[15] = PredictorAdd0;
+
+  VP8LAddGreenToBlueAndRed = AddGreenToBlueAndRed;
+  VP8LTransformColorInverse = TransformColorInverse;
+
+  VP8LMapColor32b = MapARGB;
+  VP8LMapColor8b = MapAlpha;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(VP8LDspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
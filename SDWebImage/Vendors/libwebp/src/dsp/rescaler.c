@@ -154,12 +154,65 @@ void WebPRescalerExportRowShrinkC(WebPRescaler* const wrk) {
 #undef MULT_FIX
 #undef ROUNDER
 
+//------------------------------------------------------------------------------
+// Separable filters (see WebPRescalerInitFilter())
+
+// Filters the source row 'src_y' horizontally, into its slot of 'rows'.
+static void ImportRowFilter(WebPRescaler* const wrk, const uint8_t* src) {
+  const int x_stride = wrk->num_channels;
+  const int num_taps = wrk->x_taps;
+  const int round =
+      1 << (WEBP_RESCALER_FILTER_BITS - WEBP_RESCALER_ROW_BITS - 1);
+  int32_t* const dst =
+      wrk->rows + (wrk->src_y % wrk->y_taps) * wrk->dst_width * x_stride;
+  const int* weights = wrk->x_weights;
+  int x_out, channel, k;
+  for (x_out = 0; x_out < wrk->dst_width; ++x_out, weights += num_taps) {
+    const uint8_t* const in = src + wrk->x_start[x_out] * x_stride;
+    for (channel = 0; channel < x_stride; ++channel) {
+      int sum = round;
+      for (k = 0; k < num_taps; ++k) {
+        sum += weights[k] * in[k * x_stride + channel];
+      }
+      dst[x_out * x_stride + channel] =
+          sum >> (WEBP_RESCALER_FILTER_BITS - WEBP_RESCALER_ROW_BITS);
+    }
+  }
+}
+
+// Filters the buffered rows vertically into 'dst'.
+static void ExportRowFilter(WebPRescaler* const wrk) {
+  const int shift = WEBP_RESCALER_FILTER_BITS + WEBP_RESCALER_ROW_BITS;
+  const int x_out_max = wrk->dst_width * wrk->num_channels;
+  const int y_start = wrk->y_start[wrk->dst_y];
+  const int* const weights = wrk->y_weights + wrk->dst_y * wrk->y_taps;
+  int32_t* const acc = (int32_t*)wrk->irow;
+  int x_out, k;
+  assert(wrk->src_y >= y_start + wrk->y_taps ||
+         wrk->src_y == wrk->src_height);
+  for (x_out = 0; x_out < x_out_max; ++x_out) acc[x_out] = 1 << (shift - 1);
+  for (k = 0; k < wrk->y_taps; ++k) {
+    const int w = weights[k];
+    if (w != 0) {
+      const int32_t* const row =
+          wrk->rows + ((y_start + k) % wrk->y_taps) * x_out_max;
+      for (x_out = 0; x_out < x_out_max; ++x_out) acc[x_out] += w * row[x_out];
+    }
+  }
+  for (x_out = 0; x_out < x_out_max; ++x_out) {
+    const int v = acc[x_out] >> shift;
+    wrk->dst[x_out] = (v < 0) ? 0 : (v > 255) ? 255 : v;
+  }
+}
+
 //------------------------------------------------------------------------------
 // Main entry calls
 
 void WebPRescalerImportRow(WebPRescaler* const wrk, const uint8_t* src) {
   assert(!WebPRescalerInputDone(wrk));
-  if (!wrk->x_expand) {
+  if (wrk->filter != WEBP_RESCALE_BOX) {
+    ImportRowFilter(wrk, src);
+  } else if (!wrk->x_expand) {
     WebPRescalerImportRowShrink(wrk, src);
   } else {
     WebPRescalerImportRowExpand(wrk, src);
@@ -167,7 +220,18 @@ void WebPRescalerImportRow(WebPRescaler* const wrk, const uint8_t* src) {
 }
 
 void WebPRescalerExportRow(WebPRescaler* const wrk) {
-  if (wrk->y_accum <= 0) {
+  if (wrk->filter != WEBP_RESCALE_BOX) {
+    if (wrk->y_accum <= 0) {
+      assert(!WebPRescalerOutputDone(wrk));
+      ExportRowFilter(wrk);
+      wrk->dst += wrk->dst_stride;
+      ++wrk->dst_y;
+      if (!WebPRescalerOutputDone(wrk)) {
+        const int y_end = wrk->y_start[wrk->dst_y] + wrk->y_taps;
+        wrk->y_accum = y_end - wrk->src_y;
+      }
+    }
+  } else if (wrk->y_accum <= 0) {
     assert(!WebPRescalerOutputDone(wrk));
     if (wrk->y_expand) {
       WebPRescalerExportRowExpand(wrk);
@@ -197,6 +261,7 @@ WebPRescalerExportRowFunc WebPRescalerExportRowExpand;
 WebPRescalerExportRowFunc WebPRescalerExportRowShrink;
 
 extern void WebPRescalerDspInitSSE2(void);
+extern void WebPRescalerDspInitAVX2(void);
 extern void WebPRescalerDspInitMIPS32(void);
 extern void WebPRescalerDspInitMIPSdspR2(void);
 extern void WebPRescalerDspInitNEON(void);
@@ -218,6 +283,11 @@ WEBP_TSAN_IGNORE_FUNCTION void WebPRescalerDspInit(void) {
       WebPRescalerDspInitSSE2();
     }
 #endif
+#if defined(WEBP_USE_AVX2)
+    if (VP8GetCPUInfo(kAVX2)) {
+      WebPRescalerDspInitAVX2();
+    }
+#endif
 #if defined(WEBP_USE_NEON)
     if (VP8GetCPUInfo(kNEON)) {
       WebPRescalerDspInitNEON();
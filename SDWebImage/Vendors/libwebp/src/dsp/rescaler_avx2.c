@@ -0,0 +1,409 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 Rescaling functions: horizontal shrinking import and row export,
+// bit-exact with the plain-C versions.
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+#include <immintrin.h>
+
+#include <assert.h>
+#include "../utils/rescaler.h"
+#include "../utils/utils.h"
+
+//------------------------------------------------------------------------------
+// Implementations of critical functions ImportRow / ExportRow
+
+#define ROUNDER (WEBP_RESCALER_ONE >> 1)
+#define MULT_FIX(x, y) (((uint64_t)(x) * (y) + ROUNDER) >> WEBP_RESCALER_RFIX)
+
+// Largest x_add / x_sub ratio handled by the single-channel shrinking import.
+#define MAX_SHRINK_RATIO 16
+// Number of input samples one group of 8 output samples can span, and the size
+// of the prefix-sum buffer covering them (rounded up for the 8-wide stores).
+#define MAX_GROUP_SPAN (8 * (MAX_SHRINK_RATIO + 1))
+#define PREFIX_SIZE (MAX_GROUP_SPAN + 1 + 8)
+
+// Returns the 32-bit lanes of 'v' shifted up by one lane, lane #0 being
+// taken from lane #7 of 'prev'.
+static WEBP_INLINE __m256i ShiftInLane7(const __m256i v, const __m256i prev) {
+  const __m256i rotate = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+  const __m256i A = _mm256_permutevar8x32_epi32(v, rotate);
+  const __m256i B = _mm256_permutevar8x32_epi32(prev, rotate);
+  return _mm256_blend_epi32(A, B, 0x01);
+}
+
+// Returns MULT_FIX(v[i], scale) for the eight 32-bit lanes of 'v'.
+static WEBP_INLINE __m256i MultFix8(const __m256i v, const __m256i scale) {
+  const __m256i rounder = _mm256_set1_epi64x(ROUNDER);
+  const __m256i A0 = _mm256_mul_epu32(v, scale);
+  const __m256i A1 = _mm256_mul_epu32(_mm256_srli_epi64(v, 32), scale);
+  const __m256i B0 = _mm256_srli_epi64(_mm256_add_epi64(A0, rounder), 32);
+  const __m256i B1 = _mm256_add_epi64(A1, rounder);
+  return _mm256_blend_epi32(B0, B1, 0xaa);
+}
+
+// Stores in prefix[1 + i] the running sums of 'src[0..len)', starting at 0.
+static void PrefixSums(const uint8_t* const src, int len,
+                       int32_t* const prefix) {
+  __m256i total = _mm256_setzero_si256();
+  int i;
+  prefix[0] = 0;
+  for (i = 0; i + 8 <= len; i += 8) {
+    const __m128i A = _mm_loadl_epi64((const __m128i*)(src + i));
+    const __m256i B = _mm256_cvtepu8_epi32(A);
+    const __m256i C = _mm256_add_epi32(B, _mm256_slli_si256(B, 4));
+    const __m256i D = _mm256_add_epi32(C, _mm256_slli_si256(C, 8));
+    // propagate the sum of the lower four lanes into the upper ones
+    const __m256i E = _mm256_shuffle_epi32(D, 0xff);
+    const __m256i F = _mm256_permute2x128_si256(E, E, 0x08);
+    const __m256i G = _mm256_add_epi32(_mm256_add_epi32(D, F), total);
+    _mm256_storeu_si256((__m256i*)(prefix + 1 + i), G);
+    total = _mm256_permutevar8x32_epi32(G, _mm256_set1_epi32(7));
+  }
+  for (; i < len; ++i) {
+    prefix[1 + i] = prefix[i] + src[i];
+  }
+}
+
+// The plain-C loop below is the same as in WebPRescalerImportRowShrinkC().
+// Each output sample x ends with the input sample n(x) - 1, where
+// n(x) = ceil((x + 1) * x_add / x_sub), and leaves
+// accum(x) = (x + 1) * x_add - n(x) * x_sub in ]-x_sub, 0]. Therefore, groups
+// of 8 output samples only need prefix sums of the input samples, gathered at
+// the indices n(x) and n(x) - 1, and the fractional part carried to the next
+// sample only depends on the current one.
+static void ImportRowShrink1(WebPRescaler* const wrk, const uint8_t* src) {
+  const int x_add = wrk->x_add;
+  const int x_sub = wrk->x_sub;
+  const int x_out_max = wrk->dst_width;
+  rescaler_t* const frow = wrk->frow;
+  int x_out = 0;
+  int x_in = 0;
+  uint32_t sum = 0;
+  int accum = 0;
+
+  if (x_out_max >= 8) {
+    int32_t prefix[PREFIX_SIZE];
+    // accum(x) and n(x) are moved 8 samples forward with:
+    const int step_q = (8 * x_add) / x_sub;
+    const int step_r = 8 * x_add - step_q * x_sub;
+    const __m256i r = _mm256_set1_epi32(step_r);
+    const __m256i q = _mm256_set1_epi32(step_q);
+    const __m256i sub = _mm256_set1_epi32(x_sub);
+    const __m256i scale = _mm256_set1_epi32(wrk->fx_scale);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i acc, n;
+    __m256i carry = zero;   // fractional part carried by lane #7 (only)
+    {
+      int32_t tmp_acc[8], tmp_n[8];
+      int i, a = 0, k = 0;
+      for (i = 0; i < 8; ++i) {
+        a += x_add;
+        while (a > 0) {
+          a -= x_sub;
+          ++k;
+        }
+        tmp_acc[i] = a;
+        tmp_n[i] = k;
+      }
+      acc = _mm256_loadu_si256((const __m256i*)tmp_acc);
+      n = _mm256_loadu_si256((const __m256i*)tmp_n);
+    }
+    for (; x_out + 8 <= x_out_max; x_out += 8) {
+      const int x_end = _mm256_extract_epi32(n, 7);
+      const __m256i first = _mm256_set1_epi32(x_in);
+      PrefixSums(src + x_in, x_end - x_in, prefix);
+      {
+        const __m256i idx = _mm256_sub_epi32(n, first);
+        const __m256i S1 = _mm256_i32gather_epi32(prefix, idx, 4);
+        const __m256i S2 =
+            _mm256_i32gather_epi32(prefix, _mm256_sub_epi32(idx, one), 4);
+        const __m256i S0 = ShiftInLane7(S1, zero);
+        const __m256i base = _mm256_sub_epi32(S1, S2);
+        const __m256i frac =
+            _mm256_mullo_epi32(base, _mm256_sub_epi32(zero, acc));
+        const __m256i new_carry = MultFix8(frac, scale);
+        const __m256i s = _mm256_add_epi32(_mm256_sub_epi32(S1, S0),
+                                           ShiftInLane7(new_carry, carry));
+        const __m256i out = _mm256_sub_epi32(_mm256_mullo_epi32(s, sub), frac);
+        _mm256_storeu_si256((__m256i*)(frow + x_out), out);
+        carry = new_carry;
+      }
+      x_in = x_end;
+      {
+        const __m256i A = _mm256_add_epi32(acc, r);
+        const __m256i mask = _mm256_cmpgt_epi32(A, zero);   // -1 or 0
+        acc = _mm256_sub_epi32(A, _mm256_and_si256(mask, sub));
+        n = _mm256_sub_epi32(_mm256_add_epi32(n, q), mask);
+      }
+    }
+    sum = (uint32_t)_mm256_extract_epi32(carry, 7);
+    accum = x_out * x_add - x_in * x_sub;   // accum(x_out - 1)
+  }
+  for (; x_out < x_out_max; ++x_out) {   // Finish off with plain C.
+    uint32_t base = 0;
+    accum += x_add;
+    while (accum > 0) {
+      accum -= x_sub;
+      assert(x_in < wrk->src_width);
+      base = src[x_in];
+      sum += base;
+      ++x_in;
+    }
+    {
+      const rescaler_t frac = base * (-accum);
+      frow[x_out] = sum * x_sub - frac;
+      sum = (int)MULT_FIX(frac, wrk->fx_scale);
+    }
+  }
+  assert(accum == 0);
+}
+
+// Same as RescalerImportRowShrinkSSE2() in rescaler_sse2.c.
+static void ImportRowShrink4(WebPRescaler* const wrk, const uint8_t* src) {
+  const int x_sub = wrk->x_sub;
+  int accum = 0;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i mult0 = _mm_set1_epi16(x_sub);
+  const __m128i mult1 = _mm_set1_epi32(wrk->fx_scale);
+  const __m128i rounder = _mm_set_epi32(0, ROUNDER, 0, ROUNDER);
+  __m128i sum = zero;
+  rescaler_t* frow = wrk->frow;
+  const rescaler_t* const frow_end = wrk->frow + 4 * wrk->dst_width;
+
+  for (; frow < frow_end; frow += 4) {
+    __m128i base = zero;
+    accum += wrk->x_add;
+    while (accum > 0) {
+      const __m128i A = _mm_cvtsi32_si128(WebPMemToUint32(src));
+      src += 4;
+      base = _mm_unpacklo_epi8(A, zero);
+      sum = _mm_add_epi16(sum, base);
+      accum -= x_sub;
+    }
+    {    // Emit next horizontal pixel.
+      const __m128i mult = _mm_set1_epi16(-accum);
+      const __m128i frac0 = _mm_mullo_epi16(base, mult);  // 16b x 16b -> 32b
+      const __m128i frac1 = _mm_mulhi_epu16(base, mult);
+      const __m128i frac = _mm_unpacklo_epi16(frac0, frac1);  // frac is 32b
+      const __m128i A0 = _mm_mullo_epi16(sum, mult0);
+      const __m128i A1 = _mm_mulhi_epu16(sum, mult0);
+      const __m128i B0 = _mm_unpacklo_epi16(A0, A1);      // sum * x_sub
+      const __m128i frow_out = _mm_sub_epi32(B0, frac);   // sum * x_sub - frac
+      const __m128i D0 = _mm_srli_epi64(frac, 32);
+      const __m128i D1 = _mm_mul_epu32(frac, mult1);      // 32b x 16b -> 64b
+      const __m128i D2 = _mm_mul_epu32(D0, mult1);
+      const __m128i E1 = _mm_add_epi64(D1, rounder);
+      const __m128i E2 = _mm_add_epi64(D2, rounder);
+      const __m128i F1 = _mm_shuffle_epi32(E1, 1 | (3 << 2));
+      const __m128i F2 = _mm_shuffle_epi32(E2, 1 | (3 << 2));
+      const __m128i G = _mm_unpacklo_epi32(F1, F2);
+      sum = _mm_packs_epi32(G, zero);
+      _mm_storeu_si128((__m128i*)frow, frow_out);
+    }
+  }
+  assert(accum == 0);
+}
+
+static void RescalerImportRowShrinkAVX2(WebPRescaler* const wrk,
+                                        const uint8_t* src) {
+  assert(!WebPRescalerInputDone(wrk));
+  assert(!wrk->x_expand);
+  if (wrk->num_channels == 1 &&
+      wrk->x_add <= wrk->x_sub * MAX_SHRINK_RATIO) {
+    ImportRowShrink1(wrk, src);
+  } else if (wrk->num_channels == 4 && wrk->x_add <= (wrk->x_sub << 7)) {
+    // To avoid overflow, we need: base * x_add / x_sub < 32768
+    // => x_add < x_sub << 7. That's a 1/128 reduction ratio limit.
+    ImportRowShrink4(wrk, src);
+  } else {
+    WebPRescalerImportRowShrinkC(wrk, src);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Row export
+
+// Returns MULT_FIX(v, mult) for the 32-bit values stored in the low halves of
+// the 64-bit lanes of 'even' and 'odd', packed as 16 bytes (8 from each, in
+// the original order).
+static WEBP_INLINE __m256i MultFixAndBlend(const __m256i even,
+                                           const __m256i odd,
+                                           const __m256i mult) {
+  const __m256i rounder = _mm256_set1_epi64x(ROUNDER);
+  const __m256i A0 = _mm256_add_epi64(_mm256_mul_epu32(even, mult), rounder);
+  const __m256i A1 = _mm256_add_epi64(_mm256_mul_epu32(odd, mult), rounder);
+  return _mm256_blend_epi32(_mm256_srli_epi64(A0, 32), A1, 0xaa);
+}
+
+// Packs the 16 values of 'A' and 'B' (in [0, 255]) and stores them in 'dst'.
+static WEBP_INLINE void PackAndStore16(const __m256i A, const __m256i B,
+                                       uint8_t* const dst) {
+  const __m256i C = _mm256_packs_epi32(A, B);
+  const __m256i D = _mm256_permute4x64_epi64(C, 0xd8);
+  const __m256i E = _mm256_packus_epi16(D, D);
+  const __m256i F = _mm256_permute4x64_epi64(E, 0x08);
+  _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(F));
+}
+
+// Loads 8 values and splits them into the low halves of the 64-bit lanes.
+static WEBP_INLINE void LoadDispatch(const rescaler_t* const src,
+                                     __m256i* const even, __m256i* const odd) {
+  *even = _mm256_loadu_si256((const __m256i*)src);
+  *odd = _mm256_srli_epi64(*even, 32);
+}
+
+// Returns (A * a[i] + B * b[i] + ROUNDER) >> WEBP_RESCALER_RFIX, in the low
+// halves of the 64-bit lanes.
+static WEBP_INLINE __m256i Interpolate(const __m256i a, const __m256i b,
+                                       const __m256i A, const __m256i B) {
+  const __m256i rounder = _mm256_set1_epi64x(ROUNDER);
+  const __m256i C = _mm256_add_epi64(_mm256_mul_epu32(a, A),
+                                     _mm256_mul_epu32(b, B));
+  return _mm256_srli_epi64(_mm256_add_epi64(C, rounder), WEBP_RESCALER_RFIX);
+}
+
+static void RescalerExportRowExpandAVX2(WebPRescaler* const wrk) {
+  int x_out;
+  uint8_t* const dst = wrk->dst;
+  rescaler_t* const irow = wrk->irow;
+  const int x_out_max = wrk->dst_width * wrk->num_channels;
+  const rescaler_t* const frow = wrk->frow;
+  const __m256i mult = _mm256_set1_epi64x(wrk->fy_scale);
+
+  assert(!WebPRescalerOutputDone(wrk));
+  assert(wrk->y_accum <= 0 && wrk->y_sub + wrk->y_accum >= 0);
+  assert(wrk->y_expand);
+  if (wrk->y_accum == 0) {
+    for (x_out = 0; x_out + 16 <= x_out_max; x_out += 16) {
+      __m256i A0, A1, B0, B1;
+      LoadDispatch(frow + x_out + 0, &A0, &A1);
+      LoadDispatch(frow + x_out + 8, &B0, &B1);
+      PackAndStore16(MultFixAndBlend(A0, A1, mult),
+                     MultFixAndBlend(B0, B1, mult), dst + x_out);
+    }
+    for (; x_out < x_out_max; ++x_out) {
+      const uint32_t J = frow[x_out];
+      const int v = (int)MULT_FIX(J, wrk->fy_scale);
+      assert(v >= 0 && v <= 255);
+      dst[x_out] = v;
+    }
+  } else {
+    const uint32_t B = WEBP_RESCALER_FRAC(-wrk->y_accum, wrk->y_sub);
+    const uint32_t A = (uint32_t)(WEBP_RESCALER_ONE - B);
+    const __m256i mA = _mm256_set1_epi64x(A);
+    const __m256i mB = _mm256_set1_epi64x(B);
+    for (x_out = 0; x_out + 16 <= x_out_max; x_out += 16) {
+      __m256i F0, F1, F2, F3, I0, I1, I2, I3;
+      LoadDispatch(frow + x_out + 0, &F0, &F1);
+      LoadDispatch(frow + x_out + 8, &F2, &F3);
+      LoadDispatch(irow + x_out + 0, &I0, &I1);
+      LoadDispatch(irow + x_out + 8, &I2, &I3);
+      {
+        const __m256i J0 = Interpolate(F0, I0, mA, mB);
+        const __m256i J1 = Interpolate(F1, I1, mA, mB);
+        const __m256i J2 = Interpolate(F2, I2, mA, mB);
+        const __m256i J3 = Interpolate(F3, I3, mA, mB);
+        PackAndStore16(MultFixAndBlend(J0, J1, mult),
+                       MultFixAndBlend(J2, J3, mult), dst + x_out);
+      }
+    }
+    for (; x_out < x_out_max; ++x_out) {
+      const uint64_t I = (uint64_t)A * frow[x_out]
+                       + (uint64_t)B * irow[x_out];
+      const uint32_t J = (uint32_t)((I + ROUNDER) >> WEBP_RESCALER_RFIX);
+      const int v = (int)MULT_FIX(J, wrk->fy_scale);
+      assert(v >= 0 && v <= 255);
+      dst[x_out] = v;
+    }
+  }
+}
+
+static void RescalerExportRowShrinkAVX2(WebPRescaler* const wrk) {
+  int x_out;
+  uint8_t* const dst = wrk->dst;
+  rescaler_t* const irow = wrk->irow;
+  const int x_out_max = wrk->dst_width * wrk->num_channels;
+  const rescaler_t* const frow = wrk->frow;
+  const uint32_t yscale = wrk->fy_scale * (-wrk->y_accum);
+  assert(!WebPRescalerOutputDone(wrk));
+  assert(wrk->y_accum <= 0);
+  assert(!wrk->y_expand);
+  if (yscale) {
+    const __m256i mult_xy = _mm256_set1_epi64x(wrk->fxy_scale);
+    const __m256i mult_y = _mm256_set1_epi32(yscale);
+    for (x_out = 0; x_out + 16 <= x_out_max; x_out += 16) {
+      const __m256i F0 = _mm256_loadu_si256((const __m256i*)(frow + x_out));
+      const __m256i F1 =
+          _mm256_loadu_si256((const __m256i*)(frow + x_out + 8));
+      const __m256i I0 = _mm256_loadu_si256((const __m256i*)(irow + x_out));
+      const __m256i I1 =
+          _mm256_loadu_si256((const __m256i*)(irow + x_out + 8));
+      const __m256i frac0 = MultFix8(F0, mult_y);
+      const __m256i frac1 = MultFix8(F1, mult_y);
+      const __m256i A0 = _mm256_sub_epi32(I0, frac0);   // irow[x] - frac
+      const __m256i A1 = _mm256_sub_epi32(I1, frac1);
+      _mm256_storeu_si256((__m256i*)(irow + x_out + 0), frac0);
+      _mm256_storeu_si256((__m256i*)(irow + x_out + 8), frac1);
+      PackAndStore16(MultFixAndBlend(A0, _mm256_srli_epi64(A0, 32), mult_xy),
+                     MultFixAndBlend(A1, _mm256_srli_epi64(A1, 32), mult_xy),
+                     dst + x_out);
+    }
+    for (; x_out < x_out_max; ++x_out) {
+      const uint32_t frac = (int)MULT_FIX(frow[x_out], yscale);
+      const int v = (int)MULT_FIX(irow[x_out] - frac, wrk->fxy_scale);
+      assert(v >= 0 && v <= 255);
+      dst[x_out] = v;
+      irow[x_out] = frac;   // new fractional start
+    }
+  } else {
+    const uint32_t scale = wrk->fxy_scale;
+    const __m256i mult = _mm256_set1_epi64x(scale);
+    const __m256i zero = _mm256_setzero_si256();
+    for (x_out = 0; x_out + 16 <= x_out_max; x_out += 16) {
+      __m256i A0, A1, B0, B1;
+      LoadDispatch(irow + x_out + 0, &A0, &A1);
+      LoadDispatch(irow + x_out + 8, &B0, &B1);
+      _mm256_storeu_si256((__m256i*)(irow + x_out + 0), zero);
+      _mm256_storeu_si256((__m256i*)(irow + x_out + 8), zero);
+      PackAndStore16(MultFixAndBlend(A0, A1, mult),
+                     MultFixAndBlend(B0, B1, mult), dst + x_out);
+    }
+    for (; x_out < x_out_max; ++x_out) {
+      const int v = (int)MULT_FIX(irow[x_out], scale);
+      assert(v >= 0 && v <= 255);
+      dst[x_out] = v;
+      irow[x_out] = 0;
+    }
+  }
+}
+
+#undef MULT_FIX
+#undef ROUNDER
+
+//------------------------------------------------------------------------------
+
+extern void WebPRescalerDspInitAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPRescalerDspInitAVX2(void) {
+  // The expanding import is still the SSE2 one.
+  WebPRescalerImportRowShrink = RescalerImportRowShrinkAVX2;
+  WebPRescalerExportRowExpand = RescalerExportRowExpandAVX2;
+  WebPRescalerExportRowShrink = RescalerExportRowShrinkAVX2;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(WebPRescalerDspInitAVX2)
+
+#endif  // WEBP_USE_AVX2
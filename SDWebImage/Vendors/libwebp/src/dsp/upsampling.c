@@ -104,6 +104,75 @@ UPSAMPLE_FUNC(UpsampleRgb565LinePair,  VP8YuvToRgb565,  2)
 #undef LOAD_UV
 #undef UPSAMPLE_FUNC
 
+//------------------------------------------------------------------------------
+// Premultiplied variants. The plain-C versions convert the rows first and
+// multiply the alpha in while they are still in cache.
+
+WebPUpsampleAlphaLinePairFunc WebPUpsamplersPremultiplied[MODE_LAST];
+
+static WEBP_INLINE void PremultiplyRow(const uint8_t* a, uint8_t* const dst,
+                                       int len, int alpha_first) {
+  uint8_t* const rgb = dst + (alpha_first ? 1 : 0);
+  uint8_t* const alpha = dst + (alpha_first ? 0 : 3);
+  int i;
+  for (i = 0; i < len; ++i) {
+    alpha[4 * i] = a[i];
+    rgb[4 * i + 0] = VP8PremultiplyAlpha(rgb[4 * i + 0], a[i]);
+    rgb[4 * i + 1] = VP8PremultiplyAlpha(rgb[4 * i + 1], a[i]);
+    rgb[4 * i + 2] = VP8PremultiplyAlpha(rgb[4 * i + 2], a[i]);
+  }
+}
+
+static void PremultiplyRgbaRow(const uint8_t* a, uint8_t* dst, int len) {
+  PremultiplyRow(a, dst, len, 0);
+}
+
+static void PremultiplyArgbRow(const uint8_t* a, uint8_t* dst, int len) {
+  PremultiplyRow(a, dst, len, 1);
+}
+
+static void PremultiplyRgba4444Row(const uint8_t* a, uint8_t* dst, int len) {
+#ifdef WEBP_SWAP_16BIT_CSP
+  const int rg_byte_pos = 1;
+#else
+  const int rg_byte_pos = 0;
+#endif
+  int i;
+  for (i = 0; i < len; ++i) {
+    const int a4 = a[i] >> 4;
+    const int rg = dst[2 * i + rg_byte_pos];
+    const int ba = dst[2 * i + (rg_byte_pos ^ 1)];
+    const int r = VP8PremultiplyAlpha4(rg >> 4, a4);
+    const int g = VP8PremultiplyAlpha4(rg & 0x0f, a4);
+    const int b = VP8PremultiplyAlpha4(ba >> 4, a4);
+    dst[2 * i + rg_byte_pos] = r | (g >> 4);
+    dst[2 * i + (rg_byte_pos ^ 1)] = b | a4;
+  }
+}
+
+#define UPSAMPLE_PREMUL_FUNC(FUNC_NAME, UPSAMPLE, PREMULTIPLY)                 \
+static void FUNC_NAME(const uint8_t* top_y, const uint8_t* bottom_y,           \
+                      const uint8_t* top_u, const uint8_t* top_v,              \
+                      const uint8_t* cur_u, const uint8_t* cur_v,              \
+                      const uint8_t* top_a, const uint8_t* bottom_a,           \
+                      uint8_t* top_dst, uint8_t* bottom_dst, int len) {        \
+  UPSAMPLE(top_y, bottom_y, top_u, top_v, cur_u, cur_v,                        \
+           top_dst, bottom_dst, len);                                          \
+  PREMULTIPLY(top_a, top_dst, len);                                            \
+  if (bottom_y != NULL) PREMULTIPLY(bottom_a, bottom_dst, len);                \
+}
+
+UPSAMPLE_PREMUL_FUNC(UpsampleRgbaPremulLinePair, UpsampleRgbaLinePair,
+                     PremultiplyRgbaRow)
+UPSAMPLE_PREMUL_FUNC(UpsampleBgraPremulLinePair, UpsampleBgraLinePair,
+                     PremultiplyRgbaRow)
+UPSAMPLE_PREMUL_FUNC(UpsampleArgbPremulLinePair, UpsampleArgbLinePair,
+                     PremultiplyArgbRow)
+UPSAMPLE_PREMUL_FUNC(UpsampleRgba4444PremulLinePair, UpsampleRgba4444LinePair,
+                     PremultiplyRgba4444Row)
+
+#undef UPSAMPLE_PREMUL_FUNC
+
 #endif  // FANCY_UPSAMPLING
 
 //------------------------------------------------------------------------------
@@ -213,6 +282,7 @@ WEBP_TSAN_IGNORE_FUNCTION void WebPInitYUV444Converters(void) {
 // Main calls
 
 extern void WebPInitUpsamplersSSE2(void);
+extern void WebPInitUpsamplersAVX2(void);
 extern void WebPInitUpsamplersNEON(void);
 extern void WebPInitUpsamplersMIPSdspR2(void);
 
@@ -235,6 +305,11 @@ WEBP_TSAN_IGNORE_FUNCTION void WebPInitUpsamplers(void) {
   WebPUpsamplers[MODE_Argb]      = UpsampleArgbLinePair;
   WebPUpsamplers[MODE_rgbA_4444] = UpsampleRgba4444LinePair;
 
+  WebPUpsamplersPremultiplied[MODE_rgbA] = UpsampleRgbaPremulLinePair;
+  WebPUpsamplersPremultiplied[MODE_bgrA] = UpsampleBgraPremulLinePair;
+  WebPUpsamplersPremultiplied[MODE_Argb] = UpsampleArgbPremulLinePair;
+  WebPUpsamplersPremultiplied[MODE_rgbA_4444] = UpsampleRgba4444PremulLinePair;
+
   // If defined, use CPUInfo() to overwrite some pointers with faster versions.
   if (VP8GetCPUInfo != NULL) {
 #if defined(WEBP_USE_SSE2)
@@ -242,6 +317,11 @@ WEBP_TSAN_IGNORE_FUNCTION void WebPInitUpsamplers(void) {
       WebPInitUpsamplersSSE2();
     }
 #endif
+#if defined(WEBP_USE_AVX2)
+    if (VP8GetCPUInfo(kAVX2)) {
+      WebPInitUpsamplersAVX2();
+    }
+#endif
 #if defined(WEBP_USE_NEON)
     if (VP8GetCPUInfo(kNEON)) {
       WebPInitUpsamplersNEON();
@@ -0,0 +1,298 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 version of YUV to RGB upsampling functions, bit-exact with the SSE2
+// ones (upsampling_sse2.c).
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_AVX2)
+
+#include <assert.h>
+#include <immintrin.h>
+#include <string.h>
+#include "./yuv.h"
+
+#ifdef FANCY_UPSAMPLING
+
+// See upsampling_sse2.c for the derivation of the 8b arithmetic used to
+// compute (9*a + 3*b + 3*c + d + 8) / 16. The U and V planes are upsampled
+// together: the U samples in the low half of the registers, the V samples in
+// the high half.
+
+// Computes out = (k + in + 1) / 2 - ((ij & (s^t)) | (k^in)) & 1
+#define GET_M(ij, in, out) do {                                                \
+  const __m256i tmp0 = _mm256_avg_epu8(k, (in));  /* (k + in + 1) / 2 */       \
+  const __m256i tmp1 = _mm256_and_si256((ij), st);  /* (ij) & (s^t) */         \
+  const __m256i tmp2 = _mm256_xor_si256(k, (in));   /* (k^in) */               \
+  const __m256i tmp3 = _mm256_or_si256(tmp1, tmp2); /* ((ij)&(s^t))|(k^in) */  \
+  const __m256i tmp4 = _mm256_and_si256(tmp3, one); /* & 1 -> lsb_correction */\
+  (out) = _mm256_sub_epi8(tmp0, tmp4); /* (k + in + 1) / 2 - lsb_correction */ \
+} while (0)
+
+// pack and store two alternating pixel rows, for both planes
+#define PACK_AND_STORE(a, b, da, db, out_u, out_v) do {                        \
+  const __m256i t_a = _mm256_avg_epu8(a, da); /* (9a + 3b + 3c +  d + 8) / 16 */\
+  const __m256i t_b = _mm256_avg_epu8(b, db); /* (3a + 9b +  c + 3d + 8) / 16 */\
+  const __m256i t_1 = _mm256_unpacklo_epi8(t_a, t_b);                          \
+  const __m256i t_2 = _mm256_unpackhi_epi8(t_a, t_b);                          \
+  _mm256_store_si256((__m256i*)(out_u),                                        \
+                     _mm256_permute2x128_si256(t_1, t_2, 0x20));               \
+  _mm256_store_si256((__m256i*)(out_v),                                        \
+                     _mm256_permute2x128_si256(t_1, t_2, 0x31));               \
+} while (0)
+
+// Loads 16 pixels from 'u' and 16 pixels from 'v' as one register.
+static WEBP_INLINE __m256i LoadUV(const uint8_t* const u,
+                                  const uint8_t* const v) {
+  const __m128i U = _mm_loadu_si128((const __m128i*)u);
+  const __m128i V = _mm_loadu_si128((const __m128i*)v);
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(U), V, 1);
+}
+
+// Loads 17 pixels each from rows r1 and r2 of the U and V planes and
+// generates 32 pixels for each.
+static void Upsample32Pixels(const uint8_t r1u[], const uint8_t r2u[],
+                             const uint8_t r1v[], const uint8_t r2v[],
+                             uint8_t* const out_u, uint8_t* const out_v) {
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i a = LoadUV(&r1u[0], &r1v[0]);
+  const __m256i b = LoadUV(&r1u[1], &r1v[1]);
+  const __m256i c = LoadUV(&r2u[0], &r2v[0]);
+  const __m256i d = LoadUV(&r2u[1], &r2v[1]);
+
+  const __m256i s = _mm256_avg_epu8(a, d);        // s = (a + d + 1) / 2
+  const __m256i t = _mm256_avg_epu8(b, c);        // t = (b + c + 1) / 2
+  const __m256i st = _mm256_xor_si256(s, t);      // st = s^t
+
+  const __m256i ad = _mm256_xor_si256(a, d);      // ad = a^d
+  const __m256i bc = _mm256_xor_si256(b, c);      // bc = b^c
+
+  const __m256i t1 = _mm256_or_si256(ad, bc);     // (a^d) | (b^c)
+  const __m256i t2 = _mm256_or_si256(t1, st);     // (a^d) | (b^c) | (s^t)
+  const __m256i t3 = _mm256_and_si256(t2, one);   // (a^d) | (b^c) | (s^t) & 1
+  const __m256i t4 = _mm256_avg_epu8(s, t);
+  const __m256i k = _mm256_sub_epi8(t4, t3);      // k = (a + b + c + d) / 4
+  __m256i diag1, diag2;
+
+  GET_M(bc, t, diag1);                  // diag1 = (a + 3b + 3c + d) / 8
+  GET_M(ad, s, diag2);                  // diag2 = (3a + b + c + 3d) / 8
+
+  // pack the alternate pixels
+  PACK_AND_STORE(a, b, diag1, diag2, out_u +  0, out_v +  0);  // store top
+  PACK_AND_STORE(c, d, diag2, diag1, out_u + 64, out_v + 64);  // store bottom
+}
+
+static void UpsampleLastBlock(const uint8_t* const tb_u,
+                              const uint8_t* const bb_u,
+                              const uint8_t* const tb_v,
+                              const uint8_t* const bb_v,
+                              int num_pixels,
+                              uint8_t* const out_u, uint8_t* const out_v) {
+  uint8_t r1u[17], r2u[17], r1v[17], r2v[17];
+  memcpy(r1u, tb_u, num_pixels);
+  memcpy(r2u, bb_u, num_pixels);
+  memcpy(r1v, tb_v, num_pixels);
+  memcpy(r2v, bb_v, num_pixels);
+  // replicate last byte
+  memset(r1u + num_pixels, r1u[num_pixels - 1], 17 - num_pixels);
+  memset(r2u + num_pixels, r2u[num_pixels - 1], 17 - num_pixels);
+  memset(r1v + num_pixels, r1v[num_pixels - 1], 17 - num_pixels);
+  memset(r2v + num_pixels, r2v[num_pixels - 1], 17 - num_pixels);
+  Upsample32Pixels(r1u, r2u, r1v, r2v, out_u, out_v);
+}
+
+#define CONVERT2RGB(FUNC, XSTEP, top_y, bottom_y,                              \
+                    top_dst, bottom_dst, cur_x, num_pixels) {                  \
+  int n;                                                                       \
+  for (n = 0; n < (num_pixels); ++n) {                                         \
+    FUNC(top_y[(cur_x) + n], r_u[n], r_v[n],                                   \
+         top_dst + ((cur_x) + n) * XSTEP);                                     \
+  }                                                                            \
+  if (bottom_y != NULL) {                                                      \
+    for (n = 0; n < (num_pixels); ++n) {                                       \
+      FUNC(bottom_y[(cur_x) + n], r_u[64 + n], r_v[64 + n],                    \
+           bottom_dst + ((cur_x) + n) * XSTEP);                                \
+    }                                                                          \
+  }                                                                            \
+}
+
+#define CONVERT2RGB_32(FUNC, XSTEP, top_y, bottom_y,                           \
+                       top_dst, bottom_dst, cur_x) do {                        \
+  FUNC##32AVX2(top_y + (cur_x), r_u, r_v, top_dst + (cur_x) * XSTEP);          \
+  if (bottom_y != NULL) {                                                      \
+    FUNC##32AVX2(bottom_y + (cur_x), r_u + 64, r_v + 64,                       \
+                 bottom_dst + (cur_x) * XSTEP);                                \
+  }                                                                            \
+} while (0)
+
+#define AVX2_UPSAMPLE_FUNC(FUNC_NAME, FUNC, XSTEP)                             \
+static void FUNC_NAME(const uint8_t* top_y, const uint8_t* bottom_y,           \
+                      const uint8_t* top_u, const uint8_t* top_v,              \
+                      const uint8_t* cur_u, const uint8_t* cur_v,              \
+                      uint8_t* top_dst, uint8_t* bottom_dst, int len) {        \
+  int uv_pos, pos;                                                             \
+  /* 32byte-aligned array to cache reconstructed u and v */                    \
+  uint8_t uv_buf[4 * 32 + 31];                                                 \
+  uint8_t* const r_u = (uint8_t*)((uintptr_t)(uv_buf + 31) & ~31);             \
+  uint8_t* const r_v = r_u + 32;                                               \
+                                                                               \
+  assert(top_y != NULL);                                                       \
+  {   /* Treat the first pixel in regular way */                               \
+    const int u_diag = ((top_u[0] + cur_u[0]) >> 1) + 1;                       \
+    const int v_diag = ((top_v[0] + cur_v[0]) >> 1) + 1;                       \
+    const int u0_t = (top_u[0] + u_diag) >> 1;                                 \
+    const int v0_t = (top_v[0] + v_diag) >> 1;                                 \
+    FUNC(top_y[0], u0_t, v0_t, top_dst);                                       \
+    if (bottom_y != NULL) {                                                    \
+      const int u0_b = (cur_u[0] + u_diag) >> 1;                               \
+      const int v0_b = (cur_v[0] + v_diag) >> 1;                               \
+      FUNC(bottom_y[0], u0_b, v0_b, bottom_dst);                               \
+    }                                                                          \
+  }                                                                            \
+  /* For Upsample32Pixels, 17 u/v values must be read-able for each block */   \
+  for (pos = 1, uv_pos = 0; pos + 32 + 1 <= len; pos += 32, uv_pos += 16) {    \
+    Upsample32Pixels(top_u + uv_pos, cur_u + uv_pos,                           \
+                     top_v + uv_pos, cur_v + uv_pos, r_u, r_v);                \
+    CONVERT2RGB_32(FUNC, XSTEP, top_y, bottom_y, top_dst, bottom_dst, pos);    \
+  }                                                                            \
+  if (len > 1) {                                                               \
+    const int left_over = ((len + 1) >> 1) - (pos >> 1);                       \
+    assert(left_over > 0);                                                     \
+    UpsampleLastBlock(top_u + uv_pos, cur_u + uv_pos,                          \
+                      top_v + uv_pos, cur_v + uv_pos, left_over, r_u, r_v);    \
+    CONVERT2RGB(FUNC, XSTEP, top_y, bottom_y, top_dst, bottom_dst,             \
+                pos, len - pos);                                               \
+  }                                                                            \
+}
+
+// AVX2 variants of the fancy upsampler.
+AVX2_UPSAMPLE_FUNC(UpsampleRgbaLinePair, VP8YuvToRgba, 4)
+AVX2_UPSAMPLE_FUNC(UpsampleBgraLinePair, VP8YuvToBgra, 4)
+AVX2_UPSAMPLE_FUNC(UpsampleArgbLinePair, VP8YuvToArgb, 4)
+AVX2_UPSAMPLE_FUNC(UpsampleRgba4444LinePair, VP8YuvToRgba4444, 2)
+AVX2_UPSAMPLE_FUNC(UpsampleRgb565LinePair, VP8YuvToRgb565, 2)
+
+// Premultiplied variants, also taking the alpha rows.
+
+#define CONVERT2RGBA(FUNC, XSTEP, top_y, bottom_y, top_a, bottom_a,            \
+                     top_dst, bottom_dst, cur_x, num_pixels) {                 \
+  int n;                                                                       \
+  for (n = 0; n < (num_pixels); ++n) {                                         \
+    FUNC(top_y[(cur_x) + n], r_u[n], r_v[n], top_a[(cur_x) + n],               \
+         top_dst + ((cur_x) + n) * XSTEP);                                     \
+  }                                                                            \
+  if (bottom_y != NULL) {                                                      \
+    for (n = 0; n < (num_pixels); ++n) {                                       \
+      FUNC(bottom_y[(cur_x) + n], r_u[64 + n], r_v[64 + n],                    \
+           bottom_a[(cur_x) + n], bottom_dst + ((cur_x) + n) * XSTEP);         \
+    }                                                                          \
+  }                                                                            \
+}
+
+#define CONVERT2RGBA_32(FUNC, XSTEP, top_y, bottom_y, top_a, bottom_a,         \
+                        top_dst, bottom_dst, cur_x) do {                       \
+  FUNC##32AVX2(top_y + (cur_x), r_u, r_v, top_a + (cur_x),                     \
+               top_dst + (cur_x) * XSTEP);                                     \
+  if (bottom_y != NULL) {                                                      \
+    FUNC##32AVX2(bottom_y + (cur_x), r_u + 64, r_v + 64, bottom_a + (cur_x),   \
+                 bottom_dst + (cur_x) * XSTEP);                                \
+  }                                                                            \
+} while (0)
+
+#define AVX2_UPSAMPLE_PREMUL_FUNC(FUNC_NAME, FUNC, XSTEP)                      \
+static void FUNC_NAME(const uint8_t* top_y, const uint8_t* bottom_y,           \
+                      const uint8_t* top_u, const uint8_t* top_v,              \
+                      const uint8_t* cur_u, const uint8_t* cur_v,              \
+                      const uint8_t* top_a, const uint8_t* bottom_a,           \
+                      uint8_t* top_dst, uint8_t* bottom_dst, int len) {        \
+  int uv_pos, pos;                                                             \
+  /* 32byte-aligned array to cache reconstructed u and v */                    \
+  uint8_t uv_buf[4 * 32 + 31];                                                 \
+  uint8_t* const r_u = (uint8_t*)((uintptr_t)(uv_buf + 31) & ~31);             \
+  uint8_t* const r_v = r_u + 32;                                               \
+                                                                               \
+  assert(top_y != NULL);                                                       \
+  {   /* Treat the first pixel in regular way */                               \
+    const int u_diag = ((top_u[0] + cur_u[0]) >> 1) + 1;                       \
+    const int v_diag = ((top_v[0] + cur_v[0]) >> 1) + 1;                       \
+    const int u0_t = (top_u[0] + u_diag) >> 1;                                 \
+    const int v0_t = (top_v[0] + v_diag) >> 1;                                 \
+    FUNC(top_y[0], u0_t, v0_t, top_a[0], top_dst);                             \
+    if (bottom_y != NULL) {                                                    \
+      const int u0_b = (cur_u[0] + u_diag) >> 1;                               \
+      const int v0_b = (cur_v[0] + v_diag) >> 1;                               \
+      FUNC(bottom_y[0], u0_b, v0_b, bottom_a[0], bottom_dst);                  \
+    }                                                                          \
+  }                                                                            \
+  /* For Upsample32Pixels, 17 u/v values must be read-able for each block */   \
+  for (pos = 1, uv_pos = 0; pos + 32 + 1 <= len; pos += 32, uv_pos += 16) {    \
+    Upsample32Pixels(top_u + uv_pos, cur_u + uv_pos,                           \
+                     top_v + uv_pos, cur_v + uv_pos, r_u, r_v);                \
+    CONVERT2RGBA_32(FUNC, XSTEP, top_y, bottom_y, top_a, bottom_a,             \
+                    top_dst, bottom_dst, pos);                                 \
+  }                                                                            \
+  if (len > 1) {                                                               \
+    const int left_over = ((len + 1) >> 1) - (pos >> 1);                       \
+    assert(left_over > 0);                                                     \
+    UpsampleLastBlock(top_u + uv_pos, cur_u + uv_pos,                          \
+                      top_v + uv_pos, cur_v + uv_pos, left_over, r_u, r_v);    \
+    CONVERT2RGBA(FUNC, XSTEP, top_y, bottom_y, top_a, bottom_a,                \
+                 top_dst, bottom_dst, pos, len - pos);                         \
+  }                                                                            \
+}
+
+AVX2_UPSAMPLE_PREMUL_FUNC(UpsampleRgbaPremulLinePair, VP8YuvToRgbaPremul, 4)
+AVX2_UPSAMPLE_PREMUL_FUNC(UpsampleBgraPremulLinePair, VP8YuvToBgraPremul, 4)
+AVX2_UPSAMPLE_PREMUL_FUNC(UpsampleArgbPremulLinePair, VP8YuvToArgbPremul, 4)
+AVX2_UPSAMPLE_PREMUL_FUNC(UpsampleRgba4444PremulLinePair,
+                          VP8YuvToRgba4444Premul, 2)
+
+#undef GET_M
+#undef PACK_AND_STORE
+#undef CONVERT2RGB
+#undef CONVERT2RGB_32
+#undef CONVERT2RGBA
+#undef CONVERT2RGBA_32
+#undef AVX2_UPSAMPLE_FUNC
+#undef AVX2_UPSAMPLE_PREMUL_FUNC
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern WebPUpsampleLinePairFunc WebPUpsamplers[/* MODE_LAST */];
+extern WebPUpsampleAlphaLinePairFunc
+    WebPUpsamplersPremultiplied[/* MODE_LAST */];
+
+extern void WebPInitUpsamplersAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPInitUpsamplersAVX2(void) {
+  WebPUpsamplers[MODE_RGBA] = UpsampleRgbaLinePair;
+  WebPUpsamplers[MODE_BGRA] = UpsampleBgraLinePair;
+  WebPUpsamplers[MODE_ARGB] = UpsampleArgbLinePair;
+  WebPUpsamplers[MODE_rgbA] = UpsampleRgbaLinePair;
+  WebPUpsamplers[MODE_bgrA] = UpsampleBgraLinePair;
+  WebPUpsamplers[MODE_Argb] = UpsampleArgbLinePair;
+  WebPUpsamplers[MODE_RGB_565] = UpsampleRgb565LinePair;
+  WebPUpsamplers[MODE_RGBA_4444] = UpsampleRgba4444LinePair;
+  WebPUpsamplers[MODE_rgbA_4444] = UpsampleRgba4444LinePair;
+
+  WebPUpsamplersPremultiplied[MODE_rgbA] = UpsampleRgbaPremulLinePair;
+  WebPUpsamplersPremultiplied[MODE_bgrA] = UpsampleBgraPremulLinePair;
+  WebPUpsamplersPremultiplied[MODE_Argb] = UpsampleArgbPremulLinePair;
+  WebPUpsamplersPremultiplied[MODE_rgbA_4444] = UpsampleRgba4444PremulLinePair;
+}
+
+#endif  // FANCY_UPSAMPLING
+
+#endif  // WEBP_USE_AVX2
+
+#if !(defined(FANCY_UPSAMPLING) && defined(WEBP_USE_AVX2))
+WEBP_DSP_INIT_STUB(WebPInitUpsamplersAVX2)
+#endif
@@ -177,18 +177,98 @@ SSE2_UPSAMPLE_FUNC(UpsampleArgbLinePair, VP8YuvToArgb, 4)
 SSE2_UPSAMPLE_FUNC(UpsampleRgba4444LinePair, VP8YuvToRgba4444, 2)
 SSE2_UPSAMPLE_FUNC(UpsampleRgb565LinePair, VP8YuvToRgb565, 2)
 
+// Premultiplied variants, also taking the alpha rows.
+
+#define CONVERT2RGBA(FUNC, XSTEP, top_y, bottom_y, top_a, bottom_a,            \
+                     top_dst, bottom_dst, cur_x, num_pixels) {                 \
+  int n;                                                                       \
+  for (n = 0; n < (num_pixels); ++n) {                                         \
+    FUNC(top_y[(cur_x) + n], r_u[n], r_v[n], top_a[(cur_x) + n],               \
+         top_dst + ((cur_x) + n) * XSTEP);                                     \
+  }                                                                            \
+  if (bottom_y != NULL) {                                                      \
+    for (n = 0; n < (num_pixels); ++n) {                                       \
+      FUNC(bottom_y[(cur_x) + n], r_u[64 + n], r_v[64 + n],                    \
+           bottom_a[(cur_x) + n], bottom_dst + ((cur_x) + n) * XSTEP);         \
+    }                                                                          \
+  }                                                                            \
+}
+
+#define CONVERT2RGBA_32(FUNC, XSTEP, top_y, bottom_y, top_a, bottom_a,         \
+                        top_dst, bottom_dst, cur_x) do {                       \
+  FUNC##32(top_y + (cur_x), r_u, r_v, top_a + (cur_x),                         \
+           top_dst + (cur_x) * XSTEP);                                         \
+  if (bottom_y != NULL) {                                                      \
+    FUNC##32(bottom_y + (cur_x), r_u + 64, r_v + 64, bottom_a + (cur_x),       \
+             bottom_dst + (cur_x) * XSTEP);                                    \
+  }                                                                            \
+} while (0)
+
+#define SSE2_UPSAMPLE_PREMUL_FUNC(FUNC_NAME, FUNC, XSTEP)                      \
+static void FUNC_NAME(const uint8_t* top_y, const uint8_t* bottom_y,           \
+                      const uint8_t* top_u, const uint8_t* top_v,              \
+                      const uint8_t* cur_u, const uint8_t* cur_v,              \
+                      const uint8_t* top_a, const uint8_t* bottom_a,           \
+                      uint8_t* top_dst, uint8_t* bottom_dst, int len) {        \
+  int uv_pos, pos;                                                             \
+  /* 16byte-aligned array to cache reconstructed u and v */                    \
+  uint8_t uv_buf[4 * 32 + 15];                                                 \
+  uint8_t* const r_u = (uint8_t*)((uintptr_t)(uv_buf + 15) & ~15);             \
+  uint8_t* const r_v = r_u + 32;                                               \
+                                                                               \
+  assert(top_y != NULL);                                                       \
+  {   /* Treat the first pixel in regular way */                               \
+    const int u_diag = ((top_u[0] + cur_u[0]) >> 1) + 1;                       \
+    const int v_diag = ((top_v[0] + cur_v[0]) >> 1) + 1;                       \
+    const int u0_t = (top_u[0] + u_diag) >> 1;                                 \
+    const int v0_t = (top_v[0] + v_diag) >> 1;                                 \
+    FUNC(top_y[0], u0_t, v0_t, top_a[0], top_dst);                             \
+    if (bottom_y != NULL) {                                                    \
+      const int u0_b = (cur_u[0] + u_diag) >> 1;                               \
+      const int v0_b = (cur_v[0] + v_diag) >> 1;                               \
+      FUNC(bottom_y[0], u0_b, v0_b, bottom_a[0], bottom_dst);                  \
+    }                                                                          \
+  }                                                                            \
+  /* For UPSAMPLE_32PIXELS, 17 u/v values must be read-able for each block */  \
+  for (pos = 1, uv_pos = 0; pos + 32 + 1 <= len; pos += 32, uv_pos += 16) {    \
+    UPSAMPLE_32PIXELS(top_u + uv_pos, cur_u + uv_pos, r_u);                    \
+    UPSAMPLE_32PIXELS(top_v + uv_pos, cur_v + uv_pos, r_v);                    \
+    CONVERT2RGBA_32(FUNC, XSTEP, top_y, bottom_y, top_a, bottom_a,             \
+                    top_dst, bottom_dst, pos);                                 \
+  }                                                                            \
+  if (len > 1) {                                                               \
+    const int left_over = ((len + 1) >> 1) - (pos >> 1);                       \
+    assert(left_over > 0);                                                     \
+    UPSAMPLE_LAST_BLOCK(top_u + uv_pos, cur_u + uv_pos, left_over, r_u);       \
+    UPSAMPLE_LAST_BLOCK(top_v + uv_pos, cur_v + uv_pos, left_over, r_v);       \
+    CONVERT2RGBA(FUNC, XSTEP, top_y, bottom_y, top_a, bottom_a,                \
+                 top_dst, bottom_dst, pos, len - pos);                         \
+  }                                                                            \
+}
+
+SSE2_UPSAMPLE_PREMUL_FUNC(UpsampleRgbaPremulLinePair, VP8YuvToRgbaPremul, 4)
+SSE2_UPSAMPLE_PREMUL_FUNC(UpsampleBgraPremulLinePair, VP8YuvToBgraPremul, 4)
+SSE2_UPSAMPLE_PREMUL_FUNC(UpsampleArgbPremulLinePair, VP8YuvToArgbPremul, 4)
+SSE2_UPSAMPLE_PREMUL_FUNC(UpsampleRgba4444PremulLinePair,
+                          VP8YuvToRgba4444Premul, 2)
+
 #undef GET_M
 #undef PACK_AND_STORE
 #undef UPSAMPLE_32PIXELS
 #undef UPSAMPLE_LAST_BLOCK
 #undef CONVERT2RGB
 #undef CONVERT2RGB_32
+#undef CONVERT2RGBA
+#undef CONVERT2RGBA_32
 #undef SSE2_UPSAMPLE_FUNC
+#undef SSE2_UPSAMPLE_PREMUL_FUNC
 
 //------------------------------------------------------------------------------
 // Entry point
 
 extern WebPUpsampleLinePairFunc WebPUpsamplers[/* MODE_LAST */];
+extern WebPUpsampleAlphaLinePairFunc
+    WebPUpsamplersPremultiplied[/* MODE_LAST */];
 
 extern void WebPInitUpsamplersSSE2(void);
 
@@ -204,6 +284,11 @@ WEBP_TSAN_IGNORE_FUNCTION void WebPInitUpsamplersSSE2(void) {
   WebPUpsamplers[MODE_RGB_565] = UpsampleRgb565LinePair;
   WebPUpsamplers[MODE_RGBA_4444] = UpsampleRgba4444LinePair;
   WebPUpsamplers[MODE_rgbA_4444] = UpsampleRgba4444LinePair;
+
+  WebPUpsamplersPremultiplied[MODE_rgbA] = UpsampleRgbaPremulLinePair;
+  WebPUpsamplersPremultiplied[MODE_bgrA] = UpsampleBgraPremulLinePair;
+  WebPUpsamplersPremultiplied[MODE_Argb] = UpsampleArgbPremulLinePair;
+  WebPUpsamplersPremultiplied[MODE_rgbA_4444] = UpsampleRgba4444PremulLinePair;
 }
 
 #endif  // FANCY_UPSAMPLING
@@ -98,6 +98,33 @@ ROW_FUNC(YuvToRgb565Row,   VP8YuvToRgb565, 2)
 
 #undef ROW_FUNC
 
+#define ROW_ALPHA_FUNC(FUNC_NAME, FUNC, XSTEP)                                 \
+static void FUNC_NAME(const uint8_t* y,                                        \
+                      const uint8_t* u, const uint8_t* v,                      \
+                      const uint8_t* a, uint8_t* dst, int len) {               \
+  const uint8_t* const end = dst + (len & ~1) * XSTEP;                         \
+  while (dst != end) {                                                         \
+    FUNC(y[0], u[0], v[0], a[0], dst);                                         \
+    FUNC(y[1], u[0], v[0], a[1], dst + XSTEP);                                 \
+    y += 2;                                                                    \
+    a += 2;                                                                    \
+    ++u;                                                                       \
+    ++v;                                                                       \
+    dst += 2 * XSTEP;                                                          \
+  }                                                                            \
+  if (len & 1) {                                                               \
+    FUNC(y[0], u[0], v[0], a[0], dst);                                         \
+  }                                                                            \
+}                                                                              \
+
+// Premultiplied variants.
+ROW_ALPHA_FUNC(YuvToRgbaPremulRow,     VP8YuvToRgbaPremul, 4)
+ROW_ALPHA_FUNC(YuvToBgraPremulRow,     VP8YuvToBgraPremul, 4)
+ROW_ALPHA_FUNC(YuvToArgbPremulRow,     VP8YuvToArgbPremul, 4)
+ROW_ALPHA_FUNC(YuvToRgba4444PremulRow, VP8YuvToRgba4444Premul, 2)
+
+#undef ROW_ALPHA_FUNC
+
 // Main call for processing a plane with a WebPSamplerRowFunc function:
 void WebPSamplerProcessPlane(const uint8_t* y, int y_stride,
                              const uint8_t* u, const uint8_t* v, int uv_stride,
@@ -115,12 +142,25 @@ void WebPSamplerProcessPlane(const uint8_t* y, int y_stride,
   }
 }
 
+static void InterleaveUV(const uint8_t* first, const uint8_t* second,
+                         uint8_t* dst, int len) {
+  int i;
+  for (i = 0; i < len; ++i) {
+    dst[2 * i + 0] = first[i];
+    dst[2 * i + 1] = second[i];
+  }
+}
+
 //-----------------------------------------------------------------------------
 // Main call
 
 WebPSamplerRowFunc WebPSamplers[MODE_LAST];
+WebPSamplerAlphaRowFunc WebPSamplersPremultiplied[MODE_LAST];
+void (*WebPInterleaveUV)(const uint8_t* first, const uint8_t* second,
+                         uint8_t* dst, int len);
 
 extern void WebPInitSamplersSSE2(void);
+extern void WebPInitSamplersAVX2(void);
 extern void WebPInitSamplersMIPS32(void);
 extern void WebPInitSamplersMIPSdspR2(void);
 
@@ -142,6 +182,13 @@ WEBP_TSAN_IGNORE_FUNCTION void WebPInitSamplers(void) {
   WebPSamplers[MODE_Argb]      = YuvToArgbRow;
   WebPSamplers[MODE_rgbA_4444] = YuvToRgba4444Row;
 
+  WebPSamplersPremultiplied[MODE_rgbA]      = YuvToRgbaPremulRow;
+  WebPSamplersPremultiplied[MODE_bgrA]      = YuvToBgraPremulRow;
+  WebPSamplersPremultiplied[MODE_Argb]      = YuvToArgbPremulRow;
+  WebPSamplersPremultiplied[MODE_rgbA_4444] = YuvToRgba4444PremulRow;
+
+  WebPInterleaveUV = InterleaveUV;
+
   // If defined, use CPUInfo() to overwrite some pointers with faster versions.
   if (VP8GetCPUInfo != NULL) {
 #if defined(WEBP_USE_SSE2)
@@ -149,6 +196,11 @@ WEBP_TSAN_IGNORE_FUNCTION void WebPInitSamplers(void) {
       WebPInitSamplersSSE2();
     }
 #endif  // WEBP_USE_SSE2
+#if defined(WEBP_USE_AVX2)
+    if (VP8GetCPUInfo(kAVX2)) {
+      WebPInitSamplersAVX2();
+    }
+#endif  // WEBP_USE_AVX2
 #if defined(WEBP_USE_MIPS32)
     if (VP8GetCPUInfo(kMIPS32)) {
       WebPInitSamplersMIPS32();
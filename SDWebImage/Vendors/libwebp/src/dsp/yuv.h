@@ -157,6 +157,65 @@ static WEBP_INLINE void VP8YuvToRgba(uint8_t y, uint8_t u, uint8_t v,
   rgba[3] = 0xff;
 }
 
+//-----------------------------------------------------------------------------
+// Premultiplied-alpha variants, bit-exact with the plain conversion followed
+// by WebPApplyAlphaMultiply() (resp. WebPApplyAlphaMultiply4444()).
+
+// (v * a * 32897) >> 23 is (int)(v * a / 255.) for all 8b 'v' and 'a'.
+static WEBP_INLINE int VP8PremultiplyAlpha(int v, int a) {
+  return (int)(((uint32_t)v * a * 32897U) >> 23);
+}
+
+// Same for the 4b 'v' and 'a', returned as the high nibble of a byte.
+static WEBP_INLINE int VP8PremultiplyAlpha4(int v, int a) {
+  return (((v * 0x11) * (a * 0x1111)) >> 16) & 0xf0;
+}
+
+static WEBP_INLINE void VP8YuvToRgbPremul(int y, int u, int v, int a,
+                                          uint8_t* const rgb) {
+  rgb[0] = VP8PremultiplyAlpha(VP8YUVToR(y, v), a);
+  rgb[1] = VP8PremultiplyAlpha(VP8YUVToG(y, u, v), a);
+  rgb[2] = VP8PremultiplyAlpha(VP8YUVToB(y, u), a);
+}
+
+static WEBP_INLINE void VP8YuvToRgbaPremul(uint8_t y, uint8_t u, uint8_t v,
+                                           uint8_t a, uint8_t* const rgba) {
+  VP8YuvToRgbPremul(y, u, v, a, rgba);
+  rgba[3] = a;
+}
+
+static WEBP_INLINE void VP8YuvToBgraPremul(uint8_t y, uint8_t u, uint8_t v,
+                                           uint8_t a, uint8_t* const bgra) {
+  bgra[0] = VP8PremultiplyAlpha(VP8YUVToB(y, u), a);
+  bgra[1] = VP8PremultiplyAlpha(VP8YUVToG(y, u, v), a);
+  bgra[2] = VP8PremultiplyAlpha(VP8YUVToR(y, v), a);
+  bgra[3] = a;
+}
+
+static WEBP_INLINE void VP8YuvToArgbPremul(uint8_t y, uint8_t u, uint8_t v,
+                                           uint8_t a, uint8_t* const argb) {
+  argb[0] = a;
+  VP8YuvToRgbPremul(y, u, v, a, argb + 1);
+}
+
+static WEBP_INLINE void VP8YuvToRgba4444Premul(uint8_t y, uint8_t u,
+                                               uint8_t v, uint8_t a,
+                                               uint8_t* const argb) {
+  const int a4 = a >> 4;
+  const int r = VP8PremultiplyAlpha4(VP8YUVToR(y, v) >> 4, a4);
+  const int g = VP8PremultiplyAlpha4(VP8YUVToG(y, u, v) >> 4, a4);
+  const int b = VP8PremultiplyAlpha4(VP8YUVToB(y, u) >> 4, a4);
+  const int rg = r | (g >> 4);
+  const int ba = b | a4;
+#ifdef WEBP_SWAP_16BIT_CSP
+  argb[0] = ba;
+  argb[1] = rg;
+#else
+  argb[0] = rg;
+  argb[1] = ba;
+#endif
+}
+
 // Must be called before everything, to initialize the tables.
 void VP8YUVInit(void);
 
@@ -181,8 +240,50 @@ void VP8YuvToRgba444432(const uint8_t* y, const uint8_t* u, const uint8_t* v,
 void VP8YuvToRgb56532(const uint8_t* y, const uint8_t* u, const uint8_t* v,
                       uint8_t* dst);
 
+// Same, multiplying the 32 alpha values 'a' into the (premultiplied) output.
+void VP8YuvToRgbaPremul32(const uint8_t* y, const uint8_t* u,
+                          const uint8_t* v, const uint8_t* a, uint8_t* dst);
+void VP8YuvToBgraPremul32(const uint8_t* y, const uint8_t* u,
+                          const uint8_t* v, const uint8_t* a, uint8_t* dst);
+void VP8YuvToArgbPremul32(const uint8_t* y, const uint8_t* u,
+                          const uint8_t* v, const uint8_t* a, uint8_t* dst);
+void VP8YuvToRgba4444Premul32(const uint8_t* y, const uint8_t* u,
+                              const uint8_t* v, const uint8_t* a,
+                              uint8_t* dst);
+
 #endif    // WEBP_USE_SSE2
 
+//-----------------------------------------------------------------------------
+// AVX2 extra functions (mostly for upsampling_avx2.c)
+
+#if defined(WEBP_USE_AVX2)
+
+// Same as the SSE2 functions above, bit-exact with them.
+void VP8YuvToRgba32AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                        uint8_t* dst);
+void VP8YuvToBgra32AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                        uint8_t* dst);
+void VP8YuvToArgb32AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                        uint8_t* dst);
+void VP8YuvToRgba444432AVX2(const uint8_t* y, const uint8_t* u,
+                            const uint8_t* v, uint8_t* dst);
+void VP8YuvToRgb56532AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                          uint8_t* dst);
+void VP8YuvToRgbaPremul32AVX2(const uint8_t* y, const uint8_t* u,
+                              const uint8_t* v, const uint8_t* a,
+                              uint8_t* dst);
+void VP8YuvToBgraPremul32AVX2(const uint8_t* y, const uint8_t* u,
+                              const uint8_t* v, const uint8_t* a,
+                              uint8_t* dst);
+void VP8YuvToArgbPremul32AVX2(const uint8_t* y, const uint8_t* u,
+                              const uint8_t* v, const uint8_t* a,
+                              uint8_t* dst);
+void VP8YuvToRgba4444Premul32AVX2(const uint8_t* y, const uint8_t* u,
+                                  const uint8_t* v, const uint8_t* a,
+                                  uint8_t* dst);
+
+#endif    // WEBP_USE_AVX2
+
 //------------------------------------------------------------------------------
 // RGB -> YUV conversion
 
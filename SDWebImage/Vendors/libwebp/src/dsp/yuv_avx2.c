@@ -0,0 +1,516 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// AVX2 version of the YUV->RGB conversion functions, bit-exact with the SSE2
+// ones (yuv_sse2.c) but processing 16 pixels per register.
+
+#include "./yuv.h"
+
+#if defined(WEBP_USE_AVX2)
+
+#include <immintrin.h>
+
+//-----------------------------------------------------------------------------
+// Convert spans of 32 pixels to various RGB formats for the fancy upsampler.
+
+// See yuv_sse2.c for the 14b fixed-point constants and the value ranges.
+static void ConvertYUV444ToRGB(const __m256i* const Y0,
+                               const __m256i* const U0,
+                               const __m256i* const V0,
+                               __m256i* const R,
+                               __m256i* const G,
+                               __m256i* const B) {
+  const __m256i k19077 = _mm256_set1_epi16(19077);
+  const __m256i k26149 = _mm256_set1_epi16(26149);
+  const __m256i k14234 = _mm256_set1_epi16(14234);
+  // 33050 doesn't fit in a signed short: only use this with unsigned arithmetic
+  const __m256i k33050 = _mm256_set1_epi16((short)33050);
+  const __m256i k17685 = _mm256_set1_epi16(17685);
+  const __m256i k6419  = _mm256_set1_epi16(6419);
+  const __m256i k13320 = _mm256_set1_epi16(13320);
+  const __m256i k8708  = _mm256_set1_epi16(8708);
+
+  const __m256i Y1 = _mm256_mulhi_epu16(*Y0, k19077);
+
+  const __m256i R0 = _mm256_mulhi_epu16(*V0, k26149);
+  const __m256i R1 = _mm256_sub_epi16(Y1, k14234);
+  const __m256i R2 = _mm256_add_epi16(R1, R0);
+
+  const __m256i G0 = _mm256_mulhi_epu16(*U0, k6419);
+  const __m256i G1 = _mm256_mulhi_epu16(*V0, k13320);
+  const __m256i G2 = _mm256_add_epi16(Y1, k8708);
+  const __m256i G3 = _mm256_add_epi16(G0, G1);
+  const __m256i G4 = _mm256_sub_epi16(G2, G3);
+
+  // be careful with the saturated *unsigned* arithmetic here!
+  const __m256i B0 = _mm256_mulhi_epu16(*U0, k33050);
+  const __m256i B1 = _mm256_adds_epu16(B0, Y1);
+  const __m256i B2 = _mm256_subs_epu16(B1, k17685);
+
+  // use logical shift for B2, which can be larger than 32767
+  *R = _mm256_srai_epi16(R2, 6);
+  *G = _mm256_srai_epi16(G4, 6);
+  *B = _mm256_srli_epi16(B2, 6);
+}
+
+// Load 16 bytes into the *upper* part of 16b words. That's "<< 8", basically.
+static WEBP_INLINE __m256i Load_HI_16(const uint8_t* src) {
+  const __m128i tmp = _mm_loadu_si128((const __m128i*)src);
+  return _mm256_slli_epi16(_mm256_cvtepu8_epi16(tmp), 8);
+}
+
+// Load and replicate 8 U/V samples
+static WEBP_INLINE __m256i Load_UV_HI_16(const uint8_t* src) {
+  const __m128i tmp0 = _mm_loadl_epi64((const __m128i*)src);
+  const __m128i tmp1 = _mm_unpacklo_epi8(tmp0, tmp0);   // replicate samples
+  return _mm256_slli_epi16(_mm256_cvtepu8_epi16(tmp1), 8);
+}
+
+// Convert 16 samples of YUV444 to R/G/B
+static void YUV444ToRGB(const uint8_t* const y,
+                        const uint8_t* const u,
+                        const uint8_t* const v,
+                        __m256i* const R, __m256i* const G, __m256i* const B) {
+  const __m256i Y0 = Load_HI_16(y), U0 = Load_HI_16(u), V0 = Load_HI_16(v);
+  ConvertYUV444ToRGB(&Y0, &U0, &V0, R, G, B);
+}
+
+// Convert 16 samples of YUV420 to R/G/B
+static void YUV420ToRGB(const uint8_t* const y,
+                        const uint8_t* const u,
+                        const uint8_t* const v,
+                        __m256i* const R, __m256i* const G, __m256i* const B) {
+  const __m256i Y0 = Load_HI_16(y);
+  const __m256i U0 = Load_UV_HI_16(u), V0 = Load_UV_HI_16(v);
+  ConvertYUV444ToRGB(&Y0, &U0, &V0, R, G, B);
+}
+
+// Pack R/G/B/A results into 32b output.
+static WEBP_INLINE void PackAndStore4(const __m256i* const R,
+                                      const __m256i* const G,
+                                      const __m256i* const B,
+                                      const __m256i* const A,
+                                      uint8_t* const dst) {
+  const __m256i rb = _mm256_packus_epi16(*R, *B);
+  const __m256i ga = _mm256_packus_epi16(*G, *A);
+  const __m256i rg = _mm256_unpacklo_epi8(rb, ga);
+  const __m256i ba = _mm256_unpackhi_epi8(rb, ga);
+  // RGBA_lo = pixels 0 to 3 | pixels 8 to 11
+  // RGBA_hi = pixels 4 to 7 | pixels 12 to 15
+  const __m256i RGBA_lo = _mm256_unpacklo_epi16(rg, ba);
+  const __m256i RGBA_hi = _mm256_unpackhi_epi16(rg, ba);
+  _mm256_storeu_si256((__m256i*)(dst +  0),
+                      _mm256_permute2x128_si256(RGBA_lo, RGBA_hi, 0x20));
+  _mm256_storeu_si256((__m256i*)(dst + 32),
+                      _mm256_permute2x128_si256(RGBA_lo, RGBA_hi, 0x31));
+}
+
+// Pack R/G/B/A results into 16b output.
+static WEBP_INLINE void PackAndStore4444(const __m256i* const R,
+                                         const __m256i* const G,
+                                         const __m256i* const B,
+                                         const __m256i* const A,
+                                         uint8_t* const dst) {
+#if !defined(WEBP_SWAP_16BIT_CSP)
+  const __m256i rg0 = _mm256_packus_epi16(*R, *G);
+  const __m256i ba0 = _mm256_packus_epi16(*B, *A);
+#else
+  const __m256i rg0 = _mm256_packus_epi16(*B, *A);
+  const __m256i ba0 = _mm256_packus_epi16(*R, *G);
+#endif
+  const __m256i mask_0xf0 = _mm256_set1_epi8(0xf0);
+  const __m256i rb1 = _mm256_unpacklo_epi8(rg0, ba0);  // rbrbrbrbrb...
+  const __m256i ga1 = _mm256_unpackhi_epi8(rg0, ba0);  // gagagagaga...
+  const __m256i rb2 = _mm256_and_si256(rb1, mask_0xf0);
+  const __m256i ga2 = _mm256_srli_epi16(_mm256_and_si256(ga1, mask_0xf0), 4);
+  const __m256i rgba4444 = _mm256_or_si256(rb2, ga2);
+  _mm256_storeu_si256((__m256i*)dst, rgba4444);
+}
+
+// Pack R/G/B results into 16b output.
+static WEBP_INLINE void PackAndStore565(const __m256i* const R,
+                                        const __m256i* const G,
+                                        const __m256i* const B,
+                                        uint8_t* const dst) {
+  const __m256i r0 = _mm256_packus_epi16(*R, *R);
+  const __m256i g0 = _mm256_packus_epi16(*G, *G);
+  const __m256i b0 = _mm256_packus_epi16(*B, *B);
+  const __m256i r1 = _mm256_and_si256(r0, _mm256_set1_epi8(0xf8));
+  const __m256i b1 = _mm256_and_si256(_mm256_srli_epi16(b0, 3),
+                                      _mm256_set1_epi8(0x1f));
+  const __m256i g1 = _mm256_srli_epi16(
+      _mm256_and_si256(g0, _mm256_set1_epi8(0xe0)), 5);
+  const __m256i g2 = _mm256_slli_epi16(
+      _mm256_and_si256(g0, _mm256_set1_epi8(0x1c)), 3);
+  const __m256i rg = _mm256_or_si256(r1, g1);
+  const __m256i gb = _mm256_or_si256(g2, b1);
+#if !defined(WEBP_SWAP_16BIT_CSP)
+  const __m256i rgb565 = _mm256_unpacklo_epi8(rg, gb);
+#else
+  const __m256i rgb565 = _mm256_unpacklo_epi8(gb, rg);
+#endif
+  _mm256_storeu_si256((__m256i*)dst, rgb565);
+}
+
+// Load 16 alpha values into 16b words.
+static WEBP_INLINE __m256i Load_A_16(const uint8_t* src) {
+  return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)src));
+}
+
+// Clips R/G/B to [0, 255] and premultiplies them by A. See yuv_sse2.c.
+static WEBP_INLINE void PremultiplyRGB(__m256i* const R, __m256i* const G,
+                                       __m256i* const B,
+                                       const __m256i* const A) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i max = _mm256_set1_epi16(255);
+  const __m256i k32897 = _mm256_set1_epi16((short)32897);
+  const __m256i R0 = _mm256_min_epi16(_mm256_max_epi16(*R, zero), max);
+  const __m256i G0 = _mm256_min_epi16(_mm256_max_epi16(*G, zero), max);
+  const __m256i B0 = _mm256_min_epi16(_mm256_max_epi16(*B, zero), max);
+  const __m256i R1 = _mm256_mulhi_epu16(_mm256_mullo_epi16(R0, *A), k32897);
+  const __m256i G1 = _mm256_mulhi_epu16(_mm256_mullo_epi16(G0, *A), k32897);
+  const __m256i B1 = _mm256_mulhi_epu16(_mm256_mullo_epi16(B0, *A), k32897);
+  *R = _mm256_srli_epi16(R1, 7);
+  *G = _mm256_srli_epi16(G1, 7);
+  *B = _mm256_srli_epi16(B1, 7);
+}
+
+// Same for the 4b precision of rgbA_4444.
+static WEBP_INLINE void PremultiplyRGB4444(__m256i* const R, __m256i* const G,
+                                           __m256i* const B,
+                                           const __m256i* const A) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i max = _mm256_set1_epi16(255);
+  const __m256i k0x11 = _mm256_set1_epi16(0x11);
+  const __m256i A4 = _mm256_mullo_epi16(_mm256_srli_epi16(*A, 4),
+                                        _mm256_set1_epi16(0x1111));
+  const __m256i R0 = _mm256_min_epi16(_mm256_max_epi16(*R, zero), max);
+  const __m256i G0 = _mm256_min_epi16(_mm256_max_epi16(*G, zero), max);
+  const __m256i B0 = _mm256_min_epi16(_mm256_max_epi16(*B, zero), max);
+  const __m256i R1 = _mm256_mullo_epi16(_mm256_srli_epi16(R0, 4), k0x11);
+  const __m256i G1 = _mm256_mullo_epi16(_mm256_srli_epi16(G0, 4), k0x11);
+  const __m256i B1 = _mm256_mullo_epi16(_mm256_srli_epi16(B0, 4), k0x11);
+  *R = _mm256_mulhi_epu16(R1, A4);
+  *G = _mm256_mulhi_epu16(G1, A4);
+  *B = _mm256_mulhi_epu16(B1, A4);
+}
+
+void VP8YuvToRgba32AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                        uint8_t* dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4(&R, &G, &B, &kAlpha, dst);
+  }
+}
+
+void VP8YuvToBgra32AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                        uint8_t* dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4(&B, &G, &R, &kAlpha, dst);
+  }
+}
+
+void VP8YuvToArgb32AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                        uint8_t* dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4(&kAlpha, &R, &G, &B, dst);
+  }
+}
+
+void VP8YuvToRgba444432AVX2(const uint8_t* y, const uint8_t* u,
+                            const uint8_t* v, uint8_t* dst) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 32) {
+    __m256i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore4444(&R, &G, &B, &kAlpha, dst);
+  }
+}
+
+void VP8YuvToRgb56532AVX2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                          uint8_t* dst) {
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 32) {
+    __m256i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PackAndStore565(&R, &G, &B, dst);
+  }
+}
+
+void VP8YuvToRgbaPremul32AVX2(const uint8_t* y, const uint8_t* u,
+                              const uint8_t* v, const uint8_t* a,
+                              uint8_t* dst) {
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    const __m256i A = Load_A_16(a + n);
+    __m256i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&R, &G, &B, &A, dst);
+  }
+}
+
+void VP8YuvToBgraPremul32AVX2(const uint8_t* y, const uint8_t* u,
+                              const uint8_t* v, const uint8_t* a,
+                              uint8_t* dst) {
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    const __m256i A = Load_A_16(a + n);
+    __m256i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&B, &G, &R, &A, dst);
+  }
+}
+
+void VP8YuvToArgbPremul32AVX2(const uint8_t* y, const uint8_t* u,
+                              const uint8_t* v, const uint8_t* a,
+                              uint8_t* dst) {
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 64) {
+    const __m256i A = Load_A_16(a + n);
+    __m256i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&A, &R, &G, &B, dst);
+  }
+}
+
+void VP8YuvToRgba4444Premul32AVX2(const uint8_t* y, const uint8_t* u,
+                                  const uint8_t* v, const uint8_t* a,
+                                  uint8_t* dst) {
+  int n;
+  for (n = 0; n < 32; n += 16, dst += 32) {
+    const __m256i A = Load_A_16(a + n);
+    __m256i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PremultiplyRGB4444(&R, &G, &B, &A);
+    PackAndStore4444(&R, &G, &B, &A, dst);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Arbitrary-length row conversion functions
+
+static void YuvToRgbaRow(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                         uint8_t* dst, int len) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PackAndStore4(&R, &G, &B, &kAlpha, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToRgba(y[0], u[0], v[0], dst);
+    dst += 4;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToBgraRow(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                         uint8_t* dst, int len) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PackAndStore4(&B, &G, &R, &kAlpha, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToBgra(y[0], u[0], v[0], dst);
+    dst += 4;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToArgbRow(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                         uint8_t* dst, int len) {
+  const __m256i kAlpha = _mm256_set1_epi16(255);
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    __m256i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PackAndStore4(&kAlpha, &R, &G, &B, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToArgb(y[0], u[0], v[0], dst);
+    dst += 4;
+    y += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToRgbaPremulRow(const uint8_t* y, const uint8_t* u,
+                               const uint8_t* v, const uint8_t* a,
+                               uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    const __m256i A = Load_A_16(a);
+    __m256i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&R, &G, &B, &A, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+    a += 16;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToRgbaPremul(y[0], u[0], v[0], a[0], dst);
+    dst += 4;
+    y += 1;
+    a += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToBgraPremulRow(const uint8_t* y, const uint8_t* u,
+                               const uint8_t* v, const uint8_t* a,
+                               uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    const __m256i A = Load_A_16(a);
+    __m256i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&B, &G, &R, &A, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+    a += 16;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToBgraPremul(y[0], u[0], v[0], a[0], dst);
+    dst += 4;
+    y += 1;
+    a += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToArgbPremulRow(const uint8_t* y, const uint8_t* u,
+                               const uint8_t* v, const uint8_t* a,
+                               uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 64) {
+    const __m256i A = Load_A_16(a);
+    __m256i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&A, &R, &G, &B, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+    a += 16;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToArgbPremul(y[0], u[0], v[0], a[0], dst);
+    dst += 4;
+    y += 1;
+    a += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToRgba4444PremulRow(const uint8_t* y, const uint8_t* u,
+                                   const uint8_t* v, const uint8_t* a,
+                                   uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 16 <= len; n += 16, dst += 32) {
+    const __m256i A = Load_A_16(a);
+    __m256i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PremultiplyRGB4444(&R, &G, &B, &A);
+    PackAndStore4444(&R, &G, &B, &A, dst);
+    y += 16;
+    u += 8;
+    v += 8;
+    a += 16;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToRgba4444Premul(y[0], u[0], v[0], a[0], dst);
+    dst += 2;
+    y += 1;
+    a += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void InterleaveUV(const uint8_t* first, const uint8_t* second,
+                         uint8_t* dst, int len) {
+  int i;
+  for (i = 0; i + 32 <= len; i += 32) {
+    const __m256i A = _mm256_loadu_si256((const __m256i*)(first + i));
+    const __m256i B = _mm256_loadu_si256((const __m256i*)(second + i));
+    // unpacking works within each 128b lane: put the lanes back in order
+    const __m256i lo = _mm256_unpacklo_epi8(A, B);
+    const __m256i hi = _mm256_unpackhi_epi8(A, B);
+    _mm256_storeu_si256((__m256i*)(dst + 2 * i +  0),
+                        _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)(dst + 2 * i + 32),
+                        _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+  for (; i < len; ++i) {
+    dst[2 * i + 0] = first[i];
+    dst[2 * i + 1] = second[i];
+  }
+}
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPInitSamplersAVX2(void);
+
+WEBP_TSAN_IGNORE_FUNCTION void WebPInitSamplersAVX2(void) {
+  WebPSamplers[MODE_RGBA] = YuvToRgbaRow;
+  WebPSamplers[MODE_BGRA] = YuvToBgraRow;
+  WebPSamplers[MODE_ARGB] = YuvToArgbRow;
+  WebPSamplersPremultiplied[MODE_rgbA] = YuvToRgbaPremulRow;
+  WebPSamplersPremultiplied[MODE_bgrA] = YuvToBgraPremulRow;
+  WebPSamplersPremultiplied[MODE_Argb] = YuvToArgbPremulRow;
+  WebPSamplersPremultiplied[MODE_rgbA_4444] = YuvToRgba4444PremulRow;
+  WebPInterleaveUV = InterleaveUV;
+}
+
+#else  // !WEBP_USE_AVX2
+
+WEBP_DSP_INIT_STUB(WebPInitSamplersAVX2)
+
+#endif  // WEBP_USE_AVX2
@@ -155,6 +155,52 @@ static WEBP_INLINE void PackAndStore565(const __m128i* const R,
   _mm_storeu_si128((__m128i*)dst, rgb565);
 }
 
+// Load 8 alpha values into 16b words.
+static WEBP_INLINE __m128i Load_A_16(const uint8_t* src) {
+  const __m128i zero = _mm_setzero_si128();
+  return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)src), zero);
+}
+
+// Clips R/G/B to [0, 255] and premultiplies them by A: (v * a * 32897) >> 23,
+// computed as ((v * a) . 32897) >> 7. See VP8PremultiplyAlpha().
+static WEBP_INLINE void PremultiplyRGB(__m128i* const R, __m128i* const G,
+                                       __m128i* const B,
+                                       const __m128i* const A) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max = _mm_set1_epi16(255);
+  const __m128i k32897 = _mm_set1_epi16((short)32897);
+  const __m128i R0 = _mm_min_epi16(_mm_max_epi16(*R, zero), max);
+  const __m128i G0 = _mm_min_epi16(_mm_max_epi16(*G, zero), max);
+  const __m128i B0 = _mm_min_epi16(_mm_max_epi16(*B, zero), max);
+  const __m128i R1 = _mm_mulhi_epu16(_mm_mullo_epi16(R0, *A), k32897);
+  const __m128i G1 = _mm_mulhi_epu16(_mm_mullo_epi16(G0, *A), k32897);
+  const __m128i B1 = _mm_mulhi_epu16(_mm_mullo_epi16(B0, *A), k32897);
+  *R = _mm_srli_epi16(R1, 7);
+  *G = _mm_srli_epi16(G1, 7);
+  *B = _mm_srli_epi16(B1, 7);
+}
+
+// Same for the 4b precision of rgbA_4444 (see VP8PremultiplyAlpha4()). Only
+// the high nibble of the results is relevant.
+static WEBP_INLINE void PremultiplyRGB4444(__m128i* const R, __m128i* const G,
+                                           __m128i* const B,
+                                           const __m128i* const A) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max = _mm_set1_epi16(255);
+  const __m128i k0x11 = _mm_set1_epi16(0x11);
+  const __m128i A4 = _mm_mullo_epi16(_mm_srli_epi16(*A, 4),
+                                     _mm_set1_epi16(0x1111));
+  const __m128i R0 = _mm_min_epi16(_mm_max_epi16(*R, zero), max);
+  const __m128i G0 = _mm_min_epi16(_mm_max_epi16(*G, zero), max);
+  const __m128i B0 = _mm_min_epi16(_mm_max_epi16(*B, zero), max);
+  const __m128i R1 = _mm_mullo_epi16(_mm_srli_epi16(R0, 4), k0x11);
+  const __m128i G1 = _mm_mullo_epi16(_mm_srli_epi16(G0, 4), k0x11);
+  const __m128i B1 = _mm_mullo_epi16(_mm_srli_epi16(B0, 4), k0x11);
+  *R = _mm_mulhi_epu16(R1, A4);
+  *G = _mm_mulhi_epu16(G1, A4);
+  *B = _mm_mulhi_epu16(B1, A4);
+}
+
 // Function used several times in PlanarTo24b.
 // It samples the in buffer as follows: one every two unsigned char is stored
 // at the beginning of the buffer, while the other half is stored at the end.
@@ -262,6 +308,55 @@ void VP8YuvToRgb56532(const uint8_t* y, const uint8_t* u, const uint8_t* v,
   }
 }
 
+void VP8YuvToRgbaPremul32(const uint8_t* y, const uint8_t* u,
+                          const uint8_t* v, const uint8_t* a, uint8_t* dst) {
+  int n;
+  for (n = 0; n < 32; n += 8, dst += 32) {
+    const __m128i A = Load_A_16(a + n);
+    __m128i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&R, &G, &B, &A, dst);
+  }
+}
+
+void VP8YuvToBgraPremul32(const uint8_t* y, const uint8_t* u,
+                          const uint8_t* v, const uint8_t* a, uint8_t* dst) {
+  int n;
+  for (n = 0; n < 32; n += 8, dst += 32) {
+    const __m128i A = Load_A_16(a + n);
+    __m128i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&B, &G, &R, &A, dst);
+  }
+}
+
+void VP8YuvToArgbPremul32(const uint8_t* y, const uint8_t* u,
+                          const uint8_t* v, const uint8_t* a, uint8_t* dst) {
+  int n;
+  for (n = 0; n < 32; n += 8, dst += 32) {
+    const __m128i A = Load_A_16(a + n);
+    __m128i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&A, &R, &G, &B, dst);
+  }
+}
+
+void VP8YuvToRgba4444Premul32(const uint8_t* y, const uint8_t* u,
+                              const uint8_t* v, const uint8_t* a,
+                              uint8_t* dst) {
+  int n;
+  for (n = 0; n < 32; n += 8, dst += 16) {
+    const __m128i A = Load_A_16(a + n);
+    __m128i R, G, B;
+    YUV444ToRGB(y + n, u + n, v + n, &R, &G, &B);
+    PremultiplyRGB4444(&R, &G, &B, &A);
+    PackAndStore4444(&R, &G, &B, &A, dst);
+  }
+}
+
 void VP8YuvToRgb32(const uint8_t* y, const uint8_t* u, const uint8_t* v,
                    uint8_t* dst) {
   __m128i R0, R1, R2, R3, G0, G1, G2, G3, B0, B1, B2, B3;
@@ -444,6 +539,121 @@ static void YuvToBgrRow(const uint8_t* y, const uint8_t* u, const uint8_t* v,
   }
 }
 
+static void YuvToRgbaPremulRow(const uint8_t* y, const uint8_t* u,
+                               const uint8_t* v, const uint8_t* a,
+                               uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 8 <= len; n += 8, dst += 32) {
+    const __m128i A = Load_A_16(a);
+    __m128i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&R, &G, &B, &A, dst);
+    y += 8;
+    u += 4;
+    v += 4;
+    a += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToRgbaPremul(y[0], u[0], v[0], a[0], dst);
+    dst += 4;
+    y += 1;
+    a += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToBgraPremulRow(const uint8_t* y, const uint8_t* u,
+                               const uint8_t* v, const uint8_t* a,
+                               uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 8 <= len; n += 8, dst += 32) {
+    const __m128i A = Load_A_16(a);
+    __m128i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&B, &G, &R, &A, dst);
+    y += 8;
+    u += 4;
+    v += 4;
+    a += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToBgraPremul(y[0], u[0], v[0], a[0], dst);
+    dst += 4;
+    y += 1;
+    a += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToArgbPremulRow(const uint8_t* y, const uint8_t* u,
+                               const uint8_t* v, const uint8_t* a,
+                               uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 8 <= len; n += 8, dst += 32) {
+    const __m128i A = Load_A_16(a);
+    __m128i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PremultiplyRGB(&R, &G, &B, &A);
+    PackAndStore4(&A, &R, &G, &B, dst);
+    y += 8;
+    u += 4;
+    v += 4;
+    a += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToArgbPremul(y[0], u[0], v[0], a[0], dst);
+    dst += 4;
+    y += 1;
+    a += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void YuvToRgba4444PremulRow(const uint8_t* y, const uint8_t* u,
+                                   const uint8_t* v, const uint8_t* a,
+                                   uint8_t* dst, int len) {
+  int n;
+  for (n = 0; n + 8 <= len; n += 8, dst += 16) {
+    const __m128i A = Load_A_16(a);
+    __m128i R, G, B;
+    YUV420ToRGB(y, u, v, &R, &G, &B);
+    PremultiplyRGB4444(&R, &G, &B, &A);
+    PackAndStore4444(&R, &G, &B, &A, dst);
+    y += 8;
+    u += 4;
+    v += 4;
+    a += 8;
+  }
+  for (; n < len; ++n) {   // Finish off
+    VP8YuvToRgba4444Premul(y[0], u[0], v[0], a[0], dst);
+    dst += 2;
+    y += 1;
+    a += 1;
+    u += (n & 1);
+    v += (n & 1);
+  }
+}
+
+static void InterleaveUV(const uint8_t* first, const uint8_t* second,
+                         uint8_t* dst, int len) {
+  int i;
+  for (i = 0; i + 16 <= len; i += 16) {
+    const __m128i A = _mm_loadu_si128((const __m128i*)(first + i));
+    const __m128i B = _mm_loadu_si128((const __m128i*)(second + i));
+    _mm_storeu_si128((__m128i*)(dst + 2 * i +  0), _mm_unpacklo_epi8(A, B));
+    _mm_storeu_si128((__m128i*)(dst + 2 * i + 16), _mm_unpackhi_epi8(A, B));
+  }
+  for (; i < len; ++i) {
+    dst[2 * i + 0] = first[i];
+    dst[2 * i + 1] = second[i];
+  }
+}
+
 //------------------------------------------------------------------------------
 // Entry point
 
@@ -455,6 +665,11 @@ WEBP_TSAN_IGNORE_FUNCTION void WebPInitSamplersSSE2(void) {
   WebPSamplers[MODE_BGR]  = YuvToBgrRow;
   WebPSamplers[MODE_BGRA] = YuvToBgraRow;
   WebPSamplers[MODE_ARGB] = YuvToArgbRow;
+  WebPSamplersPremultiplied[MODE_rgbA] = YuvToRgbaPremulRow;
+  WebPSamplersPremultiplied[MODE_bgrA] = YuvToBgraPremulRow;
+  WebPSamplersPremultiplied[MODE_Argb] = YuvToArgbPremulRow;
+  WebPSamplersPremultiplied[MODE_rgbA_4444] = YuvToRgba4444PremulRow;
+  WebPInterleaveUV = InterleaveUV;
 }
 
 //------------------------------------------------------------------------------
@@ -145,6 +145,7 @@ static int EncodeAlphaInternal(const uint8_t* const data, int width, int height,
       }
     } else {
       VP8LBitWriterWipeOut(&tmp_bw);
+      VP8BitWriterInit(&result->bw, 0);
       return 0;
     }
   }
@@ -356,15 +357,21 @@ static int CompressAlphaJob(VP8Encoder* const enc, void* dummy) {
   const WebPConfig* config = enc->config_;
   uint8_t* alpha_data = NULL;
   size_t alpha_size = 0;
-  const int effort_level = config->method;  // maps to [0..6]
+  const int effort_level =
+      (config->method > 0) ? config->method : 0;  // maps to [0..6]
   const WEBP_FILTER_TYPE filter =
       (config->alpha_filtering == 0) ? WEBP_FILTER_NONE :
       (config->alpha_filtering == 1) ? WEBP_FILTER_FAST :
                                        WEBP_FILTER_BEST;
-  if (!EncodeAlpha(enc, config->alpha_quality, config->alpha_compression,
-                   filter, effort_level, &alpha_data, &alpha_size)) {
-    return 0;
+  const uint64_t start = WebPTimerStart();
+  const int ok = EncodeAlpha(enc, config->alpha_quality,
+                             config->alpha_compression, filter, effort_level,
+                             &alpha_data, &alpha_size);
+  // Only this job writes 'alpha_ns' while the picture is being encoded.
+  if (config->stage_stats != NULL) {
+    WebPTimerAdd(&config->stage_stats->alpha_ns, start);
   }
+  if (!ok) return 0;
   if (alpha_size != (uint32_t)alpha_size) {  // Sanity check.
     WebPSafeFree(alpha_data);
     return 0;
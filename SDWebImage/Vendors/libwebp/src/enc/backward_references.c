@@ -1184,8 +1184,9 @@ static int BackwardReferencesHashChainDistanceOnly(
   VP8LColorCache hashers;
   const int skip_length = 32 + quality;
   const int skip_min_distance_code = 2;
+  // Zeroed, so that CostManagerClear() is safe even before CostManagerInit().
   CostManager* cost_manager =
-      (CostManager*)WebPSafeMalloc(1ULL, sizeof(*cost_manager));
+      (CostManager*)WebPSafeCalloc(1ULL, sizeof(*cost_manager));
 
   if (cost_model == NULL || cost_manager == NULL) goto Error;
 
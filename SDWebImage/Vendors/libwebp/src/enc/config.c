@@ -44,6 +44,8 @@ int WebPConfigInitInternal(WebPConfig* config,
   config->alpha_quality = 100;
   config->lossless = 0;
   config->exact = 0;
+  config->memory = NULL;
+  config->stage_stats = NULL;
   config->image_hint = WEBP_HINT_DEFAULT;
   config->emulate_jpeg_size = 0;
   config->thread_level = 0;
@@ -98,7 +100,7 @@ int WebPValidateConfig(const WebPConfig* config) {
     return 0;
   if (config->target_PSNR < 0)
     return 0;
-  if (config->method < 0 || config->method > 6)
+  if (config->method < -1 || config->method > 6)
     return 0;
   if (config->segments < 1 || config->segments > 4)
     return 0;
@@ -136,7 +138,7 @@ int WebPValidateConfig(const WebPConfig* config) {
     return 0;
   if (config->emulate_jpeg_size < 0 || config->emulate_jpeg_size > 1)
     return 0;
-  if (config->thread_level < 0 || config->thread_level > 1)
+  if (config->thread_level < 0)
     return 0;
   if (config->low_memory < 0 || config->low_memory > 1)
     return 0;
@@ -38,6 +38,16 @@ typedef struct {  // struct for organizing convergence in either size or PSNR
   double value, last_value;   // PSNR or size
   double target;
   int do_size_search;
+  // If 'has_bracket' is true, 'q' is kept within [q_lo, q_hi], and the target
+  // is interpolated between the measures at both ends once they are known
+  // (their values are negative until then). Set by SearchQuantizer() only.
+  int has_bracket;
+  float q_lo, q_hi;
+  double value_lo, value_hi;
+  // The measure closest to the target among the passes run after the search,
+  // for the last pass to fall back to (negative value if none).
+  float best_q;
+  double best_value;
 } PassStats;
 
 static int InitPassStats(const VP8Encoder* const enc, PassStats* const s) {
@@ -53,6 +63,8 @@ static int InitPassStats(const VP8Encoder* const enc, PassStats* const s) {
             : 40.;   // default, just in case
   s->value = s->last_value = 0.;
   s->do_size_search = do_size_search;
+  s->has_bracket = 0;
+  s->best_value = -1.;
   return do_size_search;
 }
 
@@ -60,11 +72,57 @@ static float Clamp(float v, float min, float max) {
   return (v < min) ? min : (v > max) ? max : v;
 }
 
+// Narrows the bracket of 'q' with the last measure, and returns the step to
+// the next 'q', given the secant step 'dq'.
+static float BracketStep(PassStats* const s, float dq) {
+  float q;
+  if (s->best_value < 0. ||
+      fabs(s->value - s->target) < fabs(s->best_value - s->target)) {
+    s->best_q = s->q;
+    s->best_value = s->value;
+  }
+  if (s->value > s->target) {
+    s->q_hi = s->q;
+    s->value_hi = s->value;
+  } else {
+    s->q_lo = s->q;
+    s->value_lo = s->value;
+  }
+  if (s->value_lo >= 0. && s->value_hi >= 0. && s->value_hi > s->value_lo) {
+    q = s->q_lo + (float)((s->target - s->value_lo) /
+                          (s->value_hi - s->value_lo)) * (s->q_hi - s->q_lo);
+  } else {
+    q = s->q + dq;
+    if (q <= s->q_lo || q >= s->q_hi) q = 0.5f * (s->q_lo + s->q_hi);
+  }
+  return q - s->q;
+}
+
+// Returns true if the last pass, measured in 's', ended farther from the
+// target than the best pass measured after the search (e.g. the secant step
+// crossed a jump of the size). 'q' is then set back to the best one, for a
+// single extra last pass.
+static int RetryBestQ(PassStats* const s) {
+  if (!s->has_bracket || s->best_value < 0. ||
+      fabs(s->value - s->target) <= fabs(s->best_value - s->target)) {
+    return 0;
+  }
+  s->q = s->best_q;
+  s->dq = 0.f;
+  s->best_value = -1.;
+  return 1;
+}
+
 static float ComputeNextQ(PassStats* const s) {
   float dq;
   if (s->is_first) {
     dq = (s->value > s->target) ? -s->dq : s->dq;
     s->is_first = 0;
+  } else if (s->has_bracket) {
+    dq = (s->value != s->last_value) ?
+        (float)((s->target - s->value) / (s->last_value - s->value) *
+                (s->last_q - s->q)) : 0.f;
+    dq = BracketStep(s, dq);
   } else if (s->value != s->last_value) {
     const double slope = (s->target - s->value) / (s->last_value - s->value);
     dq = (float)(slope * (s->last_q - s->q));
@@ -394,8 +452,17 @@ static void RecordResiduals(VP8EncIterator* const it,
 
 #if !defined(DISABLE_TOKEN_BUFFER)
 
+// Same as VP8InitResidual(), but records the statistics into 'stats'.
+static void InitTokenResidual(int first, int coeff_type, VP8Encoder* const enc,
+                              StatsArray (* const stats)[NUM_BANDS],
+                              VP8Residual* const res) {
+  VP8InitResidual(first, coeff_type, enc, res);
+  res->stats = stats[coeff_type];
+}
+
 static int RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
-                        VP8TBuffer* const tokens) {
+                        VP8TBuffer* const tokens,
+                        StatsArray (* const stats)[NUM_BANDS]) {
   int x, y, ch;
   VP8Residual res;
   VP8Encoder* const enc = it->enc_;
@@ -403,15 +470,15 @@ static int RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
   VP8IteratorNzToBytes(it);
   if (it->mb_->type_ == 1) {   // i16x16
     const int ctx = it->top_nz_[8] + it->left_nz_[8];
-    VP8InitResidual(0, 1, enc, &res);
+    InitTokenResidual(0, 1, enc, stats, &res);
     VP8SetResidualCoeffs(rd->y_dc_levels, &res);
     it->top_nz_[8] = it->left_nz_[8] =
         VP8RecordCoeffTokens(ctx, 1,
                              res.first, res.last, res.coeffs, tokens);
     VP8RecordCoeffs(ctx, &res);
-    VP8InitResidual(1, 0, enc, &res);
+    InitTokenResidual(1, 0, enc, stats, &res);
   } else {
-    VP8InitResidual(0, 3, enc, &res);
+    InitTokenResidual(0, 3, enc, stats, &res);
   }
 
   // luma-AC
@@ -427,7 +494,7 @@ static int RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
   }
 
   // U/V
-  VP8InitResidual(0, 2, enc, &res);
+  InitTokenResidual(0, 2, enc, stats, &res);
   for (ch = 0; ch <= 2; ch += 2) {
     for (y = 0; y < 2; ++y) {
       for (x = 0; x < 2; ++x) {
@@ -467,27 +534,41 @@ static void ResetSSE(VP8Encoder* const enc) {
   enc->sse_count_ = 0;
 }
 
-static void StoreSSE(const VP8EncIterator* const it) {
-  VP8Encoder* const enc = it->enc_;
+// Side statistics, accumulated in the encoder or per worker.
+typedef struct {
+  uint64_t* sse_;         // Y/U/V squared errors
+  uint64_t* sse_count_;   // pixel count for the sse_[] stats
+  int* block_count_;      // number of i4x4, i16x16 and skipped blocks
+} SideStats;
+
+static void InitSideStats(VP8Encoder* const enc, SideStats* const side) {
+  side->sse_ = enc->sse_;
+  side->sse_count_ = &enc->sse_count_;
+  side->block_count_ = enc->block_count_;
+}
+
+static void StoreSSE(const VP8EncIterator* const it,
+                     const SideStats* const side) {
   const uint8_t* const in = it->yuv_in_;
   const uint8_t* const out = it->yuv_out_;
   // Note: not totally accurate at boundary. And doesn't include in-loop filter.
-  enc->sse_[0] += VP8SSE16x16(in + Y_OFF_ENC, out + Y_OFF_ENC);
-  enc->sse_[1] += VP8SSE8x8(in + U_OFF_ENC, out + U_OFF_ENC);
-  enc->sse_[2] += VP8SSE8x8(in + V_OFF_ENC, out + V_OFF_ENC);
-  enc->sse_count_ += 16 * 16;
+  side->sse_[0] += VP8SSE16x16(in + Y_OFF_ENC, out + Y_OFF_ENC);
+  side->sse_[1] += VP8SSE8x8(in + U_OFF_ENC, out + U_OFF_ENC);
+  side->sse_[2] += VP8SSE8x8(in + V_OFF_ENC, out + V_OFF_ENC);
+  *side->sse_count_ += 16 * 16;
 }
 
-static void StoreSideInfo(const VP8EncIterator* const it) {
+static void StoreSideInfo(const VP8EncIterator* const it,
+                          const SideStats* const side) {
   VP8Encoder* const enc = it->enc_;
   const VP8MBInfo* const mb = it->mb_;
   WebPPicture* const pic = enc->pic_;
 
   if (pic->stats != NULL) {
-    StoreSSE(it);
-    enc->block_count_[0] += (mb->type_ == 0);
-    enc->block_count_[1] += (mb->type_ == 1);
-    enc->block_count_[2] += (mb->skip_ != 0);
+    StoreSSE(it, side);
+    side->block_count_[0] += (mb->type_ == 0);
+    side->block_count_[1] += (mb->type_ == 1);
+    side->block_count_[2] += (mb->skip_ != 0);
   }
 
   if (pic->extra_info != NULL) {
@@ -572,6 +653,276 @@ static uint64_t OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt,
   return size_p0;
 }
 
+//------------------------------------------------------------------------------
+// Speculative search of the quantizer.
+//
+// When a target size or PSNR is set and several threads are allowed, the
+// stat passes for several quantizers are run concurrently, each on a private
+// copy of the encoder. The candidates evenly split the current bracket of 'q',
+// and the sub-interval containing the target becomes the next bracket. Each
+// round starts from the token probabilities of the previous one's closest
+// candidate. The 'q' interpolated between the closest measures, like
+// ComputeNextQ() does, is then refined by the regular sequential passes: the
+// candidates are measured with the probabilities of the previous round, and
+// miss the size of the final encoding by up to tens of percent.
+
+#define MAX_SEARCH_WORKERS 8   // maximum number of quantizers tried at once
+
+typedef struct {
+  VP8Encoder enc_;      // copy of the encoder, using the private buffers below
+  WebPPicture pic_;     // copy of the picture, without the stats
+  uint8_t* mem_;        // mb_info_, preds_, nz_ and top samples
+  VP8RDLevel rd_opt_;
+  int max_count_;       // if not 0, the pass is measured like in the token loop
+#if !defined(DISABLE_TOKEN_BUFFER)
+  VP8TBuffer tokens_;
+#endif
+  PassStats stats_;     // candidate 'q' and resulting size or PSNR
+  uint64_t size_p0_;
+} SearchJob;
+
+#if !defined(DISABLE_TOKEN_BUFFER)
+// Same measure as a non-final pass of VP8EncTokenLoop(): the tokens are
+// recorded and the probabilities refreshed every 'max_count' macroblocks.
+// Returns 0 in case of memory error.
+static uint64_t OneTokenStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt,
+                                 int max_count, VP8TBuffer* const tokens,
+                                 PassStats* const s) {
+  VP8EncIterator it;
+  VP8EncProba* const proba = &enc->proba_;
+  const uint64_t pixel_count = enc->mb_w_ * enc->mb_h_ * 384;
+  uint64_t size_p0 = 0;
+  uint64_t distortion = 0;
+  int cnt = max_count;
+
+  VP8IteratorInit(enc, &it);
+  SetLoopParams(enc, s->q);
+  VP8TBufferClear(tokens);
+  do {
+    VP8ModeScore info;
+    VP8IteratorImport(&it, NULL);
+    if (--cnt < 0) {
+      FinalizeTokenProbas(proba);
+      VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
+      cnt = max_count;
+    }
+    VP8Decimate(&it, &info, rd_opt);
+    if (!RecordTokens(&it, &info, tokens, proba->stats_)) return 0;
+    size_p0 += info.H;
+    distortion += info.D;
+    VP8IteratorSaveBoundary(&it);
+  } while (VP8IteratorNext(&it));
+
+  size_p0 += enc->segment_hdr_.size_;
+  if (s->do_size_search) {
+    uint64_t size = FinalizeTokenProbas(proba);
+    size += VP8EstimateTokenSize(tokens, (const uint8_t*)proba->coeffs_);
+    size = (size + size_p0 + 1024) >> 11;  // -> size in bytes
+    size += HEADER_SIZE_ESTIMATE;
+    s->value = (double)size;
+  } else {
+    s->value = GetPSNR(distortion, pixel_count);
+  }
+  return size_p0;
+}
+#endif    // !DISABLE_TOKEN_BUFFER
+
+static int SearchPassJob(SearchJob* const job, void* unused) {
+  VP8Encoder* const enc = &job->enc_;
+  const int nb_mbs = enc->mb_w_ * enc->mb_h_;
+  (void)unused;
+#if !defined(DISABLE_TOKEN_BUFFER)
+  if (job->max_count_ > 0) {
+    job->size_p0_ = OneTokenStatPass(enc, job->rd_opt_, job->max_count_,
+                                     &job->tokens_, &job->stats_);
+    return (job->size_p0_ > 0);
+  }
+#endif
+  job->size_p0_ = OneStatPass(enc, job->rd_opt_, nb_mbs, 0, &job->stats_);
+  return 1;
+}
+
+static size_t SearchJobMemSize(const VP8Encoder* const enc) {
+  const size_t info_size = enc->mb_w_ * enc->mb_h_ * sizeof(*enc->mb_info_);
+  const size_t preds_size =
+      enc->preds_w_ * (4 * enc->mb_h_ + 1) * sizeof(*enc->preds_);
+  const size_t nz_size = (enc->mb_w_ + 1) * sizeof(*enc->nz_) + WEBP_ALIGN_CST;
+  const size_t top_size =
+      2 * enc->mb_w_ * 16 * sizeof(*enc->y_top_) + WEBP_ALIGN_CST;
+  return info_size + preds_size + nz_size + top_size;
+}
+
+// Copies the current state of 'enc' into the job. The buffers modified by a
+// stat pass are duplicated, the others (samples, config,...) are shared.
+static void SetupSearchJob(const VP8Encoder* const enc, const PassStats* const s,
+                           float q, SearchJob* const job) {
+  VP8Encoder* const dst = &job->enc_;
+  const size_t info_size = enc->mb_w_ * enc->mb_h_ * sizeof(*enc->mb_info_);
+  const size_t preds_size =
+      enc->preds_w_ * (4 * enc->mb_h_ + 1) * sizeof(*enc->preds_);
+  const size_t nz_size = (enc->mb_w_ + 1) * sizeof(*enc->nz_) + WEBP_ALIGN_CST;
+  uint8_t* mem = job->mem_;
+
+  *dst = *enc;
+  dst->mb_info_ = (VP8MBInfo*)mem;
+  memcpy(dst->mb_info_, enc->mb_info_, info_size);
+  mem += info_size;
+  memcpy(mem, enc->preds_ - 1 - enc->preds_w_, preds_size);
+  dst->preds_ = mem + 1 + enc->preds_w_;
+  mem += preds_size;
+  dst->nz_ = 1 + (uint32_t*)WEBP_ALIGN(mem);
+  dst->nz_[-1] = 0;   // constant
+  mem += nz_size;
+  dst->y_top_ = (uint8_t*)WEBP_ALIGN(mem);
+  dst->uv_top_ = dst->y_top_ + enc->mb_w_ * 16;
+  dst->lf_stats_ = NULL;
+  job->pic_ = *enc->pic_;
+  job->pic_.stats = NULL;
+  dst->pic_ = &job->pic_;
+  dst->proba_.dirty_ = 1;   // the level costs must point to the copy's tables
+
+  job->stats_ = *s;
+  job->stats_.q = q;
+}
+
+// Runs the search in about 'num_passes' stat passes, and stores in 's' the
+// quantizer to measure next. If 'max_count' is not 0, the passes are measured
+// with OneTokenStatPass(). Returns the number of rounds of passes run, or 0 if
+// the search failed, in which case the regular sequential search should be
+// used.
+static int SearchQuantizer(VP8Encoder* const enc, VP8RDLevel rd_opt,
+                           int max_count, int num_passes, PassStats* const s) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  WebPWorker workers[MAX_SEARCH_WORKERS];
+  int use_thread[MAX_SEARCH_WORKERS];
+  const int num_jobs = (enc->thread_level_ < MAX_SEARCH_WORKERS) ?
+                       enc->thread_level_ : MAX_SEARCH_WORKERS;
+  int num_rounds = (num_passes + num_jobs - 1) / num_jobs;
+  const size_t mem_size = WEBP_ALIGN(SearchJobMemSize(enc));
+  float lo = 0.f, hi = 100.f;   // bracket of 'q' for the next round
+  int above = 0;                // first candidate above the target
+  int num_done = 0;             // number of rounds run
+  SearchJob* jobs;
+  uint8_t* mem;
+  int n, ok = 1;
+
+  assert(num_jobs >= 2);
+  jobs = (SearchJob*)WebPSafeMalloc(num_jobs, sizeof(*jobs));
+  mem = (uint8_t*)WebPSafeMalloc(num_jobs, mem_size + WEBP_ALIGN_CST);
+  if (jobs == NULL || mem == NULL) {
+    WebPSafeFree(jobs);
+    WebPSafeFree(mem);
+    return 0;
+  }
+  for (n = 0; n < num_jobs; ++n) {
+    jobs[n].mem_ = (uint8_t*)WEBP_ALIGN(mem) + n * mem_size;
+    jobs[n].rd_opt_ = rd_opt;
+    jobs[n].max_count_ = max_count;
+#if !defined(DISABLE_TOKEN_BUFFER)
+    VP8TBufferInit(&jobs[n].tokens_, enc->tokens_.page_size_);
+#endif
+    worker_interface->Init(&workers[n]);
+    workers[n].hook = (WebPWorkerHook)SearchPassJob;
+    workers[n].data1 = &jobs[n];
+    workers[n].data2 = NULL;
+    use_thread[n] = (n > 0) && worker_interface->Reset(&workers[n]);
+  }
+
+  while (ok && num_rounds-- > 0) {
+    const float step = (hi - lo) / (num_jobs + 1);
+    int best = 0;
+    for (n = 0; n < num_jobs; ++n) {
+      SetupSearchJob(enc, s, lo + step * (n + 1), &jobs[n]);
+      if (n > 0) {
+        if (use_thread[n]) {
+          worker_interface->Launch(&workers[n]);
+        } else {
+          worker_interface->Execute(&workers[n]);
+        }
+      }
+    }
+    worker_interface->Execute(&workers[0]);
+    for (n = 0; n < num_jobs; ++n) {
+      ok &= worker_interface->Sync(&workers[n]);
+      if (fabs(jobs[n].stats_.value - s->target) <
+          fabs(jobs[best].stats_.value - s->target)) {
+        best = n;
+      }
+#if (DEBUG_SEARCH > 0)
+      printf("#%2d/%d value:%.1lf   q:%.2f\n", num_rounds, n,
+             jobs[n].stats_.value, jobs[n].stats_.q);
+#endif
+    }
+    if (!ok) break;
+    if (enc->max_i4_header_bits_ > 0 &&
+        jobs[best].size_p0_ > PARTITION0_SIZE_LIMIT) {
+      ++num_rounds;
+      enc->max_i4_header_bits_ >>= 1;  // strengthen header bit limitation...
+      continue;                        // ...and start over
+    }
+    ++num_done;
+    // The next round starts from the probabilities of the closest candidate.
+    memcpy(enc->proba_.coeffs_, jobs[best].enc_.proba_.coeffs_,
+           sizeof(enc->proba_.coeffs_));
+    enc->proba_.dirty_ = 1;
+
+    // Both the size and the PSNR increase with 'q'.
+    for (above = 0; above < num_jobs; ++above) {
+      if (jobs[above].stats_.value > s->target) break;
+    }
+    if (above > 0 && above < num_jobs) {
+      lo = jobs[above - 1].stats_.q;
+      hi = jobs[above].stats_.q;
+      if (hi - lo <= DQ_LIMIT) break;
+    } else {
+      // The end of the bracket was measured with older probabilities and
+      // might be off: the bracket is extended one step past it.
+      if (above == 0) {
+        hi = jobs[0].stats_.q;
+        lo = Clamp(lo - step, 0.f, 100.f);
+      } else {
+        lo = jobs[num_jobs - 1].stats_.q;
+        hi = Clamp(hi + step, 0.f, 100.f);
+      }
+      if (hi - lo <= DQ_LIMIT) break;   // reached the end of the range
+    }
+  }
+  for (n = 0; n < num_jobs; ++n) {
+    worker_interface->End(&workers[n]);
+#if !defined(DISABLE_TOKEN_BUFFER)
+    VP8TBufferClear(&jobs[n].tokens_);
+#endif
+  }
+  if (!ok) {
+    WebPSafeFree(jobs);
+    WebPSafeFree(mem);
+    return 0;
+  }
+
+  // Interpolate between the two measures surrounding the target, or
+  // extrapolate from the two closest ones.
+  n = (above == 0) ? 0 : (above == num_jobs) ? num_jobs - 2 : above - 1;
+  s->is_first = 0;
+  s->q = jobs[n].stats_.q;
+  s->value = jobs[n].stats_.value;
+  s->last_q = jobs[n + 1].stats_.q;
+  s->last_value = jobs[n + 1].stats_.value;
+  ComputeNextQ(s);
+  s->q = Clamp(s->q, lo, hi);
+  s->dq = 10.f;   // not converged: the next pass measures 'q'
+  // The measures above were made with other probabilities: only the bracket
+  // of 'q' is kept, the next passes measure its ends again.
+  s->has_bracket = 1;
+  s->q_lo = lo;
+  s->q_hi = hi;
+  s->value_lo = s->value_hi = -1.;
+  s->best_value = -1.;
+
+  WebPSafeFree(jobs);
+  WebPSafeFree(mem);
+  return num_done;
+}
+
 static int StatLoop(VP8Encoder* const enc) {
   const int method = enc->method_;
   const int do_search = enc->do_search_;
@@ -597,6 +948,10 @@ static int StatLoop(VP8Encoder* const enc) {
       nb_mbs = (nb_mbs > 200) ? nb_mbs >> 2 : 50;
     }
   }
+  if (do_search && enc->thread_level_ > 1 && num_pass_left > 2) {
+    // at least one pass is left to check the 'q' found, before the last one
+    num_pass_left -= SearchQuantizer(enc, rd_opt, 0, num_pass_left - 2, &stats);
+  }
 
   while (num_pass_left-- > 0) {
     const int is_last_pass = (fabs(stats.dq) <= DQ_LIMIT) ||
@@ -623,6 +978,9 @@ static int StatLoop(VP8Encoder* const enc) {
       if (fabs(stats.dq) <= DQ_LIMIT) break;
     }
   }
+  if (do_search && RetryBestQ(&stats)) {
+    if (OneStatPass(enc, rd_opt, nb_mbs, 0, &stats) == 0) return 0;
+  }
   if (!do_search || !stats.do_size_search) {
     // Need to finalize probas now, since it wasn't done during the search.
     FinalizeSkipProba(enc);
@@ -694,13 +1052,30 @@ static void ResetAfterSkip(VP8EncIterator* const it) {
   }
 }
 
+// Realtime mode (method < 0, without target): there's no stats-collection
+// loop. The tokens are coded with the default probabilities, and the skip
+// probability is computed after the fact, since the macroblock headers are
+// only written at the end.
+static void RealtimeLoopInitialize(VP8Encoder* const enc) {
+  SetLoopParams(enc, enc->config_->quality);
+  enc->proba_.use_skip_proba_ = 1;
+  enc->percent_ += 20;   // for the skipped stats-collection loop
+}
+
 int VP8EncLoop(VP8Encoder* const enc) {
   VP8EncIterator it;
+  SideStats side;
+  const int realtime = (enc->method_ < 0) && !enc->do_search_;
   int ok = PreLoopInitialize(enc);
   if (!ok) return 0;
 
-  StatLoop(enc);  // stats-collection loop
+  if (realtime) {
+    RealtimeLoopInitialize(enc);
+  } else {
+    StatLoop(enc);  // stats-collection loop
+  }
 
+  InitSideStats(enc, &side);
   VP8IteratorInit(enc, &it);
   VP8InitFilter(&it);
   do {
@@ -715,13 +1090,18 @@ int VP8EncLoop(VP8Encoder* const enc) {
       CodeResiduals(it.bw_, &it, &info);
     } else {   // reset predictors after a skip
       ResetAfterSkip(&it);
+      enc->proba_.nb_skip_++;
     }
-    StoreSideInfo(&it);
+    StoreSideInfo(&it, &side);
     VP8StoreFilterStats(&it);
     VP8IteratorExport(&it);
     ok = VP8IteratorProgress(&it, 20);
     VP8IteratorSaveBoundary(&it);
   } while (ok && VP8IteratorNext(&it));
+  if (realtime) {
+    enc->proba_.skip_proba_ =
+        CalcSkipProba(enc->proba_.nb_skip_, enc->mb_w_ * enc->mb_h_);
+  }
 
   return PostLoopFinalize(&it, ok);
 }
@@ -733,6 +1113,360 @@ int VP8EncLoop(VP8Encoder* const enc) {
 
 #define MIN_COUNT 96  // minimum number of macroblocks before updating stats
 
+//------------------------------------------------------------------------------
+// Multi-threaded token loop.
+//
+// The macroblock rows are dealt to the workers in round-robin order and coded
+// as a wavefront: each row is cut into spans of macroblocks, and a span is
+// only coded once the span above-right of it is done, so that the top and
+// top-right contexts are available. The workers code one span each per step,
+// and are synchronized between the steps. This is when the token statistics
+// are merged and the level costs refreshed, which keeps the output
+// independent of the threads' scheduling. Each worker records its tokens in
+// its own buffer, and the rows are emitted in order at the end.
+
+#define MAX_ROW_WORKERS 16   // maximum number of rows coded concurrently
+
+typedef struct {
+  VP8EncIterator it_;        // private iterator, sharing the top contexts
+  VP8TBuffer tokens_;        // tokens of the rows coded by this worker
+  StatsArray stats_[NUM_TYPES][NUM_BANDS];   // token stats since last merge
+  LFStats lf_stats_;         // autofilter stats
+  int max_edge_[NUM_MB_SEGMENTS];   // max edge delta, for the filter strength
+  uint64_t sse_[3];          // side stats, merged at the end
+  uint64_t sse_count_;
+  int block_count_[3];
+  SideStats side_;           // points to the side stats above
+  uint64_t size_p0_;         // header bits
+  uint64_t distortion_;
+  size_t* row_tokens_;       // start and end of each row in its token buffer
+  int is_last_pass_;
+  int y_;                    // row to code during the step (-1 if none)
+  int x_start_, x_end_;      // span of macroblocks to code during the step
+} RowJob;
+
+static int CodeRowSpanJob(RowJob* const job, void* unused) {
+  VP8EncIterator* const it = &job->it_;
+  VP8Encoder* const enc = it->enc_;
+  const VP8RDLevel rd_opt = enc->rd_opt_level_;
+  const int y = job->y_;
+  int x;
+  (void)unused;
+
+  if (job->x_start_ == 0) {
+    VP8IteratorSetRow(it, y);
+    job->row_tokens_[2 * y + 0] = VP8TBufferNumTokens(&job->tokens_);
+  }
+  for (x = job->x_start_; x < job->x_end_; ++x) {
+    VP8ModeScore info;
+    assert(it->x_ == x && it->y_ == y);
+    VP8IteratorImport(it, NULL);
+    VP8Decimate(it, &info, rd_opt);
+    if (!RecordTokens(it, &info, &job->tokens_, job->stats_)) return 0;
+    job->size_p0_ += info.H;
+    job->distortion_ += info.D;
+    if (job->is_last_pass_) {
+      StoreSideInfo(it, &job->side_);
+      VP8StoreFilterStats(it);
+      VP8IteratorExport(it);
+    }
+    VP8IteratorSaveBoundary(it);
+    VP8IteratorNext(it);
+  }
+  if (x == enc->mb_w_) {
+    job->row_tokens_[2 * y + 1] = VP8TBufferNumTokens(&job->tokens_);
+  }
+  return 1;
+}
+
+// Wavefront schedule: the row 'y' is coded by the worker 'y % num_workers',
+// during the steps [y * delay, y * delay + num_spans).
+typedef struct {
+  int num_workers;
+  int span;        // number of macroblocks per span
+  int num_spans;   // number of spans per row
+  int delay;       // number of steps between the start of two rows
+  int num_steps;
+} RowSchedule;
+
+static void InitRowSchedule(const VP8Encoder* const enc, int num_workers,
+                            RowSchedule* const s) {
+  // Use at least two spans per row and worker, so that all the workers can
+  // be kept busy once the wavefront is established. 'delay' must be at least
+  // two steps for the span above-right to be done.
+  s->num_workers = num_workers;
+  s->span = enc->mb_w_ / (2 * num_workers);
+  if (s->span < 1) s->span = 1;
+  s->num_spans = (enc->mb_w_ + s->span - 1) / s->span;
+  s->delay = (s->num_spans + num_workers - 1) / num_workers;
+  if (s->delay < 2) s->delay = 2;
+  s->num_steps = (enc->mb_h_ - 1) * s->delay + s->num_spans;
+}
+
+// Sets the span of macroblocks the worker 'w' codes during 'step', if any.
+// Returns the number of macroblocks to code.
+static int SetupRowJob(const VP8Encoder* const enc, const RowSchedule* const s,
+                       int w, int step, RowJob* const job) {
+  // Only the last row started by the worker can be in progress, since
+  // num_workers * delay >= num_spans.
+  int y = step / s->delay;
+  job->y_ = -1;
+  if (y < w) return 0;
+  y -= (y - w) % s->num_workers;
+  while (y >= enc->mb_h_) y -= s->num_workers;
+  if (y >= 0 && step - y * s->delay < s->num_spans) {
+    const int x = (step - y * s->delay) * s->span;
+    job->y_ = y;
+    job->x_start_ = x;
+    job->x_end_ = (x + s->span < enc->mb_w_) ? x + s->span : enc->mb_w_;
+    return job->x_end_ - job->x_start_;
+  }
+  return 0;
+}
+
+// Adds the token statistics of the job to the encoder's ones, and resets them.
+static void MergeTokenStats(RowJob* const job, VP8EncProba* const proba) {
+  const proba_t* const src = &job->stats_[0][0][0][0];
+  proba_t* const dst = &proba->stats_[0][0][0][0];
+  const int size = NUM_TYPES * NUM_BANDS * NUM_CTX * NUM_PROBAS;
+  int i;
+  for (i = 0; i < size; ++i) {
+    if (src[i] != 0) {
+      uint32_t nb = (dst[i] & 0xffffu) + (src[i] & 0xffffu);
+      uint32_t total = (dst[i] >> 16) + (src[i] >> 16);
+      while (total > 0xffffu) {   // same down-scaling as in VP8RecordCoeffs()
+        nb = (nb + 1u) >> 1;
+        total = (total + 1u) >> 1;
+      }
+      dst[i] = (total << 16) | nb;
+    }
+  }
+  memset(job->stats_, 0, sizeof(job->stats_));
+}
+
+// Gathers the side and filter stats of the last pass into the encoder.
+static void MergeSideStats(VP8Encoder* const enc,
+                           const RowJob* const jobs, int num_jobs) {
+  int n, i, s;
+  for (n = 0; n < num_jobs; ++n) {
+    const RowJob* const job = &jobs[n];
+    for (i = 0; i < 3; ++i) {
+      enc->sse_[i] += job->sse_[i];
+      enc->block_count_[i] += job->block_count_[i];
+    }
+    enc->sse_count_ += job->sse_count_;
+    if (enc->lf_stats_ != NULL) {
+      for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+        for (i = 0; i < MAX_LF_LEVELS; ++i) {
+          (*enc->lf_stats_)[s][i] += job->lf_stats_[s][i];
+        }
+      }
+    }
+    for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+      if (job->max_edge_[s] > enc->dqm_[s].max_edge_) {
+        enc->dqm_[s].max_edge_ = job->max_edge_[s];
+      }
+    }
+  }
+}
+
+static void InitRowJobs(VP8Encoder* const enc, RowJob* const jobs,
+                        int num_jobs, int is_last_pass) {
+  int n;
+  for (n = 0; n < num_jobs; ++n) {
+    RowJob* const job = &jobs[n];
+    VP8IteratorInit(enc, &job->it_);
+    job->it_.lf_stats_ = (enc->lf_stats_ != NULL) ? &job->lf_stats_ : NULL;
+    job->it_.max_edge_ = job->max_edge_;
+    if (is_last_pass) VP8InitFilter(&job->it_);
+    VP8TBufferClear(&job->tokens_);
+    memset(job->stats_, 0, sizeof(job->stats_));
+    memset(job->sse_, 0, sizeof(job->sse_));
+    memset(job->max_edge_, 0, sizeof(job->max_edge_));
+    memset(job->block_count_, 0, sizeof(job->block_count_));
+    job->sse_count_ = 0;
+    job->size_p0_ = 0;
+    job->distortion_ = 0;
+    job->is_last_pass_ = is_last_pass;
+  }
+}
+
+static int ThreadedTokenLoop(VP8Encoder* const enc, int num_workers) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  WebPWorker workers[MAX_ROW_WORKERS];
+  int use_thread[MAX_ROW_WORKERS];
+  int max_count = (enc->mb_w_ * enc->mb_h_) >> 3;
+  int num_pass_left = enc->config_->pass;
+  const int do_search = enc->do_search_;
+  VP8EncProba* const proba = &enc->proba_;
+  const uint64_t pixel_count = enc->mb_w_ * enc->mb_h_ * 384;
+  const int page_size = enc->tokens_.page_size_ / num_workers;
+  RowSchedule sched;
+  PassStats stats;
+  RowJob* jobs;
+  size_t* row_tokens;
+  int n, ok;
+
+  assert(num_workers >= 2 && num_workers <= MAX_ROW_WORKERS);
+  InitPassStats(enc, &stats);
+  InitRowSchedule(enc, num_workers, &sched);
+  ok = PreLoopInitialize(enc);
+  if (!ok) return 0;
+
+  if (max_count < MIN_COUNT) max_count = MIN_COUNT;
+  if (do_search && num_pass_left > 2) {
+    // at least one pass is left to check the 'q' found, before the last one
+    num_pass_left -= SearchQuantizer(enc, enc->rd_opt_level_, max_count,
+                                     num_pass_left - 2, &stats);
+  }
+
+  jobs = (RowJob*)WebPSafeMalloc(num_workers, sizeof(*jobs));
+  row_tokens = (size_t*)WebPSafeMalloc(2ULL * enc->mb_h_, sizeof(*row_tokens));
+  if (jobs == NULL || row_tokens == NULL) {
+    WebPSafeFree(jobs);
+    WebPSafeFree(row_tokens);
+    VP8EncFreeBitWriters(enc);
+    return WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+  for (n = 0; n < num_workers; ++n) {
+    RowJob* const job = &jobs[n];
+    VP8TBufferInit(&job->tokens_, page_size);
+    job->side_.sse_ = job->sse_;
+    job->side_.sse_count_ = &job->sse_count_;
+    job->side_.block_count_ = job->block_count_;
+    job->row_tokens_ = row_tokens;
+    worker_interface->Init(&workers[n]);
+    workers[n].hook = (WebPWorkerHook)CodeRowSpanJob;
+    workers[n].data1 = job;
+    workers[n].data2 = NULL;
+    // The first job is run in the calling thread. The others fall back to
+    // being run synchronously if no thread is available.
+    use_thread[n] = (n > 0) && worker_interface->Reset(&workers[n]);
+  }
+
+  while (ok && num_pass_left-- > 0) {
+    const int is_last_pass = (fabs(stats.dq) <= DQ_LIMIT) ||
+                             (num_pass_left == 0) ||
+                             (enc->max_i4_header_bits_ == 0);
+    const int percent0 = enc->percent_;
+    uint64_t size_p0 = 0;
+    uint64_t distortion = 0;
+    int num_mbs_done = 0;
+    int cnt = max_count;
+    int step;
+    SetLoopParams(enc, stats.q);
+    if (is_last_pass) {
+      ResetTokenStats(enc);
+    }
+    InitRowJobs(enc, jobs, num_workers, is_last_pass);
+    for (step = 0; ok && step < sched.num_steps; ++step) {
+      int num_mbs[MAX_ROW_WORKERS];
+      for (n = 0; n < num_workers; ++n) {
+        num_mbs[n] = SetupRowJob(enc, &sched, n, step, &jobs[n]);
+        if (n > 0 && num_mbs[n] > 0) {
+          if (use_thread[n]) {
+            worker_interface->Launch(&workers[n]);
+          } else {
+            worker_interface->Execute(&workers[n]);
+          }
+        }
+      }
+      if (num_mbs[0] > 0) worker_interface->Execute(&workers[0]);
+      for (n = 0; n < num_workers; ++n) {
+        if (num_mbs[n] > 0) {
+          ok &= worker_interface->Sync(&workers[n]);
+          num_mbs_done += num_mbs[n];
+          cnt -= num_mbs[n];
+        }
+      }
+      if (!ok) {
+        WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+        break;
+      }
+      if (cnt < 0) {
+        for (n = 0; n < num_workers; ++n) MergeTokenStats(&jobs[n], proba);
+        FinalizeTokenProbas(proba);
+        VP8CalculateLevelCosts(proba);  // refresh cost tables for rd-opt
+        cnt = max_count;
+      }
+      if (is_last_pass) {
+        ok = WebPReportProgress(enc->pic_, percent0 + 20 * num_mbs_done /
+                                    (enc->mb_w_ * enc->mb_h_),
+                                &enc->percent_);
+      }
+    }
+    if (!ok) break;
+
+    for (n = 0; n < num_workers; ++n) {
+      MergeTokenStats(&jobs[n], proba);
+      size_p0 += jobs[n].size_p0_;
+      distortion += jobs[n].distortion_;
+    }
+    size_p0 += enc->segment_hdr_.size_;
+    if (stats.do_size_search) {
+      uint64_t size = FinalizeTokenProbas(&enc->proba_);
+      for (n = 0; n < num_workers; ++n) {
+        size += VP8EstimateTokenSize(&jobs[n].tokens_,
+                                     (const uint8_t*)proba->coeffs_);
+      }
+      size = (size + size_p0 + 1024) >> 11;  // -> size in bytes
+      size += HEADER_SIZE_ESTIMATE;
+      stats.value = (double)size;
+    } else {  // compute and store PSNR
+      stats.value = GetPSNR(distortion, pixel_count);
+    }
+
+#if (DEBUG_SEARCH > 0)
+    printf("#%2d metric:%.1lf -> %.1lf   last_q=%.2lf q=%.2lf dq=%.2lf\n",
+           num_pass_left, stats.last_value, stats.value,
+           stats.last_q, stats.q, stats.dq);
+#endif
+    if (size_p0 > PARTITION0_SIZE_LIMIT) {
+      ++num_pass_left;
+      enc->max_i4_header_bits_ >>= 1;  // strengthen header bit limitation...
+      continue;                        // ...and start over
+    }
+    if (is_last_pass) {
+      if (do_search && RetryBestQ(&stats)) {
+        ++num_pass_left;
+        enc->percent_ = percent0;
+        continue;                      // redo the last pass at the best 'q'
+      }
+      break;   // done
+    }
+    if (do_search) {
+      ComputeNextQ(&stats);  // Adjust q
+    }
+  }
+  for (n = 0; n < num_workers; ++n) {
+    worker_interface->End(&workers[n]);
+  }
+  if (ok) {
+    int y;
+    if (!stats.do_size_search) {
+      FinalizeTokenProbas(&enc->proba_);
+    }
+    if (enc->lf_stats_ != NULL) {
+      memset(enc->lf_stats_, 0, sizeof(*enc->lf_stats_));
+    }
+    MergeSideStats(enc, jobs, num_workers);
+    for (y = 0; ok && y < enc->mb_h_; ++y) {
+      ok = VP8EmitTokenRange(&jobs[y % num_workers].tokens_,
+                             row_tokens[2 * y + 0], row_tokens[2 * y + 1],
+                             enc->parts_ + 0, (const uint8_t*)proba->coeffs_);
+    }
+  }
+  ok = ok && WebPReportProgress(enc->pic_, enc->percent_ + 20, &enc->percent_);
+  jobs[0].it_.lf_stats_ = enc->lf_stats_;   // for the final filter strength
+  ok = PostLoopFinalize(&jobs[0].it_, ok);
+  for (n = 0; n < num_workers; ++n) {
+    VP8TBufferClear(&jobs[n].tokens_);
+  }
+  WebPSafeFree(jobs);
+  WebPSafeFree(row_tokens);
+  return ok;
+}
+
 int VP8EncTokenLoop(VP8Encoder* const enc) {
   // Roughly refresh the proba eight times per pass
   int max_count = (enc->mb_w_ * enc->mb_h_) >> 3;
@@ -743,13 +1477,26 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
   const VP8RDLevel rd_opt = enc->rd_opt_level_;
   const uint64_t pixel_count = enc->mb_w_ * enc->mb_h_ * 384;
   PassStats stats;
+  SideStats side;
   int ok;
 
+  if (enc->thread_level_ > 1 && enc->mb_h_ > 1) {
+    const int num_workers = (enc->thread_level_ < MAX_ROW_WORKERS) ?
+                            enc->thread_level_ : MAX_ROW_WORKERS;
+    return ThreadedTokenLoop(enc, num_workers);
+  }
+
   InitPassStats(enc, &stats);
+  InitSideStats(enc, &side);
   ok = PreLoopInitialize(enc);
   if (!ok) return 0;
 
   if (max_count < MIN_COUNT) max_count = MIN_COUNT;
+  if (do_search && enc->thread_level_ > 1 && num_pass_left > 2) {
+    // at least one pass is left to check the 'q' found, before the last one
+    num_pass_left -= SearchQuantizer(enc, enc->rd_opt_level_, max_count,
+                                     num_pass_left - 2, &stats);
+  }
 
   assert(enc->num_parts_ == 1);
   assert(enc->use_tokens_);
@@ -780,7 +1527,7 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
         cnt = max_count;
       }
       VP8Decimate(&it, &info, rd_opt);
-      ok = RecordTokens(&it, &info, &enc->tokens_);
+      ok = RecordTokens(&it, &info, &enc->tokens_, proba->stats_);
       if (!ok) {
         WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
         break;
@@ -788,7 +1535,7 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
       size_p0 += info.H;
       distortion += info.D;
       if (is_last_pass) {
-        StoreSideInfo(&it);
+        StoreSideInfo(&it, &side);
         VP8StoreFilterStats(&it);
         VP8IteratorExport(&it);
         ok = VP8IteratorProgress(&it, 20);
@@ -820,6 +1567,12 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
       continue;                        // ...and start over
     }
     if (is_last_pass) {
+      if (do_search && RetryBestQ(&stats)) {
+        ++num_pass_left;
+        enc->percent_ = it.percent0_;
+        memset(enc->block_count_, 0, sizeof(enc->block_count_));
+        continue;                      // redo the last pass at the best 'q'
+      }
       break;   // done
     }
     if (do_search) {
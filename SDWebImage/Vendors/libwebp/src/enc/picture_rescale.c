@@ -16,6 +16,7 @@
 
 #include "./vp8enci.h"
 #include "../utils/rescaler.h"
+#include "../utils/thread.h"
 #include "../utils/utils.h"
 
 #define HALVE(x) (((x) + 1) >> 1)
@@ -160,22 +161,138 @@ int WebPPictureCrop(WebPPicture* pic,
 //------------------------------------------------------------------------------
 // Simple picture rescaler
 
-static void RescalePlane(const uint8_t* src,
-                         int src_width, int src_height, int src_stride,
-                         uint8_t* dst,
-                         int dst_width, int dst_height, int dst_stride,
-                         rescaler_t* const work,
-                         int num_channels) {
+#define MAX_RESCALE_BANDS 16    // maximum number of bands rescaled in parallel
+
+typedef struct {
+  const uint8_t* src;
+  int src_width, src_height, src_stride;
+  uint8_t* dst;
+  int dst_width, dst_height, dst_stride;
+  int num_channels;
+} RescalePlaneParams;
+
+// Output rows [dst_height * band / num_bands, dst_height * (band + 1) /
+// num_bands[ of each plane, rescaled in sequence using 'work'.
+typedef struct {
+  const RescalePlaneParams* planes;
+  int num_planes;
+  WebPRescalingFilter filter;
+  int band, num_bands;
+  rescaler_t* work;
+} RescaleBand;
+
+static void RescaleBandOfPlane(const RescalePlaneParams* const plane,
+                               WebPRescalingFilter filter,
+                               int band, int num_bands,
+                               rescaler_t* const work) {
+  const int y_start = (int)((int64_t)plane->dst_height * band / num_bands);
+  const int y_end =
+      (int)((int64_t)plane->dst_height * (band + 1) / num_bands);
   WebPRescaler rescaler;
-  int y = 0;
-  WebPRescalerInit(&rescaler, src_width, src_height,
-                   dst, dst_width, dst_height, dst_stride,
-                   num_channels, work);
-  while (y < src_height) {
-    y += WebPRescalerImport(&rescaler, src_height - y,
-                            src + y * src_stride, src_stride);
-    WebPRescalerExport(&rescaler);
+  int y;
+  if (y_start >= y_end) return;
+  WebPRescalerInitFilter(&rescaler, plane->src_width, plane->src_height,
+                         plane->dst + (size_t)y_start * plane->dst_stride,
+                         plane->dst_width, plane->dst_height,
+                         plane->dst_stride, plane->num_channels, filter, work);
+  y = WebPRescalerSeek(&rescaler, y_start, plane->src, plane->src_stride);
+  while (rescaler.dst_y < y_end) {
+    y += WebPRescalerImport(&rescaler, plane->src_height - y,
+                            plane->src + (size_t)y * plane->src_stride,
+                            plane->src_stride);
+    while (WebPRescalerHasPendingOutput(&rescaler) &&
+           rescaler.dst_y < y_end) {
+      WebPRescalerExportRow(&rescaler);
+    }
+  }
+}
+
+static int RescaleBandHook(void* arg1, void* arg2) {
+  const RescaleBand* const job = (const RescaleBand*)arg1;
+  int p;
+  (void)arg2;
+  for (p = 0; p < job->num_planes; ++p) {
+    RescaleBandOfPlane(&job->planes[p], job->filter,
+                       job->band, job->num_bands, job->work);
+  }
+  return 1;
+}
+
+// Rescales all the planes, splitting the output rows into at most
+// 'num_threads' bands that are processed concurrently. Each band seeks the
+// rescalers to its first row, so the result doesn't depend on the split.
+static int RescalePlanes(const RescalePlaneParams* const planes,
+                         int num_planes, WebPRescalingFilter filter,
+                         int num_threads) {
+  const WebPWorkerInterface* const worker_interface = WebPGetWorkerInterface();
+  WebPWorker workers[MAX_RESCALE_BANDS];
+  RescaleBand bands[MAX_RESCALE_BANDS];
+  uint64_t work_size = 0;
+  rescaler_t* work;
+  int num_bands = num_threads;
+  int ok = 1;
+  int i;
+
+  if (num_bands > MAX_RESCALE_BANDS) num_bands = MAX_RESCALE_BANDS;
+  if (num_bands > planes[0].dst_height) num_bands = planes[0].dst_height;
+  if (num_bands < 1) num_bands = 1;
+  for (i = 0; i < num_planes; ++i) {
+    const RescalePlaneParams* const plane = &planes[i];
+    const uint64_t size =
+        WebPRescalerWorkSize(plane->src_width, plane->src_height,
+                             plane->dst_width, plane->dst_height,
+                             plane->num_channels, filter);
+    if (size > work_size) work_size = size;
+  }
+  work = (rescaler_t*)WebPSafeMalloc(num_bands * work_size, sizeof(*work));
+  if (work == NULL) return 0;
+
+  WebPRescalerDspInit();
+  for (i = 0; i < num_bands; ++i) {
+    RescaleBand* const job = &bands[i];
+    job->planes = planes;
+    job->num_planes = num_planes;
+    job->filter = filter;
+    job->band = i;
+    job->num_bands = num_bands;
+    job->work = work + (size_t)i * work_size;
+    worker_interface->Init(&workers[i]);
+    workers[i].hook = RescaleBandHook;
+    workers[i].data1 = job;
+    workers[i].data2 = NULL;
+  }
+  for (i = 1; i < num_bands; ++i) {
+    // Fall back to processing the band synchronously if no thread is
+    // available.
+    if (worker_interface->Reset(&workers[i])) {
+      worker_interface->Launch(&workers[i]);
+    } else {
+      worker_interface->Execute(&workers[i]);
+    }
   }
+  worker_interface->Execute(&workers[0]);
+  for (i = 0; i < num_bands; ++i) {
+    ok &= worker_interface->Sync(&workers[i]);
+    worker_interface->End(&workers[i]);
+  }
+  WebPSafeFree(work);
+  return ok;
+}
+
+static void SetPlane(RescalePlaneParams* const plane,
+                     const uint8_t* src,
+                     int src_width, int src_height, int src_stride,
+                     uint8_t* dst, int dst_width, int dst_height,
+                     int dst_stride, int num_channels) {
+  plane->src = src;
+  plane->src_width = src_width;
+  plane->src_height = src_height;
+  plane->src_stride = src_stride;
+  plane->dst = dst;
+  plane->dst_width = dst_width;
+  plane->dst_height = dst_height;
+  plane->dst_stride = dst_stride;
+  plane->num_channels = num_channels;
 }
 
 static void AlphaMultiplyARGB(WebPPicture* const pic, int inverse) {
@@ -191,12 +308,16 @@ static void AlphaMultiplyY(WebPPicture* const pic, int inverse) {
   }
 }
 
-int WebPPictureRescale(WebPPicture* pic, int width, int height) {
+int WebPPictureRescaleWithFilter(WebPPicture* pic, int width, int height,
+                                 WebPRescalingFilter filter,
+                                 int num_threads) {
   WebPPicture tmp;
+  RescalePlaneParams planes[4];
+  int num_planes = 0;
   int prev_width, prev_height;
-  rescaler_t* work;
 
   if (pic == NULL) return 0;
+  if (filter != WEBP_RESCALE_BOX && filter != WEBP_RESCALE_LANCZOS3) return 0;
   prev_width = pic->width;
   prev_height = pic->height;
   if (!WebPRescalerGetScaledDimensions(
@@ -209,56 +330,59 @@ int WebPPictureRescale(WebPPicture* pic, int width, int height) {
   tmp.height = height;
   if (!WebPPictureAlloc(&tmp)) return 0;
 
+  WebPInitAlphaProcessing();
   if (!pic->use_argb) {
-    work = (rescaler_t*)WebPSafeMalloc(2ULL * width, sizeof(*work));
-    if (work == NULL) {
-      WebPPictureFree(&tmp);
-      return 0;
-    }
-    // If present, we need to rescale alpha first (for AlphaMultiplyY).
+    SetPlane(&planes[num_planes++], pic->y, prev_width, prev_height,
+             pic->y_stride, tmp.y, width, height, tmp.y_stride, 1);
+    SetPlane(&planes[num_planes++], pic->u, HALVE(prev_width),
+             HALVE(prev_height), pic->uv_stride, tmp.u, HALVE(width),
+             HALVE(height), tmp.uv_stride, 1);
+    SetPlane(&planes[num_planes++], pic->v, HALVE(prev_width),
+             HALVE(prev_height), pic->uv_stride, tmp.v, HALVE(width),
+             HALVE(height), tmp.uv_stride, 1);
     if (pic->a != NULL) {
-      WebPInitAlphaProcessing();
-      RescalePlane(pic->a, prev_width, prev_height, pic->a_stride,
-                   tmp.a, width, height, tmp.a_stride, work, 1);
+      SetPlane(&planes[num_planes++], pic->a, prev_width, prev_height,
+               pic->a_stride, tmp.a, width, height, tmp.a_stride, 1);
     }
-
     // We take transparency into account on the luma plane only. That's not
     // totally exact blending, but still is a good approximation.
     AlphaMultiplyY(pic, 0);
-    RescalePlane(pic->y, prev_width, prev_height, pic->y_stride,
-                 tmp.y, width, height, tmp.y_stride, work, 1);
-    AlphaMultiplyY(&tmp, 1);
-
-    RescalePlane(pic->u,
-                 HALVE(prev_width), HALVE(prev_height), pic->uv_stride,
-                 tmp.u,
-                 HALVE(width), HALVE(height), tmp.uv_stride, work, 1);
-    RescalePlane(pic->v,
-                 HALVE(prev_width), HALVE(prev_height), pic->uv_stride,
-                 tmp.v,
-                 HALVE(width), HALVE(height), tmp.uv_stride, work, 1);
   } else {
-    work = (rescaler_t*)WebPSafeMalloc(2ULL * width * 4, sizeof(*work));
-    if (work == NULL) {
-      WebPPictureFree(&tmp);
-      return 0;
-    }
     // In order to correctly interpolate colors, we need to apply the alpha
     // weighting first (black-matting), scale the RGB values, and remove
     // the premultiplication afterward (while preserving the alpha channel).
-    WebPInitAlphaProcessing();
+    SetPlane(&planes[num_planes++], (const uint8_t*)pic->argb,
+             prev_width, prev_height, pic->argb_stride * 4,
+             (uint8_t*)tmp.argb, width, height, tmp.argb_stride * 4, 4);
     AlphaMultiplyARGB(pic, 0);
-    RescalePlane((const uint8_t*)pic->argb, prev_width, prev_height,
-                 pic->argb_stride * 4,
-                 (uint8_t*)tmp.argb, width, height,
-                 tmp.argb_stride * 4,
-                 work, 4);
+  }
+  if (!RescalePlanes(planes, num_planes, filter, num_threads)) {
+    WebPPictureFree(&tmp);
+    return 0;
+  }
+  // The ringing of the filter can leave premultiplied values above alpha.
+  if (!pic->use_argb) {
+    if (tmp.a != NULL) {
+      if (filter != WEBP_RESCALE_BOX) {
+        WebPClampToAlphaRows(tmp.y, tmp.y_stride, tmp.a, tmp.a_stride,
+                             width, height);
+      }
+      AlphaMultiplyY(&tmp, 1);
+    }
+  } else {
+    if (filter != WEBP_RESCALE_BOX) {
+      WebPClampToAlphaARGBRows((uint8_t*)tmp.argb, tmp.argb_stride * 4,
+                               width, height);
+    }
     AlphaMultiplyARGB(&tmp, 1);
   }
   WebPPictureFree(pic);
-  WebPSafeFree(work);
   *pic = tmp;
   return 1;
 }
 
+int WebPPictureRescale(WebPPicture* pic, int width, int height) {
+  return WebPPictureRescaleWithFilter(pic, width, height, WEBP_RESCALE_BOX, 1);
+}
+
 //------------------------------------------------------------------------------
@@ -870,7 +870,7 @@ static int ReconstructUV(VP8EncIterator* const it, VP8ModeScore* const rd,
 // RD-opt decision. Reconstruct each modes, evalue distortion and bit-cost.
 // Pick the mode is lower RD-cost = Rate + lambda * Distortion.
 
-static void StoreMaxDelta(VP8SegmentInfo* const dqm, const int16_t DCs[16]) {
+static void StoreMaxDelta(int* const max_edge, const int16_t DCs[16]) {
   // We look at the first three AC coefficients to determine what is the average
   // delta between each sub-4x4 block.
   const int v0 = abs(DCs[1]);
@@ -878,7 +878,7 @@ static void StoreMaxDelta(VP8SegmentInfo* const dqm, const int16_t DCs[16]) {
   const int v2 = abs(DCs[5]);
   int max_v = (v0 > v1) ? v1 : v0;
   max_v = (v2 > max_v) ? v2 : max_v;
-  if (max_v > dqm->max_edge_) dqm->max_edge_ = max_v;
+  if (max_v > *max_edge) *max_edge = max_v;
 }
 
 static void SwapModeScore(VP8ModeScore** a, VP8ModeScore** b) {
@@ -958,7 +958,9 @@ static void PickBestIntra16(VP8EncIterator* const it, VP8ModeScore* rd) {
   // distortion, record max delta so we can later adjust the minimal filtering
   // strength needed to smooth these blocks out.
   if ((rd->nz & 0xffff) == 0 && rd->D > dqm->min_disto_) {
-    StoreMaxDelta(dqm, rd->y_dc_levels);
+    StoreMaxDelta((it->max_edge_ != NULL) ? &it->max_edge_[it->mb_->segment_]
+                                          : &dqm->max_edge_,
+                  rd->y_dc_levels);
   }
 }
 
@@ -1244,6 +1246,42 @@ static void RefineUsingDistortion(VP8EncIterator* const it,
   rd->score = best_score;
 }
 
+// Realtime mode decision (method < 0): intra16 only, picking among a few
+// luma and chroma modes the one with the smallest sum of absolute differences.
+static const uint8_t kRealtimeModes[3] = { DC_PRED, V_PRED, H_PRED };
+
+static void PickModesRealtime(VP8EncIterator* const it,
+                              VP8ModeScore* const rd) {
+  const uint8_t* const src_y = it->yuv_in_ + Y_OFF_ENC;
+  const uint8_t* const src_uv = it->yuv_in_ + U_OFF_ENC;
+  int best_mode = DC_PRED, best_uv_mode = DC_PRED;
+  int best_sad = VP8SAD16x16(src_y, it->yuv_p_ + VP8I16ModeOffsets[DC_PRED]);
+  int best_uv_sad =
+      VP8SAD16x8(src_uv, it->yuv_p_ + VP8UVModeOffsets[DC_PRED]);
+  int nz, n;
+
+  for (n = 1; n < (int)sizeof(kRealtimeModes); ++n) {
+    const int mode = kRealtimeModes[n];
+    const int sad = VP8SAD16x16(src_y, it->yuv_p_ + VP8I16ModeOffsets[mode]);
+    const int uv_sad =
+        VP8SAD16x8(src_uv, it->yuv_p_ + VP8UVModeOffsets[mode]);
+    if (sad < best_sad) {
+      best_mode = mode;
+      best_sad = sad;
+    }
+    if (uv_sad < best_uv_sad) {
+      best_uv_mode = mode;
+      best_uv_sad = uv_sad;
+    }
+  }
+  VP8SetIntra16Mode(it, best_mode);
+  VP8SetIntraUVMode(it, best_uv_mode);
+  nz = ReconstructIntra16(it, rd, it->yuv_out_ + Y_OFF_ENC, best_mode);
+  nz |= ReconstructUV(it, rd, it->yuv_out_ + U_OFF_ENC, best_uv_mode);
+  rd->nz = nz;
+  rd->score = best_sad + best_uv_sad;
+}
+
 //------------------------------------------------------------------------------
 // Entry point
 
@@ -1270,6 +1308,8 @@ int VP8Decimate(VP8EncIterator* const it, VP8ModeScore* const rd,
       it->do_trellis_ = 1;
       SimpleQuantize(it, rd);
     }
+  } else if (method < 0) {
+    PickModesRealtime(it, rd);
   } else {
     // At this point we have heuristically decided intra16 / intra4.
     // For method >= 2, pick the best intra4/intra16 based on SSE (~tad slower).
@@ -246,6 +246,47 @@ int VP8EmitTokens(VP8TBuffer* const b, VP8BitWriter* const bw,
   return 1;
 }
 
+size_t VP8TBufferNumTokens(const VP8TBuffer* const b) {
+  size_t num_tokens = 0;
+  const VP8Tokens* p = b->pages_;
+  while (p != NULL) {
+    num_tokens += b->page_size_;
+    p = p->next_;
+  }
+  return num_tokens - b->left_;
+}
+
+int VP8EmitTokenRange(const VP8TBuffer* const b, size_t start, size_t end,
+                      VP8BitWriter* const bw, const uint8_t* const probas) {
+  const VP8Tokens* p = b->pages_;
+  const size_t page_size = (size_t)b->page_size_;
+  assert(!b->error_);
+  assert(start <= end && end <= VP8TBufferNumTokens(b));
+  while (start >= page_size) {   // skip the pages before 'start'
+    p = p->next_;
+    start -= page_size;
+    end -= page_size;
+  }
+  while (start < end) {
+    // Tokens are stored from the end of the page towards its beginning.
+    const token_t* const tokens = TOKEN_DATA(p);
+    const size_t last = (end < page_size) ? end : page_size;
+    for (; start < last; ++start) {
+      const token_t token = tokens[page_size - 1 - start];
+      const int bit = (token >> 15) & 1;
+      if (token & FIXED_PROBA_BIT) {
+        VP8PutBit(bw, bit, token & 0xffu);  // constant proba
+      } else {
+        VP8PutBit(bw, bit, probas[token & 0x3fffu]);
+      }
+    }
+    p = p->next_;
+    start -= page_size;
+    end -= page_size;
+  }
+  return 1;
+}
+
 // Size estimation
 size_t VP8EstimateTokenSize(VP8TBuffer* const b, const uint8_t* const probas) {
   size_t size = 0;
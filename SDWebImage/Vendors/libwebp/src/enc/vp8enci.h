@@ -238,6 +238,7 @@ typedef struct {
   uint64_t      luma_bits_;        // macroblock bit-cost for luma
   uint64_t      uv_bits_;          // macroblock bit-cost for chroma
   LFStats*      lf_stats_;         // filter stats (borrowed from enc_)
+  int*          max_edge_;         // max edge deltas (NULL: in enc_->dqm_)
   int           do_trellis_;       // if true, perform extra level optimisation
   int           count_down_;       // number of mb still to be processed
   int           count_down0_;      // starting counter value (for progress)
@@ -324,6 +325,14 @@ void VP8TBufferClear(VP8TBuffer* const b);   // de-allocate pages memory
 int VP8EmitTokens(VP8TBuffer* const b, VP8BitWriter* const bw,
                   const uint8_t* const probas, int final_pass);
 
+// Returns the number of tokens recorded so far.
+size_t VP8TBufferNumTokens(const VP8TBuffer* const b);
+
+// Same as VP8EmitTokens(), but only emits the tokens in the range
+// [start, end), counted in recording order. The memory is not released.
+int VP8EmitTokenRange(const VP8TBuffer* const b, size_t start, size_t end,
+                      VP8BitWriter* const bw, const uint8_t* const probas);
+
 // record the coding of coefficients without knowing the probabilities yet
 int VP8RecordCoeffTokens(const int ctx, const int coeff_type,
                          int first, int last,
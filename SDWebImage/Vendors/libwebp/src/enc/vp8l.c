@@ -321,8 +321,8 @@ static int AnalyzeAndInit(VP8LEncoder* const enc) {
   const int height = pic->height;
   const int pix_cnt = width * height;
   const WebPConfig* const config = enc->config_;
-  const int method = config->method;
-  const int low_effort = (config->method == 0);
+  const int method = (config->method > 0) ? config->method : 0;
+  const int low_effort = (method == 0);
   // we round the block size up, so we're guaranteed to have
   // at max MAX_REFS_BLOCK_PER_IMAGE blocks used:
   int refs_block_size = (pix_cnt - 1) / MAX_REFS_BLOCK_PER_IMAGE + 1;
@@ -1386,7 +1386,7 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
                                    VP8LBitWriter* const bw, int use_cache) {
   WebPEncodingError err = VP8_ENC_OK;
   const int quality = (int)config->quality;
-  const int low_effort = (config->method == 0);
+  const int low_effort = (config->method <= 0);
   const int width = picture->width;
   const int height = picture->height;
   VP8LEncoder* const enc = VP8LEncoderNew(config, picture);
@@ -1395,7 +1395,10 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
   int hdr_size = 0;
   int data_size = 0;
   int use_delta_palettization = 0;
+  WebPEncStageStats timings;   // merged into config->stage_stats, if any
+  uint64_t start = WebPTimerStart();
 
+  memset(&timings, 0, sizeof(timings));
   if (enc == NULL) {
     err = VP8_ENC_ERROR_OUT_OF_MEMORY;
     goto Error;
@@ -1419,6 +1422,8 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
       goto Error;
     }
   }
+  WebPTimerAdd(&timings.analysis_ns, start);
+  start = WebPTimerStart();
 
 #ifdef WEBP_EXPERIMENTAL_FEATURES
   if (config->delta_palettization) {
@@ -1475,14 +1480,24 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
   }
 
   VP8LPutBits(bw, !TRANSFORM_PRESENT, 1);  // No more transforms.
+  WebPTimerAdd(&timings.transform_ns, start);
 
   // ---------------------------------------------------------------------------
   // Encode and write the transformed image.
+  start = WebPTimerStart();
   err = EncodeImageInternal(bw, enc->argb_, &enc->hash_chain_, enc->refs_,
                             enc->current_width_, height, quality, low_effort,
                             use_cache, &enc->cache_bits_, enc->histo_bits_,
                             byte_position, &hdr_size, &data_size);
   if (err != VP8_ENC_OK) goto Error;
+  WebPTimerAdd(&timings.coding_ns, start);
+
+  if (config->stage_stats != NULL) {
+    WebPEncStageStats* const stats = config->stage_stats;
+    stats->analysis_ns += timings.analysis_ns;
+    stats->transform_ns += timings.transform_ns;
+    stats->coding_ns += timings.coding_ns;
+  }
 
   if (picture->stats != NULL) {
     WebPAuxStats* const stats = picture->stats;
@@ -1512,6 +1527,7 @@ int VP8LEncodeImage(const WebPConfig* const config,
   size_t coded_size;
   int percent = 0;
   int initial_size;
+  uint64_t start;
   WebPEncodingError err = VP8_ENC_OK;
   VP8LBitWriter bw;
 
@@ -1573,8 +1589,13 @@ int VP8LEncodeImage(const WebPConfig* const config,
   if (!WebPReportProgress(picture, 90, &percent)) goto UserAbort;
 
   // Finish the RIFF chunk.
+  start = WebPTimerStart();
   err = WriteImage(picture, &bw, &coded_size);
   if (err != VP8_ENC_OK) goto Error;
+  if (config->stage_stats != NULL) {
+    WebPTimerAdd(&config->stage_stats->bitstream_ns, start);
+    config->stage_stats->bytes_out = coded_size;
+  }
 
   if (!WebPReportProgress(picture, 100, &percent)) goto UserAbort;
 
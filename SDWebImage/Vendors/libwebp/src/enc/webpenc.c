@@ -39,7 +39,8 @@ int WebPGetEncoderVersion(void) {
 
 static void ResetSegmentHeader(VP8Encoder* const enc) {
   VP8EncSegmentHeader* const hdr = &enc->segment_hdr_;
-  hdr->num_segments_ = enc->config_->segments;
+  // The realtime method uses a fixed map with a single segment.
+  hdr->num_segments_ = (enc->method_ < 0) ? 1 : enc->config_->segments;
   hdr->update_map_  = (hdr->num_segments_ > 1);
   hdr->size_ = 0;
 }
@@ -91,6 +92,10 @@ static void ResetBoundaryPredictions(VP8Encoder* const enc) {
 //-------------------+---+---+---+---+---+---+---+
 // full-SNS          |   |   |   |   | x | x | x |
 //-------------------+---+---+---+---+---+---+---+
+//
+// Method -1 is the realtime mode: a single segment, intra16 with a few modes
+// picked by SAD, default token probabilities and no stats-collection pass
+// (unless a target size or PSNR is set).
 
 static void MapConfigToTools(VP8Encoder* const enc) {
   const WebPConfig* const config = enc->config_;
@@ -313,23 +318,12 @@ int WebPReportProgress(const WebPPicture* const pic,
 }
 //------------------------------------------------------------------------------
 
-int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
+static int Encode(const WebPConfig* const config, WebPPicture* const pic) {
+  WebPEncStageStats timings;   // merged into config->stage_stats, if any
+  uint64_t start;
   int ok = 0;
 
-  if (pic == NULL)
-    return 0;
-  WebPEncodingSetError(pic, VP8_ENC_OK);  // all ok so far
-  if (config == NULL)  // bad params
-    return WebPEncodingSetError(pic, VP8_ENC_ERROR_NULL_PARAMETER);
-  if (!WebPValidateConfig(config))
-    return WebPEncodingSetError(pic, VP8_ENC_ERROR_INVALID_CONFIGURATION);
-  if (pic->width <= 0 || pic->height <= 0)
-    return WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_DIMENSION);
-  if (pic->width > WEBP_MAX_DIMENSION || pic->height > WEBP_MAX_DIMENSION)
-    return WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_DIMENSION);
-
-  if (pic->stats != NULL) memset(pic->stats, 0, sizeof(*pic->stats));
-
+  memset(&timings, 0, sizeof(timings));
   if (!config->lossless) {
     VP8Encoder* enc = NULL;
 
@@ -337,6 +331,7 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
       WebPCleanupTransparentArea(pic);
     }
 
+    start = WebPTimerStart();
     if (pic->use_argb || pic->y == NULL || pic->u == NULL || pic->v == NULL) {
       // Make sure we have YUVA samples.
       if (config->preprocessing & 4) {
@@ -357,32 +352,43 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
         }
       }
     }
+    WebPTimerAdd(&timings.convert_ns, start);
 
     enc = InitVP8Encoder(config, pic);
     if (enc == NULL) return 0;  // pic->error is already set.
     // Note: each of the tasks below account for 20% in the progress report.
+    start = WebPTimerStart();
     ok = VP8EncAnalyze(enc);
+    WebPTimerAdd(&timings.analysis_ns, start);
 
     // Analysis is done, proceed to actual coding.
     ok = ok && VP8EncStartAlpha(enc);   // possibly done in parallel
+    start = WebPTimerStart();
     if (!enc->use_tokens_) {
       ok = ok && VP8EncLoop(enc);
     } else {
       ok = ok && VP8EncTokenLoop(enc);
     }
+    WebPTimerAdd(&timings.coding_ns, start);
     ok = ok && VP8EncFinishAlpha(enc);
 
+    start = WebPTimerStart();
     ok = ok && VP8EncWrite(enc);
+    WebPTimerAdd(&timings.bitstream_ns, start);
     StoreStats(enc);
+    timings.bytes_out = enc->coded_size_;
+    timings.num_mbs = enc->mb_w_ * enc->mb_h_;
     if (!ok) {
       VP8EncFreeBitWriters(enc);
     }
     ok &= DeleteVP8Encoder(enc);  // must always be called, even if !ok
   } else {
     // Make sure we have ARGB samples.
+    start = WebPTimerStart();
     if (pic->argb == NULL && !WebPPictureYUVAToARGB(pic)) {
       return 0;
     }
+    WebPTimerAdd(&timings.convert_ns, start);
 
     if (!config->exact) {
       WebPCleanupTransparentAreaLossless(pic);
@@ -391,5 +397,56 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
     ok = VP8LEncodeImage(config, pic);  // Sets pic->error in case of problem.
   }
 
+  if (config->stage_stats != NULL) {
+    WebPEncStageStats* const stats = config->stage_stats;
+    stats->convert_ns += timings.convert_ns;
+    stats->analysis_ns += timings.analysis_ns;
+    stats->coding_ns += timings.coding_ns;
+    stats->bitstream_ns += timings.bitstream_ns;
+    if (!config->lossless) {
+      stats->bytes_out = timings.bytes_out;
+      stats->num_mbs = timings.num_mbs;
+    }
+  }
+  return ok;
+}
+
+int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
+  const uint64_t start = WebPTimerStart();
+  WebPMemoryScope scope;
+  int ok;
+
+  if (pic == NULL)
+    return 0;
+  WebPEncodingSetError(pic, VP8_ENC_OK);  // all ok so far
+  if (config == NULL)  // bad params
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_NULL_PARAMETER);
+  if (!WebPValidateConfig(config))
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_INVALID_CONFIGURATION);
+  if (pic->width <= 0 || pic->height <= 0)
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_DIMENSION);
+  if (pic->width > WEBP_MAX_DIMENSION || pic->height > WEBP_MAX_DIMENSION)
+    return WebPEncodingSetError(pic, VP8_ENC_ERROR_BAD_DIMENSION);
+
+  if (pic->stats != NULL) memset(pic->stats, 0, sizeof(*pic->stats));
+  if (config->stage_stats != NULL) {
+    memset(config->stage_stats, 0, sizeof(*config->stage_stats));
+  }
+
+  if (config->memory == NULL) {
+    ok = Encode(config, pic);
+  } else {
+    if (!WebPMemoryScopeBegin(&scope, config->memory)) {
+      return WebPEncodingSetError(pic, VP8_ENC_ERROR_INVALID_CONFIGURATION);
+    }
+    ok = Encode(config, pic);
+    if (!ok && scope.budget_exceeded_) {
+      WebPEncodingSetError(pic, VP8_ENC_ERROR_MEMORY_BUDGET);
+    }
+    WebPMemoryScopeEnd(&scope);
+  }
+  if (config->stage_stats != NULL) {
+    WebPTimerAdd(&config->stage_stats->total_ns, start);
+  }
   return ok;
 }
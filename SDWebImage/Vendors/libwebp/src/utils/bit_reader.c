@@ -18,6 +18,45 @@
 #include "./bit_reader_inl.h"
 #include "../utils/utils.h"
 
+//------------------------------------------------------------------------------
+// Segmented input
+
+int VP8InputChainFind(const VP8InputChain* const chain, size_t pos) {
+  int lo = 0, hi = chain->num_segments_;
+  if (pos >= chain->size_) return chain->num_segments_;
+  // Invariant: segments_[lo].pos_ <= pos < segments_[hi].pos_
+  while (hi - lo > 1) {
+    const int mid = (lo + hi) >> 1;
+    if (chain->segments_[mid].pos_ <= pos) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Returns the part of the input in [*pos, end) that is available in a single
+// segment, and advances *pos past it. Returns NULL if there's none (yet).
+static const uint8_t* GetNextSegment(const VP8InputChain* const chain,
+                                     size_t* const pos, size_t end,
+                                     size_t* const size) {
+  const int s = (*pos < end) ? VP8InputChainFind(chain, *pos)
+                             : chain->num_segments_;
+  if (s == chain->num_segments_) return NULL;
+  {
+    const VP8InputSegment* const segment = &chain->segments_[s];
+    const size_t offset = *pos - segment->pos_;
+    *size = segment->size_ - offset;
+    if (*size > end - *pos) *size = end - *pos;
+    *pos += *size;
+    return segment->buf_ + offset;
+  }
+}
+
+// Read buffer of the bit readers, while no input is available.
+static const uint8_t kNoInput[1] = { 0 };
+
 //------------------------------------------------------------------------------
 // VP8BitReader
 
@@ -40,10 +79,38 @@ void VP8InitBitReader(VP8BitReader* const br,
   br->value_   = 0;
   br->bits_    = -8;   // to load the very first 8bits
   br->eof_     = 0;
+  br->chain_   = NULL;
   VP8BitReaderSetBuffer(br, start, size);
   VP8LoadNewBytes(br);
 }
 
+void VP8InitBitReaderChain(VP8BitReader* const br,
+                           const VP8InputChain* const chain,
+                           size_t start, size_t end) {
+  assert(br != NULL);
+  assert(chain != NULL);
+  assert(start <= end);
+  br->range_    = 255 - 1;
+  br->value_    = 0;
+  br->bits_     = -8;  // the first bits are loaded on first use, if available
+  br->eof_      = 0;
+  br->chain_    = chain;
+  br->next_pos_ = start;
+  br->end_pos_  = end;
+  VP8BitReaderSetBuffer(br, kNoInput, 0);
+}
+
+// Moves the read buffer to the next part of the segmented input, if available.
+static int LoadNextSegment(VP8BitReader* const br) {
+  const uint8_t* buf;
+  size_t size;
+  if (br->chain_ == NULL) return 0;
+  buf = GetNextSegment(br->chain_, &br->next_pos_, br->end_pos_, &size);
+  if (buf == NULL) return 0;
+  VP8BitReaderSetBuffer(br, buf, size);
+  return 1;
+}
+
 void VP8RemapBitReader(VP8BitReader* const br, ptrdiff_t offset) {
   if (br->buf_ != NULL) {
     br->buf_ += offset;
@@ -87,7 +154,7 @@ const uint8_t kVP8NewRange[128] = {
 void VP8LoadFinalBytes(VP8BitReader* const br) {
   assert(br != NULL && br->buf_ != NULL);
   // Only read 8bits at a time
-  if (br->buf_ < br->buf_end_) {
+  if (br->buf_ < br->buf_end_ || LoadNextSegment(br)) {
     br->bits_ += 8;
     br->value_ = (bit_t)(*br->buf_++) | (br->value_ << 8);
   } else if (!br->eof_) {
@@ -148,6 +215,7 @@ void VP8LInitBitReader(VP8LBitReader* const br, const uint8_t* const start,
   br->val_ = 0;
   br->bit_pos_ = 0;
   br->eos_ = 0;
+  br->chain_ = NULL;
 
   if (length > sizeof(br->val_)) {
     length = sizeof(br->val_);
@@ -176,9 +244,23 @@ static void VP8LSetEndOfStream(VP8LBitReader* const br) {
   br->bit_pos_ = 0;  // To avoid undefined behaviour with shifts.
 }
 
+// Moves buf_ to the next part of the segmented input, if available.
+static int VP8LLoadNextSegment(VP8LBitReader* const br) {
+  const uint8_t* buf;
+  size_t size;
+  if (br->chain_ == NULL) return 0;
+  buf = GetNextSegment(br->chain_, &br->next_pos_, br->end_pos_, &size);
+  if (buf == NULL) return 0;
+  br->buf_ = buf;
+  br->len_ = size;
+  br->pos_ = 0;
+  return 1;
+}
+
 // If not at EOS, reload up to VP8L_LBITS byte-by-byte
 static void ShiftBytes(VP8LBitReader* const br) {
-  while (br->bit_pos_ >= 8 && br->pos_ < br->len_) {
+  while (br->bit_pos_ >= 8 &&
+         (br->pos_ < br->len_ || VP8LLoadNextSegment(br))) {
     br->val_ >>= 8;
     br->val_ |= ((vp8l_val_t)br->buf_[br->pos_]) << (VP8L_LBITS - 8);
     ++br->pos_;
@@ -189,6 +271,24 @@ static void ShiftBytes(VP8LBitReader* const br) {
   }
 }
 
+void VP8LInitBitReaderChain(VP8LBitReader* const br,
+                            const VP8InputChain* const chain,
+                            size_t start, size_t end) {
+  assert(br != NULL);
+  assert(chain != NULL);
+  assert(start <= end);
+  br->val_ = 0;
+  br->bit_pos_ = VP8L_LBITS;  // nothing loaded yet
+  br->eos_ = 0;
+  br->buf_ = kNoInput;
+  br->len_ = 0;
+  br->pos_ = 0;
+  br->chain_ = chain;
+  br->next_pos_ = start;
+  br->end_pos_ = end;
+  ShiftBytes(br);
+}
+
 void VP8LDoFillBitWindow(VP8LBitReader* const br) {
   assert(br->bit_pos_ >= VP8L_WBITS);
 #if defined(VP8L_USE_FAST_LOAD)
@@ -64,6 +64,30 @@ typedef uint32_t bit_t;
 
 typedef uint32_t range_t;
 
+//------------------------------------------------------------------------------
+// Segmented input
+
+// The input can be made of several memory segments, read one after the other.
+typedef struct {
+  const uint8_t* buf_;        // segment data
+  size_t size_;               // segment size (non-zero)
+  size_t pos_;                // input position of the first byte of buf_
+} VP8InputSegment;
+
+typedef struct {
+  VP8InputSegment* segments_;
+  int num_segments_;
+  int max_segments_;          // allocated size of segments_[]
+  size_t size_;               // total size of the input
+} VP8InputChain;
+
+// End position standing for the end of the input, whatever its final size.
+#define VP8_INPUT_CHAIN_END (~(size_t)0)
+
+// Returns the index of the segment holding the input byte at 'pos', or
+// chain->num_segments_ if 'pos' is past the end of the input.
+int VP8InputChainFind(const VP8InputChain* const chain, size_t pos);
+
 //------------------------------------------------------------------------------
 // Bitreader
 
@@ -78,11 +102,21 @@ struct VP8BitReader {
   const uint8_t* buf_end_;    // end of read buffer
   const uint8_t* buf_max_;    // max packed-read position on buffer
   int eof_;                   // true if input is exhausted
+  // segmented input: the read buffer is the current part of a segment
+  const VP8InputChain* chain_;  // NULL if the input is a single buffer
+  size_t next_pos_;           // input position matching buf_end_
+  size_t end_pos_;            // input position where the data ends
 };
 
 // Initialize the bit reader and the boolean decoder.
 void VP8InitBitReader(VP8BitReader* const br,
                       const uint8_t* const start, size_t size);
+// Initialize the bit reader for the bytes [start, end) of a segmented input.
+// The bytes don't need to be available yet: the reader will pick up the
+// segments appended to 'chain' later on.
+void VP8InitBitReaderChain(VP8BitReader* const br,
+                           const VP8InputChain* const chain,
+                           size_t start, size_t end);
 // Sets the working read buffer.
 void VP8BitReaderSetBuffer(VP8BitReader* const br,
                            const uint8_t* const start, size_t size);
@@ -125,12 +159,21 @@ typedef struct {
   size_t         pos_;        // byte position in buf_
   int            bit_pos_;    // current bit-reading position in val_
   int            eos_;        // true if a bit was read past the end of buffer
+  // segmented input: buf_ is the current part of a segment
+  const VP8InputChain* chain_;  // NULL if the input is a single buffer
+  size_t         next_pos_;   // input position matching buf_ + len_
+  size_t         end_pos_;    // input position where the data ends
 } VP8LBitReader;
 
 void VP8LInitBitReader(VP8LBitReader* const br,
                        const uint8_t* const start,
                        size_t length);
 
+// Same as VP8InitBitReaderChain(), for the lossless bit reader.
+void VP8LInitBitReaderChain(VP8LBitReader* const br,
+                            const VP8InputChain* const chain,
+                            size_t start, size_t end);
+
 //  Sets a new data buffer.
 void VP8LBitReaderSetBuffer(VP8LBitReader* const br,
                             const uint8_t* const buffer, size_t length);
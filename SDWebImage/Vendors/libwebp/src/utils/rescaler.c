@@ -67,9 +67,210 @@ void WebPRescalerInit(WebPRescaler* const wrk, int src_width, int src_height,
   wrk->frow = work + num_channels * dst_width;
   memset(work, 0, 2 * dst_width * num_channels * sizeof(*work));
 
+  wrk->filter = WEBP_RESCALE_BOX;
+  wrk->x_taps = wrk->y_taps = 0;
+  wrk->x_start = wrk->y_start = NULL;
+  wrk->x_weights = wrk->y_weights = NULL;
+  wrk->rows = NULL;
+
   WebPRescalerDspInit();
 }
 
+//------------------------------------------------------------------------------
+// Separable filters
+
+#define LANCZOS_LOBES 3
+#define FILTER_PI 3.14159265358979323846
+
+// Returns sin(pi * x). Written out so as not to depend on libm.
+static double SinPi(double x) {
+  const int n = (int)((x >= 0.) ? x + 0.5 : x - 0.5);   // nearest integer
+  const double f = (x - n) * FILTER_PI;                // in [-pi/2, pi/2]
+  const double f2 = f * f;
+  const double s = f * (1. - f2 / 6. * (1. - f2 / 20. * (1. - f2 / 42. *
+                   (1. - f2 / 72. * (1. - f2 / 110.)))));
+  return (n & 1) ? -s : s;
+}
+
+static double Lanczos3(double x) {
+  if (x < 0.) x = -x;
+  if (x < 1e-8) return 1.;
+  if (x >= LANCZOS_LOBES) return 0.;
+  return LANCZOS_LOBES * SinPi(x) * SinPi(x / LANCZOS_LOBES) /
+         (FILTER_PI * FILTER_PI * x * x);
+}
+
+static int FloorToInt(double x) {
+  const int i = (int)x;
+  return (x < i) ? i - 1 : i;
+}
+
+static int RoundToInt(double x) {
+  return (int)((x >= 0.) ? x + 0.5 : x - 0.5);
+}
+
+// The filter is stretched by the reduction ratio when shrinking.
+static double FilterScale(int src_size, int dst_size) {
+  const double ratio = (double)src_size / dst_size;
+  return (ratio > 1.) ? ratio : 1.;
+}
+
+static int NumTaps(int src_size, int dst_size) {
+  const int num_taps = (int)(2. * LANCZOS_LOBES *
+                             FilterScale(src_size, dst_size)) + 1;
+  return (num_taps > src_size) ? src_size : num_taps;
+}
+
+// Computes the 'num_taps' weights of the output sample 'pos' and returns the
+// index of the source sample the first one applies to. The source samples
+// outside of [0, src_size) are replaced by the nearest edge sample.
+static int ComputeWeights(int pos, int src_size, int dst_size, int num_taps,
+                          int* const weights) {
+  const double ratio = (double)src_size / dst_size;
+  const double scale = FilterScale(src_size, dst_size);
+  const double support = LANCZOS_LOBES * scale;
+  const double center = (pos + 0.5) * ratio - 0.5;
+  const int first = FloorToInt(center - support) + 1;
+  const int last = FloorToInt(center + support);
+  int start = first;
+  int i, sum = 0, biggest = 0;
+  double norm = 0.;
+  if (start > src_size - num_taps) start = src_size - num_taps;
+  if (start < 0) start = 0;
+  for (i = first; i <= last; ++i) norm += Lanczos3((i - center) / scale);
+  norm = (1 << WEBP_RESCALER_FILTER_BITS) / norm;
+  memset(weights, 0, num_taps * sizeof(*weights));
+  for (i = first; i <= last; ++i) {
+    const int j = (i < 0) ? 0 : (i >= src_size) ? src_size - 1 : i;
+    assert(j - start >= 0 && j - start < num_taps);
+    weights[j - start] += RoundToInt(Lanczos3((i - center) / scale) * norm);
+  }
+  for (i = 0; i < num_taps; ++i) {
+    sum += weights[i];
+    if (weights[i] > weights[biggest]) biggest = i;
+  }
+  // Rounding errors go to the main weight, for an exact unit gain.
+  weights[biggest] += (1 << WEBP_RESCALER_FILTER_BITS) - sum;
+  return start;
+}
+
+uint64_t WebPRescalerWorkSize(int src_width, int src_height,
+                              int dst_width, int dst_height,
+                              int num_channels, WebPRescalingFilter filter) {
+  const uint64_t row_size = (uint64_t)dst_width * num_channels;
+  if (filter == WEBP_RESCALE_BOX) {
+    return 2 * row_size;
+  } else {
+    const int x_taps = NumTaps(src_width, dst_width);
+    const int y_taps = NumTaps(src_height, dst_height);
+    return (y_taps + 1) * row_size +                  // rows + accumulator
+           (uint64_t)dst_width * (x_taps + 1) +       // x_start + x_weights
+           (uint64_t)dst_height * (y_taps + 1);       // y_start + y_weights
+  }
+}
+
+void WebPRescalerInitFilter(WebPRescaler* const wrk,
+                            int src_width, int src_height,
+                            uint8_t* const dst,
+                            int dst_width, int dst_height, int dst_stride,
+                            int num_channels, WebPRescalingFilter filter,
+                            rescaler_t* const work) {
+  const int row_size = dst_width * num_channels;
+  int i;
+  WebPRescalerInit(wrk, src_width, src_height, dst, dst_width, dst_height,
+                   dst_stride, num_channels, work);
+  if (filter == WEBP_RESCALE_BOX) return;
+
+  wrk->filter = filter;
+  wrk->x_taps = NumTaps(src_width, dst_width);
+  wrk->y_taps = NumTaps(src_height, dst_height);
+  wrk->rows = (int32_t*)work;
+  wrk->irow = wrk->frow = work + (size_t)wrk->y_taps * row_size;
+  wrk->x_start = (int*)(wrk->irow + row_size);
+  wrk->x_weights = wrk->x_start + dst_width;
+  wrk->y_start = wrk->x_weights + (size_t)dst_width * wrk->x_taps;
+  wrk->y_weights = wrk->y_start + dst_height;
+  for (i = 0; i < dst_width; ++i) {
+    wrk->x_start[i] =
+        ComputeWeights(i, src_width, dst_width, wrk->x_taps,
+                       wrk->x_weights + (size_t)i * wrk->x_taps);
+  }
+  for (i = 0; i < dst_height; ++i) {
+    wrk->y_start[i] =
+        ComputeWeights(i, src_height, dst_height, wrk->y_taps,
+                       wrk->y_weights + (size_t)i * wrk->y_taps);
+  }
+  wrk->y_sub = 1;
+  wrk->y_accum = wrk->y_start[0] + wrk->y_taps;
+}
+
+void WebPRescalerInitStrip(WebPRescaler* const strip,
+                           const WebPRescaler* const wrk,
+                           int x_offset, int width) {
+  const size_t row_size = (size_t)width * wrk->num_channels;
+  assert(wrk->filter != WEBP_RESCALE_BOX);
+  assert(wrk->src_y == 0 && wrk->dst_y == 0);
+  assert(x_offset >= 0 && width > 0 && x_offset + width <= wrk->dst_width);
+  *strip = *wrk;
+  strip->dst_width = width;
+  strip->dst = wrk->dst + x_offset * wrk->num_channels;
+  // 'x_start' holds absolute source positions: the source rows are unchanged.
+  strip->x_start = wrk->x_start + x_offset;
+  strip->x_weights = wrk->x_weights + (size_t)x_offset * wrk->x_taps;
+  // The (y_taps + 1) rows of the strip lie in the ones of 'wrk', in order.
+  strip->rows =
+      wrk->rows + (size_t)(wrk->y_taps + 1) * x_offset * wrk->num_channels;
+  strip->irow = strip->frow =
+      (rescaler_t*)strip->rows + (size_t)wrk->y_taps * row_size;
+}
+
+#undef FILTER_PI
+#undef LANCZOS_LOBES
+
+//------------------------------------------------------------------------------
+// Band rescaling
+
+#define MULT_FIX(x, y) \
+    (((uint64_t)(x) * (y) + (WEBP_RESCALER_ONE >> 1)) >> WEBP_RESCALER_RFIX)
+
+int WebPRescalerSeek(WebPRescaler* const wrk, int dst_y,
+                     const uint8_t* src, int src_stride) {
+  assert(wrk->src_y == 0 && wrk->dst_y == 0);
+  if (dst_y <= 0) return 0;
+  assert(dst_y < wrk->dst_height);
+  wrk->dst_y = dst_y;
+  if (wrk->filter != WEBP_RESCALE_BOX) {
+    wrk->src_y = wrk->y_start[dst_y];
+    wrk->y_accum = wrk->y_taps;
+  } else if (wrk->y_expand) {
+    // The row 'dst_y' interpolates between the source rows 'n - 2' and
+    // 'n - 1', which are imported next.
+    const int64_t pos = (int64_t)dst_y * wrk->y_add;
+    const int n = 1 + (int)((pos + wrk->y_sub - 1) / wrk->y_sub);
+    wrk->src_y = (n >= 2) ? n - 2 : 0;
+    wrk->y_accum = (int)(wrk->y_sub + pos - (int64_t)wrk->src_y * wrk->y_sub);
+  } else {
+    // The row 'dst_y' starts with what remains of the source row 'n - 1'.
+    const int64_t pos = (int64_t)dst_y * wrk->y_add;
+    const int n = (int)((pos + wrk->y_sub - 1) / wrk->y_sub);
+    const int accum = (int)(pos - (int64_t)n * wrk->y_sub);   // in ]-y_sub, 0]
+    if (accum < 0) {
+      const uint32_t yscale = wrk->fy_scale * (-accum);
+      int x;
+      wrk->src_y = n - 1;
+      WebPRescalerImportRow(wrk, src + (size_t)(n - 1) * src_stride);
+      for (x = 0; x < wrk->num_channels * wrk->dst_width; ++x) {
+        wrk->irow[x] = (uint32_t)MULT_FIX(wrk->frow[x], yscale);
+      }
+    }
+    wrk->src_y = n;
+    wrk->y_accum = accum + wrk->y_add;
+  }
+  return wrk->src_y;
+}
+
+#undef MULT_FIX
+
 int WebPRescalerGetScaledDimensions(int src_width, int src_height,
                                     int* const scaled_width,
                                     int* const scaled_height) {
@@ -109,14 +310,16 @@ int WebPRescaleNeededLines(const WebPRescaler* const wrk, int max_num_lines) {
 int WebPRescalerImport(WebPRescaler* const wrk, int num_lines,
                        const uint8_t* src, int src_stride) {
   int total_imported = 0;
+  const int use_box = (wrk->filter == WEBP_RESCALE_BOX);
   while (total_imported < num_lines && !WebPRescalerHasPendingOutput(wrk)) {
-    if (wrk->y_expand) {
+    if (use_box && wrk->y_expand) {
       rescaler_t* const tmp = wrk->irow;
       wrk->irow = wrk->frow;
       wrk->frow = tmp;
     }
     WebPRescalerImportRow(wrk, src);
-    if (!wrk->y_expand) {     // Accumulate the contribution of the new row.
+    // Accumulate the contribution of the new row.
+    if (use_box && !wrk->y_expand) {
       int x;
       for (x = 0; x < wrk->num_channels * wrk->dst_width; ++x) {
         wrk->irow[x] += wrk->frow[x];
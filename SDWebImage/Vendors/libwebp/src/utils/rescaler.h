@@ -25,6 +25,11 @@ extern "C" {
 #define WEBP_RESCALER_FRAC(x, y) \
     ((uint32_t)(((uint64_t)(x) << WEBP_RESCALER_RFIX) / (y)))
 
+// Separable filters: precision of the weights, and number of fractional bits
+// kept in the horizontally filtered rows.
+#define WEBP_RESCALER_FILTER_BITS 14
+#define WEBP_RESCALER_ROW_BITS 7
+
 // Structure used for on-the-fly rescaling
 typedef uint32_t rescaler_t;   // type for side-buffer
 typedef struct WebPRescaler WebPRescaler;
@@ -44,6 +49,16 @@ struct WebPRescaler {
   uint8_t* dst;
   int dst_stride;
   rescaler_t* irow, *frow;    // work buffer
+  // Separable filters (filter != WEBP_RESCALE_BOX) only. Output row 'dst_y'
+  // is computed from the horizontally filtered source rows
+  // [y_start[dst_y], y_start[dst_y] + y_taps), kept in the ring buffer 'rows'
+  // (row 'y' in slot 'y % y_taps'). 'y_accum' is then the number of source
+  // rows still needed for the next output row, and 'irow' the accumulator.
+  WebPRescalingFilter filter;
+  int x_taps, y_taps;         // number of weights per output sample
+  int* x_start, *y_start;     // first source sample of each output sample
+  int* x_weights, *y_weights; // x_taps (resp. y_taps) weights per sample
+  int32_t* rows;              // y_taps filtered rows of dst_width samples
 };
 
 // Initialize a rescaler given scratch area 'work' and dimensions of src & dst.
@@ -54,6 +69,38 @@ void WebPRescalerInit(WebPRescaler* const rescaler,
                       int num_channels,
                       rescaler_t* const work);
 
+// Returns the number of rescaler_t elements needed by the 'work' area of
+// WebPRescalerInitFilter().
+uint64_t WebPRescalerWorkSize(int src_width, int src_height,
+                              int dst_width, int dst_height,
+                              int num_channels, WebPRescalingFilter filter);
+
+// Same as WebPRescalerInit() using the given resampling 'filter'. 'work' must
+// hold WebPRescalerWorkSize() elements.
+void WebPRescalerInitFilter(WebPRescaler* const rescaler,
+                            int src_width, int src_height,
+                            uint8_t* const dst,
+                            int dst_width, int dst_height, int dst_stride,
+                            int num_channels, WebPRescalingFilter filter,
+                            rescaler_t* const work);
+
+// Sets up 'strip' to produce the output columns [x_offset, x_offset + width)
+// of the freshly initialized separable-filter 'rescaler', whose weights it
+// shares. The rows of the strip are taken from the ones of 'rescaler', which
+// must not be used anymore once split into disjoint strips. These don't
+// depend on each other and can run concurrently.
+void WebPRescalerInitStrip(WebPRescaler* const strip,
+                           const WebPRescaler* const rescaler,
+                           int x_offset, int width);
+
+// Sets up a freshly initialized rescaler to produce the output rows from
+// 'dst_y' onward, as if the previous ones had already been exported. 'src'
+// points to the whole source picture, of which at most one row is imported.
+// Returns the index of the next source row to pass to WebPRescalerImport().
+// 'rescaler->dst' is left untouched.
+int WebPRescalerSeek(WebPRescaler* const rescaler, int dst_y,
+                     const uint8_t* src, int src_stride);
+
 // If either 'scaled_width' or 'scaled_height' (but not both) is 0 the value
 // will be calculated preserving the aspect ratio, otherwise the values are
 // left unmodified. Returns true on success, false if either value is 0 after
@@ -202,7 +202,7 @@ static int pthread_cond_wait(pthread_cond_t* const condition,
 
 //------------------------------------------------------------------------------
 
-static void Execute(WebPWorker* const worker);  // Forward declaration.
+static void RunHook(WebPWorker* const worker);  // Forward declaration.
 
 static THREADFN ThreadLoop(void* ptr) {
   WebPWorker* const worker = (WebPWorker*)ptr;
@@ -213,7 +213,7 @@ static THREADFN ThreadLoop(void* ptr) {
       pthread_cond_wait(&worker->impl_->condition_, &worker->impl_->mutex_);
     }
     if (worker->status_ == WORK) {
-      Execute(worker);
+      RunHook(worker);
       worker->status_ = OK;
     } else if (worker->status_ == NOT_OK) {   // finish the worker
       done = 1;
@@ -303,17 +303,26 @@ static int Reset(WebPWorker* const worker) {
   return ok;
 }
 
-static void Execute(WebPWorker* const worker) {
+// Calls the hook in the memory scope of the thread which launched it.
+static void RunHook(WebPWorker* const worker) {
   if (worker->hook != NULL) {
+    WebPMemoryScope* const prev_scope = WebPMemoryScopeSwap(worker->scope_);
     worker->had_error |= !worker->hook(worker->data1, worker->data2);
+    WebPMemoryScopeSwap(prev_scope);
   }
 }
 
+static void Execute(WebPWorker* const worker) {
+  worker->scope_ = WebPMemoryScopeGetCurrent();
+  RunHook(worker);
+}
+
 static void Launch(WebPWorker* const worker) {
+  worker->scope_ = WebPMemoryScopeGetCurrent();
 #ifdef WEBP_USE_THREAD
   ChangeState(worker, WORK);
 #else
-  Execute(worker);
+  RunHook(worker);
 #endif
 }
 
@@ -356,3 +365,311 @@ const WebPWorkerInterface* WebPGetWorkerInterface(void) {
 }
 
 //------------------------------------------------------------------------------
+// Thread pool
+//
+// The pooled interface doesn't tie a thread to each worker: Launch() queues
+// the worker's job on one of the pool's persistent threads, round-robin. Each
+// thread runs the jobs of its own queue in order, and steals the oldest job of
+// the other queues when it has nothing left to do. Sync() runs the job itself
+// if it is still waiting in a queue.
+
+#ifdef WEBP_USE_THREAD
+
+typedef struct PoolJob PoolJob;
+struct PoolJob {               // per-worker state, stored in worker->impl_
+  WebPWorker* worker_;
+  pthread_mutex_t mutex_;      // protects worker->status_
+  pthread_cond_t  condition_;  // signaled when the job is done
+  int queue_;                  // queue receiving the job
+  int queued_;                 // true while the job is waiting in its queue
+  PoolJob* prev_;
+  PoolJob* next_;
+};
+
+typedef struct {
+  pthread_mutex_t mutex_;
+  PoolJob* first_;
+  PoolJob* last_;
+} PoolQueue;
+
+#define MAX_POOL_THREADS 64
+
+typedef struct {
+  int num_threads_;
+  pthread_t threads_[MAX_POOL_THREADS];
+  PoolQueue queues_[MAX_POOL_THREADS];
+  pthread_mutex_t mutex_;      // protects the fields below
+  pthread_cond_t  condition_;  // signaled when a job is queued, or on stop
+  int pending_;                // number of queued jobs
+  int stop_;
+  int next_queue_;             // queue for the next worker to be reset
+} WorkerPool;
+
+static WorkerPool* g_pool = NULL;
+
+static PoolJob* GetPoolJob(const WebPWorker* const worker) {
+  return (PoolJob*)worker->impl_;
+}
+
+// Unlink 'job' from 'queue'. Must be called with the queue's mutex locked.
+static void Unlink(PoolQueue* const queue, PoolJob* const job) {
+  if (job->prev_ != NULL) job->prev_->next_ = job->next_;
+  if (job->next_ != NULL) job->next_->prev_ = job->prev_;
+  if (queue->first_ == job) queue->first_ = job->next_;
+  if (queue->last_ == job) queue->last_ = job->prev_;
+  job->prev_ = job->next_ = NULL;
+  job->queued_ = 0;
+}
+
+static void DecrementPending(WorkerPool* const pool) {
+  pthread_mutex_lock(&pool->mutex_);
+  --pool->pending_;
+  pthread_mutex_unlock(&pool->mutex_);
+}
+
+// Remove 'job' from its queue, if still there. Returns true if removed.
+static int Dequeue(WorkerPool* const pool, PoolJob* const job) {
+  PoolQueue* const queue = &pool->queues_[job->queue_];
+  int removed = 0;
+  pthread_mutex_lock(&queue->mutex_);
+  if (job->queued_) {
+    Unlink(queue, job);
+    removed = 1;
+  }
+  pthread_mutex_unlock(&queue->mutex_);
+  if (removed) DecrementPending(pool);
+  return removed;
+}
+
+// Return the oldest job of the thread's own queue, or steal one.
+static PoolJob* NextJob(WorkerPool* const pool, int id) {
+  int i;
+  for (i = 0; i < pool->num_threads_; ++i) {
+    PoolQueue* const queue = &pool->queues_[(id + i) % pool->num_threads_];
+    PoolJob* job;
+    pthread_mutex_lock(&queue->mutex_);
+    job = queue->first_;
+    if (job != NULL) Unlink(queue, job);
+    pthread_mutex_unlock(&queue->mutex_);
+    if (job != NULL) {
+      DecrementPending(pool);
+      return job;
+    }
+  }
+  return NULL;
+}
+
+static void RunJob(PoolJob* const job) {
+  WebPWorker* const worker = job->worker_;
+  RunHook(worker);
+  pthread_mutex_lock(&job->mutex_);
+  worker->status_ = OK;
+  pthread_cond_signal(&job->condition_);
+  pthread_mutex_unlock(&job->mutex_);
+}
+
+typedef struct {
+  WorkerPool* pool_;
+  int id_;
+} PoolThreadArgs;
+
+static PoolThreadArgs g_pool_args[MAX_POOL_THREADS];
+
+static THREADFN PoolLoop(void* ptr) {
+  const PoolThreadArgs* const args = (const PoolThreadArgs*)ptr;
+  WorkerPool* const pool = args->pool_;
+  for (;;) {
+    PoolJob* const job = NextJob(pool, args->id_);
+    if (job != NULL) {
+      RunJob(job);
+      continue;
+    }
+    pthread_mutex_lock(&pool->mutex_);
+    while (pool->pending_ == 0 && !pool->stop_) {
+      pthread_cond_wait(&pool->condition_, &pool->mutex_);
+    }
+    if (pool->pending_ == 0) {   // stopping, and nothing left to do
+      pthread_mutex_unlock(&pool->mutex_);
+      break;
+    }
+    pthread_mutex_unlock(&pool->mutex_);
+  }
+  return THREAD_RETURN(NULL);
+}
+
+static int PoolSync(WebPWorker* const worker) {
+  PoolJob* const job = GetPoolJob(worker);
+  if (job != NULL) {
+    if (g_pool != NULL && Dequeue(g_pool, job)) {  // not started: run it here
+      RunJob(job);
+    }
+    pthread_mutex_lock(&job->mutex_);
+    while (worker->status_ == WORK) {
+      pthread_cond_wait(&job->condition_, &job->mutex_);
+    }
+    pthread_mutex_unlock(&job->mutex_);
+  }
+  assert(worker->status_ <= OK);
+  return !worker->had_error;
+}
+
+static int PoolReset(WebPWorker* const worker) {
+  int ok = 1;
+  worker->had_error = 0;
+  if (worker->status_ < OK) {
+    PoolJob* job;
+    if (g_pool == NULL) return 0;   // the pool was stopped
+    job = (PoolJob*)WebPSafeCalloc(1, sizeof(*job));
+    if (job == NULL) return 0;
+    if (pthread_mutex_init(&job->mutex_, NULL)) {
+      WebPSafeFree(job);
+      return 0;
+    }
+    if (pthread_cond_init(&job->condition_, NULL)) {
+      pthread_mutex_destroy(&job->mutex_);
+      WebPSafeFree(job);
+      return 0;
+    }
+    job->worker_ = worker;
+    pthread_mutex_lock(&g_pool->mutex_);
+    job->queue_ = g_pool->next_queue_;
+    g_pool->next_queue_ = (g_pool->next_queue_ + 1) % g_pool->num_threads_;
+    pthread_mutex_unlock(&g_pool->mutex_);
+    worker->impl_ = (WebPWorkerImpl*)job;
+    worker->status_ = OK;
+  } else if (worker->status_ > OK) {
+    ok = PoolSync(worker);
+  }
+  assert(!ok || (worker->status_ == OK));
+  return ok;
+}
+
+static void PoolLaunch(WebPWorker* const worker) {
+  PoolJob* const job = GetPoolJob(worker);
+  PoolQueue* queue;
+  if (job == NULL) return;
+  assert(worker->status_ == OK);
+  worker->status_ = WORK;
+  worker->scope_ = WebPMemoryScopeGetCurrent();
+  if (g_pool == NULL) {   // the pool was stopped: run the job right away
+    RunJob(job);
+    return;
+  }
+  queue = &g_pool->queues_[job->queue_];
+  pthread_mutex_lock(&queue->mutex_);
+  job->prev_ = queue->last_;
+  job->next_ = NULL;
+  if (queue->last_ != NULL) {
+    queue->last_->next_ = job;
+  } else {
+    queue->first_ = job;
+  }
+  queue->last_ = job;
+  job->queued_ = 1;
+  pthread_mutex_unlock(&queue->mutex_);
+  pthread_mutex_lock(&g_pool->mutex_);
+  ++g_pool->pending_;
+  pthread_cond_signal(&g_pool->condition_);
+  pthread_mutex_unlock(&g_pool->mutex_);
+}
+
+static void PoolEnd(WebPWorker* const worker) {
+  PoolJob* const job = GetPoolJob(worker);
+  if (job != NULL) {
+    PoolSync(worker);
+    pthread_mutex_destroy(&job->mutex_);
+    pthread_cond_destroy(&job->condition_);
+    WebPSafeFree(job);
+    worker->impl_ = NULL;
+  }
+  worker->status_ = NOT_OK;
+}
+
+static const WebPWorkerInterface g_pool_interface = {
+  Init, PoolReset, PoolSync, PoolLaunch, Execute, PoolEnd
+};
+
+static void StopThreads(WorkerPool* const pool, int num_threads) {
+  int i;
+  pthread_mutex_lock(&pool->mutex_);
+  pool->stop_ = 1;
+  pthread_cond_broadcast(&pool->condition_);
+  pthread_mutex_unlock(&pool->mutex_);
+  for (i = 0; i < num_threads; ++i) {
+    pthread_join(pool->threads_[i], NULL);
+  }
+}
+
+static void DeletePool(WorkerPool* const pool) {
+  int i;
+  for (i = 0; i < pool->num_threads_; ++i) {
+    pthread_mutex_destroy(&pool->queues_[i].mutex_);
+  }
+  pthread_mutex_destroy(&pool->mutex_);
+  pthread_cond_destroy(&pool->condition_);
+  WebPSafeFree(pool);
+}
+
+const WebPWorkerInterface* WebPWorkerPoolStart(int num_threads) {
+  WorkerPool* pool;
+  int i;
+  if (g_pool != NULL || num_threads < 1 || num_threads > MAX_POOL_THREADS) {
+    return NULL;
+  }
+  pool = (WorkerPool*)WebPSafeCalloc(1, sizeof(*pool));
+  if (pool == NULL) return NULL;
+  pool->num_threads_ = num_threads;
+  if (pthread_mutex_init(&pool->mutex_, NULL)) {
+    WebPSafeFree(pool);
+    return NULL;
+  }
+  if (pthread_cond_init(&pool->condition_, NULL)) {
+    pthread_mutex_destroy(&pool->mutex_);
+    WebPSafeFree(pool);
+    return NULL;
+  }
+  for (i = 0; i < num_threads; ++i) {
+    pthread_mutex_init(&pool->queues_[i].mutex_, NULL);
+  }
+  for (i = 0; i < num_threads; ++i) {
+    g_pool_args[i].pool_ = pool;
+    g_pool_args[i].id_ = i;
+    if (pthread_create(&pool->threads_[i], NULL, PoolLoop, &g_pool_args[i])) {
+      StopThreads(pool, i);
+      DeletePool(pool);
+      return NULL;
+    }
+  }
+  g_pool = pool;
+  return &g_pool_interface;
+}
+
+void WebPWorkerPoolStop(void) {
+  if (g_pool != NULL) {
+    StopThreads(g_pool, g_pool->num_threads_);
+    DeletePool(g_pool);
+    g_pool = NULL;
+  }
+  // Don't leave the pooled interface installed without its threads.
+  if (g_worker_interface.Reset == PoolReset) {
+    const WebPWorkerInterface default_interface = {
+      Init, Reset, Sync, Launch, Execute, End
+    };
+    g_worker_interface = default_interface;
+  }
+}
+
+#undef MAX_POOL_THREADS
+
+#else   // !WEBP_USE_THREAD
+
+const WebPWorkerInterface* WebPWorkerPoolStart(int num_threads) {
+  (void)num_threads;
+  return NULL;
+}
+
+void WebPWorkerPoolStop(void) {}
+
+#endif  // WEBP_USE_THREAD
+
+//------------------------------------------------------------------------------
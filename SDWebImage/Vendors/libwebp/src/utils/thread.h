@@ -46,6 +46,7 @@ typedef struct {
   void* data1;            // first argument passed to 'hook'
   void* data2;            // second argument passed to 'hook'
   int had_error;          // return value of the last call to 'hook'
+  struct WebPMemoryScope* scope_;   // memory scope in which 'hook' is called
 } WebPWorker;
 
 // The interface for all thread-worker related functions. All these functions
@@ -78,12 +79,27 @@ typedef struct {
 // decoding takes place. The contents of the interface struct are copied, it
 // is safe to free the corresponding memory after this call. This function is
 // not thread-safe. Return false in case of invalid pointer or methods.
+// Unlike the default and pooled interfaces, a custom interface doesn't call
+// the hooks in the memory scope of the launching thread (see utils.h): their
+// allocations then bypass the call's WebPMemoryPolicy.
 WEBP_EXTERN(int) WebPSetWorkerInterface(
     const WebPWorkerInterface* const winterface);
 
 // Retrieve the currently set thread worker interface.
 WEBP_EXTERN(const WebPWorkerInterface*) WebPGetWorkerInterface(void);
 
+// Start a pool of 'num_threads' persistent threads (at most 64), and return
+// the worker interface running the workers' jobs on them. It is meant to be
+// installed with WebPSetWorkerInterface(), to avoid creating and joining
+// threads for each picture. Returns NULL in case of error, if a pool is
+// already running or if threads are not supported. Not thread-safe.
+WEBP_EXTERN(const WebPWorkerInterface*) WebPWorkerPoolStart(int num_threads);
+
+// Stop the pool's threads. All the workers using the pooled interface must
+// have been ended before. If the pooled interface is still installed, the
+// default one is restored. Not thread-safe.
+WEBP_EXTERN(void) WebPWorkerPoolStop(void);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
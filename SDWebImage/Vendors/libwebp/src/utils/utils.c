@@ -183,22 +183,345 @@ static int CheckSizeArgumentsOverflow(uint64_t nmemb, size_t size) {
   return 1;
 }
 
+//------------------------------------------------------------------------------
+// Memory scopes
+
+#if defined(_MSC_VER)
+#define WEBP_THREAD_LOCAL __declspec(thread)
+#elif defined(__clang__)
+#if __has_feature(tls)
+#define WEBP_THREAD_LOCAL __thread
+#endif
+#elif defined(__GNUC__)
+#define WEBP_THREAD_LOCAL __thread
+#endif
+
+#if defined(WEBP_THREAD_LOCAL)
+static WEBP_THREAD_LOCAL WebPMemoryScope* g_scope = NULL;
+#define CURRENT_SCOPE() (g_scope)
+#else
+#define CURRENT_SCOPE() ((WebPMemoryScope*)NULL)
+#endif
+
+struct WebPMemoryBlock {
+  void* ptr_;        // NULL for free entries
+  size_t size_;
+  int persistent_;   // true if allocated with malloc()
+};
+
+#if defined(WEBP_USE_THREAD) && defined(WEBP_THREAD_LOCAL)
+#if defined(_WIN32)
+#include <windows.h>
+struct WebPMemoryScopeLock {
+  CRITICAL_SECTION mutex_;
+};
+#define LOCK_INIT(l)     (InitializeCriticalSection(&(l)->mutex_), 1)
+#define LOCK_ACQUIRE(l)  EnterCriticalSection(&(l)->mutex_)
+#define LOCK_RELEASE(l)  LeaveCriticalSection(&(l)->mutex_)
+#define LOCK_DESTROY(l)  DeleteCriticalSection(&(l)->mutex_)
+#else
+#include <pthread.h>
+struct WebPMemoryScopeLock {
+  pthread_mutex_t mutex_;
+};
+#define LOCK_INIT(l)     (pthread_mutex_init(&(l)->mutex_, NULL) == 0)
+#define LOCK_ACQUIRE(l)  pthread_mutex_lock(&(l)->mutex_)
+#define LOCK_RELEASE(l)  pthread_mutex_unlock(&(l)->mutex_)
+#define LOCK_DESTROY(l)  pthread_mutex_destroy(&(l)->mutex_)
+#endif
+#define SCOPE_USES_LOCK 1
+#else
+#define SCOPE_USES_LOCK 0
+#endif
+
+static void* PolicyMalloc(const WebPMemoryPolicy* const policy, size_t size) {
+  return (policy->malloc_func != NULL) ?
+      policy->malloc_func(size, policy->opaque) : malloc(size);
+}
+
+static void PolicyFree(const WebPMemoryPolicy* const policy, void* const ptr) {
+  if (policy->free_func != NULL) {
+    if (ptr != NULL) policy->free_func(ptr, policy->opaque);
+  } else {
+    free(ptr);
+  }
+}
+
+// Charges 'size' bytes to the budget of 'scope'. Returns false if the budget
+// would be exceeded.
+static int Charge(WebPMemoryScope* const scope, size_t size) {
+  const size_t budget = scope->policy_->budget;
+  if (budget > 0 && (size > budget || scope->used_ > budget - size)) {
+    scope->budget_exceeded_ = 1;
+    return 0;
+  }
+  scope->used_ += size;
+  return 1;
+}
+
+static void LockScope(WebPMemoryScope* const scope) {
+#if SCOPE_USES_LOCK
+  if (scope->lock_ != NULL) LOCK_ACQUIRE(scope->lock_);
+#else
+  (void)scope;
+#endif
+}
+
+static void UnlockScope(WebPMemoryScope* const scope) {
+#if SCOPE_USES_LOCK
+  if (scope->lock_ != NULL) LOCK_RELEASE(scope->lock_);
+#else
+  (void)scope;
+#endif
+}
+
+// Creates the lock of 'scope', upon its first allocation. The workers can only
+// share the scope once it holds their state, so this is never done
+// concurrently.
+static int NewLock(WebPMemoryScope* const scope) {
+#if SCOPE_USES_LOCK
+  WebPMemoryScopeLock* lock;
+  if (!Charge(scope, sizeof(*lock))) return 0;
+  lock = (WebPMemoryScopeLock*)PolicyMalloc(scope->policy_, sizeof(*lock));
+  if (lock != NULL && !LOCK_INIT(lock)) {
+    PolicyFree(scope->policy_, lock);
+    lock = NULL;
+  }
+  if (lock == NULL) {
+    scope->used_ -= sizeof(*lock);
+    return 0;
+  }
+  scope->lock_ = lock;
+#else
+  (void)scope;
+#endif
+  return 1;
+}
+
+static void DeleteLock(WebPMemoryScope* const scope) {
+#if SCOPE_USES_LOCK
+  if (scope->lock_ != NULL) {
+    LOCK_DESTROY(scope->lock_);
+    PolicyFree(scope->policy_, scope->lock_);
+    scope->lock_ = NULL;
+  }
+#else
+  (void)scope;
+#endif
+}
+
+static WEBP_INLINE int HashBlock(const WebPMemoryScope* const scope,
+                                 const void* const ptr) {
+  const uint32_t h = (uint32_t)((uintptr_t)ptr >> 4) * 0x9e3779b1u;
+  return (int)((h ^ (h >> 16)) & (scope->max_blocks_ - 1));
+}
+
+static WebPMemoryBlock* FindBlock(const WebPMemoryScope* const scope,
+                                  const void* const ptr) {
+  if (scope->num_blocks_ > 0) {
+    int i = HashBlock(scope, ptr);
+    while (scope->blocks_[i].ptr_ != NULL) {
+      if (scope->blocks_[i].ptr_ == ptr) return &scope->blocks_[i];
+      i = (i + 1) & (scope->max_blocks_ - 1);
+    }
+  }
+  return NULL;
+}
+
+static void PutBlock(WebPMemoryScope* const scope,
+                     const WebPMemoryBlock* const block) {
+  int i = HashBlock(scope, block->ptr_);
+  while (scope->blocks_[i].ptr_ != NULL) i = (i + 1) & (scope->max_blocks_ - 1);
+  scope->blocks_[i] = *block;
+  ++scope->num_blocks_;
+}
+
+static int AddBlock(WebPMemoryScope* const scope, void* const ptr, size_t size,
+                    int persistent) {
+  WebPMemoryBlock block;
+  if (2 * (scope->num_blocks_ + 1) > scope->max_blocks_) {   // grow
+    WebPMemoryBlock* const old_blocks = scope->blocks_;
+    const int old_max_blocks = scope->max_blocks_;
+    const int max_blocks = (old_max_blocks > 0) ? 2 * old_max_blocks : 64;
+    const size_t blocks_size = max_blocks * sizeof(*scope->blocks_);
+    int i;
+    // The hash-set is charged too, the old one being alive during the copy.
+    if (!Charge(scope, blocks_size)) return 0;
+    scope->blocks_ = (WebPMemoryBlock*)PolicyMalloc(scope->policy_,
+                                                     blocks_size);
+    if (scope->blocks_ == NULL) {
+      scope->blocks_ = old_blocks;
+      scope->used_ -= blocks_size;
+      return 0;
+    }
+    memset(scope->blocks_, 0, blocks_size);
+    scope->max_blocks_ = max_blocks;
+    scope->num_blocks_ = 0;
+    for (i = 0; i < old_max_blocks; ++i) {
+      if (old_blocks[i].ptr_ != NULL) PutBlock(scope, &old_blocks[i]);
+    }
+    PolicyFree(scope->policy_, old_blocks);
+    scope->used_ -= old_max_blocks * sizeof(*scope->blocks_);
+  }
+  block.ptr_ = ptr;
+  block.size_ = size;
+  block.persistent_ = persistent;
+  PutBlock(scope, &block);
+  return 1;
+}
+
+static void RemoveBlock(WebPMemoryScope* const scope,
+                        WebPMemoryBlock* const block) {
+  const int mask = scope->max_blocks_ - 1;
+  int i = (int)(block - scope->blocks_);
+  int j = i;
+  // Backward-shift deletion, to keep the probing sequences unbroken.
+  block->ptr_ = NULL;
+  --scope->num_blocks_;
+  while (1) {
+    int k;
+    j = (j + 1) & mask;
+    if (scope->blocks_[j].ptr_ == NULL) break;
+    k = HashBlock(scope, scope->blocks_[j].ptr_);
+    // Move the entry if its home position 'k' is not within ]i, j].
+    if ((j > i) ? (k <= i || k > j) : (k <= i && k > j)) {
+      scope->blocks_[i] = scope->blocks_[j];
+      scope->blocks_[j].ptr_ = NULL;
+      i = j;
+    }
+  }
+}
+
+static void FreeBlock(const WebPMemoryScope* const scope, void* const ptr,
+                      int persistent) {
+  if (persistent) {
+    free(ptr);
+  } else {
+    PolicyFree(scope->policy_, ptr);
+  }
+}
+
+// Allocates 'size' bytes for the current 'scope', within its budget.
+static void* ScopeMalloc(WebPMemoryScope* const scope, size_t size,
+                         int persistent) {
+  void* ptr = NULL;
+  if (scope->lock_ == NULL && !NewLock(scope)) return NULL;
+  LockScope(scope);
+  if (Charge(scope, size)) {
+    ptr = persistent ? malloc(size) : PolicyMalloc(scope->policy_, size);
+    if (ptr != NULL && !AddBlock(scope, ptr, size, persistent)) {
+      FreeBlock(scope, ptr, persistent);
+      ptr = NULL;
+    }
+    if (ptr == NULL) scope->used_ -= size;
+  }
+  UnlockScope(scope);
+  return ptr;
+}
+
+// Releases 'ptr' if it was allocated in one of the scopes of the thread.
+static int ScopeFree(void* const ptr) {
+  WebPMemoryScope* scope;
+  for (scope = CURRENT_SCOPE(); scope != NULL; scope = scope->prev_) {
+    WebPMemoryBlock* block;
+    LockScope(scope);
+    block = FindBlock(scope, ptr);
+    if (block != NULL) {
+      const int persistent = block->persistent_;
+      scope->used_ -= block->size_;
+      RemoveBlock(scope, block);
+      FreeBlock(scope, ptr, persistent);
+    }
+    UnlockScope(scope);
+    if (block != NULL) return 1;
+  }
+  return 0;
+}
+
+int WebPMemoryScopeBegin(WebPMemoryScope* const scope,
+                         const WebPMemoryPolicy* const policy) {
+  assert(scope != NULL && policy != NULL);
+  memset(scope, 0, sizeof(*scope));
+  scope->policy_ = policy;
+#if defined(WEBP_THREAD_LOCAL)
+  scope->prev_ = g_scope;
+  g_scope = scope;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+void WebPMemoryScopeEnd(WebPMemoryScope* const scope) {
+#if defined(WEBP_THREAD_LOCAL)
+  int i;
+  assert(scope == g_scope);
+  // Only the persistent blocks can outlive the scope.
+  for (i = 0; i < scope->max_blocks_; ++i) {
+    assert(scope->blocks_[i].ptr_ == NULL || scope->blocks_[i].persistent_);
+  }
+  (void)i;
+  PolicyFree(scope->policy_, scope->blocks_);
+  scope->blocks_ = NULL;
+  DeleteLock(scope);
+  g_scope = scope->prev_;
+#else
+  (void)scope;
+#endif
+}
+
+WebPMemoryScope* WebPMemoryScopeGetCurrent(void) {
+  return CURRENT_SCOPE();
+}
+
+WebPMemoryScope* WebPMemoryScopeSwap(WebPMemoryScope* const scope) {
+  WebPMemoryScope* const prev = CURRENT_SCOPE();
+#if defined(WEBP_THREAD_LOCAL)
+  g_scope = scope;
+#else
+  (void)scope;
+#endif
+  return prev;
+}
+
+//------------------------------------------------------------------------------
+
 void* WebPSafeMalloc(uint64_t nmemb, size_t size) {
+  WebPMemoryScope* const scope = CURRENT_SCOPE();
+  void* ptr;
+  Increment(&num_malloc_calls);
+  if (!CheckSizeArgumentsOverflow(nmemb, size)) return NULL;
+  assert(nmemb * size > 0);
+  ptr = (scope != NULL) ? ScopeMalloc(scope, (size_t)(nmemb * size), 0)
+                        : malloc((size_t)(nmemb * size));
+  AddMem(ptr, (size_t)(nmemb * size));
+  return ptr;
+}
+
+void* WebPSafeMallocPersistent(uint64_t nmemb, size_t size) {
+  WebPMemoryScope* const scope = CURRENT_SCOPE();
   void* ptr;
   Increment(&num_malloc_calls);
   if (!CheckSizeArgumentsOverflow(nmemb, size)) return NULL;
   assert(nmemb * size > 0);
-  ptr = malloc((size_t)(nmemb * size));
+  ptr = (scope != NULL) ? ScopeMalloc(scope, (size_t)(nmemb * size), 1)
+                        : malloc((size_t)(nmemb * size));
   AddMem(ptr, (size_t)(nmemb * size));
   return ptr;
 }
 
 void* WebPSafeCalloc(uint64_t nmemb, size_t size) {
+  WebPMemoryScope* const scope = CURRENT_SCOPE();
   void* ptr;
   Increment(&num_calloc_calls);
   if (!CheckSizeArgumentsOverflow(nmemb, size)) return NULL;
   assert(nmemb * size > 0);
-  ptr = calloc((size_t)nmemb, size);
+  if (scope != NULL) {
+    ptr = ScopeMalloc(scope, (size_t)(nmemb * size), 0);
+    if (ptr != NULL) memset(ptr, 0, (size_t)(nmemb * size));
+  } else {
+    ptr = calloc((size_t)nmemb, size);
+  }
   AddMem(ptr, (size_t)(nmemb * size));
   return ptr;
 }
@@ -207,6 +530,7 @@ void WebPSafeFree(void* const ptr) {
   if (ptr != NULL) {
     Increment(&num_free_calls);
     SubMem(ptr);
+    if (ScopeFree(ptr)) return;
   }
   free(ptr);
 }
@@ -218,6 +542,32 @@ void WebPFree(void* ptr) {
 
 //------------------------------------------------------------------------------
 
+#if defined(WEBP_STAGE_TIMING)
+#if defined(_WIN32)
+#include <windows.h>
+
+uint64_t WebPGetTimeNs(void) {
+  LARGE_INTEGER freq, count;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&count);
+  // Split the conversion to avoid overflowing 64 bits.
+  return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000ULL +
+         (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000ULL /
+             (uint64_t)freq.QuadPart;
+}
+#else
+#include <time.h>
+
+uint64_t WebPGetTimeNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif  // _WIN32
+#endif  // WEBP_STAGE_TIMING
+
+//------------------------------------------------------------------------------
+
 void WebPCopyPlane(const uint8_t* src, int src_stride,
                    uint8_t* dst, int dst_stride, int width, int height) {
   assert(src != NULL && dst != NULL);
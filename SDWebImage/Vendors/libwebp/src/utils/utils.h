@@ -48,6 +48,54 @@ WEBP_EXTERN(void*) WebPSafeCalloc(uint64_t nmemb, size_t size);
 // Companion deallocation function to the above allocations.
 WEBP_EXTERN(void) WebPSafeFree(void* const ptr);
 
+// Same as WebPSafeMalloc(), for memory owned by objects that can outlive the
+// current memory scope (output buffers, pictures...): it is charged to the
+// budget of the scope, but always comes from malloc().
+WEBP_EXTERN(void*) WebPSafeMallocPersistent(uint64_t nmemb, size_t size);
+
+//------------------------------------------------------------------------------
+// Memory scopes
+//
+// While a scope is active on a thread, the blocks allocated from this thread
+// by WebPSafeMalloc() and WebPSafeCalloc() come from the allocator of the
+// scope's WebPMemoryPolicy, and are charged to its budget. They must be
+// released by WebPSafeFree() before the scope ends. The hooks launched by the
+// default and pooled worker interfaces (see thread.h) run in the scope of the
+// launching thread, so a scope can be used by several threads at once: its
+// accesses, including the calls to the policy's allocator, are serialized.
+
+typedef struct WebPMemoryBlock WebPMemoryBlock;
+typedef struct WebPMemoryScopeLock WebPMemoryScopeLock;
+typedef struct WebPMemoryScope WebPMemoryScope;
+struct WebPMemoryScope {
+  const WebPMemoryPolicy* policy_;
+  size_t used_;                // number of bytes charged to the budget,
+                               // including the bookkeeping below
+  int budget_exceeded_;        // true if an allocation was denied
+  WebPMemoryBlock* blocks_;    // hash-set of the blocks allocated in the scope
+  int num_blocks_;
+  int max_blocks_;             // size of blocks_[], zero or a power of 2
+  WebPMemoryScopeLock* lock_;  // serializes the accesses of the threads
+  WebPMemoryScope* prev_;      // enclosing scope
+};
+
+// Makes 'scope' the current scope of the calling thread, using 'policy', until
+// the matching call to WebPMemoryScopeEnd(). Returns false if memory scopes
+// are not supported on this platform.
+WEBP_EXTERN(int) WebPMemoryScopeBegin(WebPMemoryScope* const scope,
+                                      const WebPMemoryPolicy* const policy);
+
+// Restores the previous scope of the calling thread.
+WEBP_EXTERN(void) WebPMemoryScopeEnd(WebPMemoryScope* const scope);
+
+// Returns the current scope of the calling thread, or NULL if there is none.
+WEBP_EXTERN(WebPMemoryScope*) WebPMemoryScopeGetCurrent(void);
+
+// Makes 'scope' (possibly NULL) the current scope of the calling thread, and
+// returns the previous one. This is used by the worker threads to run a hook
+// in the scope of the thread which launched it.
+WEBP_EXTERN(WebPMemoryScope*) WebPMemoryScopeSwap(WebPMemoryScope* const scope);
+
 //------------------------------------------------------------------------------
 // Alignment
 
@@ -145,6 +193,32 @@ static WEBP_INLINE int BitsLog2Floor(uint32_t n) {
 }
 #endif
 
+//------------------------------------------------------------------------------
+// Stage timing.
+// When WEBP_STAGE_TIMING is defined, the stages of the decoders and encoders
+// are timed with a monotonic clock (see WebPDecStageStats and
+// WebPEncStageStats). Otherwise, the timers compile to nothing.
+
+#if defined(WEBP_STAGE_TIMING)
+// Returns the current time of a monotonic clock, in nanoseconds.
+WEBP_EXTERN(uint64_t) WebPGetTimeNs(void);
+
+static WEBP_INLINE uint64_t WebPTimerStart(void) {
+  return WebPGetTimeNs();
+}
+
+// Adds the time elapsed since 'start' to '*acc'.
+static WEBP_INLINE void WebPTimerAdd(uint64_t* const acc, uint64_t start) {
+  *acc += WebPGetTimeNs() - start;
+}
+#else
+static WEBP_INLINE uint64_t WebPTimerStart(void) { return 0; }
+static WEBP_INLINE void WebPTimerAdd(uint64_t* const acc, uint64_t start) {
+  (void)acc;
+  (void)start;
+}
+#endif  // WEBP_STAGE_TIMING
+
 //------------------------------------------------------------------------------
 // Pixel copying.
 
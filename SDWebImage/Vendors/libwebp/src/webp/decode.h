@@ -20,7 +20,7 @@
 extern "C" {
 #endif
 
-#define WEBP_DECODER_ABI_VERSION 0x0208    // MAJOR(8b) + MINOR(8b)
+#define WEBP_DECODER_ABI_VERSION 0x0302    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -30,9 +30,12 @@ typedef struct WebPRGBABuffer WebPRGBABuffer;
 typedef struct WebPYUVABuffer WebPYUVABuffer;
 typedef struct WebPDecBuffer WebPDecBuffer;
 typedef struct WebPIDecoder WebPIDecoder;
+typedef struct WebPISegment WebPISegment;
 typedef struct WebPBitstreamFeatures WebPBitstreamFeatures;
 typedef struct WebPDecoderOptions WebPDecoderOptions;
 typedef struct WebPDecoderConfig WebPDecoderConfig;
+typedef struct WebPDecContext WebPDecContext;
+typedef struct WebPDecStageStats WebPDecStageStats;
 
 // Return the decoder's version number, packed in hexadecimal using 8bits for
 // each of major/minor/revision. E.g: v2.5.7 is 0x020507.
@@ -128,6 +131,20 @@ WEBP_EXTERN(uint8_t*) WebPDecodeYUVInto(
     uint8_t* u, size_t u_size, int u_stride,
     uint8_t* v, size_t v_size, int v_stride);
 
+// Variants of WebPDecodeYUVInto() for the semi-planar NV12 (U first) and NV21
+// (V first) layouts: the chroma samples are written interleaved into the
+// single 'uv' plane of 'uv_size' bytes, whose rows hold 2 * ((width + 1) / 2)
+// samples and are 'uv_stride' bytes apart. Neither plane needs any particular
+// alignment, so they can point straight into the frames of a video pipeline.
+WEBP_EXTERN(uint8_t*) WebPDecodeNV12Into(
+    const uint8_t* data, size_t data_size,
+    uint8_t* luma, size_t luma_size, int luma_stride,
+    uint8_t* uv, size_t uv_size, int uv_stride);
+WEBP_EXTERN(uint8_t*) WebPDecodeNV21Into(
+    const uint8_t* data, size_t data_size,
+    uint8_t* luma, size_t luma_size, int luma_stride,
+    uint8_t* uv, size_t uv_size, int uv_stride);
+
 //------------------------------------------------------------------------------
 // Output colorspaces and buffer
 
@@ -155,7 +172,10 @@ typedef enum WEBP_CSP_MODE {
   MODE_rgbA_4444 = 10,
   // YUV modes must come after RGB ones.
   MODE_YUV = 11, MODE_YUVA = 12,  // yuv 4:2:0
-  MODE_LAST = 13
+  // Semi-planar yuv 4:2:0: the luma plane is followed by a single chroma plane
+  // of interleaved samples, U first (NV12) or V first (NV21).
+  MODE_NV12 = 13, MODE_NV21 = 14,
+  MODE_LAST = 15
 } WEBP_CSP_MODE;
 
 // Some useful macros:
@@ -174,6 +194,10 @@ static WEBP_INLINE int WebPIsRGBMode(WEBP_CSP_MODE mode) {
   return (mode < MODE_YUV);
 }
 
+static WEBP_INLINE int WebPIsSemiPlanarMode(WEBP_CSP_MODE mode) {
+  return (mode == MODE_NV12 || mode == MODE_NV21);
+}
+
 //------------------------------------------------------------------------------
 // WebPDecBuffer: Generic structure for describing the output sample buffer.
 
@@ -183,6 +207,11 @@ struct WebPRGBABuffer {    // view as RGBA
   size_t size;      // total size of the *rgba buffer.
 };
 
+// For MODE_NV12 and MODE_NV21, 'u' and 'v' point to the first U and V
+// samples of the interleaved chroma plane ('v = u + 1' for NV12 and
+// 'u = v + 1' for NV21), 'u_stride' and 'v_stride' must be equal, 'u_size' and
+// 'v_size' are the number of bytes available from each pointer on, and the
+// alpha plane is not used.
 struct WebPYUVABuffer {              // view as YUVA
   uint8_t* y, *u, *v, *a;     // pointer to luma, chroma U/V, alpha samples
   int y_stride;               // luma stride
@@ -236,7 +265,8 @@ typedef enum VP8StatusCode {
   VP8_STATUS_UNSUPPORTED_FEATURE,
   VP8_STATUS_SUSPENDED,
   VP8_STATUS_USER_ABORT,
-  VP8_STATUS_NOT_ENOUGH_DATA
+  VP8_STATUS_NOT_ENOUGH_DATA,
+  VP8_STATUS_MEMORY_BUDGET_EXCEEDED
 } VP8StatusCode;
 
 //------------------------------------------------------------------------------
@@ -335,6 +365,20 @@ WEBP_EXTERN(VP8StatusCode) WebPIAppend(
 WEBP_EXTERN(VP8StatusCode) WebPIUpdate(
     WebPIDecoder* idec, const uint8_t* data, size_t data_size);
 
+// A memory segment of the input, for WebPIAppendSegments().
+struct WebPISegment {
+  const uint8_t* data;
+  size_t size;
+};
+
+// A variant of WebPIAppend() taking the next data as a list of 'num_segments'
+// segments, to be read in sequence. The segments are not copied (only the
+// headers are, when they straddle segments): their content must remain valid
+// and unchanged until the decoding is complete or WebPIDelete() is called.
+// This mode can't be mixed with WebPIAppend() or WebPIUpdate().
+WEBP_EXTERN(VP8StatusCode) WebPIAppendSegments(
+    WebPIDecoder* idec, const WebPISegment* segments, int num_segments);
+
 // Returns the RGB/A image decoded so far. Returns NULL if output params
 // are not initialized yet. The RGB/A output type corresponds to the colorspace
 // specified during call to WebPINewDecoder() or WebPINewRGB().
@@ -431,6 +475,28 @@ static WEBP_INLINE VP8StatusCode WebPGetFeatures(
                                  WEBP_DECODER_ABI_VERSION);
 }
 
+// Decoding statistics
+// Time spent in each stage of a decoding call, in nanoseconds, along with the
+// amount of data processed. The timings are only measured when the library is
+// built with WEBP_STAGE_TIMING defined, and are left to zero otherwise. When
+// the stages run on different threads, their timings add up to more than
+// 'total_ns', which is the wall-clock time of the call(s).
+struct WebPDecStageStats {
+  uint64_t header_ns;       // parsing of the VP8/VP8L headers
+  uint64_t tokens_ns;       // parsing of the modes and residuals (lossy), or
+                            // entropy decoding of the pixels (lossless)
+  uint64_t reconstruct_ns;  // prediction + inverse transforms
+  uint64_t filter_ns;       // in-loop filtering and dithering (lossy only)
+  uint64_t convert_ns;      // upsampling and colorspace conversion
+  uint64_t alpha_ns;        // decoding of the alpha plane (lossy only)
+  uint64_t rescale_ns;      // rescaling and conversion, if 'use_scaling'
+  uint64_t total_ns;        // whole decoding
+  uint64_t bytes_in;        // size of the input data
+  uint64_t alpha_bytes;     // size of the compressed alpha data
+  int num_mbs;              // number of macroblocks parsed (lossy only)
+  uint32_t pad[3];          // padding for later use
+};
+
 // Decoding options
 struct WebPDecoderOptions {
   int bypass_filtering;               // if true, skip the in-loop filtering
@@ -445,8 +511,28 @@ struct WebPDecoderOptions {
   int dithering_strength;             // dithering strength (0=Off, 100=full)
   int flip;                           // flip output vertically
   int alpha_dithering_strength;       // alpha dithering strength in [0..100]
-
-  uint32_t pad[5];                    // padding for later use
+  int num_threads;                    // if use_threads is true and this is
+                                      // larger than 2, decode lossy pictures
+                                      // using this many threads
+  int use_quarter_thumbnail;          // if true, lossy pictures are decoded
+                                      // as approximate thumbnails of size
+                                      // ((width + 3) / 4, (height + 3) / 4),
+                                      // averaging each unfiltered 4x4 block.
+                                      // Cropping and scaling then apply to
+                                      // this size. Lossless pictures are
+                                      // decoded at full size.
+  WebPRescalingFilter rescaling_filter;  // resampling filter used when
+                                      // 'use_scaling' is true. The default
+                                      // is WEBP_RESCALE_BOX.
+  const WebPMemoryPolicy* memory;     // if not NULL, custom allocator and
+                                      // memory budget for the call. Not
+                                      // supported by incremental decoding.
+  WebPDecStageStats* stage_stats;     // if not NULL, receives the timings of
+                                      // the decoding stages, once the
+                                      // picture is completely decoded.
+
+  uint32_t pad[2];                    // padding for later use
+  void* pad2[1];                      // padding for later pointers
 };
 
 // Main object storing the configuration for advanced decoding.
@@ -486,6 +572,48 @@ WEBP_EXTERN(WebPIDecoder*) WebPIDecode(const uint8_t* data, size_t data_size,
 WEBP_EXTERN(VP8StatusCode) WebPDecode(const uint8_t* data, size_t data_size,
                                       WebPDecoderConfig* config);
 
+// Callback receiving the decoded rows [y, y + band->height) of the output
+// picture, in the colorspace requested by config->output.colorspace. 'band'
+// and its samples are only valid during the call. For the YUV colorspaces, 'y'
+// is even, and so is band->height except for the very last rows.
+// Must return false to abort the decoding, true otherwise.
+typedef int (*WebPRowCallback)(const WebPDecBuffer* band, int y,
+                               void* user_data);
+
+// Streaming version of WebPDecode(): instead of being stored in
+// config->output, the output rows are handed to 'put' (along with 'user_data')
+// band by band, as soon as they are decoded. Only a few rows are held in
+// memory at any time, whatever the size of the picture. Cropping, scaling
+// and multi-threading options are supported, 'config->options.flip' is not.
+// config->output must not reference external memory, and only its colorspace
+// is used. On return, config->output.width/height are set to the output
+// dimensions. Returns VP8_STATUS_USER_ABORT if 'put' returned false.
+WEBP_EXTERN(VP8StatusCode) WebPDecodeRows(const uint8_t* data,
+                                          size_t data_size,
+                                          WebPDecoderConfig* config,
+                                          WebPRowCallback put,
+                                          void* user_data);
+
+// Reusable decoding context. When decoding many pictures in a row, passing the
+// same context to WebPDecodeWithContext() keeps the decoder's internal buffers
+// (working memory, pixel cache, Huffman tables, rescaling scratch...) alive
+// from one call to the next, growing them as needed, instead of allocating
+// and releasing them for every picture.
+// A context must not be used by several decodings at the same time.
+
+// Returns a new empty context, or NULL in case of memory error.
+WEBP_EXTERN(WebPDecContext*) WebPDecContextNew(void);
+
+// Releases 'context' and all the memory it holds.
+WEBP_EXTERN(void) WebPDecContextDelete(WebPDecContext* context);
+
+// Same as WebPDecode(), but using (and updating) the memory held by 'context'.
+// If 'context' is NULL, this is equivalent to WebPDecode().
+WEBP_EXTERN(VP8StatusCode) WebPDecodeWithContext(WebPDecContext* context,
+                                                 const uint8_t* data,
+                                                 size_t data_size,
+                                                 WebPDecoderConfig* config);
+
 #ifdef __cplusplus
 }    // extern "C"
 #endif
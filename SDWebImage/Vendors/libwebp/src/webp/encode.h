@@ -20,7 +20,7 @@
 extern "C" {
 #endif
 
-#define WEBP_ENCODER_ABI_VERSION 0x0209    // MAJOR(8b) + MINOR(8b)
+#define WEBP_ENCODER_ABI_VERSION 0x0301    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -31,6 +31,7 @@ extern "C" {
 typedef struct WebPConfig WebPConfig;
 typedef struct WebPPicture WebPPicture;   // main structure for I/O
 typedef struct WebPAuxStats WebPAuxStats;
+typedef struct WebPEncStageStats WebPEncStageStats;
 typedef struct WebPMemoryWriter WebPMemoryWriter;
 
 // Return the encoder's version number, packed in hexadecimal using 8bits for
@@ -90,11 +91,32 @@ typedef enum WebPImageHint {
   WEBP_HINT_LAST
 } WebPImageHint;
 
+// Time spent in each stage of WebPEncode(), in nanoseconds, along with the
+// amount of data processed. The timings are only measured when the library is
+// built with WEBP_STAGE_TIMING defined, and are left to zero otherwise. The
+// alpha plane can be compressed in parallel with the other stages.
+struct WebPEncStageStats {
+  uint64_t convert_ns;    // RGB <-> YUV conversion of the input
+  uint64_t analysis_ns;   // segmentation analysis (lossy), or image analysis
+                          // and near-lossless preprocessing (lossless)
+  uint64_t transform_ns;  // palette and predictive transforms (lossless only)
+  uint64_t coding_ns;     // macroblock coding and token recording (lossy),
+                          // or backward references and entropy coding
+  uint64_t bitstream_ns;  // writing of the final bitstream
+  uint64_t alpha_ns;      // compression of the alpha plane (lossy only)
+  uint64_t total_ns;      // whole WebPEncode() call
+  uint64_t bytes_out;     // size of the output
+  int num_mbs;            // number of macroblocks coded (lossy only)
+  uint32_t pad[3];        // padding for later use
+};
+
 // Compression parameters.
 struct WebPConfig {
   int lossless;           // Lossless encoding (0=lossy(default), 1=lossless).
   float quality;          // between 0 (smallest file) and 100 (biggest)
   int method;             // quality/speed trade-off (0=fast, 6=slower-better)
+                          // -1 selects the realtime lossy mode, with larger
+                          // files (same as 0 for lossless).
 
   WebPImageHint image_hint;  // Hint for image type (lossless only for now).
 
@@ -132,6 +154,10 @@ struct WebPConfig {
                           // JPEG compression. Generally, the output size will
                           // be similar but the degradation will be lower.
   int thread_level;       // If non-zero, try and use multi-threaded encoding.
+                          // Values above 1 also set the number of threads
+                          // coding the macroblocks in lossy mode (method>=3),
+                          // and of quantizers tried at once when searching
+                          // for target_size or target_PSNR.
   int low_memory;         // If set, reduce memory usage (but increase CPU use).
 
   int near_lossless;      // Near lossless encoding [0 = max loss .. 100 = off
@@ -140,6 +166,10 @@ struct WebPConfig {
                           // transparent area. Otherwise, discard this invisible
                           // RGB information for better compression. The default
                           // value is 0.
+  const WebPMemoryPolicy* memory;  // if not NULL, custom allocator and memory
+                                   // budget for WebPEncode().
+  WebPEncStageStats* stage_stats;  // if not NULL, receives the timings of
+                                   // the encoding stages.
 
 #ifdef WEBP_EXPERIMENTAL_FEATURES
   int delta_palettization;
@@ -147,6 +177,7 @@ struct WebPConfig {
 #else
   uint32_t pad[3];        // padding for later use
 #endif  // WEBP_EXPERIMENTAL_FEATURES
+  void* pad2[1];          // padding for later pointers
 };
 
 // Enumerate some predefined settings for WebPConfig, depending on the type
@@ -282,6 +313,7 @@ typedef enum WebPEncodingError {
   VP8_ENC_ERROR_BAD_WRITE,                // error while flushing bytes
   VP8_ENC_ERROR_FILE_TOO_BIG,             // file is bigger than 4G
   VP8_ENC_ERROR_USER_ABORT,               // abort request by user
+  VP8_ENC_ERROR_MEMORY_BUDGET,            // config->memory budget exceeded
   VP8_ENC_ERROR_LAST                      // list terminator. always last.
 } WebPEncodingError;
 
@@ -434,6 +466,15 @@ WEBP_EXTERN(int) WebPPictureIsView(const WebPPicture* picture);
 // Returns false in case of error (invalid parameter or insufficient memory).
 WEBP_EXTERN(int) WebPPictureRescale(WebPPicture* pic, int width, int height);
 
+// Same as WebPPictureRescale(), using the resampling 'filter' instead of the
+// default box filter. Up to 'num_threads' threads (capped at 16) each rescale
+// a band of the output rows; the result does not depend on 'num_threads'.
+// Returns false in case of error (invalid parameter or insufficient memory).
+WEBP_EXTERN(int) WebPPictureRescaleWithFilter(WebPPicture* pic,
+                                              int width, int height,
+                                              WebPRescalingFilter filter,
+                                              int num_threads);
+
 // Colorspace conversion function to import RGB samples.
 // Previous buffer will be free'd, if any.
 // *rgb buffer should have a size of at least height * rgb_stride.
@@ -46,6 +46,31 @@ typedef long long int int64_t;
 # endif  /* __GNUC__ >= 4 */
 #endif  /* WEBP_EXTERN */
 
+// Custom memory management for a decoding or encoding call (see
+// WebPDecoderOptions::memory and WebPConfig::memory).
+typedef struct WebPMemoryPolicy WebPMemoryPolicy;
+struct WebPMemoryPolicy {
+  // Allocator for the working memory of the call. If NULL, malloc() and free()
+  // are used. The memory which can outlive the call (output buffers, picture
+  // samples...) always comes from malloc(). The worker threads of
+  // multi-threaded calls allocate through the policy too, so these functions
+  // can be called from several threads, though never concurrently.
+  void* (*malloc_func)(size_t size, void* opaque);
+  void (*free_func)(void* ptr, void* opaque);
+  void* opaque;       // passed to malloc_func() and free_func()
+  // Maximum number of bytes allocated at any time during the call, including
+  // the bookkeeping of the allocations (0 = no limit). The call fails as soon
+  // as an allocation would exceed it.
+  size_t budget;
+};
+
+// Resampling filters used for rescaling (see WebPDecoderOptions and
+// WebPPictureRescaleWithFilter()).
+typedef enum WebPRescalingFilter {
+  WEBP_RESCALE_BOX = 0,     // area averaging (bilinear when enlarging). Fast.
+  WEBP_RESCALE_LANCZOS3     // 3-lobe Lanczos windowed sinc. Sharper, slower.
+} WebPRescalingFilter;
+
 // Macro to check ABI compatibility (same major revision number)
 #define WEBP_ABI_IS_INCOMPATIBLE(a, b) (((a) >> 8) != ((b) >> 8))
 